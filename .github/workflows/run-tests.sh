@@ -4,6 +4,22 @@ set -ex
 set -o pipefail
 
 ninja -C ./build test
+# Smoke test of the generator benchmarks, the results should be valid JSON
+./build/bench-generators --duration=10 --output=bench.json
+python3 -c 'import json; assert len(json.load(open("bench.json"))["benchmarks"]) > 10'
+# Same for the end-to-end benchmark on a private bus, with a slow and leaky server
+# exporting an object tree (100 objects, each fuzzed 10 times at least)
+test/bench-e2e.py --dfuzzer ./build/dfuzzer --test-server ./build/dfuzzer-test-server \
+                  --runs=1 --iterations=200 --traversal-iterations=10 --output=bench.json \
+                  --server-arg=--latency=1 --server-arg=--latency-jitter=2 --server-arg=--burn=10 \
+                  --server-arg=--leak-memory=1024 --server-arg=--tree-objects=100 --server-arg=--tree-object-manager
+python3 -c 'import json; assert json.load(open("bench.json"))["benchmarks"][1]["calls"] > 100 * 10'
+python3 -c 'import json; assert all(b["calls"] > 0 for b in json.load(open("bench.json"))["benchmarks"])'
+rm -f bench.json
+test/bench-bugs.py --dfuzzer ./build/dfuzzer --test-server ./build/dfuzzer-test-server \
+                   --seeds=1 --max-iterations=2000 --bug=boundary_int --bug=array_length --output=bench.json
+python3 -c 'import json; assert all(b["found"] == 1 for b in json.load(open("bench.json"))["bugs"])'
+rm -f bench.json
 
 dfuzzer=("dfuzzer")
 if [[ "$TYPE" == valgrind ]]; then
@@ -34,6 +50,8 @@ set -e
 # Make sure we can process complex signatures without issues
 "${dfuzzer[@]}" -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_complex_sig_1
 "${dfuzzer[@]}" -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_complex_sig_2
+# Same as above, but with maximally nested values in variants
+"${dfuzzer[@]}" --nesting-stress -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_complex_sig_2
 
 # Crash on a specific string
 "${dfuzzer[@]}" -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_crash_on_leeroy
@@ -46,12 +64,234 @@ you guessed it - also a string
 no way this is a string as well
 EOF
 "${dfuzzer[@]}" -f inputs.txt -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_crash_on_leeroy && false
+# Same as above, but with a binary log, which should render the same as the text one
+mkdir dfuzzer-binlogs
+"${dfuzzer[@]}" --log-dir dfuzzer-binlogs --log-format=binary -f inputs.txt -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_crash_on_leeroy && false
+dfuzzer-log dfuzzer-binlogs/org.freedesktop.dfuzzerServer.dflog | tee dfuzzer-binlogs/rendered
+grep -F "df_crash_on_leeroy;(s);('Leeroy Jenkins',);Crash" dfuzzer-binlogs/rendered
+grep -c ";Success$" dfuzzer-binlogs/rendered
+dfuzzer-log - <dfuzzer-binlogs/org.freedesktop.dfuzzerServer.dflog | cmp - dfuzzer-binlogs/rendered
+dfuzzer-log dfuzzer-binlogs/rendered && false
+dfuzzer-log /a/b/c/d/e && false
+dfuzzer-log && false
+# Compressed logs (both formats) should contain the same records
+"${dfuzzer[@]}" --log-dir dfuzzer-binlogs --log-format=binary --log-compress -f inputs.txt -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_crash_on_leeroy && false
+dfuzzer-log dfuzzer-binlogs/org.freedesktop.dfuzzerServer.dflog.gz | grep -F "df_crash_on_leeroy;(s);('Leeroy Jenkins',);Crash"
+"${dfuzzer[@]}" --log-dir dfuzzer-binlogs --log-compress -f inputs.txt -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_crash_on_leeroy && false
+zcat dfuzzer-binlogs/org.freedesktop.dfuzzerServer.gz | grep -F "df_crash_on_leeroy;(s);('Leeroy Jenkins',);Crash"
+# With the flight recorder only the last N inputs preceding the crash are logged
+"${dfuzzer[@]}" --log-dir dfuzzer-binlogs --flight-recorder=2 -f inputs.txt -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_crash_on_leeroy && false
+grep -F "df_crash_on_leeroy;(s);('Leeroy Jenkins',);Crash" dfuzzer-binlogs/org.freedesktop.dfuzzerServer
+[[ $(grep -c ";Success$" dfuzzer-binlogs/org.freedesktop.dfuzzerServer) -eq 2 ]]
+"${dfuzzer[@]}" --flight-recorder=2 -n org.freedesktop.dfuzzerServer && false
+"${dfuzzer[@]}" --log-dir dfuzzer-binlogs --flight-recorder=0 -n org.freedesktop.dfuzzerServer && false
+# The JSON event stream should contain the failure with its input, both when
+# written into a file and into a file descriptor
+"${dfuzzer[@]}" --json=dfuzzer-binlogs/events.json -f inputs.txt -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_crash_on_leeroy && false
+"${dfuzzer[@]}" --json=3 -f inputs.txt -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_crash_on_leeroy 3>dfuzzer-binlogs/events-fd.json && false
+for f in dfuzzer-binlogs/events.json dfuzzer-binlogs/events-fd.json; do
+    python3 - "$f" <<'EOF'
+import json, sys
+
+data = open(sys.argv[1]).read()
+assert data.startswith("\x1e")
+events = [json.loads(record) for record in data.split("\x1e")[1:]]
+assert events[0]["event"] == "run_start" and events[-1]["event"] == "run_end"
+failure = next(e for e in events if e["event"] == "failure")
+assert failure["name"] == "df_crash_on_leeroy" and failure["input"] == "('Leeroy Jenkins',)", failure
+assert failure["crash"], failure
+assert any(e["event"] == "test_end" and e["result"] == "FAIL" for e in events)
+EOF
+done
+"${dfuzzer[@]}" --json=42 -n org.freedesktop.dfuzzerServer && false
+# The summary should account the crash to the crashing method
+"${dfuzzer[@]}" --log-dir dfuzzer-binlogs -f inputs.txt -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_crash_on_leeroy && false
+cat dfuzzer-binlogs/org.freedesktop.dfuzzerServer.stats
+grep -E "^org\.freedesktop\.dfuzzerInterface\.df_crash_on_leeroy +[0-9]+ +[0-9]+ +[0-9]+ +1 " dfuzzer-binlogs/org.freedesktop.dfuzzerServer.stats
+# Prometheus metrics
+"${dfuzzer[@]}" --metrics-file=dfuzzer-binlogs/dfuzzer.prom -f inputs.txt -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_crash_on_leeroy && false
+cat dfuzzer-binlogs/dfuzzer.prom
+grep -E "^dfuzzer_calls_total [1-9][0-9]*$" dfuzzer-binlogs/dfuzzer.prom
+grep -E "^dfuzzer_crashes_total 1$" dfuzzer-binlogs/dfuzzer.prom
+grep -F 'dfuzzer_interface_members_tested{object="/org/freedesktop/dfuzzerObject",interface="org.freedesktop.dfuzzerInterface"} 1' dfuzzer-binlogs/dfuzzer.prom
+"${dfuzzer[@]}" --metrics-file=/a/b/c/d/e -n org.freedesktop.dfuzzerServer && false
+# Pause a long running test over the control socket, then skip it
+"${dfuzzer[@]}" --control-socket=dfuzzer-binlogs/control -I 1000000 -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_complex_sig_1 &
+dfuzzer_pid=$!
+python3 - dfuzzer-binlogs/control <<'EOF'
+import os, socket, sys, time
+
+def request(command):
+    with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as s:
+        s.connect(sys.argv[1])
+        s.sendall(command.encode() + b"\n")
+        data = b""
+        while not data.endswith(b"\n\n"):
+            chunk = s.recv(4096)
+            assert chunk, data
+            data += chunk
+    return data.decode()
+
+for _ in range(600):
+    if os.path.exists(sys.argv[1]):
+        break
+    time.sleep(0.1)
+
+assert request("pause") == "OK\n\n"
+for _ in range(600):
+    status = request("status")
+    if "state=paused\n" in status:
+        break
+    time.sleep(0.1)
+print(status)
+assert "name=df_complex_sig_1\n" in status and "iterations=1000000\n" in status, status
+iteration = status.split("\niteration=")[1].split("\n")[0]
+time.sleep(1)
+assert f"\niteration={iteration}\n" in request("status")
+assert request("foo").startswith("ERROR")
+# Skipping works while paused, dfuzzer then finishes
+assert request("skip") == "OK\n\n"
+EOF
+wait $dfuzzer_pid
+[[ ! -e dfuzzer-binlogs/control ]]
+# Phase breakdown
+"${dfuzzer[@]}" --profile -e true -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_complex_sig_1 | tee dfuzzer-binlogs/profile
+grep -E "^org\.freedesktop\.dfuzzerInterface\.df_complex_sig_1 " dfuzzer-binlogs/profile
+grep -E "^Share .* 100\.0%$" dfuzzer-binlogs/profile
+# USDT probes (only in builds with sys/sdt.h)
+readelf -n "$(command -v dfuzzer)" >dfuzzer-binlogs/notes
+if grep -q stapsdt dfuzzer-binlogs/notes; then
+        for probe in input_generated call_start call_end crash_detected target_restarted introspection_done; do
+                grep -E "Name: $probe$" dfuzzer-binlogs/notes
+        done
+fi
+# Timeline in the Chrome trace event format
+"${dfuzzer[@]}" --trace=dfuzzer-binlogs/trace.json -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_complex_sig_1
+python3 - <<'EOF'
+import json
+
+with open("dfuzzer-binlogs/trace.json") as f:
+    events = json.load(f)
+categories = {e.get("cat") for e in events if e["ph"] == "X"}
+assert {"introspection", "interface", "test", "call"} <= categories, categories
+assert any(e.get("cat") == "test" and e["name"] == "df_complex_sig_1" for e in events)
+assert all(e["dur"] >= 0 for e in events if e["ph"] == "X")
+EOF
+# Split the interface into three shards and merge their results
+for k in 1 2 3; do
+        "${dfuzzer[@]}" --shard=$k/3 --seed=1 -I 10 --json=dfuzzer-binlogs/shard-$k.json -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface || { r=$?; [[ $r -eq 2 || $r -eq 3 ]]; }
+done
+python3 - <<'EOF'
+import json
+
+shards = []
+for k in (1, 2, 3):
+    with open(f"dfuzzer-binlogs/shard-{k}.json") as f:
+        events = [json.loads(record) for record in f.read().split("\x1e")[1:]]
+    assert events[0]["event"] == "run_start" and events[0]["shard"] == f"{k}/3", events[0]
+    shards.append({(e["kind"], e["name"]) for e in events if e["event"] == "test_end"})
+# Each member is tested by exactly one shard
+assert sum(len(s) for s in shards) == len(set.union(*shards)) > 10, shards
+assert ("method", "df_crash") in set.union(*shards)
+EOF
+set +e
+dfuzzer-log --merge dfuzzer-binlogs/shard-{1,2,3}.json | tee dfuzzer-binlogs/merged
+[[ ${PIPESTATUS[0]} -eq 2 ]] || exit 1
+dfuzzer-log --merge dfuzzer-binlogs/shard-{1,2}.json
+[[ $? -eq 1 ]] || exit 1
+dfuzzer-log --merge dfuzzer-binlogs/shard-{1,2,3,3}.json
+[[ $? -eq 1 ]] || exit 1
+set -e
+grep -E "^FAIL \[M\] org\.freedesktop\.dfuzzerServer /org/freedesktop/dfuzzerObject org\.freedesktop\.dfuzzerInterface df_crash( |$)" dfuzzer-binlogs/merged
+grep -E "^Runs: 3 \(shards: 3 of 3\)$" dfuzzer-binlogs/merged
+"${dfuzzer[@]}" --shard=4/3 -n org.freedesktop.dfuzzerServer && false
+# Checkpoint of a whole interface, then resume it: everything is skipped, but
+# the findings are still reported
+set +e
+"${dfuzzer[@]}" --checkpoint=dfuzzer-binlogs/checkpoint -I 10 -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface
+[[ $? -eq 2 ]] || exit 1
+"${dfuzzer[@]}" --checkpoint=dfuzzer-binlogs/checkpoint --resume --json=dfuzzer-binlogs/resumed.json -I 10 -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface
+[[ $? -eq 2 ]] || exit 1
+set -e
+cat dfuzzer-binlogs/checkpoint
+grep -E "^completed method /org/freedesktop/dfuzzerObject org\.freedesktop\.dfuzzerInterface df_crash 1$" dfuzzer-binlogs/checkpoint
+grep -E "^findings [1-9][0-9]*$" dfuzzer-binlogs/checkpoint
+python3 - <<'EOF'
+import json
+
+with open("dfuzzer-binlogs/resumed.json") as f:
+    events = [json.loads(record) for record in f.read().split("\x1e")[1:]]
+tests = [e for e in events if e["event"] == "test_end"]
+assert len(tests) > 10, tests
+assert all(e["reason"] == "completed-before-resume" and e["calls"] == 0 for e in tests), tests
+EOF
+"${dfuzzer[@]}" --checkpoint=dfuzzer-binlogs/checkpoint --resume -n org.freedesktop.systemd1 && false
+"${dfuzzer[@]}" --resume -n org.freedesktop.dfuzzerServer && false
+rm -fr dfuzzer-binlogs
+# Incremental fuzzing: the second run gives only the regression budget to the
+# unchanged method
+mkdir -p dfuzzer-binlogs
+"${dfuzzer[@]}" --incremental=dfuzzer-binlogs/fingerprints -I 20 -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_hello
+cat dfuzzer-binlogs/fingerprints
+grep -E "^method /org/freedesktop/dfuzzerObject org\.freedesktop\.dfuzzerInterface df_hello [0-9a-f]{64}$" dfuzzer-binlogs/fingerprints
+grep -E "^interface /org/freedesktop/dfuzzerObject org\.freedesktop\.dfuzzerInterface [0-9a-f]{64}$" dfuzzer-binlogs/fingerprints
+"${dfuzzer[@]}" --incremental=dfuzzer-binlogs/fingerprints --regression-iterations=3 --json=dfuzzer-binlogs/incremental.json -I 20 -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_hello
+python3 - <<'EOF'
+import json
+
+with open("dfuzzer-binlogs/incremental.json") as f:
+    events = [json.loads(record) for record in f.read().split("\x1e")[1:]]
+tests = [e for e in events if e["event"] == "test_start"]
+assert len(tests) == 1 and tests[0]["iterations"] == 3, tests
+EOF
+"${dfuzzer[@]}" --regression-iterations=3 -n org.freedesktop.dfuzzerServer && false
+rm -fr dfuzzer-binlogs
+# Plan: everything is listed, but nothing is called (df_crash would crash the
+# server)
+mkdir -p dfuzzer-binlogs
+"${dfuzzer[@]}" --plan --json=dfuzzer-binlogs/plan.json -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface | tee dfuzzer-binlogs/plan
+grep -E "^method +/org/freedesktop/dfuzzerObject +org\.freedesktop\.dfuzzerInterface +df_crash " dfuzzer-binlogs/plan
+grep -E "^Total: [1-9][0-9]* methods, [0-9]+ properties \([0-9]+ suppressed\), [1-9][0-9]* calls, estimated duration [0-9]+\.[0-9]{3} s$" dfuzzer-binlogs/plan
+python3 - <<'EOF'
+import json
+
+with open("dfuzzer-binlogs/plan.json") as f:
+    events = [json.loads(record) for record in f.read().split("\x1e")[1:]]
+assert not [e for e in events if e["event"] in ("test_start", "test_end", "failure")], events
+plan = [e for e in events if e["event"] == "plan"]
+assert ("method", "df_crash") in {(e["kind"], e["name"]) for e in plan}, plan
+assert all(e["latency_usec"] > 0 and e["estimate_usec"] >= 0 for e in plan), plan
+end = [e for e in events if e["event"] == "plan_end"]
+assert len(end) == 1 and end[0]["calls"] == sum(e["calls"] for e in plan), end
+EOF
+"${dfuzzer[@]}" -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_hello
+rm -fr dfuzzer-binlogs
+rm -f inputs.txt
+# Same as above, but with a typed dictionary scoped to the method argument
+cat >inputs.txt <<'EOF'
+string not this one
+
+[org.freedesktop.dfuzzerInterface:df_crash_on_leeroy:string]
+string Leeroy Jenkins
+EOF
+"${dfuzzer[@]}" -D inputs.txt -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_crash_on_leeroy && false
+rm -f inputs.txt
+# Invalid typed dictionaries
+"${dfuzzer[@]}" -v -n org.freedesktop.systemd1 -D /a/b/c/d/e && false
+printf "[a:b:c:d]\nstring a" >inputs.txt
+"${dfuzzer[@]}" -v -n org.freedesktop.systemd1 -D inputs.txt && false
 rm -f inputs.txt
 
 # Test if we respect the org.freedesktop.DBus.Method.NoReply annotation
 "${dfuzzer[@]}" -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_noreply && false
 "${dfuzzer[@]}" -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_noreply_expected
 
+# Slow and leaky methods still work, intermittent crashes get caught eventually
+for method in df_slow df_burn df_leak_memory df_leak_fd; do
+        "${dfuzzer[@]}" -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t "$method"
+done
+"${dfuzzer[@]}" -s -v -I 2000 -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_crash_intermittent && false
+
 # Test property handling
 "${dfuzzer[@]}" -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -p crash_on_write && false
 "${dfuzzer[@]}" -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -p read_only
@@ -65,6 +305,17 @@ sudo systemctl stop dfuzzer-test-server
 
 sudo systemctl stop dfuzzer-test-server
 
+# Kill dfuzzer while it waits for a hanging call, the crash recorder should still
+# tell us which call was in flight
+mkdir dfuzzer-crashrec
+timeout -s KILL 5 "${dfuzzer[@]}" --log-dir dfuzzer-crashrec --crash-recorder=4 -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_hang && false
+dfuzzer-log --recover dfuzzer-crashrec/org.freedesktop.dfuzzerServer.dfcrash | tee dfuzzer-crashrec/recovered
+tail -n 1 dfuzzer-crashrec/recovered | grep -E ";df_hang;\(t\);\(.+\);In flight$"
+dfuzzer-log --recover dfuzzer-crashrec/recovered && false
+rm -fr dfuzzer-crashrec
+
+sudo systemctl stop dfuzzer-test-server
+
 "${dfuzzer[@]}" -e true -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_hello
 
 set +e
@@ -144,6 +395,7 @@ rm -f dfuzzer.conf
 "${dfuzzer[@]}" -v -n org.freedesktop.systemd1 -o /org/freedesktop/systemd1 -i org.freedesktop.systemd1.Manager -p ccccccc && false
 # -t/--method= and -p/--property= are mutualy exclusive
 "${dfuzzer[@]}" -v -n org.freedesktop.systemd1 -o / -i a -t method -p property && false
+"${dfuzzer[@]}" -v -n org.freedesktop.systemd1 --log-format=xml && false
 # Non-existent -f/--dictionary= path
 "${dfuzzer[@]}" -v -n org.freedesktop.systemd1 -f /a/b/c/d/e && false
 for opt in "-y" "--min-iterations" "-x" "--max-iterations" "-I" "--iterations"; do
@@ -0,0 +1,571 @@
+/** @file binlog.c */
+/*
+ * dfuzzer - tool for fuzz testing processes communicating through D-Bus.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <gio/gio.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "binlog.h"
+#include "compress.h"
+#include "log.h"
+#include "util.h"
+
+/** Size of the output buffer of the writer thread */
+#define DF_BINLOG_BUFFER_SIZE (256 * 1024)
+/** How often the writer thread flushes buffered records when idle (in usec),
+  * for compressed logs each flush is a zlib sync flush */
+#define DF_BINLOG_FLUSH_INTERVAL DF_COMPRESS_FLUSH_INTERVAL
+/** Size of the fixed part of a CALL record (without the length prefix) */
+#define DF_BINLOG_CALL_SIZE (1 + 4 + 8 + 4 + 1)
+/** Number of strings in a METHOD record */
+#define DF_BINLOG_METHOD_STRINGS 4
+
+/* A record waiting in the queue. The fuzzing thread only takes a reference
+ * to the GVariant, the (possibly expensive) serialization is done by the
+ * writer thread. */
+typedef struct df_binlog_entry {
+        df_binlog_record_type_t type;
+        guint32 method_id;
+        guint64 iteration;
+        guint32 seed;
+        df_binlog_outcome_t outcome;
+        GVariant *value;
+        char *strings[DF_BINLOG_METHOD_STRINGS];
+} df_binlog_entry_t;
+
+static const char *const df_binlog_outcome_names[_DF_BINLOG_OUTCOME_MAX] = {
+        [DF_BINLOG_OUTCOME_SUCCESS]         = "Success",
+        [DF_BINLOG_OUTCOME_CRASH]           = "Crash",
+        [DF_BINLOG_OUTCOME_COMMAND_ERROR]   = "Command execution error",
+};
+
+static GOutputStream *df_binlog_output;
+static GThread *df_binlog_writer_thread;
+static GError *df_binlog_error;
+static guint32 df_binlog_next_method_id;
+
+/* Single-producer single-consumer ring: df_binlog_tail is written only by the
+ * fuzzing thread, df_binlog_head only by the writer thread. Both indices grow
+ * monotonically and wrap around naturally, since the queue size is a power
+ * of two. */
+static df_binlog_entry_t df_binlog_queue[DF_BINLOG_QUEUE_SIZE];
+static guint df_binlog_head;
+static guint df_binlog_tail;
+/* The mutex and the condition are used only to put the writer thread to sleep
+ * when the queue is empty, the fast path doesn't take any locks */
+static GMutex df_binlog_mutex;
+static GCond df_binlog_cond;
+static gint df_binlog_writer_waiting;
+static gint df_binlog_stopping;
+
+G_STATIC_ASSERT((DF_BINLOG_QUEUE_SIZE & (DF_BINLOG_QUEUE_SIZE - 1)) == 0);
+
+static inline void df_binlog_put_u16(guint8 *p, guint16 v)
+{
+        v = GUINT16_TO_LE(v);
+        memcpy(p, &v, sizeof(v));
+}
+
+static inline void df_binlog_put_u32(guint8 *p, guint32 v)
+{
+        v = GUINT32_TO_LE(v);
+        memcpy(p, &v, sizeof(v));
+}
+
+static inline void df_binlog_put_u64(guint8 *p, guint64 v)
+{
+        v = GUINT64_TO_LE(v);
+        memcpy(p, &v, sizeof(v));
+}
+
+static inline guint16 df_binlog_get_u16(const guint8 *p)
+{
+        guint16 v;
+
+        memcpy(&v, p, sizeof(v));
+        return GUINT16_FROM_LE(v);
+}
+
+static inline guint32 df_binlog_get_u32(const guint8 *p)
+{
+        guint32 v;
+
+        memcpy(&v, p, sizeof(v));
+        return GUINT32_FROM_LE(v);
+}
+
+static inline guint64 df_binlog_get_u64(const guint8 *p)
+{
+        guint64 v;
+
+        memcpy(&v, p, sizeof(v));
+        return GUINT64_FROM_LE(v);
+}
+
+static void df_binlog_entry_clear(df_binlog_entry_t *e)
+{
+        if (e->value)
+                g_variant_unref(e->value);
+        for (size_t i = 0; i < DF_BINLOG_METHOD_STRINGS; i++)
+                g_free(e->strings[i]);
+
+        memset(e, 0, sizeof(*e));
+}
+
+static gboolean df_binlog_write_entry(GOutputStream *output, const df_binlog_entry_t *e, GError **error)
+{
+        guint8 buf[4 + DF_BINLOG_CALL_SIZE];
+
+        switch (e->type) {
+        case DF_BINLOG_RECORD_METHOD: {
+                guint16 lengths[DF_BINLOG_METHOD_STRINGS];
+                guint32 size = 1 + 4;
+
+                for (size_t i = 0; i < DF_BINLOG_METHOD_STRINGS; i++) {
+                        /* All strings are D-Bus names or signatures, which are
+                         * at most 255 characters long */
+                        lengths[i] = (guint16) MIN(strlen(e->strings[i]), G_MAXUINT16);
+                        size += 2 + lengths[i];
+                }
+
+                df_binlog_put_u32(buf, size);
+                buf[4] = e->type;
+                df_binlog_put_u32(buf + 5, e->method_id);
+                if (!g_output_stream_write_all(output, buf, 4 + 1 + 4, NULL, NULL, error))
+                        return FALSE;
+
+                for (size_t i = 0; i < DF_BINLOG_METHOD_STRINGS; i++) {
+                        df_binlog_put_u16(buf, lengths[i]);
+                        if (!g_output_stream_write_all(output, buf, 2, NULL, NULL, error) ||
+                            !g_output_stream_write_all(output, e->strings[i], lengths[i], NULL, NULL, error))
+                                return FALSE;
+                }
+
+                return TRUE;
+        }
+        case DF_BINLOG_RECORD_CALL: {
+                gsize size;
+
+                size = g_variant_get_size(e->value);
+                df_binlog_put_u32(buf, DF_BINLOG_CALL_SIZE + size);
+                buf[4] = e->type;
+                df_binlog_put_u32(buf + 5, e->method_id);
+                df_binlog_put_u64(buf + 9, e->iteration);
+                df_binlog_put_u32(buf + 17, e->seed);
+                buf[21] = e->outcome;
+
+                return g_output_stream_write_all(output, buf, sizeof(buf), NULL, NULL, error) &&
+                       g_output_stream_write_all(output, g_variant_get_data(e->value), size, NULL, NULL, error);
+        }
+        default:
+                g_assert_not_reached();
+        }
+}
+
+static gpointer df_binlog_writer(gpointer data)
+{
+        gint64 last_flush = g_get_monotonic_time();
+        gboolean dirty = FALSE;
+
+        for (;;) {
+                guint head = df_binlog_head;
+                df_binlog_entry_t *e;
+
+                if (head == (guint) g_atomic_int_get(&df_binlog_tail)) {
+                        gboolean stop;
+
+                        /* The queue is drained, push the buffered records to the
+                         * file, but at most once per DF_BINLOG_FLUSH_INTERVAL, so
+                         * we don't end up with a write per record */
+                        if (dirty && g_get_monotonic_time() - last_flush >= DF_BINLOG_FLUSH_INTERVAL) {
+                                if (!df_binlog_error)
+                                        (void) g_output_stream_flush(df_binlog_output, NULL, &df_binlog_error);
+                                last_flush = g_get_monotonic_time();
+                                dirty = FALSE;
+                        }
+
+                        g_mutex_lock(&df_binlog_mutex);
+                        g_atomic_int_set(&df_binlog_writer_waiting, TRUE);
+                        while (head == (guint) g_atomic_int_get(&df_binlog_tail) && !g_atomic_int_get(&df_binlog_stopping)) {
+                                if (!dirty)
+                                        g_cond_wait(&df_binlog_cond, &df_binlog_mutex);
+                                else if (!g_cond_wait_until(&df_binlog_cond, &df_binlog_mutex, last_flush + DF_BINLOG_FLUSH_INTERVAL))
+                                        /* Time to flush the pending records */
+                                        break;
+                        }
+                        g_atomic_int_set(&df_binlog_writer_waiting, FALSE);
+                        stop = head == (guint) g_atomic_int_get(&df_binlog_tail) && g_atomic_int_get(&df_binlog_stopping);
+                        g_mutex_unlock(&df_binlog_mutex);
+
+                        if (stop)
+                                break;
+
+                        continue;
+                }
+
+                e = &df_binlog_queue[head % DF_BINLOG_QUEUE_SIZE];
+                /* Keep draining the queue even after a write error, so the
+                 * fuzzing thread doesn't get stuck */
+                if (!df_binlog_error)
+                        (void) df_binlog_write_entry(df_binlog_output, e, &df_binlog_error);
+                df_binlog_entry_clear(e);
+                dirty = TRUE;
+
+                g_atomic_int_set(&df_binlog_head, head + 1);
+        }
+
+        return NULL;
+}
+
+static df_binlog_entry_t *df_binlog_queue_reserve(void)
+{
+        /* Wait for the writer thread if the queue is full */
+        while (df_binlog_tail - (guint) g_atomic_int_get(&df_binlog_head) >= DF_BINLOG_QUEUE_SIZE)
+                g_usleep(100);
+
+        return &df_binlog_queue[df_binlog_tail % DF_BINLOG_QUEUE_SIZE];
+}
+
+static void df_binlog_queue_commit(void)
+{
+        g_atomic_int_set(&df_binlog_tail, df_binlog_tail + 1);
+
+        /* Wake up the writer thread only if it's actually sleeping */
+        if (g_atomic_int_get(&df_binlog_writer_waiting)) {
+                g_mutex_lock(&df_binlog_mutex);
+                g_cond_signal(&df_binlog_cond);
+                g_mutex_unlock(&df_binlog_mutex);
+        }
+}
+
+/**
+ * @function Opens a binary log file (in append mode) and starts the writer
+ * thread.
+ * @param file_name Path to the log file
+ * @param compress Compress the log with gzip
+ * @return 0 on success, -1 on error
+ */
+int df_binlog_open(const char *file_name, gboolean compress)
+{
+        g_autoptr(GOutputStream) stream = NULL;
+        g_autoptr(GError) error = NULL;
+        guint8 header[DF_BINLOG_HEADER_SIZE] = {};
+
+        g_assert(file_name);
+        g_assert(!df_binlog_output);
+
+        stream = df_compress_open_append(file_name, compress, &error);
+        if (!stream)
+                return df_fail_ret(-1, "Failed to open file %s: %s\n", file_name, error->message);
+
+        df_binlog_output = g_buffered_output_stream_new_sized(stream, DF_BINLOG_BUFFER_SIZE);
+
+        memcpy(header, DF_BINLOG_MAGIC, sizeof(DF_BINLOG_MAGIC));
+        header[8] = DF_BINLOG_VERSION;
+        header[9] = G_BYTE_ORDER == G_LITTLE_ENDIAN ? 'l' : 'B';
+        if (!g_output_stream_write_all(df_binlog_output, header, sizeof(header), NULL, NULL, &error)) {
+                g_clear_object(&df_binlog_output);
+                return df_fail_ret(-1, "Failed to write to file %s: %s\n", file_name, error->message);
+        }
+
+        df_binlog_head = df_binlog_tail = 0;
+        df_binlog_stopping = FALSE;
+        df_binlog_writer_thread = g_thread_try_new("df-binlog", df_binlog_writer, NULL, &error);
+        if (!df_binlog_writer_thread) {
+                g_clear_object(&df_binlog_output);
+                return df_fail_ret(-1, "Failed to start the log writer thread: %s\n", error->message);
+        }
+
+        return 0;
+}
+
+/**
+ * @function Writes all queued records, stops the writer thread and closes
+ * the log file. Does nothing if the log is not open.
+ * @return 0 on success, -1 if any of the writes failed
+ */
+int df_binlog_close(void)
+{
+        g_autoptr(GError) error = NULL;
+        int r = 0;
+
+        if (!df_binlog_output)
+                return 0;
+
+        g_mutex_lock(&df_binlog_mutex);
+        g_atomic_int_set(&df_binlog_stopping, TRUE);
+        g_cond_signal(&df_binlog_cond);
+        g_mutex_unlock(&df_binlog_mutex);
+        g_thread_join(g_steal_pointer(&df_binlog_writer_thread));
+
+        if (df_binlog_error) {
+                r = df_fail_ret(-1, "Failed to write the binary log: %s\n", df_binlog_error->message);
+                g_clear_error(&df_binlog_error);
+        }
+
+        if (!g_output_stream_close(df_binlog_output, NULL, &error) && r == 0)
+                r = df_fail_ret(-1, "Failed to close the binary log: %s\n", error->message);
+        g_clear_object(&df_binlog_output);
+
+        return r;
+}
+
+gboolean df_binlog_is_open(void)
+{
+        return !!df_binlog_output;
+}
+
+/**
+ * @function Queues a record describing a tested method. Subsequent calls of
+ * the method refer to it using the returned ID.
+ * @return ID of the method
+ */
+guint32 df_binlog_add_method(const char *interface, const char *object, const char *method, const char *signature)
+{
+        df_binlog_entry_t *e;
+
+        if (!df_binlog_output)
+                return 0;
+
+        e = df_binlog_queue_reserve();
+        e->type = DF_BINLOG_RECORD_METHOD;
+        e->method_id = df_binlog_next_method_id;
+        e->strings[0] = g_strdup(interface ?: "");
+        e->strings[1] = g_strdup(object ?: "");
+        e->strings[2] = g_strdup(method ?: "");
+        e->strings[3] = g_strdup(signature ?: "");
+        df_binlog_queue_commit();
+
+        return df_binlog_next_method_id++;
+}
+
+/**
+ * @function Queues a record of a single method call.
+ * @param method_id ID returned by df_binlog_add_method()
+ * @param iteration Iteration the arguments were generated for
+ * @param seed Seed of the pseudo-random generators
+ * @param outcome Result of the call
+ * @param value Arguments of the call
+ */
+void df_binlog_add_call(guint32 method_id, guint64 iteration, guint32 seed, df_binlog_outcome_t outcome, GVariant *value)
+{
+        df_binlog_entry_t *e;
+
+        g_assert(value);
+        g_assert(outcome < _DF_BINLOG_OUTCOME_MAX);
+
+        if (!df_binlog_output)
+                return;
+
+        e = df_binlog_queue_reserve();
+        e->type = DF_BINLOG_RECORD_CALL;
+        e->method_id = method_id;
+        e->iteration = iteration;
+        e->seed = seed;
+        e->outcome = outcome;
+        e->value = g_variant_ref(value);
+        df_binlog_queue_commit();
+}
+
+/* Read exactly size bytes from the input
+ *
+ * Returns 1 on success, 0 on EOF before the first byte, -EBADMSG if the input
+ * ends in the middle (including truncated compressed data), and -EIO on read
+ * errors
+ */
+static int df_binlog_read(GInputStream *input, void *buf, gsize size)
+{
+        g_autoptr(GError) error = NULL;
+        gsize n = 0;
+
+        if (!g_input_stream_read_all(input, buf, size, &n, NULL, &error)) {
+                /* A compressed log which ends in the middle of a block */
+                if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT))
+                        return -EBADMSG;
+
+                return df_fail_ret(-EIO, "Failed to read the binary log: %s\n", error->message);
+        }
+        if (n == 0 && size > 0)
+                return 0;
+        if (n < size)
+                return -EBADMSG;
+
+        return 1;
+}
+
+static int df_binlog_parse_method(const guint8 *p, gsize size, GHashTable *methods)
+{
+        g_auto(GStrv) strings = NULL;
+        guint32 id;
+
+        if (size < 4)
+                return -EBADMSG;
+
+        id = df_binlog_get_u32(p);
+        p += 4;
+        size -= 4;
+
+        strings = g_new0(char *, DF_BINLOG_METHOD_STRINGS + 1);
+        for (size_t i = 0; i < DF_BINLOG_METHOD_STRINGS; i++) {
+                guint16 len;
+
+                if (size < 2)
+                        return -EBADMSG;
+                len = df_binlog_get_u16(p);
+                if (size < 2u + len)
+                        return -EBADMSG;
+
+                strings[i] = g_strndup((const char *) p + 2, len);
+                p += 2 + len;
+                size -= 2 + len;
+        }
+
+        if (!g_variant_type_string_is_valid(strings[3]))
+                return -EBADMSG;
+
+        g_hash_table_replace(methods, GUINT_TO_POINTER(id), g_steal_pointer(&strings));
+
+        return 0;
+}
+
+static int df_binlog_render_call(const guint8 *p, gsize size, GHashTable *methods, gboolean byteswap, FILE *output)
+{
+        g_autoptr(GBytes) bytes = NULL;
+        g_autoptr(GVariant) value = NULL;
+        g_autoptr(gchar) value_str = NULL;
+        char **strings;
+        guint8 outcome;
+
+        /* The type byte has already been consumed */
+        if (size < DF_BINLOG_CALL_SIZE - 1)
+                return -EBADMSG;
+
+        strings = g_hash_table_lookup(methods, GUINT_TO_POINTER(df_binlog_get_u32(p)));
+        outcome = p[16];
+        if (!strings || outcome >= _DF_BINLOG_OUTCOME_MAX)
+                return -EBADMSG;
+
+        bytes = g_bytes_new(p + DF_BINLOG_CALL_SIZE - 1, size - (DF_BINLOG_CALL_SIZE - 1));
+        value = g_variant_ref_sink(g_variant_new_from_bytes(G_VARIANT_TYPE(strings[3]), bytes, FALSE));
+        if (byteswap) {
+                GVariant *swapped;
+
+                swapped = g_variant_byteswap(value);
+                g_variant_unref(value);
+                value = swapped;
+        }
+
+        value_str = g_variant_print(value, TRUE);
+        fprintf(output, "%s;%s;%s;%s;%s;%s\n", strings[0], strings[1], strings[2], strings[3],
+                value_str, df_binlog_outcome_names[outcome]);
+
+        return 0;
+}
+
+/**
+ * @function Renders a binary log in the text log format. A truncated record
+ * at the end of the log (e.g. when dfuzzer got killed) is reported and ignored.
+ * @param input Stream with the binary log
+ * @param output Where to write the text log
+ * @return 0 on success, negative errno on error
+ */
+int df_binlog_render(GInputStream *input, FILE *output)
+{
+        g_autoptr(GHashTable) methods = NULL;
+        g_autofree guint8 *buf = NULL;
+        gsize buf_size = 0;
+        gboolean byteswap = FALSE, have_header = FALSE;
+
+        g_assert(input);
+        g_assert(output);
+
+        methods = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) g_strfreev);
+
+        for (;;) {
+                guint8 prefix[DF_BINLOG_HEADER_SIZE];
+                guint32 size;
+                int r;
+
+                r = df_binlog_read(input, prefix, 4);
+                if (r == 0)
+                        break;
+                if (r == -EBADMSG)
+                        goto truncated;
+                if (r < 0)
+                        return r;
+
+                /* Logs from multiple runs are concatenated, each with its own
+                 * header. The magic can't be mistaken for a record length, since
+                 * it would mean a ~1 GiB record and D-Bus messages are limited
+                 * to 128 MiB. */
+                if (memcmp(prefix, DF_BINLOG_MAGIC, 4) == 0) {
+                        r = df_binlog_read(input, prefix + 4, sizeof(prefix) - 4);
+                        if (r == 0 || r == -EBADMSG)
+                                goto truncated;
+                        if (r < 0)
+                                return r;
+                        if (memcmp(prefix, DF_BINLOG_MAGIC, sizeof(DF_BINLOG_MAGIC)) != 0)
+                                return df_fail_ret(-EBADMSG, "Invalid binary log header\n");
+                        if (prefix[8] != DF_BINLOG_VERSION)
+                                return df_fail_ret(-EPROTONOSUPPORT, "Unsupported binary log version %u\n", prefix[8]);
+
+                        byteswap = prefix[9] != (G_BYTE_ORDER == G_LITTLE_ENDIAN ? 'l' : 'B');
+                        have_header = TRUE;
+                        g_hash_table_remove_all(methods);
+                        continue;
+                }
+
+                if (!have_header)
+                        return df_fail_ret(-EBADMSG, "Not a dfuzzer binary log\n");
+
+                size = df_binlog_get_u32(prefix);
+                if (size == 0)
+                        return df_fail_ret(-EBADMSG, "Invalid record in the binary log\n");
+                if (size > buf_size) {
+                        buf = g_realloc(buf, size);
+                        buf_size = size;
+                }
+
+                r = df_binlog_read(input, buf, size);
+                if (r == 0 || r == -EBADMSG)
+                        goto truncated;
+                if (r < 0)
+                        return r;
+
+                switch (buf[0]) {
+                case DF_BINLOG_RECORD_METHOD:
+                        r = df_binlog_parse_method(buf + 1, size - 1, methods);
+                        break;
+                case DF_BINLOG_RECORD_CALL:
+                        r = df_binlog_render_call(buf + 1, size - 1, methods, byteswap, output);
+                        break;
+                default:
+                        /* Skip unknown records */
+                        r = 0;
+                        break;
+                }
+                if (r < 0)
+                        return df_fail_ret(r, "Invalid record in the binary log\n");
+        }
+
+        return 0;
+
+truncated:
+        df_fail("Warning: the binary log ends with a truncated record, ignoring it\n");
+        return 0;
+}
@@ -0,0 +1,45 @@
+/** @file binlog.h */
+#pragma once
+
+#include <gio/gio.h>
+#include <stdio.h>
+
+/* Binary log layout (all integers are little-endian)
+ *
+ * Header:  char magic[8] ("DFZBLOG\0"), guint8 version, guint8 byte order
+ *          of the serialized GVariant data ('l' or 'B'), guint8 reserved[6]
+ * Record:  guint32 length (of the rest of the record), guint8 type, payload
+ *
+ * METHOD payload: guint32 id, then interface, object, method and signature,
+ *                 each as guint16 length + bytes (not NUL-terminated)
+ * CALL payload:   guint32 method id, guint64 iteration, guint32 seed,
+ *                 guint8 outcome, serialized GVariant of the arguments
+ *
+ * A log may consist of multiple concatenated runs, each starting with a header.
+ */
+#define DF_BINLOG_MAGIC "DFZBLOG"
+#define DF_BINLOG_VERSION 1
+#define DF_BINLOG_HEADER_SIZE 16
+/** Maximum number of records waiting for the writer thread */
+#define DF_BINLOG_QUEUE_SIZE 4096
+
+typedef enum df_binlog_record_type {
+        DF_BINLOG_RECORD_METHOD = 1,
+        DF_BINLOG_RECORD_CALL,
+} df_binlog_record_type_t;
+
+typedef enum df_binlog_outcome {
+        DF_BINLOG_OUTCOME_SUCCESS = 0,
+        DF_BINLOG_OUTCOME_CRASH,
+        DF_BINLOG_OUTCOME_COMMAND_ERROR,
+        _DF_BINLOG_OUTCOME_MAX
+} df_binlog_outcome_t;
+
+int df_binlog_open(const char *file_name, gboolean compress);
+int df_binlog_close(void);
+gboolean df_binlog_is_open(void);
+
+guint32 df_binlog_add_method(const char *interface, const char *object, const char *method, const char *signature);
+void df_binlog_add_call(guint32 method_id, guint64 iteration, guint32 seed, df_binlog_outcome_t outcome, GVariant *value);
+
+int df_binlog_render(GInputStream *input, FILE *output);
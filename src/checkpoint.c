@@ -0,0 +1,333 @@
+/** @file checkpoint.c */
+/*
+ * dfuzzer - tool for fuzz testing processes communicating through D-Bus.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <gio/gio.h>
+#include <string.h>
+
+#include "checkpoint.h"
+#include "log.h"
+#include "util.h"
+
+/* Touched only by the fuzzing thread */
+static char *df_checkpoint_file_name;
+static char *df_checkpoint_bus;
+static char *df_checkpoint_shard;
+static unsigned int df_checkpoint_seed;
+static gboolean df_checkpoint_seed_set;
+/* "KIND OBJECT INTERFACE NAME" of completed tests -> result */
+static GHashTable *df_checkpoint_completed;
+/* "completed ..." lines in the order the tests completed */
+static GString *df_checkpoint_completed_lines;
+static guint64 df_checkpoint_findings;
+/* Currently running test, NULL if there's none */
+static char *df_checkpoint_current;
+static guint64 df_checkpoint_current_iteration;
+static gint64 df_checkpoint_last_write;
+static gboolean df_checkpoint_write_failed;
+
+static char *df_checkpoint_key(const char *kind, const char *object, const char *interface, const char *name)
+{
+        return g_strjoin(" ", kind, object, interface, name, NULL);
+}
+
+static void df_checkpoint_add_completed(char *key, int ret)
+{
+        g_string_append_printf(df_checkpoint_completed_lines, "completed %s %d\n", key, ret);
+        g_hash_table_insert(df_checkpoint_completed, key, GINT_TO_POINTER(ret));
+        if (ret > 0)
+                df_checkpoint_findings++;
+}
+
+/* g_file_set_contents() writes into a temporary file and renames it over the
+ * target, so the checkpoint is never torn */
+static int df_checkpoint_write(void)
+{
+        g_autoptr(GString) out = NULL;
+        g_autoptr(GError) error = NULL;
+
+        df_checkpoint_last_write = g_get_monotonic_time();
+
+        out = g_string_new("# dfuzzer checkpoint, resume with --resume\n");
+        g_string_append_printf(out, "version %d\n", DF_CHECKPOINT_VERSION);
+        g_string_append_printf(out, "bus %s\n", df_checkpoint_bus);
+        if (df_checkpoint_shard)
+                g_string_append_printf(out, "shard %s\n", df_checkpoint_shard);
+        if (df_checkpoint_seed_set)
+                g_string_append_printf(out, "seed %u\n", df_checkpoint_seed);
+        g_string_append_printf(out, "findings %"G_GUINT64_FORMAT"\n", df_checkpoint_findings);
+        if (df_checkpoint_current)
+                g_string_append_printf(out, "current %s %"G_GUINT64_FORMAT"\n",
+                                       df_checkpoint_current, df_checkpoint_current_iteration);
+        g_string_append_len(out, df_checkpoint_completed_lines->str, df_checkpoint_completed_lines->len);
+
+        if (!g_file_set_contents(df_checkpoint_file_name, out->str, out->len, &error)) {
+                /* Report only the first failure, the run goes on without checkpoints */
+                if (!df_checkpoint_write_failed)
+                        df_fail("Failed to write checkpoint %s: %s\n", df_checkpoint_file_name, error->message);
+                df_checkpoint_write_failed = TRUE;
+                return -1;
+        }
+
+        return 0;
+}
+
+static int df_checkpoint_load(const char *bus, const char *shard)
+{
+        g_autoptr(GError) error = NULL;
+        g_autoptr(gchar) contents = NULL;
+        g_auto(GStrv) lines = NULL;
+        g_autoptr(gchar) file_bus = NULL, file_shard = NULL;
+        guint64 version = 0;
+
+        if (!g_file_get_contents(df_checkpoint_file_name, &contents, NULL, &error)) {
+                if (g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+                        return df_verbose_ret(0, "Checkpoint %s doesn't exist, starting from scratch\n",
+                                              df_checkpoint_file_name);
+
+                return df_fail_ret(-1, "Failed to read checkpoint %s: %s\n", df_checkpoint_file_name, error->message);
+        }
+
+        lines = g_strsplit(contents, "\n", -1);
+        STRV_FOREACH(line, lines) {
+                g_auto(GStrv) f = NULL;
+                guint n;
+
+                if (isempty(line) || line[0] == '#')
+                        continue;
+
+                f = g_strsplit(line, " ", -1);
+                n = g_strv_length(f);
+                if (g_str_equal(f[0], "version") && n == 2) {
+                        if (safe_strtoull(f[1], &version) < 0)
+                                goto invalid;
+                } else if (g_str_equal(f[0], "bus") && n == 2) {
+                        g_free(file_bus);
+                        file_bus = g_strdup(f[1]);
+                } else if (g_str_equal(f[0], "shard") && n == 2) {
+                        g_free(file_shard);
+                        file_shard = g_strdup(f[1]);
+                } else if (g_str_equal(f[0], "seed") && n == 2) {
+                        guint64 seed;
+
+                        if (safe_strtoull(f[1], &seed) < 0 || seed > G_MAXUINT)
+                                goto invalid;
+                        df_checkpoint_seed = (unsigned int) seed;
+                        df_checkpoint_seed_set = TRUE;
+                } else if (g_str_equal(f[0], "findings") && n == 2)
+                        /* Recounted from the completed tests */
+                        continue;
+                else if (g_str_equal(f[0], "current") && n == 6)
+                        /* Interrupted tests are run again from the start */
+                        fprintf(stderr, "Resuming, %s %s of %s at %s was interrupted at iteration %s\n",
+                                f[1], f[4], f[3], f[2], f[5]);
+                else if (g_str_equal(f[0], "completed") && n == 6) {
+                        guint64 ret;
+
+                        if (safe_strtoull(f[5], &ret) < 0 || ret > G_MAXINT)
+                                goto invalid;
+                        df_checkpoint_add_completed(df_checkpoint_key(f[1], f[2], f[3], f[4]), (int) ret);
+                } else
+                        goto invalid;
+        }
+
+        if (version != DF_CHECKPOINT_VERSION)
+                return df_fail_ret(-1, "Checkpoint %s has unsupported version %"G_GUINT64_FORMAT"\n",
+                                   df_checkpoint_file_name, version);
+        if (!file_bus)
+                goto invalid;
+        if (!g_str_equal(file_bus, bus))
+                return df_fail_ret(-1, "Checkpoint %s is for bus name %s, not %s\n",
+                                   df_checkpoint_file_name, file_bus, bus);
+        if (g_strcmp0(file_shard, shard) != 0)
+                return df_fail_ret(-1, "Checkpoint %s is for shard %s, not %s\n",
+                                   df_checkpoint_file_name, file_shard ?: "(none)", shard ?: "(none)");
+
+        fprintf(stderr, "Resuming from checkpoint %s: %u tests completed, %"G_GUINT64_FORMAT" findings\n",
+                df_checkpoint_file_name, g_hash_table_size(df_checkpoint_completed), df_checkpoint_findings);
+
+        return 0;
+
+invalid:
+        return df_fail_ret(-1, "Checkpoint %s is invalid\n", df_checkpoint_file_name);
+}
+
+static void df_checkpoint_free(void)
+{
+        g_clear_pointer(&df_checkpoint_file_name, g_free);
+        g_clear_pointer(&df_checkpoint_bus, g_free);
+        g_clear_pointer(&df_checkpoint_shard, g_free);
+        g_clear_pointer(&df_checkpoint_completed, g_hash_table_unref);
+        if (df_checkpoint_completed_lines)
+                g_string_free(g_steal_pointer(&df_checkpoint_completed_lines), TRUE);
+        g_clear_pointer(&df_checkpoint_current, g_free);
+}
+
+/**
+ * @function Starts writing the checkpoint file, optionally resuming from
+ * it first.
+ * @param file_name Path to the checkpoint file
+ * @param bus Tested bus name
+ * @param shard Shard of the run (see df_shard_to_string()), may be NULL
+ * @param resume Load the completed tests from the file if it exists; it
+ * must be for the same bus name and shard
+ * @return 0 on success, -1 on error
+ */
+int df_checkpoint_open(const char *file_name, const char *bus, const char *shard, gboolean resume)
+{
+        g_assert(file_name);
+        g_assert(bus);
+        g_assert(!df_checkpoint_file_name);
+
+        df_checkpoint_file_name = g_strdup(file_name);
+        df_checkpoint_bus = g_strdup(bus);
+        df_checkpoint_shard = g_strdup(shard);
+        df_checkpoint_completed = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+        df_checkpoint_completed_lines = g_string_new(NULL);
+        df_checkpoint_findings = 0;
+        df_checkpoint_seed_set = FALSE;
+        df_checkpoint_write_failed = FALSE;
+
+        /* Don't overwrite a checkpoint which can't be resumed from */
+        if ((resume && df_checkpoint_load(bus, shard) < 0) || df_checkpoint_write() < 0) {
+                df_checkpoint_free();
+                return -1;
+        }
+
+        return 0;
+}
+
+/**
+ * @function Writes the final state of the run into the checkpoint file and
+ * stops writing it. Does nothing if the checkpoint is not open.
+ * @return 0 on success, -1 if any of the writes failed
+ */
+int df_checkpoint_close(void)
+{
+        int r = 0;
+
+        if (!df_checkpoint_file_name)
+                return 0;
+
+        if (!df_checkpoint_write_failed)
+                (void) df_checkpoint_write();
+        if (df_checkpoint_write_failed)
+                r = -1;
+
+        df_checkpoint_free();
+
+        return r;
+}
+
+gboolean df_checkpoint_is_enabled(void)
+{
+        return !!df_checkpoint_file_name;
+}
+
+/**
+ * @function Gets the seed recorded in the checkpoint the run resumed from.
+ * @return TRUE if there's one, FALSE otherwise
+ */
+gboolean df_checkpoint_get_seed(unsigned int *ret)
+{
+        g_assert(ret);
+
+        if (!df_checkpoint_file_name || !df_checkpoint_seed_set)
+                return FALSE;
+
+        *ret = df_checkpoint_seed;
+        return TRUE;
+}
+
+void df_checkpoint_set_seed(unsigned int seed)
+{
+        df_checkpoint_seed = seed;
+        df_checkpoint_seed_set = TRUE;
+}
+
+/**
+ * @function Checks if a method or property was tested before resuming.
+ * @param ret Result of the test, if it was completed
+ * @return TRUE if it was completed, FALSE otherwise
+ */
+gboolean df_checkpoint_is_completed(const char *kind, const char *object, const char *interface,
+                                    const char *name, int *ret)
+{
+        g_autoptr(gchar) key = NULL;
+        gpointer value;
+
+        g_assert(ret);
+
+        if (!df_checkpoint_file_name)
+                return FALSE;
+
+        key = df_checkpoint_key(kind, object, interface, name);
+        if (!g_hash_table_lookup_extended(df_checkpoint_completed, key, NULL, &value))
+                return FALSE;
+
+        *ret = GPOINTER_TO_INT(value);
+        return TRUE;
+}
+
+void df_checkpoint_test_start(const char *kind, const char *object, const char *interface, const char *name)
+{
+        if (!df_checkpoint_file_name)
+                return;
+
+        g_free(df_checkpoint_current);
+        df_checkpoint_current = df_checkpoint_key(kind, object, interface, name);
+        df_checkpoint_current_iteration = 0;
+}
+
+/**
+ * @function Called by the fuzzing thread before each call, rewrites the
+ * checkpoint once in a while.
+ * @param iteration Current iteration of the tested method or property
+ */
+void df_checkpoint_iteration(guint64 iteration)
+{
+        if (!df_checkpoint_file_name)
+                return;
+
+        df_checkpoint_current_iteration = iteration;
+        if (!df_checkpoint_write_failed &&
+            g_get_monotonic_time() - df_checkpoint_last_write >= DF_CHECKPOINT_INTERVAL)
+                (void) df_checkpoint_write();
+}
+
+/**
+ * @function Marks the current test as completed.
+ * @param ret Result of the test; tests which ended with an error are not
+ * marked, so they are run again after resuming
+ */
+void df_checkpoint_test_end(int ret)
+{
+        g_autoptr(gchar) key = NULL;
+
+        if (!df_checkpoint_file_name || !df_checkpoint_current)
+                return;
+
+        key = g_steal_pointer(&df_checkpoint_current);
+        /* Tests completed before resuming keep their result */
+        if (ret < 0 || g_hash_table_contains(df_checkpoint_completed, key))
+                return;
+
+        df_checkpoint_add_completed(g_steal_pointer(&key), ret);
+        if (!df_checkpoint_write_failed &&
+            (ret > 0 || g_get_monotonic_time() - df_checkpoint_last_write >= DF_CHECKPOINT_INTERVAL))
+                (void) df_checkpoint_write();
+}
@@ -0,0 +1,41 @@
+/** @file checkpoint.h */
+#pragma once
+
+#include <gio/gio.h>
+
+/* Checkpoint file (--checkpoint=), periodically rewritten with the progress
+ * of the run, so an interrupted run can be resumed (--resume) without
+ * testing the completed methods and properties again. The file is written
+ * into a temporary file and renamed over the previous one, so it's never
+ * torn. It's a text file with one record per line:
+ *
+ *   version 1
+ *   bus BUS_NAME
+ *   shard K/N                                   (only with --shard=)
+ *   seed SEED                                   (seed of the current interface)
+ *   findings N                                  (completed tests which found something)
+ *   current KIND OBJECT INTERFACE NAME ITERATION
+ *   completed KIND OBJECT INTERFACE NAME RESULT
+ *
+ * where KIND is "method" or "property" and RESULT is the return value of
+ * df_fuzz_test_method() or df_fuzz_test_property(). None of the fields can
+ * contain a space. */
+
+/** Version of the file format */
+#define DF_CHECKPOINT_VERSION 1
+/** How often (in usec) the checkpoint is rewritten during a test, it's also
+  * rewritten right after each finding */
+#define DF_CHECKPOINT_INTERVAL (10 * G_USEC_PER_SEC)
+
+int df_checkpoint_open(const char *file_name, const char *bus, const char *shard, gboolean resume);
+int df_checkpoint_close(void);
+gboolean df_checkpoint_is_enabled(void);
+
+gboolean df_checkpoint_get_seed(unsigned int *ret);
+void df_checkpoint_set_seed(unsigned int seed);
+gboolean df_checkpoint_is_completed(const char *kind, const char *object, const char *interface,
+                                    const char *name, int *ret);
+
+void df_checkpoint_test_start(const char *kind, const char *object, const char *interface, const char *name);
+void df_checkpoint_iteration(guint64 iteration);
+void df_checkpoint_test_end(int ret);
@@ -0,0 +1,177 @@
+/** @file compress.c */
+/*
+ * dfuzzer - tool for fuzz testing processes communicating through D-Bus.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <gio/gio.h>
+#include <sys/stat.h>
+
+#include "compress.h"
+
+/* GZlibDecompressor stops at the end of the first gzip member, but logs
+ * appended by multiple dfuzzer runs consist of multiple members, so wrap it
+ * and restart it on each member boundary (like gzip -d does) */
+#define DF_TYPE_GZIP_DECOMPRESSOR (df_gzip_decompressor_get_type())
+G_DECLARE_FINAL_TYPE(DfGzipDecompressor, df_gzip_decompressor, DF, GZIP_DECOMPRESSOR, GObject)
+
+struct _DfGzipDecompressor {
+        GObject parent_instance;
+        GConverter *zlib;
+        /* The last member ended exactly at the end of the input seen so far */
+        gboolean member_done;
+};
+
+static void df_gzip_decompressor_iface_init(GConverterIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE(DfGzipDecompressor, df_gzip_decompressor, G_TYPE_OBJECT,
+                        G_IMPLEMENT_INTERFACE(G_TYPE_CONVERTER, df_gzip_decompressor_iface_init))
+
+static GConverterResult df_gzip_decompressor_convert(GConverter *converter, const void *inbuf, gsize inbuf_size,
+                                                     void *outbuf, gsize outbuf_size, GConverterFlags flags,
+                                                     gsize *bytes_read, gsize *bytes_written, GError **error)
+{
+        DfGzipDecompressor *self = DF_GZIP_DECOMPRESSOR(converter);
+        GConverterResult r;
+
+        if (self->member_done && inbuf_size == 0 && (flags & G_CONVERTER_INPUT_AT_END)) {
+                *bytes_read = *bytes_written = 0;
+                return G_CONVERTER_FINISHED;
+        }
+
+        r = g_converter_convert(self->zlib, inbuf, inbuf_size, outbuf, outbuf_size, flags,
+                                bytes_read, bytes_written, error);
+        if (r == G_CONVERTER_ERROR)
+                return r;
+
+        self->member_done = FALSE;
+        if (r == G_CONVERTER_FINISHED) {
+                g_converter_reset(self->zlib);
+                self->member_done = TRUE;
+
+                /* Continue with the next member, if there's (possibly) any */
+                if (*bytes_read < inbuf_size || !(flags & G_CONVERTER_INPUT_AT_END))
+                        return G_CONVERTER_CONVERTED;
+        }
+
+        return r;
+}
+
+static void df_gzip_decompressor_reset(GConverter *converter)
+{
+        DfGzipDecompressor *self = DF_GZIP_DECOMPRESSOR(converter);
+
+        g_converter_reset(self->zlib);
+        self->member_done = FALSE;
+}
+
+static void df_gzip_decompressor_iface_init(GConverterIface *iface)
+{
+        iface->convert = df_gzip_decompressor_convert;
+        iface->reset = df_gzip_decompressor_reset;
+}
+
+static void df_gzip_decompressor_finalize(GObject *object)
+{
+        DfGzipDecompressor *self = DF_GZIP_DECOMPRESSOR(object);
+
+        g_clear_object(&self->zlib);
+
+        G_OBJECT_CLASS(df_gzip_decompressor_parent_class)->finalize(object);
+}
+
+static void df_gzip_decompressor_class_init(DfGzipDecompressorClass *klass)
+{
+        G_OBJECT_CLASS(klass)->finalize = df_gzip_decompressor_finalize;
+}
+
+static void df_gzip_decompressor_init(DfGzipDecompressor *self)
+{
+        self->zlib = G_CONVERTER(g_zlib_decompressor_new(G_ZLIB_COMPRESSOR_FORMAT_GZIP));
+}
+
+/**
+ * @function Opens a file for appending, optionally compressing everything
+ * written to it. Every g_output_stream_flush() on a compressed stream does
+ * a zlib sync flush, i.e. all data written so far can be decompressed even
+ * if the stream is never closed.
+ * @param file_name Path to the file
+ * @param compress Write a gzip stream (a new member is appended to existing files)
+ * @param error Return location for a GError
+ * @return New GOutputStream on success, NULL on error
+ */
+GOutputStream *df_compress_open_append(const char *file_name, gboolean compress, GError **error)
+{
+        g_autoptr(GFile) file = NULL;
+        g_autoptr(GFileOutputStream) stream = NULL;
+        g_autoptr(GZlibCompressor) compressor = NULL;
+
+        g_assert(file_name);
+
+        (void) umask(0022);
+
+        file = g_file_new_for_path(file_name);
+        stream = g_file_append_to(file, G_FILE_CREATE_NONE, NULL, error);
+        if (!stream)
+                return NULL;
+
+        if (!compress)
+                return G_OUTPUT_STREAM(g_steal_pointer(&stream));
+
+        compressor = g_zlib_compressor_new(G_ZLIB_COMPRESSOR_FORMAT_GZIP, -1);
+
+        return g_converter_output_stream_new(G_OUTPUT_STREAM(stream), G_CONVERTER(compressor));
+}
+
+/**
+ * @function Wraps an input stream with a gzip decompressor if the stream
+ * starts with the gzip magic, so both plain and compressed logs can be read
+ * the same way.
+ * @param base Stream to read from
+ * @param error Return location for a GError
+ * @return New GInputStream on success, NULL on error
+ */
+GInputStream *df_decompress_input_stream_new(GInputStream *base, GError **error)
+{
+        g_autoptr(GInputStream) buffered = NULL;
+        g_autoptr(DfGzipDecompressor) decompressor = NULL;
+        const guint8 *peek;
+        gsize size = 0;
+
+        g_assert(base);
+
+        buffered = g_buffered_input_stream_new(base);
+
+        /* The fill might be short on pipes */
+        for (;;) {
+                gssize n;
+
+                peek = g_buffered_input_stream_peek_buffer(G_BUFFERED_INPUT_STREAM(buffered), &size);
+                if (size >= 2)
+                        break;
+
+                n = g_buffered_input_stream_fill(G_BUFFERED_INPUT_STREAM(buffered), 2 - size, NULL, error);
+                if (n < 0)
+                        return NULL;
+                if (n == 0)
+                        break;
+        }
+
+        if (size < 2 || peek[0] != 0x1f || peek[1] != 0x8b)
+                return g_steal_pointer(&buffered);
+
+        decompressor = g_object_new(DF_TYPE_GZIP_DECOMPRESSOR, NULL);
+
+        return g_converter_input_stream_new(buffered, G_CONVERTER(decompressor));
+}
@@ -0,0 +1,13 @@
+/** @file compress.h */
+#pragma once
+
+#include <gio/gio.h>
+
+/** File name suffix of compressed logs */
+#define DF_COMPRESS_SUFFIX ".gz"
+/** How often compressed logs are sync-flushed, i.e. the maximum amount of
+  * log (in usec) lost when dfuzzer gets killed */
+#define DF_COMPRESS_FLUSH_INTERVAL G_USEC_PER_SEC
+
+GOutputStream *df_compress_open_append(const char *file_name, gboolean compress, GError **error);
+GInputStream *df_decompress_input_stream_new(GInputStream *base, GError **error);
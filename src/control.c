@@ -0,0 +1,432 @@
+/** @file control.c */
+/*
+ * dfuzzer - tool for fuzz testing processes communicating through D-Bus.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <gio/gio.h>
+#include <poll.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "control.h"
+#include "log.h"
+#include "util.h"
+
+#define DF_CONTROL_PAUSE (1 << 0)
+#define DF_CONTROL_SKIP (1 << 1)
+
+static gboolean df_control_enabled;
+static char *df_control_path;
+static fd_t df_control_fd = -1;
+/* Written to by df_control_close() to wake up and stop the server thread */
+static fd_t df_control_stop_pipe[2] = { -1, -1 };
+static GThread *df_control_thread;
+
+/* Protects the strings below and the flags, signalled when the flags change */
+static GMutex df_control_mutex;
+static GCond df_control_cond;
+/* DF_CONTROL_* flags, changed under the mutex, read without it by the
+ * fuzzing thread on each call */
+static int df_control_flags;
+static gboolean df_control_paused;
+static struct {
+        char *kind;
+        char *bus;
+        char *object;
+        char *interface;
+        char *name;
+        guint64 iterations;
+        gint64 test_start;
+} df_control_test;
+
+/* Updated by the fuzzing thread with relaxed atomic operations */
+static struct {
+        gint64 start;
+        guint64 iteration;
+        guint64 calls;
+        guint64 findings;
+        guint64 tested;
+        guint64 pending;
+} df_control_counters;
+
+static void df_control_test_clear(void)
+{
+        g_clear_pointer(&df_control_test.kind, g_free);
+        g_clear_pointer(&df_control_test.bus, g_free);
+        g_clear_pointer(&df_control_test.object, g_free);
+        g_clear_pointer(&df_control_test.interface, g_free);
+        g_clear_pointer(&df_control_test.name, g_free);
+        df_control_test.iterations = 0;
+}
+
+/**
+ * @function Executes a single control command.
+ * @param command The command without the trailing newline
+ * @return New GString with the response (including the terminating empty line)
+ */
+GString *df_control_handle_command(const char *command)
+{
+        g_autoptr(gchar) cmd = NULL;
+        GString *out;
+
+        g_assert(command);
+
+        cmd = g_strstrip(g_strdup(command));
+        out = g_string_new(NULL);
+
+        if (g_str_equal(cmd, "status")) {
+                gint64 now = g_get_monotonic_time();
+                guint64 calls, iteration;
+
+                calls = __atomic_load_n(&df_control_counters.calls, __ATOMIC_RELAXED);
+                iteration = __atomic_load_n(&df_control_counters.iteration, __ATOMIC_RELAXED);
+
+                g_mutex_lock(&df_control_mutex);
+                g_string_append_printf(out, "state=%s\n",
+                                       df_control_paused ? "paused" :
+                                       df_control_flags & DF_CONTROL_PAUSE ? "pausing" : "running");
+                g_string_append_printf(out, "kind=%s\n", df_control_test.kind ?: "");
+                g_string_append_printf(out, "bus=%s\n", df_control_test.bus ?: "");
+                g_string_append_printf(out, "object=%s\n", df_control_test.object ?: "");
+                g_string_append_printf(out, "interface=%s\n", df_control_test.interface ?: "");
+                g_string_append_printf(out, "name=%s\n", df_control_test.name ?: "");
+                g_string_append_printf(out, "iteration=%"G_GUINT64_FORMAT"\n", iteration);
+                g_string_append_printf(out, "iterations=%"G_GUINT64_FORMAT"\n", df_control_test.iterations);
+                g_string_append_printf(out, "test_calls_per_second=%.1f\n",
+                                       df_control_test.name && now > df_control_test.test_start ?
+                                       iteration * (double) G_USEC_PER_SEC / (now - df_control_test.test_start) : 0.0);
+                g_mutex_unlock(&df_control_mutex);
+
+                g_string_append_printf(out, "calls=%"G_GUINT64_FORMAT"\n", calls);
+                g_string_append_printf(out, "calls_per_second=%.1f\n",
+                                       now > df_control_counters.start ?
+                                       calls * (double) G_USEC_PER_SEC / (now - df_control_counters.start) : 0.0);
+                g_string_append_printf(out, "findings=%"G_GUINT64_FORMAT"\n",
+                                       __atomic_load_n(&df_control_counters.findings, __ATOMIC_RELAXED));
+                g_string_append_printf(out, "tested=%"G_GUINT64_FORMAT"\n",
+                                       __atomic_load_n(&df_control_counters.tested, __ATOMIC_RELAXED));
+                g_string_append_printf(out, "pending=%"G_GUINT64_FORMAT"\n",
+                                       __atomic_load_n(&df_control_counters.pending, __ATOMIC_RELAXED));
+                g_string_append_printf(out, "uptime_sec=%"G_GINT64_FORMAT"\n",
+                                       (now - df_control_counters.start) / G_USEC_PER_SEC);
+        } else if (g_str_equal(cmd, "pause") || g_str_equal(cmd, "resume") || g_str_equal(cmd, "skip")) {
+                g_mutex_lock(&df_control_mutex);
+                if (g_str_equal(cmd, "pause"))
+                        __atomic_store_n(&df_control_flags, df_control_flags | DF_CONTROL_PAUSE, __ATOMIC_RELEASE);
+                else if (g_str_equal(cmd, "resume"))
+                        __atomic_store_n(&df_control_flags, df_control_flags & ~DF_CONTROL_PAUSE, __ATOMIC_RELEASE);
+                else
+                        __atomic_store_n(&df_control_flags, df_control_flags | DF_CONTROL_SKIP, __ATOMIC_RELEASE);
+                g_cond_broadcast(&df_control_cond);
+                g_mutex_unlock(&df_control_mutex);
+
+                g_string_append(out, "OK\n");
+        } else if (g_str_equal(cmd, "help"))
+                g_string_append(out, "status\npause\nresume\nskip\nhelp\n");
+        else
+                g_string_append_printf(out, "ERROR unknown command '%s'\n", cmd);
+
+        g_string_append_c(out, '\n');
+
+        return out;
+}
+
+static int df_control_send_all(fd_t fd, const char *buf, gsize size)
+{
+        while (size > 0) {
+                ssize_t n;
+
+                /* Don't get killed by SIGPIPE when the client goes away */
+                n = send(fd, buf, size, MSG_NOSIGNAL);
+                if (n < 0) {
+                        if (errno == EINTR)
+                                continue;
+
+                        return -errno;
+                }
+
+                buf += n;
+                size -= n;
+        }
+
+        return 0;
+}
+
+/* Wait for the fd to become readable, returns 0 when asked to stop */
+static int df_control_wait(fd_t fd)
+{
+        struct pollfd fds[] = {
+                { .fd = fd,                      .events = POLLIN },
+                { .fd = df_control_stop_pipe[0], .events = POLLIN },
+        };
+
+        for (;;) {
+                if (poll(fds, G_N_ELEMENTS(fds), -1) < 0) {
+                        if (errno == EINTR)
+                                continue;
+
+                        return -errno;
+                }
+
+                if (fds[1].revents)
+                        return 0;
+                if (fds[0].revents)
+                        return 1;
+        }
+}
+
+static void df_control_serve_client(fd_t fd)
+{
+        char buf[DF_CONTROL_LINE_MAX];
+        gsize len = 0;
+
+        for (;;) {
+                char *nl;
+                ssize_t n;
+
+                if (df_control_wait(fd) <= 0)
+                        return;
+
+                n = recv(fd, buf + len, sizeof(buf) - len, 0);
+                if (n < 0 && errno == EINTR)
+                        continue;
+                if (n <= 0)
+                        return;
+                len += n;
+
+                /* Handle all complete lines in the buffer */
+                while ((nl = memchr(buf, '\n', len))) {
+                        g_autoptr(GString) response = NULL;
+
+                        *nl = '\0';
+                        response = df_control_handle_command(buf);
+                        if (df_control_send_all(fd, response->str, response->len) < 0)
+                                return;
+
+                        len -= nl + 1 - buf;
+                        memmove(buf, nl + 1, len);
+                }
+
+                if (len == sizeof(buf)) {
+                        (void) df_control_send_all(fd, "ERROR line too long\n\n", strlen("ERROR line too long\n\n"));
+                        return;
+                }
+        }
+}
+
+static gpointer df_control_server(gpointer data)
+{
+        /* Clients are served one at a time, which is plenty for a few
+         * operators poking at a campaign */
+        for (;;) {
+                g_auto(fd_t) fd = -1;
+
+                if (df_control_wait(df_control_fd) <= 0)
+                        break;
+
+                fd = accept4(df_control_fd, NULL, NULL, SOCK_CLOEXEC);
+                if (fd < 0)
+                        continue;
+
+                df_control_serve_client(fd);
+        }
+
+        return NULL;
+}
+
+/**
+ * @function Creates the control socket and starts serving it from a
+ * background thread. A stale socket left at the path is replaced.
+ * @param path Path of the socket
+ * @return 0 on success, -1 on error
+ */
+int df_control_open(const char *path)
+{
+        g_autoptr(GError) error = NULL;
+        struct sockaddr_un sa = { .sun_family = AF_UNIX };
+        struct stat st;
+
+        g_assert(path);
+        g_assert(!df_control_enabled);
+
+        if (strlen(path) >= sizeof(sa.sun_path))
+                return df_fail_ret(-1, "Control socket path %s is too long\n", path);
+        strcpy(sa.sun_path, path);
+
+        if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+                (void) unlink(path);
+
+        df_control_fd = socket(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, 0);
+        if (df_control_fd < 0)
+                return df_fail_ret(-1, "Failed to create the control socket: %m\n");
+        if (bind(df_control_fd, (struct sockaddr *) &sa, offsetof(struct sockaddr_un, sun_path) + strlen(path) + 1) < 0) {
+                df_fail("Failed to bind the control socket to %s: %m\n", path);
+                goto fail;
+        }
+        if (listen(df_control_fd, SOMAXCONN) < 0 || pipe2(df_control_stop_pipe, O_CLOEXEC) < 0) {
+                df_fail("Failed to set up the control socket: %m\n");
+                (void) unlink(path);
+                goto fail;
+        }
+
+        memset(&df_control_counters, 0, sizeof(df_control_counters));
+        df_control_counters.start = g_get_monotonic_time();
+        df_control_flags = 0;
+        df_control_paused = FALSE;
+        df_control_path = g_strdup(path);
+
+        df_control_thread = g_thread_try_new("df-control", df_control_server, NULL, &error);
+        if (!df_control_thread) {
+                df_fail("Failed to start the control socket thread: %s\n", error->message);
+                (void) unlink(path);
+                g_clear_pointer(&df_control_path, g_free);
+                goto fail;
+        }
+
+        df_control_enabled = TRUE;
+
+        return 0;
+
+fail:
+        df_control_fd = safe_close(df_control_fd);
+        df_control_stop_pipe[0] = safe_close(df_control_stop_pipe[0]);
+        df_control_stop_pipe[1] = safe_close(df_control_stop_pipe[1]);
+
+        return -1;
+}
+
+/**
+ * @function Stops the control socket thread and removes the socket. Does
+ * nothing if the control socket is not enabled.
+ */
+void df_control_close(void)
+{
+        if (!df_control_enabled)
+                return;
+
+        (void) write(df_control_stop_pipe[1], "", 1);
+        g_thread_join(g_steal_pointer(&df_control_thread));
+
+        (void) unlink(df_control_path);
+        g_clear_pointer(&df_control_path, g_free);
+        df_control_fd = safe_close(df_control_fd);
+        df_control_stop_pipe[0] = safe_close(df_control_stop_pipe[0]);
+        df_control_stop_pipe[1] = safe_close(df_control_stop_pipe[1]);
+
+        g_mutex_lock(&df_control_mutex);
+        df_control_test_clear();
+        g_mutex_unlock(&df_control_mutex);
+
+        df_control_enabled = FALSE;
+}
+
+gboolean df_control_is_enabled(void)
+{
+        return df_control_enabled;
+}
+
+/**
+ * @function Publishes the method or property which is about to be tested.
+ * A skip requested while no test was running is dropped.
+ */
+void df_control_test_start(const char *kind, const char *bus, const char *object, const char *interface,
+                           const char *name, guint64 iterations)
+{
+        if (!df_control_enabled)
+                return;
+
+        g_mutex_lock(&df_control_mutex);
+        df_control_test_clear();
+        df_control_test.kind = g_strdup(kind);
+        df_control_test.bus = g_strdup(bus);
+        df_control_test.object = g_strdup(object);
+        df_control_test.interface = g_strdup(interface);
+        df_control_test.name = g_strdup(name);
+        df_control_test.iterations = iterations;
+        df_control_test.test_start = g_get_monotonic_time();
+        __atomic_store_n(&df_control_counters.iteration, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&df_control_flags, df_control_flags & ~DF_CONTROL_SKIP, __ATOMIC_RELEASE);
+        g_mutex_unlock(&df_control_mutex);
+}
+
+/**
+ * @function Sets the number of methods and properties of the current
+ * interface waiting to be tested.
+ */
+void df_control_begin_interface(guint64 total)
+{
+        if (df_control_enabled)
+                __atomic_store_n(&df_control_counters.pending, total, __ATOMIC_RELAXED);
+}
+
+void df_control_member_tested(void)
+{
+        if (!df_control_enabled)
+                return;
+
+        __atomic_fetch_add(&df_control_counters.tested, 1, __ATOMIC_RELAXED);
+        if (__atomic_load_n(&df_control_counters.pending, __ATOMIC_RELAXED) > 0)
+                __atomic_fetch_sub(&df_control_counters.pending, 1, __ATOMIC_RELAXED);
+}
+
+void df_control_record_finding(void)
+{
+        if (df_control_enabled)
+                __atomic_fetch_add(&df_control_counters.findings, 1, __ATOMIC_RELAXED);
+}
+
+static gboolean df_control_checkpoint_slow(void)
+{
+        gboolean skip;
+
+        g_mutex_lock(&df_control_mutex);
+        while ((df_control_flags & (DF_CONTROL_PAUSE|DF_CONTROL_SKIP)) == DF_CONTROL_PAUSE) {
+                df_control_paused = TRUE;
+                g_cond_wait(&df_control_cond, &df_control_mutex);
+        }
+        df_control_paused = FALSE;
+
+        skip = !!(df_control_flags & DF_CONTROL_SKIP);
+        __atomic_store_n(&df_control_flags, df_control_flags & ~DF_CONTROL_SKIP, __ATOMIC_RELEASE);
+        g_mutex_unlock(&df_control_mutex);
+
+        return skip;
+}
+
+/**
+ * @function Called by the fuzzing thread before each call. Blocks while
+ * fuzzing is paused.
+ * @param iteration Current iteration of the tested method or property
+ * @return TRUE if the current test should be skipped, FALSE otherwise
+ */
+gboolean df_control_checkpoint(guint64 iteration)
+{
+        if (!df_control_enabled)
+                return FALSE;
+
+        __atomic_store_n(&df_control_counters.iteration, iteration, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&df_control_counters.calls, 1, __ATOMIC_RELAXED);
+
+        if (G_LIKELY(__atomic_load_n(&df_control_flags, __ATOMIC_ACQUIRE) == 0))
+                return FALSE;
+
+        return df_control_checkpoint_slow();
+}
@@ -0,0 +1,34 @@
+/** @file control.h */
+#pragma once
+
+#include <gio/gio.h>
+
+/* Control socket: a Unix stream socket served by a background thread. Each
+ * request is a single line with a command, each response consists of lines
+ * terminated by an empty line. Commands:
+ *
+ *   status  "key=value" lines with the current target, test and counters
+ *   pause   stop fuzzing before the next call
+ *   resume  continue fuzzing
+ *   skip    abandon the currently tested method or property
+ *   help    list of commands
+ *
+ * Successful commands other than status and help reply with "OK", invalid
+ * ones with "ERROR <message>". */
+
+/** Maximum length of a request line */
+#define DF_CONTROL_LINE_MAX 256
+
+int df_control_open(const char *path);
+void df_control_close(void);
+gboolean df_control_is_enabled(void);
+
+void df_control_test_start(const char *kind, const char *bus, const char *object, const char *interface,
+                           const char *name, guint64 iterations);
+void df_control_begin_interface(guint64 total);
+void df_control_member_tested(void);
+void df_control_record_finding(void);
+
+gboolean df_control_checkpoint(guint64 iteration);
+
+GString *df_control_handle_command(const char *command);
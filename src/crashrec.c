@@ -0,0 +1,325 @@
+/** @file crashrec.c */
+/*
+ * dfuzzer - tool for fuzz testing processes communicating through D-Bus.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <gio/gio.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "crashrec.h"
+#include "log.h"
+#include "util.h"
+
+#define DF_CRASHREC_STRINGS 4
+
+static df_crashrec_header_t *df_crashrec;
+static gsize df_crashrec_size;
+/** seq of the last recorded call */
+static guint64 df_crashrec_seq;
+
+static inline gsize df_crashrec_file_size(guint32 n_slots, guint32 slot_size)
+{
+        return sizeof(df_crashrec_header_t) + (gsize) n_slots * slot_size;
+}
+
+static inline df_crashrec_slot_t *df_crashrec_slot(const df_crashrec_header_t *h, guint64 index)
+{
+        return (df_crashrec_slot_t *) ((guint8 *) h + sizeof(*h) + index * h->slot_size);
+}
+
+/**
+ * @function Creates (or overwrites) the crash recorder file and maps it
+ * into memory.
+ * @param file_name Path to the file
+ * @param n_slots Number of recent inputs kept in the file
+ * @return 0 on success, negative errno on error
+ */
+int df_crashrec_open(const char *file_name, guint n_slots)
+{
+        df_crashrec_header_t *h;
+        gsize size;
+        fd_t fd;
+        void *p;
+        int r;
+
+        g_assert(file_name);
+        g_assert(!df_crashrec);
+
+        if (n_slots == 0 || n_slots > DF_CRASHREC_MAX_SLOTS)
+                return -EINVAL;
+
+        size = df_crashrec_file_size(n_slots, DF_CRASHREC_SLOT_SIZE);
+
+        fd = open(file_name, O_RDWR|O_CREAT|O_TRUNC|O_CLOEXEC, 0644);
+        if (fd < 0)
+                return df_fail_ret(-errno, "Failed to open file %s: %m\n", file_name);
+
+        /* Allocate the blocks up front, writing into a hole of a sparse file
+         * on a full file system would get us SIGBUS */
+        r = posix_fallocate(fd, 0, size);
+        if (r != 0) {
+                safe_close(fd);
+                return df_fail_ret(-r, "Failed to allocate file %s: %s\n", file_name, strerror(r));
+        }
+
+        p = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+        r = -errno;
+        /* The mapping keeps the file open */
+        safe_close(fd);
+        if (p == MAP_FAILED)
+                return df_fail_ret(r, "Failed to map file %s: %s\n", file_name, strerror(-r));
+
+        h = p;
+        memcpy(h->magic, DF_CRASHREC_MAGIC, sizeof(DF_CRASHREC_MAGIC));
+        h->version = DF_CRASHREC_VERSION;
+        h->byte_order = G_BYTE_ORDER == G_LITTLE_ENDIAN ? 'l' : 'B';
+        h->state = DF_CRASHREC_STATE_RUNNING;
+        h->pid = getpid();
+        h->n_slots = n_slots;
+        h->slot_size = DF_CRASHREC_SLOT_SIZE;
+
+        df_crashrec = h;
+        df_crashrec_size = size;
+        df_crashrec_seq = 0;
+
+        return 0;
+}
+
+/**
+ * @function Marks the crash recorder file as finished and unmaps it. The file
+ * is kept, so the last inputs can still be inspected. Does nothing if the
+ * recorder is not open.
+ */
+void df_crashrec_close(void)
+{
+        if (!df_crashrec)
+                return;
+
+        __atomic_store_n(&df_crashrec->state, DF_CRASHREC_STATE_FINISHED, __ATOMIC_RELEASE);
+        (void) munmap(df_crashrec, df_crashrec_size);
+        df_crashrec = NULL;
+        df_crashrec_size = 0;
+}
+
+gboolean df_crashrec_is_open(void)
+{
+        return !!df_crashrec;
+}
+
+/**
+ * @function Records an input right before it's sent to the tested process.
+ * Does nothing if the recorder is not open.
+ * @param iteration Iteration the arguments were generated for
+ * @param value Arguments of the call
+ */
+void df_crashrec_begin_call(const char *interface, const char *object, const char *method, const char *signature,
+                            guint64 iteration, GVariant *value)
+{
+        const char *strings[DF_CRASHREC_STRINGS] = { interface, object, method, signature };
+        df_crashrec_slot_t *slot;
+        gsize avail;
+        guint8 *p;
+
+        g_assert(value);
+
+        if (!df_crashrec)
+                return;
+
+        df_crashrec_seq++;
+        slot = df_crashrec_slot(df_crashrec, (df_crashrec_seq - 1) % df_crashrec->n_slots);
+
+        /* Invalidate the slot first and make sure none of the following stores
+         * can overtake it, so a half-written slot is never considered valid */
+        __atomic_store_n(&slot->seq, 0, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+
+        p = slot->data;
+        avail = df_crashrec->slot_size - sizeof(*slot);
+        for (size_t i = 0; i < DF_CRASHREC_STRINGS; i++) {
+                /* D-Bus names and signatures are at most 255 characters long,
+                 * so all of them always fit */
+                gsize len = MIN(strlen(strings[i] ?: ""), 255u);
+
+                memcpy(p, strings[i] ?: "", len);
+                slot->lengths[i] = len;
+                p += len;
+                avail -= len;
+        }
+
+        slot->iteration = iteration;
+        slot->value_size = g_variant_get_size(value);
+        slot->stored_size = MIN(slot->value_size, avail);
+        memcpy(p, g_variant_get_data(value), slot->stored_size);
+
+        /* Publish the slot */
+        __atomic_store_n(&slot->seq, df_crashrec_seq, __ATOMIC_RELEASE);
+}
+
+/**
+ * @function Marks the last recorded call as returned. Does nothing if the
+ * recorder is not open.
+ */
+void df_crashrec_end_call(void)
+{
+        if (!df_crashrec)
+                return;
+
+        __atomic_store_n(&df_crashrec->completed, df_crashrec_seq, __ATOMIC_RELEASE);
+}
+
+static gint df_crashrec_compare_slots(gconstpointer a, gconstpointer b)
+{
+        const df_crashrec_slot_t *x = *(df_crashrec_slot_t * const *) a, *y = *(df_crashrec_slot_t * const *) b;
+
+        return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+static int df_crashrec_print_slot(const df_crashrec_slot_t *slot, gsize slot_size, guint64 completed, FILE *output)
+{
+        g_autofree gchar *strings[DF_CRASHREC_STRINGS] = {};
+        g_autofree gchar *value_str = NULL;
+        const guint8 *p = slot->data;
+        gsize total = 0;
+
+        for (size_t i = 0; i < DF_CRASHREC_STRINGS; i++)
+                total += slot->lengths[i];
+        if (total + slot->stored_size > slot_size - sizeof(*slot) || slot->stored_size > slot->value_size)
+                return -EBADMSG;
+
+        for (size_t i = 0; i < DF_CRASHREC_STRINGS; i++) {
+                strings[i] = g_strndup((const char *) p, slot->lengths[i]);
+                p += slot->lengths[i];
+        }
+
+        if (!g_variant_type_string_is_valid(strings[3]))
+                return -EBADMSG;
+
+        if (slot->stored_size < slot->value_size)
+                value_str = g_strdup_printf("<truncated, %"G_GUINT32_FORMAT" of %"G_GUINT32_FORMAT" bytes>",
+                                            slot->stored_size, slot->value_size);
+        else {
+                g_autoptr(GVariant) value = NULL;
+
+                value = g_variant_ref_sink(g_variant_new_from_data(G_VARIANT_TYPE(strings[3]), p, slot->stored_size,
+                                                                   FALSE, NULL, NULL));
+                value_str = g_variant_print(value, TRUE);
+        }
+
+        fprintf(output, "%s;%s;%s;%s;%s;%s\n", strings[0], strings[1], strings[2], strings[3], value_str,
+                slot->seq > completed ? "In flight" : "Completed");
+
+        if (slot->seq > completed)
+                df_fail("Call in flight: %s.%s on %s, iteration %"G_GUINT64_FORMAT"\n",
+                        strings[0], strings[2], strings[1], slot->iteration);
+
+        return 0;
+}
+
+/**
+ * @function Prints inputs kept in a crash recorder file in the text log
+ * format, oldest first. The last field is "Completed" for calls which
+ * returned and "In flight" for the call dfuzzer was waiting for when it was
+ * terminated.
+ * @param file_name Path to the crash recorder file
+ * @param output Where to write the inputs
+ * @return 0 on success, negative errno on error
+ */
+int df_crashrec_recover(const char *file_name, FILE *output)
+{
+        g_autoptr(GPtrArray) slots = NULL;
+        const df_crashrec_header_t *h;
+        struct stat st;
+        guint64 completed;
+        fd_t fd;
+        void *p;
+        int r = 0;
+
+        g_assert(file_name);
+        g_assert(output);
+
+        fd = open(file_name, O_RDONLY|O_CLOEXEC);
+        if (fd < 0)
+                return df_fail_ret(-errno, "Failed to open file %s: %m\n", file_name);
+        if (fstat(fd, &st) < 0) {
+                r = -errno;
+                safe_close(fd);
+                return df_fail_ret(r, "Failed to stat file %s: %s\n", file_name, strerror(-r));
+        }
+        if ((gsize) st.st_size < sizeof(*h)) {
+                safe_close(fd);
+                return df_fail_ret(-EBADMSG, "Not a dfuzzer crash recorder file: %s\n", file_name);
+        }
+
+        p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        r = -errno;
+        safe_close(fd);
+        if (p == MAP_FAILED)
+                return df_fail_ret(r, "Failed to map file %s: %s\n", file_name, strerror(-r));
+        h = p;
+        r = 0;
+
+        if (memcmp(h->magic, DF_CRASHREC_MAGIC, sizeof(DF_CRASHREC_MAGIC)) != 0) {
+                r = df_fail_ret(-EBADMSG, "Not a dfuzzer crash recorder file: %s\n", file_name);
+                goto finish;
+        }
+        if (h->version != DF_CRASHREC_VERSION) {
+                r = df_fail_ret(-EPROTONOSUPPORT, "Unsupported crash recorder version %u\n", h->version);
+                goto finish;
+        }
+        if (h->byte_order != (G_BYTE_ORDER == G_LITTLE_ENDIAN ? 'l' : 'B')) {
+                r = df_fail_ret(-EPROTONOSUPPORT, "Crash recorder file %s was written on a machine with a different byte order\n",
+                                file_name);
+                goto finish;
+        }
+        if (h->n_slots == 0 || h->n_slots > DF_CRASHREC_MAX_SLOTS || h->slot_size <= sizeof(df_crashrec_slot_t) ||
+            h->slot_size % 8 != 0 || (gsize) st.st_size < df_crashrec_file_size(h->n_slots, h->slot_size)) {
+                r = df_fail_ret(-EBADMSG, "Invalid crash recorder file %s\n", file_name);
+                goto finish;
+        }
+
+        slots = g_ptr_array_sized_new(h->n_slots);
+        for (guint32 i = 0; i < h->n_slots; i++) {
+                df_crashrec_slot_t *slot = df_crashrec_slot(h, i);
+
+                /* Empty or half-written */
+                if (slot->seq == 0)
+                        continue;
+
+                g_ptr_array_add(slots, slot);
+        }
+        g_ptr_array_sort(slots, df_crashrec_compare_slots);
+
+        completed = h->completed;
+        for (guint i = 0; i < slots->len; i++) {
+                if (df_crashrec_print_slot(slots->pdata[i], h->slot_size, completed, output) < 0)
+                        df_fail("Warning: ignoring an invalid slot in %s\n", file_name);
+        }
+
+        if (h->state == DF_CRASHREC_STATE_FINISHED)
+                df_fail("dfuzzer (PID %"G_GUINT32_FORMAT") finished normally\n", h->pid);
+        else
+                df_fail("dfuzzer (PID %"G_GUINT32_FORMAT") was terminated abnormally\n", h->pid);
+
+finish:
+        (void) munmap(p, st.st_size);
+
+        return r;
+}
@@ -0,0 +1,71 @@
+/** @file crashrec.h */
+#pragma once
+
+#include <gio/gio.h>
+#include <stdio.h>
+
+/* Crash recorder file layout (all integers in the native byte order, the file
+ * is meant to be read on the machine it was written on)
+ *
+ * Header:  df_crashrec_header_t
+ * Slots:   n_slots * slot_size bytes, each starting with df_crashrec_slot_t,
+ *          followed by the interface, object, method and signature (not
+ *          NUL-terminated) and the serialized GVariant of the arguments
+ *
+ * Inputs are written into the slots round-robin before each call. A slot is
+ * invalidated (seq = 0) before it's overwritten and its seq is stored only
+ * after the rest of it, so a slot with a non-zero seq is always complete,
+ * whenever dfuzzer gets killed.
+ */
+#define DF_CRASHREC_MAGIC "DFZCREC"
+#define DF_CRASHREC_VERSION 1
+/** Size of a single slot, enough for the default maximum buffer size of
+  * generated strings; larger inputs are truncated */
+#define DF_CRASHREC_SLOT_SIZE (64 * 1024)
+/** Maximum number of slots */
+#define DF_CRASHREC_MAX_SLOTS 4096
+
+typedef enum df_crashrec_state {
+        DF_CRASHREC_STATE_RUNNING = 1,
+        DF_CRASHREC_STATE_FINISHED,
+} df_crashrec_state_t;
+
+typedef struct df_crashrec_header {
+        char magic[8];
+        guint8 version;
+        /* Byte order of the file ('l' or 'B') */
+        guint8 byte_order;
+        guint8 state;
+        guint8 reserved[1];
+        guint32 pid;
+        guint32 n_slots;
+        guint32 slot_size;
+        /* seq of the last call which returned */
+        guint64 completed;
+        guint8 reserved2[32];
+} df_crashrec_header_t;
+
+typedef struct df_crashrec_slot {
+        /* Sequence number of the call, starting at 1; 0 if the slot is empty
+         * or being written */
+        guint64 seq;
+        guint64 iteration;
+        guint32 value_size;
+        /* Less than value_size if the value didn't fit into the slot */
+        guint32 stored_size;
+        guint16 lengths[4];
+        guint8 data[];
+} df_crashrec_slot_t;
+
+G_STATIC_ASSERT(sizeof(df_crashrec_header_t) == 64);
+G_STATIC_ASSERT(sizeof(df_crashrec_slot_t) == 32);
+
+int df_crashrec_open(const char *file_name, guint n_slots);
+void df_crashrec_close(void);
+gboolean df_crashrec_is_open(void);
+
+void df_crashrec_begin_call(const char *interface, const char *object, const char *method, const char *signature,
+                            guint64 iteration, GVariant *value);
+void df_crashrec_end_call(void);
+
+int df_crashrec_recover(const char *file_name, FILE *output);
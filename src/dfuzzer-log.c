@@ -0,0 +1,300 @@
+/** @file dfuzzer-log.c */
+/*
+ * dfuzzer-log - tool for processing binary logs and event streams written by dfuzzer.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <getopt.h>
+#include <gio/gio.h>
+#include <gio/gunixinputstream.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "binlog.h"
+#include "compress.h"
+#include "crashrec.h"
+#include "json.h"
+#include "log.h"
+#include "shard.h"
+#include "util.h"
+
+/* Combined results of the event streams passed to --merge */
+typedef struct df_log_merge {
+        guint64 runs;
+        /* Number of shards of the sharded runs, 0 if there were none */
+        guint shard_count;
+        /* Indexes of the merged shards */
+        GHashTable *shards;
+        guint64 tests;
+        guint64 passed;
+        guint64 failed;
+        guint64 skipped;
+        guint64 errors;
+        guint64 calls;
+        int exit_status;
+} df_log_merge_t;
+
+static void df_log_print_help(const char *name)
+{
+        printf(
+         "Usage: %1$s [OPTIONS] FILE...\n\n"
+         "Render binary logs written by dfuzzer --log-format=binary in the text log format.\n"
+         "Logs compressed with --log-compress are decompressed automatically.\n"
+         "Use '-' as FILE to read from the standard input.\n\n"
+         "  -h --help                   Show this help text.\n"
+         "  -V --version                Show dfuzzer version.\n"
+         "  -r --recover                Print the last inputs kept in crash recorder files written by\n"
+         "                              dfuzzer --crash-recorder=, including the call in flight.\n"
+         "  -m --merge                  Merge the event streams written by dfuzzer --json= (e.g. by\n"
+         "                              all shards of a --shard=K/N run) into one report and exit\n"
+         "                              with the combined exit status.\n"
+         "\nExamples:\n\n"
+         "# %1$s logs/org.freedesktop.systemd1.dflog | grep ';Crash$'\n"
+         "# %1$s --recover logs/org.freedesktop.systemd1.dfcrash | tail -n 1\n"
+         "# %1$s --merge shard-1.json shard-2.json shard-3.json\n",
+         name);
+}
+
+static int df_log_render_file(const char *path)
+{
+        g_autoptr(GInputStream) input = NULL;
+        g_autoptr(GInputStream) stream = NULL;
+        g_autoptr(GError) error = NULL;
+
+        if (g_str_equal(path, "-"))
+                input = g_unix_input_stream_new(STDIN_FILENO, FALSE);
+        else {
+                g_autoptr(GFile) file = NULL;
+
+                file = g_file_new_for_path(path);
+                input = G_INPUT_STREAM(g_file_read(file, NULL, &error));
+                if (!input)
+                        return df_fail_ret(-1, "Failed to open file %s: %s\n", path, error->message);
+        }
+
+        /* Compressed logs are decompressed on the fly */
+        stream = df_decompress_input_stream_new(input, &error);
+        if (!stream)
+                return df_fail_ret(-1, "Failed to read file %s: %s\n", path, error->message);
+
+        if (df_binlog_render(stream, stdout) < 0)
+                return df_fail_ret(-1, "Failed to render binary log %s\n", path);
+
+        return 0;
+}
+
+/* Same precedence as dfuzzer's exit status: error, failures, warnings, success
+ * and nothing tested */
+static int df_log_merge_exit_status(int a, int b)
+{
+        static const int precedence[] = { 1, 2, 3, 0, 4 };
+
+        for (size_t i = 0; i < G_N_ELEMENTS(precedence); i++)
+                if (a == precedence[i] || b == precedence[i])
+                        return precedence[i];
+
+        return 1;
+}
+
+static int df_log_merge_shard(const char *path, const char *spec, df_log_merge_t *m)
+{
+        guint index, count;
+
+        /* Not sharded */
+        if (!spec)
+                return 0;
+
+        if (df_shard_parse(spec, &index, &count) < 0)
+                return df_fail_ret(-1, "%s: invalid shard '%s'\n", path, spec);
+        if (m->shard_count == 0)
+                m->shard_count = count;
+        else if (count != m->shard_count)
+                return df_fail_ret(-1, "%s: shard %s doesn't match the other runs split into %u shards\n",
+                                   path, spec, m->shard_count);
+        if (!g_hash_table_add(m->shards, GUINT_TO_POINTER(index)))
+                return df_fail_ret(-1, "%s: shard %s was already merged\n", path, spec);
+
+        return 0;
+}
+
+static void df_log_merge_test(GHashTable *e, df_log_merge_t *m)
+{
+        const char *result, *kind, *reason;
+        guint64 calls;
+
+        result = g_hash_table_lookup(e, "result") ?: "";
+        kind = g_hash_table_lookup(e, "kind") ?: "";
+        reason = g_hash_table_lookup(e, "reason");
+
+        m->tests++;
+        if (safe_strtoull(g_hash_table_lookup(e, "calls") ?: "", &calls) == 0)
+                m->calls += calls;
+
+        if (g_str_equal(result, "PASS"))
+                m->passed++;
+        else if (g_str_equal(result, "SKIP"))
+                m->skipped++;
+        else {
+                if (g_str_equal(result, "FAIL"))
+                        m->failed++;
+                else
+                        m->errors++;
+
+                printf("%s [%c] %s %s %s %s%s%s\n", result, g_ascii_toupper(kind[0] ?: '?'),
+                       (char *) g_hash_table_lookup(e, "bus") ?: "",
+                       (char *) g_hash_table_lookup(e, "object") ?: "",
+                       (char *) g_hash_table_lookup(e, "interface") ?: "",
+                       (char *) g_hash_table_lookup(e, "name") ?: "",
+                       reason ? " - " : "", reason ?: "");
+        }
+}
+
+static int df_log_merge_file(const char *path, df_log_merge_t *m)
+{
+        g_autoptr(GError) error = NULL;
+        g_autoptr(gchar) contents = NULL;
+        g_auto(GStrv) records = NULL;
+        gboolean finished = FALSE;
+
+        if (!g_file_get_contents(path, &contents, NULL, &error))
+                return df_fail_ret(-1, "Failed to read file %s: %s\n", path, error->message);
+
+        m->runs++;
+        records = g_strsplit(contents, DF_JSON_RS, -1);
+        STRV_FOREACH(record, records) {
+                g_autoptr(GHashTable) e = NULL;
+                const char *event;
+
+                if (isempty(g_strstrip(record)))
+                        continue;
+
+                /* E.g. the truncated last event of a killed run */
+                if (df_json_parse_event(record, &e) < 0)
+                        return df_fail_ret(-1, "%s: invalid event: %s\n", path, record);
+
+                event = g_hash_table_lookup(e, "event") ?: "";
+                if (g_str_equal(event, "run_start")) {
+                        if (df_log_merge_shard(path, g_hash_table_lookup(e, "shard"), m) < 0)
+                                return -1;
+                } else if (g_str_equal(event, "test_end"))
+                        df_log_merge_test(e, m);
+                else if (g_str_equal(event, "run_end")) {
+                        guint64 exit_status;
+
+                        if (safe_strtoull(g_hash_table_lookup(e, "exit_status") ?: "", &exit_status) < 0)
+                                return df_fail_ret(-1, "%s: invalid exit status\n", path);
+
+                        m->exit_status = df_log_merge_exit_status(m->exit_status, (int) MIN(exit_status, 1000));
+                        finished = TRUE;
+                }
+        }
+
+        if (!finished)
+                return df_fail_ret(-1, "%s: the run didn't finish\n", path);
+
+        return 0;
+}
+
+static int df_log_merge_files(char **paths)
+{
+        g_autoptr(GHashTable) shards = NULL;
+        df_log_merge_t m = {
+                /* Neutral for df_log_merge_exit_status() */
+                .exit_status = 4,
+        };
+
+        shards = g_hash_table_new(g_direct_hash, g_direct_equal);
+        m.shards = shards;
+
+        STRV_FOREACH(path, paths)
+                if (df_log_merge_file(path, &m) < 0)
+                        m.exit_status = 1;
+
+        if (m.shard_count > 0) {
+                for (guint i = 1; i <= m.shard_count; i++)
+                        if (!g_hash_table_contains(shards, GUINT_TO_POINTER(i))) {
+                                df_fail("Shard %u/%u is missing\n", i, m.shard_count);
+                                m.exit_status = 1;
+                        }
+
+                printf("Runs: %"G_GUINT64_FORMAT" (shards: %u of %u)\n",
+                       m.runs, g_hash_table_size(shards), m.shard_count);
+        } else
+                printf("Runs: %"G_GUINT64_FORMAT"\n", m.runs);
+
+        printf("Tests: %"G_GUINT64_FORMAT" (PASS: %"G_GUINT64_FORMAT", FAIL: %"G_GUINT64_FORMAT
+               ", SKIP: %"G_GUINT64_FORMAT", ERROR: %"G_GUINT64_FORMAT")\n",
+               m.tests, m.passed, m.failed, m.skipped, m.errors);
+        printf("Calls: %"G_GUINT64_FORMAT"\n", m.calls);
+        printf("Exit status: %d\n", m.exit_status);
+
+        return m.exit_status;
+}
+
+int main(int argc, char **argv)
+{
+        static const struct option options[] = {
+                { "help",       no_argument,    NULL,   'h' },
+                { "version",    no_argument,    NULL,   'V' },
+                { "recover",    no_argument,    NULL,   'r' },
+                { "merge",      no_argument,    NULL,   'm' },
+                {}
+        };
+        gboolean recover = FALSE, merge = FALSE;
+        int c, r, ret = 0;
+
+        while ((c = getopt_long(argc, argv, "hVrm", options, NULL)) >= 0) {
+                switch (c) {
+                case 'h':
+                        df_log_print_help(argv[0]);
+                        return 0;
+                case 'V':
+                        printf("dfuzzer %s\n", G_STRINGIFY(DFUZZER_VERSION));
+                        return 0;
+                case 'r':
+                        recover = TRUE;
+                        break;
+                case 'm':
+                        merge = TRUE;
+                        break;
+                default:
+                        return 1;
+                }
+        }
+
+        if (optind >= argc) {
+                df_fail("Error: at least one log file is required!\nSee -h for help.\n");
+                return 1;
+        }
+
+        if (recover && merge) {
+                df_fail("Error: --recover and --merge are mutually exclusive.\n");
+                return 1;
+        }
+
+        if (merge)
+                return df_log_merge_files(argv + optind);
+
+        for (int i = optind; i < argc; i++) {
+                if (recover)
+                        r = df_crashrec_recover(argv[i], stdout);
+                else
+                        r = df_log_render_file(argv[i]);
+                if (r < 0)
+                        ret = 1;
+        }
+
+        return ret;
+}
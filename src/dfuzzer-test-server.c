@@ -28,12 +28,24 @@
  * Test if org.freedesktop.dfuzzerServer is on SESSION bus:
  * $ gdbus call --session --dest org.freedesktop.DBus -o /org/freedesktop/Dbus \
  * --method org.freedesktop.DBus.ListNames | grep org.freedesktop.dfuzzerServer
+ *
+ * Besides the methods which always misbehave in the same way, the server can
+ * be made slow, leaky or crashy as a whole (see --help), which makes it
+ * a reference target for benchmarking timeout handling, resource detectors
+ * and recovery.
  */
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
 #include <gio/gio.h>
+#include <gio/gunixfdlist.h>
 #include <glib/gstdio.h>
 #include <glib-unix.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "util.h"
 
@@ -49,6 +61,29 @@ static struct {
         guint32 u;
 } prop_read_write;
 
+/* Upper bound of the latency of df_slow */
+#define DF_SLOW_MAX_MSEC 100
+/* Upper bound of the memory leaked by a df_leak_memory call */
+#define DF_LEAK_MAX_SIZE (64 * 1024)
+
+/* Misbehavior of all method calls, set from the command line */
+static struct {
+        /* Reply latency in msec, plus a random jitter of up to latency_jitter msec */
+        guint64 latency;
+        guint64 latency_jitter;
+        /* Rounds of busy work for each byte of the input */
+        guint64 burn_rounds;
+        /* Bytes of memory and number of fds to leak */
+        guint64 leak_memory;
+        guint64 leak_fds;
+        /* Crash on average every Nth call, 0 to never crash */
+        guint64 crash_rate;
+} modes;
+
+/* Keep the compiler from optimizing the busy work and leaks away */
+static volatile guint64 burn_sink;
+static void * volatile leak_sink;
+
 // Introspection data for the service we are exporting.
 static const gchar introspection_xml[] =
 "<node>"
@@ -93,6 +128,21 @@ static const gchar introspection_xml[] =
 "                       <arg type='a{t(bov)}' name='in5' direction='in'/>"
 "                       <arg type='i' name='response' direction='out'/>"
 "               </method>"
+"               <method name='df_slow'>"
+"                       <arg type='u' name='msec' direction='in'/>"
+"               </method>"
+"               <method name='df_burn'>"
+"                       <arg type='ay' name='data' direction='in'/>"
+"                       <arg type='t' name='hash' direction='out'/>"
+"               </method>"
+"               <method name='df_leak_memory'>"
+"                       <arg type='u' name='size' direction='in'/>"
+"               </method>"
+"               <method name='df_leak_fd'>"
+"               </method>"
+"               <method name='df_crash_intermittent'>"
+"                       <arg type='u' name='value' direction='in'/>"
+"               </method>"
 ""
 "               <property name='read_only' type='s' access='read'/>"
 "               <property name='write_only' type='s' access='write'/>"
@@ -114,15 +164,50 @@ static inline void test_abort(void)
         abort();
 }
 
-static void handle_method_call(
-                GDBusConnection *connection, const gchar *sender,
-                const gchar *object_path, const gchar *interface_name,
-                const gchar *method_name, GVariant *parameters,
-                GDBusMethodInvocation *invocation, gpointer user_data)
+/* Busy work proportional to the size of the serialized data */
+static guint64 burn_cpu(const guint8 *data, gsize size, guint64 rounds)
 {
-        g_autoptr(gchar) response = NULL;
+        guint64 hash = 14695981039346656037ULL;
 
-        g_printf("->[handle_method_call] %s\n", method_name);
+        /* FNV-1a, repeated */
+        for (gsize i = 0; i < size; i++)
+                for (guint64 r = 0; r < rounds; r++)
+                        hash = (hash ^ data[i]) * 1099511628211ULL;
+
+        return hash;
+}
+
+static void leak_memory(gsize size)
+{
+        void *p;
+
+        if (size == 0)
+                return;
+
+        /* Touch the memory, so it shows up in the RSS */
+        p = g_malloc(size);
+        memset(p, 0xaa, size);
+        leak_sink = p;
+}
+
+static void leak_fd(void)
+{
+        if (open("/dev/null", O_RDONLY) < 0)
+                g_printerr("Failed to open /dev/null: %m\n");
+}
+
+static gboolean return_empty_reply(gpointer user_data)
+{
+        g_dbus_method_invocation_return_value(user_data, g_variant_new("()"));
+
+        return G_SOURCE_REMOVE;
+}
+
+static void dispatch_method_call(GDBusMethodInvocation *invocation)
+{
+        const gchar *method_name = g_dbus_method_invocation_get_method_name(invocation);
+        GVariant *parameters = g_dbus_method_invocation_get_parameters(invocation);
+        g_autoptr(gchar) response = NULL;
 
         if (g_str_equal(method_name, "df_hello")) {
                 gchar *msg;
@@ -170,6 +255,76 @@ static void handle_method_call(
                 g_dbus_method_invocation_return_value(invocation, g_variant_new("(s)", response));
         } else if (g_str_equal(method_name, "df_complex_sig_2"))
                 g_dbus_method_invocation_return_value(invocation, g_variant_new("(i)", 0));
+        else if (g_str_equal(method_name, "df_slow")) {
+                guint32 msec;
+
+                /* Reply later without blocking the other calls */
+                g_variant_get(parameters, "(u)", &msec);
+                g_timeout_add(msec % (DF_SLOW_MAX_MSEC + 1), return_empty_reply, invocation);
+        } else if (g_str_equal(method_name, "df_burn")) {
+                g_autoptr(GVariant) data = NULL;
+                const guint8 *bytes;
+                gsize size;
+
+                g_variant_get(parameters, "(@ay)", &data);
+                bytes = g_variant_get_fixed_array(data, &size, sizeof(guint8));
+                g_dbus_method_invocation_return_value(invocation,
+                        g_variant_new("(t)", burn_cpu(bytes, size, modes.burn_rounds ?: 1000)));
+        } else if (g_str_equal(method_name, "df_leak_memory")) {
+                guint32 size;
+
+                g_variant_get(parameters, "(u)", &size);
+                leak_memory(size % (DF_LEAK_MAX_SIZE + 1));
+                g_dbus_method_invocation_return_value(invocation, g_variant_new("()"));
+        } else if (g_str_equal(method_name, "df_leak_fd")) {
+                leak_fd();
+                g_dbus_method_invocation_return_value(invocation, g_variant_new("()"));
+        } else if (g_str_equal(method_name, "df_crash_intermittent")) {
+                guint64 rate = modes.crash_rate ?: 100;
+                guint32 value;
+
+                /* Depends only on the input, so the crash is reproducible */
+                g_variant_get(parameters, "(u)", &value);
+                if (value % rate == 0)
+                        test_abort();
+
+                g_dbus_method_invocation_return_value(invocation, g_variant_new("()"));
+        }
+}
+
+static gboolean dispatch_delayed_method_call(gpointer user_data)
+{
+        dispatch_method_call(user_data);
+
+        return G_SOURCE_REMOVE;
+}
+
+static void handle_method_call(
+                GDBusConnection *connection, const gchar *sender,
+                const gchar *object_path, const gchar *interface_name,
+                const gchar *method_name, GVariant *parameters,
+                GDBusMethodInvocation *invocation, gpointer user_data)
+{
+        guint64 latency;
+
+        g_printf("->[handle_method_call] %s\n", method_name);
+
+        /* Misbehavior enabled from the command line, applied to all calls */
+        if (modes.crash_rate > 0 && g_random_int_range(0, (gint32) modes.crash_rate) == 0)
+                test_abort();
+        if (modes.burn_rounds > 0)
+                burn_sink = burn_cpu(g_variant_get_data(parameters), g_variant_get_size(parameters), modes.burn_rounds);
+        leak_memory(modes.leak_memory);
+        for (guint64 i = 0; i < modes.leak_fds; i++)
+                leak_fd();
+
+        latency = modes.latency;
+        if (modes.latency_jitter > 0)
+                latency += g_random_int_range(0, (gint32) modes.latency_jitter + 1);
+        if (latency > 0)
+                g_timeout_add(latency, dispatch_delayed_method_call, invocation);
+        else
+                dispatch_method_call(invocation);
 }
 
 static GVariant *handle_get_property(
@@ -226,6 +381,475 @@ static const GDBusInterfaceVTable interface_vtable = {
         .set_property = handle_set_property
 };
 
+/* Synthetic object tree (--tree-objects=), for benchmarking traversal and
+ * introspection. Objects are numbered breadth-first, i.e. object i has
+ * children i * fanout + 1 ... i * fanout + fanout, and object 0 is the root
+ * at DF_TREE_ROOT. GDBus subtrees are only one level deep, so a subtree is
+ * registered for each object which has children. */
+
+#define DF_TREE_ROOT "/org/freedesktop/dfuzzerTree"
+/* Number of shared interfaces, object i implements Shared(i % this) */
+#define DF_TREE_SHARED_INTERFACES 4
+/* Every Nth object implements an interface unique to it */
+#define DF_TREE_UNIQUE_EVERY 10
+
+static const gchar tree_introspection_xml[] =
+"<node>"
+"       <interface name='org.freedesktop.dfuzzerTree.Node'>"
+"               <method name='Ping'>"
+"                       <arg type='s' name='msg' direction='in'/>"
+"                       <arg type='s' name='response' direction='out'/>"
+"               </method>"
+"               <property name='Index' type='u' access='read'/>"
+"       </interface>"
+"       <interface name='org.freedesktop.dfuzzerTree.Shared0'>"
+"               <method name='Add'>"
+"                       <arg type='i' name='a' direction='in'/>"
+"                       <arg type='i' name='b' direction='in'/>"
+"                       <arg type='i' name='sum' direction='out'/>"
+"               </method>"
+"       </interface>"
+"       <interface name='org.freedesktop.dfuzzerTree.Shared1'>"
+"               <method name='Add'>"
+"                       <arg type='i' name='a' direction='in'/>"
+"                       <arg type='i' name='b' direction='in'/>"
+"                       <arg type='i' name='sum' direction='out'/>"
+"               </method>"
+"       </interface>"
+"       <interface name='org.freedesktop.dfuzzerTree.Shared2'>"
+"               <method name='Add'>"
+"                       <arg type='i' name='a' direction='in'/>"
+"                       <arg type='i' name='b' direction='in'/>"
+"                       <arg type='i' name='sum' direction='out'/>"
+"               </method>"
+"       </interface>"
+"       <interface name='org.freedesktop.dfuzzerTree.Shared3'>"
+"               <method name='Add'>"
+"                       <arg type='i' name='a' direction='in'/>"
+"                       <arg type='i' name='b' direction='in'/>"
+"                       <arg type='i' name='sum' direction='out'/>"
+"               </method>"
+"       </interface>"
+"       <interface name='org.freedesktop.DBus.ObjectManager'>"
+"               <method name='GetManagedObjects'>"
+"                       <arg type='a{oa{sa{sv}}}' name='objects' direction='out'/>"
+"               </method>"
+"               <signal name='InterfacesAdded'>"
+"                       <arg type='o' name='object'/>"
+"                       <arg type='a{sa{sv}}' name='interfaces'/>"
+"               </signal>"
+"               <signal name='InterfacesRemoved'>"
+"                       <arg type='o' name='object'/>"
+"                       <arg type='as' name='interfaces'/>"
+"               </signal>"
+"       </interface>"
+"</node>";
+
+static struct {
+        /* Set from the command line */
+        guint64 objects;
+        guint64 depth;
+        guint64 fanout;
+        gboolean object_manager;
+
+        GDBusNodeInfo *introspection_data;
+        /* Object paths by index */
+        GPtrArray *paths;
+        /* Interfaces unique to an object, created on demand */
+        GHashTable *unique_interfaces;
+} tree = {
+        .depth = 3,
+        .fanout = 10,
+};
+
+static gboolean tree_has_child(guint64 index, guint64 child)
+{
+        return child > index * tree.fanout && child <= index * tree.fanout + tree.fanout && child < tree.paths->len;
+}
+
+static GDBusInterfaceInfo *tree_get_unique_interface(guint64 index)
+{
+        g_autoptr(GDBusNodeInfo) node_info = NULL;
+        g_autoptr(gchar) xml = NULL;
+        GDBusInterfaceInfo *info;
+
+        info = g_hash_table_lookup(tree.unique_interfaces, GSIZE_TO_POINTER(index));
+        if (info)
+                return info;
+
+        xml = g_strdup_printf("<node>"
+                              "  <interface name='org.freedesktop.dfuzzerTree.Unique%"G_GUINT64_FORMAT"'>"
+                              "    <method name='Echo'>"
+                              "      <arg type='v' name='in' direction='in'/>"
+                              "      <arg type='v' name='out' direction='out'/>"
+                              "    </method>"
+                              "  </interface>"
+                              "</node>", index);
+        node_info = g_dbus_node_info_new_for_xml(xml, NULL);
+        g_assert(node_info);
+
+        info = g_dbus_interface_info_ref(node_info->interfaces[0]);
+        g_hash_table_insert(tree.unique_interfaces, GSIZE_TO_POINTER(index), info);
+
+        return info;
+}
+
+/* Interfaces of an object, as a NULL-terminated array of new references */
+static GDBusInterfaceInfo **tree_get_interfaces(guint64 index)
+{
+        GPtrArray *interfaces = g_ptr_array_new();
+        GDBusInterfaceInfo **all = tree.introspection_data->interfaces;
+
+        g_ptr_array_add(interfaces, g_dbus_interface_info_ref(all[0]));
+        g_ptr_array_add(interfaces, g_dbus_interface_info_ref(all[1 + index % DF_TREE_SHARED_INTERFACES]));
+        if (index % DF_TREE_UNIQUE_EVERY == 0)
+                g_ptr_array_add(interfaces, g_dbus_interface_info_ref(tree_get_unique_interface(index)));
+        if (index == 0 && tree.object_manager)
+                g_ptr_array_add(interfaces, g_dbus_interface_info_ref(all[1 + DF_TREE_SHARED_INTERFACES]));
+        g_ptr_array_add(interfaces, NULL);
+
+        return (GDBusInterfaceInfo **) g_ptr_array_free(interfaces, FALSE);
+}
+
+/* Resolves a child node (or the subtree's own object if node is NULL) */
+static gboolean tree_resolve(gpointer user_data, const gchar *node, guint64 *ret_index)
+{
+        guint64 index = GPOINTER_TO_SIZE(user_data), child;
+        char *end;
+
+        if (!node) {
+                *ret_index = index;
+                return TRUE;
+        }
+
+        if (!g_str_has_prefix(node, "obj"))
+                return FALSE;
+
+        child = g_ascii_strtoull(node + strlen("obj"), &end, 10);
+        if (*end != '\0' || !tree_has_child(index, child))
+                return FALSE;
+
+        *ret_index = child;
+        return TRUE;
+}
+
+static GVariant *tree_get_managed_objects(void)
+{
+        GVariantBuilder objects;
+
+        g_variant_builder_init(&objects, G_VARIANT_TYPE("a{oa{sa{sv}}}"));
+        for (guint i = 1; i < tree.paths->len; i++) {
+                g_autofree GDBusInterfaceInfo **interfaces = tree_get_interfaces(i);
+                GVariantBuilder object;
+
+                g_variant_builder_init(&object, G_VARIANT_TYPE("a{sa{sv}}"));
+                for (GDBusInterfaceInfo **info = interfaces; *info; info++) {
+                        GVariantBuilder properties;
+
+                        g_variant_builder_init(&properties, G_VARIANT_TYPE("a{sv}"));
+                        if (info == interfaces)
+                                g_variant_builder_add(&properties, "{sv}", "Index", g_variant_new_uint32(i));
+                        g_variant_builder_add(&object, "{sa{sv}}", (*info)->name, &properties);
+                        g_dbus_interface_info_unref(*info);
+                }
+
+                g_variant_builder_add(&objects, "{oa{sa{sv}}}", tree.paths->pdata[i], &object);
+        }
+
+        return g_variant_new("(a{oa{sa{sv}}})", &objects);
+}
+
+static void tree_handle_method_call(
+                GDBusConnection *connection, const gchar *sender,
+                const gchar *object_path, const gchar *interface_name,
+                const gchar *method_name, GVariant *parameters,
+                GDBusMethodInvocation *invocation, gpointer user_data)
+{
+        if (g_str_equal(method_name, "Ping")) {
+                const gchar *msg;
+
+                g_variant_get(parameters, "(&s)", &msg);
+                g_dbus_method_invocation_return_value(invocation, g_variant_new("(s)", msg));
+        } else if (g_str_equal(method_name, "Add")) {
+                gint32 a, b;
+
+                g_variant_get(parameters, "(ii)", &a, &b);
+                g_dbus_method_invocation_return_value(invocation,
+                        g_variant_new("(i)", (gint32) ((guint32) a + (guint32) b)));
+        } else if (g_str_equal(method_name, "Echo"))
+                g_dbus_method_invocation_return_value(invocation, parameters);
+        else if (g_str_equal(method_name, "GetManagedObjects"))
+                g_dbus_method_invocation_return_value(invocation, tree_get_managed_objects());
+        else
+                g_dbus_method_invocation_return_dbus_error(invocation, "org.freedesktop.DBus.Error.UnknownMethod",
+                                                           method_name);
+}
+
+static GVariant *tree_handle_get_property(
+                GDBusConnection *connection, const gchar *sender, const gchar *object_path,
+                const gchar *interface_name, const gchar *property_name, GError **error,
+                gpointer user_data)
+{
+        return g_variant_new_uint32(GPOINTER_TO_SIZE(user_data));
+}
+
+static const GDBusInterfaceVTable tree_interface_vtable = {
+        .method_call = tree_handle_method_call,
+        .get_property = tree_handle_get_property,
+};
+
+static gchar **tree_enumerate(GDBusConnection *connection, const gchar *sender,
+                              const gchar *object_path, gpointer user_data)
+{
+        guint64 index = GPOINTER_TO_SIZE(user_data);
+        GPtrArray *nodes = g_ptr_array_new();
+
+        for (guint64 child = index * tree.fanout + 1; tree_has_child(index, child); child++)
+                g_ptr_array_add(nodes, g_strdup_printf("obj%"G_GUINT64_FORMAT, child));
+        g_ptr_array_add(nodes, NULL);
+
+        return (gchar **) g_ptr_array_free(nodes, FALSE);
+}
+
+static GDBusInterfaceInfo **tree_introspect(GDBusConnection *connection, const gchar *sender,
+                                            const gchar *object_path, const gchar *node,
+                                            gpointer user_data)
+{
+        guint64 index;
+
+        if (!tree_resolve(user_data, node, &index))
+                return NULL;
+
+        return tree_get_interfaces(index);
+}
+
+static const GDBusInterfaceVTable *tree_dispatch(GDBusConnection *connection, const gchar *sender,
+                                                 const gchar *object_path, const gchar *interface_name,
+                                                 const gchar *node, gpointer *out_user_data,
+                                                 gpointer user_data)
+{
+        guint64 index;
+
+        if (!tree_resolve(user_data, node, &index))
+                return NULL;
+
+        *out_user_data = GSIZE_TO_POINTER(index);
+        return &tree_interface_vtable;
+}
+
+static const GDBusSubtreeVTable tree_subtree_vtable = {
+        .enumerate = tree_enumerate,
+        .introspect = tree_introspect,
+        .dispatch = tree_dispatch,
+};
+
+static void tree_register(GDBusConnection *connection)
+{
+        guint64 n = 1, level = 1;
+
+        /* Number of objects which fit into the given depth */
+        for (guint64 d = 0; d < tree.depth && n < tree.objects; d++) {
+                level = level > G_MAXUINT32 / tree.fanout ? G_MAXUINT32 : level * tree.fanout;
+                n = MIN(n + level, G_MAXUINT32);
+        }
+        n = MIN(n, tree.objects);
+
+        tree.introspection_data = g_dbus_node_info_new_for_xml(tree_introspection_xml, NULL);
+        g_assert(tree.introspection_data);
+        tree.unique_interfaces = g_hash_table_new_full(NULL, NULL, NULL,
+                                                       (GDestroyNotify) g_dbus_interface_info_unref);
+        tree.paths = g_ptr_array_new_full(n, g_free);
+
+        g_ptr_array_add(tree.paths, g_strdup(DF_TREE_ROOT));
+        for (guint64 i = 1; i < n; i++)
+                g_ptr_array_add(tree.paths, g_strdup_printf("%s/obj%"G_GUINT64_FORMAT,
+                                                            (char *) tree.paths->pdata[(i - 1) / tree.fanout], i));
+
+        for (guint64 i = 0; i < n; i++) {
+                guint reg_id;
+
+                /* Leaves are served by the subtree of their parent */
+                if (i > 0 && !tree_has_child(i, i * tree.fanout + 1))
+                        continue;
+
+                reg_id = g_dbus_connection_register_subtree(connection, tree.paths->pdata[i],
+                                                            &tree_subtree_vtable,
+                                                            G_DBUS_SUBTREE_FLAGS_NONE,
+                                                            GSIZE_TO_POINTER(i),
+                                                            NULL, NULL);
+                g_assert(reg_id > 0);
+        }
+
+        g_printf("Registered %"G_GUINT64_FORMAT" objects under %s\n", n, DF_TREE_ROOT);
+}
+
+/* Planted bugs (--planted-bugs), each crashing the server on a specific
+ * input, for measuring how quickly dfuzzer finds them. Roughly ordered by
+ * difficulty, see test/bench-bugs.py for the expected odds:
+ *
+ *   df_bug_boundary_int         (i) is G_MAXINT32
+ *   df_bug_string_prefix        (s) starts with "/org/"
+ *   df_bug_array_length         (ai) has exactly 7 elements
+ *   df_bug_fd_type              (h) is the write end of a pipe
+ *   df_bug_magic_int            (u) is 7 modulo 1000
+ *   Sequence.df_bug_sequence_*  arm with 5 modulo 32, then fire with 9 modulo
+ *                               32 from the same connection
+ *   df_bug_deep_struct          (i(s(u(y)))) has y == 42 and u is 3 modulo 16
+ *   df_bug_magic_string         (s) is "dfuzzer-planted-bug", i.e. found only
+ *                               with a dictionary
+ */
+
+#define DF_BUGS_OBJECT "/org/freedesktop/dfuzzerBugs"
+
+static const gchar bugs_introspection_xml[] =
+"<node>"
+"       <interface name='org.freedesktop.dfuzzerBugs'>"
+"               <method name='df_bug_boundary_int'>"
+"                       <arg type='i' name='value' direction='in'/>"
+"               </method>"
+"               <method name='df_bug_string_prefix'>"
+"                       <arg type='s' name='value' direction='in'/>"
+"               </method>"
+"               <method name='df_bug_array_length'>"
+"                       <arg type='ai' name='value' direction='in'/>"
+"               </method>"
+"               <method name='df_bug_fd_type'>"
+"                       <arg type='h' name='value' direction='in'/>"
+"               </method>"
+"               <method name='df_bug_magic_int'>"
+"                       <arg type='u' name='value' direction='in'/>"
+"               </method>"
+"               <method name='df_bug_deep_struct'>"
+"                       <arg type='(i(s(u(y))))' name='value' direction='in'/>"
+"               </method>"
+"               <method name='df_bug_magic_string'>"
+"                       <arg type='s' name='value' direction='in'/>"
+"               </method>"
+"       </interface>"
+"       <interface name='org.freedesktop.dfuzzerBugs.Sequence'>"
+"               <method name='df_bug_sequence_arm'>"
+"                       <arg type='u' name='value' direction='in'/>"
+"               </method>"
+"               <method name='df_bug_sequence_fire'>"
+"                       <arg type='u' name='value' direction='in'/>"
+"               </method>"
+"       </interface>"
+"</node>";
+
+static gboolean planted_bugs;
+static GDBusNodeInfo *bugs_introspection_data;
+/* Unique names of connections which armed the sequence bug */
+static GHashTable *bugs_armed;
+
+static gboolean bugs_is_pipe_write_end(GDBusMethodInvocation *invocation, gint32 handle)
+{
+        g_autoptr(GError) error = NULL;
+        g_auto(fd_t) fd = -1;
+        GUnixFDList *fd_list;
+        struct stat st;
+        int flags;
+
+        fd_list = g_dbus_message_get_unix_fd_list(g_dbus_method_invocation_get_message(invocation));
+        if (!fd_list || handle < 0 || handle >= g_unix_fd_list_get_length(fd_list))
+                return FALSE;
+
+        fd = g_unix_fd_list_get(fd_list, handle, &error);
+        if (fd < 0)
+                return FALSE;
+
+        flags = fcntl(fd, F_GETFL);
+        return fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode) && flags >= 0 && (flags & O_ACCMODE) == O_WRONLY;
+}
+
+static gboolean bugs_is_triggered(GDBusMethodInvocation *invocation, const gchar *sender,
+                                  const gchar *method_name, GVariant *parameters)
+{
+        if (g_str_equal(method_name, "df_bug_boundary_int")) {
+                gint32 value;
+
+                g_variant_get(parameters, "(i)", &value);
+                return value == G_MAXINT32;
+        } else if (g_str_equal(method_name, "df_bug_string_prefix")) {
+                const gchar *value;
+
+                g_variant_get(parameters, "(&s)", &value);
+                return g_str_has_prefix(value, "/org/");
+        } else if (g_str_equal(method_name, "df_bug_array_length")) {
+                g_autoptr(GVariant) value = NULL;
+
+                g_variant_get(parameters, "(@ai)", &value);
+                return g_variant_n_children(value) == 7;
+        } else if (g_str_equal(method_name, "df_bug_fd_type")) {
+                gint32 handle;
+
+                g_variant_get(parameters, "(h)", &handle);
+                return bugs_is_pipe_write_end(invocation, handle);
+        } else if (g_str_equal(method_name, "df_bug_magic_int")) {
+                guint32 value;
+
+                g_variant_get(parameters, "(u)", &value);
+                return value % 1000 == 7;
+        } else if (g_str_equal(method_name, "df_bug_deep_struct")) {
+                guint32 u;
+                guchar y;
+
+                g_variant_get(parameters, "((i(s(u(y)))))", NULL, NULL, &u, &y);
+                return y == 42 && u % 16 == 3;
+        } else if (g_str_equal(method_name, "df_bug_magic_string")) {
+                const gchar *value;
+
+                g_variant_get(parameters, "(&s)", &value);
+                return g_str_equal(value, "dfuzzer-planted-bug");
+        } else if (g_str_equal(method_name, "df_bug_sequence_arm")) {
+                guint32 value;
+
+                g_variant_get(parameters, "(u)", &value);
+                if (value % 32 == 5)
+                        g_hash_table_add(bugs_armed, g_strdup(sender));
+                return FALSE;
+        } else if (g_str_equal(method_name, "df_bug_sequence_fire")) {
+                guint32 value;
+
+                g_variant_get(parameters, "(u)", &value);
+                return value % 32 == 9 && g_hash_table_contains(bugs_armed, sender);
+        }
+
+        return FALSE;
+}
+
+static void bugs_handle_method_call(
+                GDBusConnection *connection, const gchar *sender,
+                const gchar *object_path, const gchar *interface_name,
+                const gchar *method_name, GVariant *parameters,
+                GDBusMethodInvocation *invocation, gpointer user_data)
+{
+        if (bugs_is_triggered(invocation, sender, method_name, parameters)) {
+                g_printf("->[planted bug] %s\n", method_name);
+                test_abort();
+        }
+
+        g_dbus_method_invocation_return_value(invocation, g_variant_new("()"));
+}
+
+static const GDBusInterfaceVTable bugs_interface_vtable = {
+        .method_call = bugs_handle_method_call,
+};
+
+static void bugs_register(GDBusConnection *connection)
+{
+        bugs_introspection_data = g_dbus_node_info_new_for_xml(bugs_introspection_xml, NULL);
+        g_assert(bugs_introspection_data);
+        bugs_armed = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+        for (GDBusInterfaceInfo **info = bugs_introspection_data->interfaces; *info; info++) {
+                guint reg_id;
+
+                reg_id = g_dbus_connection_register_object(connection, DF_BUGS_OBJECT, *info,
+                                                           &bugs_interface_vtable, NULL, NULL, NULL);
+                g_assert(reg_id > 0);
+        }
+}
+
 static void bus_acquired(GDBusConnection *connection, const gchar *name, gpointer user_data)
 {
         g_printf("->[bus_acquired]\n");
@@ -243,6 +867,11 @@ static void bus_acquired(GDBusConnection *connection, const gchar *name, gpointe
                                 NULL,   // user_data_free_func
                                 NULL);  // GError**
         g_assert(reg_id > 0);
+
+        if (tree.objects > 0)
+                tree_register(connection);
+        if (planted_bugs)
+                bugs_register(connection);
 }
 
 static void name_acquired(GDBusConnection *connection, const gchar *name, gpointer user_data)
@@ -264,10 +893,132 @@ gboolean handle_signal(gpointer userdata)
         return FALSE;
 }
 
+static void print_help(const char *name)
+{
+        printf(
+         "Usage: %1$s [OPTIONS]\n\n"
+         "D-Bus test server for dfuzzer. Options apply to every method call:\n\n"
+         "  -h --help                   Show this help text.\n"
+         "     --latency=MSEC           Reply after MSEC milliseconds.\n"
+         "     --latency-jitter=MSEC    Add a random delay of up to MSEC milliseconds.\n"
+         "     --burn=ROUNDS            Do ROUNDS rounds of busy work per byte of the input.\n"
+         "                              Also the rounds of df_burn (default: 1000).\n"
+         "     --leak-memory=BYTES      Leak BYTES bytes of memory.\n"
+         "     --leak-fds=N             Leak N file descriptors.\n"
+         "     --crash-rate=N           Crash randomly, on average once every N calls.\n"
+         "                              Also the rate of df_crash_intermittent (default: 100).\n"
+         "     --tree-objects=N         Export a synthetic tree of N objects under\n"
+         "                              " DF_TREE_ROOT ".\n"
+         "     --tree-depth=D           Maximum depth of the tree (default: 3).\n"
+         "     --tree-fanout=F          Number of children of each object (default: 10).\n"
+         "     --tree-object-manager    Implement org.freedesktop.DBus.ObjectManager at the tree root.\n"
+         "     --planted-bugs           Export methods with planted bugs under " DF_BUGS_OBJECT ".\n"
+         , name);
+}
+
+static guint64 parse_number(const char *option, const char *value)
+{
+        guint64 n;
+        char *end;
+
+        /* Keep everything in the range of g_random_int_range() and g_timeout_add() */
+        errno = 0;
+        n = g_ascii_strtoull(value, &end, 10);
+        if (errno != 0 || end == value || *end != '\0' || n > G_MAXINT32) {
+                g_printerr("Invalid value for --%s: %s\n", option, value);
+                exit(1);
+        }
+
+        return n;
+}
+
+static void parse_arguments(int argc, char **argv)
+{
+        enum {
+                ARG_LATENCY = 0x100,
+                ARG_LATENCY_JITTER,
+                ARG_BURN,
+                ARG_LEAK_MEMORY,
+                ARG_LEAK_FDS,
+                ARG_CRASH_RATE,
+                ARG_TREE_OBJECTS,
+                ARG_TREE_DEPTH,
+                ARG_TREE_FANOUT,
+                ARG_TREE_OBJECT_MANAGER,
+                ARG_PLANTED_BUGS
+        };
+
+        static const struct option options[] = {
+                { "help",                no_argument,        NULL,   'h'                     },
+                { "latency",             required_argument,  NULL,   ARG_LATENCY             },
+                { "latency-jitter",      required_argument,  NULL,   ARG_LATENCY_JITTER      },
+                { "burn",                required_argument,  NULL,   ARG_BURN                },
+                { "leak-memory",         required_argument,  NULL,   ARG_LEAK_MEMORY         },
+                { "leak-fds",            required_argument,  NULL,   ARG_LEAK_FDS            },
+                { "crash-rate",          required_argument,  NULL,   ARG_CRASH_RATE          },
+                { "tree-objects",        required_argument,  NULL,   ARG_TREE_OBJECTS        },
+                { "tree-depth",          required_argument,  NULL,   ARG_TREE_DEPTH          },
+                { "tree-fanout",         required_argument,  NULL,   ARG_TREE_FANOUT         },
+                { "tree-object-manager", no_argument,        NULL,   ARG_TREE_OBJECT_MANAGER },
+                { "planted-bugs",        no_argument,        NULL,   ARG_PLANTED_BUGS        },
+                {}
+        };
+        int c, index;
+
+        while ((c = getopt_long(argc, argv, "h", options, &index)) >= 0) {
+                switch (c) {
+                        case 'h':
+                                print_help(argv[0]);
+                                exit(0);
+                        case ARG_LATENCY:
+                                modes.latency = parse_number(options[index].name, optarg);
+                                break;
+                        case ARG_LATENCY_JITTER:
+                                modes.latency_jitter = parse_number(options[index].name, optarg);
+                                break;
+                        case ARG_BURN:
+                                modes.burn_rounds = parse_number(options[index].name, optarg);
+                                break;
+                        case ARG_LEAK_MEMORY:
+                                modes.leak_memory = parse_number(options[index].name, optarg);
+                                break;
+                        case ARG_LEAK_FDS:
+                                modes.leak_fds = parse_number(options[index].name, optarg);
+                                break;
+                        case ARG_CRASH_RATE:
+                                modes.crash_rate = parse_number(options[index].name, optarg);
+                                break;
+                        case ARG_TREE_OBJECTS:
+                                tree.objects = parse_number(options[index].name, optarg);
+                                break;
+                        case ARG_TREE_DEPTH:
+                                tree.depth = parse_number(options[index].name, optarg);
+                                break;
+                        case ARG_TREE_FANOUT:
+                                tree.fanout = parse_number(options[index].name, optarg);
+                                if (tree.fanout == 0) {
+                                        g_printerr("--tree-fanout must be at least 1\n");
+                                        exit(1);
+                                }
+                                break;
+                        case ARG_TREE_OBJECT_MANAGER:
+                                tree.object_manager = TRUE;
+                                break;
+                        case ARG_PLANTED_BUGS:
+                                planted_bugs = TRUE;
+                                break;
+                        default:
+                                exit(1);
+                }
+        }
+}
+
 int main(int argc, char **argv)
 {
         guint name_id;
 
+        parse_arguments(argc, argv);
+
         // Parses introspection_xml and returns a GDBusNodeInfo representing the data.
         // The introspection XML must contain exactly one top-level <node> element.
         introspection_data = g_dbus_node_info_new_for_xml(introspection_xml, NULL);
@@ -28,13 +28,31 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <getopt.h>
+#include <signal.h>
 
+#include "binlog.h"
 #include "bus.h"
+#include "checkpoint.h"
+#include "control.h"
+#include "compress.h"
+#include "crashrec.h"
+#include "dictionary.h"
+#include "fdpool.h"
+#include "flightrec.h"
 #include "fuzz.h"
+#include "incremental.h"
 #include "introspection.h"
+#include "json.h"
 #include "log.h"
+#include "metrics.h"
+#include "plan.h"
+#include "probes.h"
+#include "profile.h"
 #include "rand.h"
+#include "shard.h"
+#include "stats.h"
 #include "suppression.h"
+#include "trace.h"
 #include "util.h"
 
 #define DF_BUS_ROOT_NODE "/"
@@ -78,6 +96,37 @@ static int df_supflg;
 static char *df_execute_cmd;
 /** Path to directory containing output logs */
 static char *df_log_dir_name;
+/** Write the log in the binary format (see binlog.h) */
+static gboolean df_log_binary;
+/** Compress the log with gzip */
+static gboolean df_log_compress;
+/** Number of recent inputs kept by the flight recorder, 0 if disabled */
+static guint64 df_flight_recorder_size;
+/** Number of recent inputs kept in the crash recorder file, 0 if disabled */
+static guint64 df_crash_recorder_size;
+/** Path or file descriptor number for the JSON event stream */
+static const char *df_json_target;
+/** Path to the Prometheus metrics file */
+static const char *df_metrics_file_name;
+/** Path to the control socket */
+static const char *df_control_socket_path;
+/** Print a per-phase time breakdown at exit */
+static gboolean df_print_profile;
+/** Only list what would be tested, with an estimated duration */
+static gboolean df_plan_mode;
+/** Path to the Chrome trace event file */
+static const char *df_trace_file_name;
+/** Seed for the random generators, the current time if not set */
+static guint64 df_seed;
+static gboolean df_seed_set;
+/** Path to the checkpoint file */
+static const char *df_checkpoint_file_name;
+/** Skip the tests completed in the checkpoint file */
+static gboolean df_resume;
+/** Path to the fingerprint file for incremental fuzzing */
+static const char *df_incremental_file_name;
+/** Number of iterations for members which didn't change since the last incremental run */
+static guint64 df_regression_iterations = DF_INCREMENTAL_REGRESSION_ITERATIONS;
 static guint64 df_max_iterations = G_MAXUINT32;
 static guint64 df_min_iterations = 10;
 
@@ -210,6 +259,65 @@ static int df_get_pid(GDBusConnection *dcon, gboolean activate)
         return pid;
 }
 
+/**
+ * @function Updates the progress reporting after a method or property test.
+ * @param progress Progress of the current interface from df_metrics_add_interface()
+ * @param ret Return value of the test
+ */
+static void df_member_tested(df_metrics_interface_t *progress, int ret)
+{
+        df_metrics_interface_tested(progress);
+        df_control_member_tested();
+
+        if (ret > 0) {
+                df_log_progress_finding();
+                df_metrics_record_finding();
+                df_control_record_finding();
+        }
+}
+
+/**
+ * @function Folds the result of a test completed before resuming into the
+ * result of the interface, see the handling of the return values of
+ * df_fuzz_test_method() and df_fuzz_test_property() below.
+ */
+static int df_resumed_result(int rv, int ret)
+{
+        if (ret == 3)
+                return rv == DF_BUS_FAIL ? rv : DF_BUS_WARNING;
+        if (ret > 0)
+                return DF_BUS_FAIL;
+
+        return rv;
+}
+
+/**
+ * @function Gives the full budget only to methods and properties which are
+ * new or changed since the last --incremental run, the unchanged ones get
+ * at most the regression budget.
+ * @param fingerprint Fingerprint of the method or property, NULL if
+ * incremental fuzzing is disabled
+ * @param iterations Full budget of the method or property
+ * @return Number of iterations to do
+ */
+static guint64 df_member_iterations(const char *kind, const char *object, const char *interface, const char *name,
+                                    const char *fingerprint, guint64 iterations)
+{
+        df_incremental_state_t state;
+
+        if (!fingerprint)
+                return iterations;
+
+        state = df_incremental_check(kind, object, interface, name, fingerprint);
+        if (state != DF_INCREMENTAL_UNCHANGED)
+                return iterations;
+
+        df_verbose("  %s %s unchanged since the last run, %"G_GUINT64_FORMAT" iterations\n", kind, name,
+                   MIN(iterations, df_regression_iterations));
+
+        return MIN(iterations, df_regression_iterations);
+}
+
 /**
  * @function Controls fuzz testing of all methods of specified interface (intf)
  * and reports results.
@@ -225,12 +333,17 @@ static int df_fuzz(GDBusConnection *dcon, const char *name, const char *object,
         g_autoptr(GDBusProxy) dproxy = NULL;
         g_autoptr(GDBusNodeInfo) node_info = NULL;
         GDBusInterfaceInfo *interface_info = NULL;
+        df_metrics_interface_t *progress = NULL;
+        gint64 start;
         guint64 iterations;
+        unsigned int seed;
         int method_found = 0, property_found = 0, ret;
         int rv = DF_BUS_OK;
 
         // initialization of random module
-        df_rand_init(time(NULL));
+        seed = df_seed_set ? (unsigned int) df_seed : time(NULL);
+        df_checkpoint_set_seed(seed);
+        df_rand_init(df_shard_seed(seed));
 
         // Sanity check fuzzing target
         if (isempty(name) || isempty(object) || isempty(interface)) {
@@ -246,18 +359,49 @@ static int df_fuzz(GDBusConnection *dcon, const char *name, const char *object,
         if (!dproxy)
                 return DF_BUS_ERROR;
 
+        start = g_get_monotonic_time();
         node_info = df_get_interface_info(dproxy, interface, &interface_info);
         if (!node_info)
                 return DF_BUS_ERROR;
+        df_trace_span("introspection", interface, start, g_get_monotonic_time(), object);
+
+        if (df_incremental_is_enabled()) {
+                g_autoptr(gchar) fingerprint = NULL;
+                df_incremental_state_t state;
+
+                fingerprint = df_incremental_fingerprint_interface(interface_info);
+                state = df_incremental_check("interface", object, interface, NULL, fingerprint);
+                df_verbose("  Interface %s since the last run\n", df_incremental_state_to_string(state));
+                if (!df_plan_is_enabled())
+                        df_incremental_record("interface", object, interface, NULL, fingerprint);
+        }
 
         if (df_fuzz_init(dproxy) == -1) {
                 df_debug("Error in df_fuzz_add_proxy()\n");
                 return DF_BUS_ERROR;
         }
 
+        /* Count everything that's going to be tested for the progress reporting */
+        if (df_metrics_is_enabled() || df_control_is_enabled()) {
+                guint64 total = 0;
+
+                STRV_FOREACH_COND(p, interface_info->properties, !df_skip_properties)
+                        if ((!df_test_property || g_str_equal(df_test_property, p->name)) &&
+                            df_shard_owns(object, interface, p->name))
+                                total++;
+                STRV_FOREACH_COND(m, interface_info->methods, !df_skip_methods)
+                        if ((!df_test_method || g_str_equal(df_test_method, m->name)) &&
+                            df_shard_owns(object, interface, m->name))
+                                total++;
+
+                progress = df_metrics_add_interface(object, interface, total);
+                df_control_begin_interface(total);
+        }
+
         /* Test properties */
         STRV_FOREACH_COND(p, interface_info->properties, !df_skip_properties) {
                 g_auto(df_dbus_property_t) dbus_property = {0,};
+                g_autoptr(gchar) fingerprint = NULL;
 
                 /* Test only a specific property if set */
                 if (df_test_property && !g_str_equal(df_test_property, p->name))
@@ -265,14 +409,49 @@ static int df_fuzz(GDBusConnection *dcon, const char *name, const char *object,
 
                 property_found = 1;
 
+                /* Tested by another shard */
+                if (!df_shard_owns(object, interface, p->name))
+                        continue;
+
+                if (df_checkpoint_is_completed("property", object, interface, p->name, &ret)) {
+                        df_verbose("%s  %sSKIP%s [P] %s - completed before resuming\n", ansi_cr(), ansi_blue(),
+                                   ansi_normal(), p->name);
+                        df_fuzz_report_skipped("property", name, object, interface, p->name, "completed-before-resume");
+                        df_member_tested(progress, ret);
+                        rv = df_resumed_result(rv, ret);
+                        continue;
+                }
+
                 dbus_property.name = strdup(p->name);
                 dbus_property.signature = strjoin("(", p->signature, ")");
                 dbus_property.is_readable = p->flags & G_DBUS_PROPERTY_INFO_FLAGS_READABLE;
                 dbus_property.is_writable = p->flags & G_DBUS_PROPERTY_INFO_FLAGS_WRITABLE;
                 dbus_property.expect_reply = df_object_returns_reply(p->annotations);
 
+                if (df_dictionary_is_loaded()) {
+                        df_dictionary_t *dictionary;
+
+                        dictionary = df_dictionary_resolve(interface, p->name, NULL);
+                        if (dictionary) {
+                                dbus_property.dictionaries = g_ptr_array_new_with_free_func((GDestroyNotify) df_dictionary_free);
+                                g_ptr_array_add(dbus_property.dictionaries, dictionary);
+                        }
+                }
+
                 iterations = df_get_number_of_iterations(dbus_property.signature);
                 iterations = CLAMP(iterations, df_min_iterations, df_max_iterations);
+                if (df_incremental_is_enabled())
+                        fingerprint = df_incremental_fingerprint_property(p);
+                iterations = df_member_iterations("property", object, interface, p->name, fingerprint, iterations);
+
+                if (df_plan_is_enabled()) {
+                        guint64 reads, writes;
+
+                        df_fuzz_get_property_iterations(&dbus_property, &reads, &writes);
+                        df_plan_add("property", name, object, interface, p->name, dbus_property.signature,
+                                    iterations, reads + writes, FALSE);
+                        continue;
+                }
                 ret = df_fuzz_test_property(
                                 dcon,
                                 &dbus_property,
@@ -281,12 +460,17 @@ static int df_fuzz(GDBusConnection *dcon, const char *name, const char *object,
                                 interface,
                                 df_pid,
                                 iterations);
+                df_member_tested(progress, ret);
+                if (ret >= 0)
+                        df_incremental_record("property", object, interface, p->name, fingerprint);
                 if (ret < 0) {
                         // error during testing method
                         df_debug("Error in df_fuzz_test_property()\n");
                         return DF_BUS_ERROR;
                 } else if (ret == 1 && !df_test_property) {
                         // launch process again after crash
+                        df_profile_enter(DF_PROFILE_RECOVERY);
+                        start = g_get_monotonic_time();
                         rv = DF_BUS_FAIL;
                         dproxy = safe_g_dbus_proxy_unref(dproxy);
 
@@ -306,6 +490,9 @@ static int df_fuzz(GDBusConnection *dcon, const char *name, const char *object,
                                 df_debug("Error in df_get_pid() on getting pid of process\n");
                                 return DF_BUS_ERROR;
                         }
+                        df_metrics_set_target_pid(df_pid);
+                        DF_PROBE2(target_restarted, name, df_pid);
+                        df_log_flush();
                         fprintf(stderr, "%s%s[RE-CONNECTED TO PID: %d]%s\n",
                                         ansi_cr(), ansi_cyan(), df_pid, ansi_blue());
 
@@ -313,6 +500,8 @@ static int df_fuzz(GDBusConnection *dcon, const char *name, const char *object,
                                 df_debug("Error in df_fuzz_add_proxy()\n");
                                 return DF_BUS_ERROR;
                         }
+                        df_profile_enter(DF_PROFILE_OTHER);
+                        df_trace_span("recovery", "reconnect", start, g_get_monotonic_time(), NULL);
                 } else if (ret == 1 && df_test_property)
                         rv = DF_BUS_FAIL;
         }
@@ -320,6 +509,8 @@ static int df_fuzz(GDBusConnection *dcon, const char *name, const char *object,
         /* Test methods */
         STRV_FOREACH_COND(m, interface_info->methods, !df_skip_methods) {
                 g_auto(df_dbus_method_t) dbus_method = {0,};
+                g_autoptr(gchar) fingerprint = NULL;
+                gboolean suppressed;
                 char *description;
 
                 /* Test only a specific method if set */
@@ -328,9 +519,26 @@ static int df_fuzz(GDBusConnection *dcon, const char *name, const char *object,
 
                 method_found = 1;
 
-                if (df_suppression_check(suppressions, object, interface, m->name, &description) != 0) {
+                /* Tested by another shard */
+                if (!df_shard_owns(object, interface, m->name))
+                        continue;
+
+                if (df_checkpoint_is_completed("method", object, interface, m->name, &ret)) {
+                        df_verbose("%s  %sSKIP%s [M] %s - completed before resuming\n", ansi_cr(), ansi_blue(),
+                                   ansi_normal(), m->name);
+                        df_fuzz_report_skipped("method", name, object, interface, m->name, "completed-before-resume");
+                        df_member_tested(progress, ret);
+                        rv = df_resumed_result(rv, ret);
+                        continue;
+                }
+
+                /* Suppressed methods are still listed in the plan */
+                suppressed = df_suppression_check(suppressions, object, interface, m->name, &description) != 0;
+                if (suppressed && !df_plan_is_enabled()) {
                         df_verbose("%s  %sSKIP%s [M] %s - %s\n", ansi_cr(), ansi_blue(), ansi_normal(),
                                    m->name, description ?: "suppressed method");
+                        df_fuzz_report_skipped("method", name, object, interface, m->name, "suppressed");
+                        df_member_tested(progress, 0);
                         continue;
                 }
 
@@ -338,9 +546,21 @@ static int df_fuzz(GDBusConnection *dcon, const char *name, const char *object,
                 dbus_method.signature = df_method_get_full_signature(m);
                 dbus_method.returns_value = !!*(m->out_args);
                 dbus_method.expect_reply = df_object_returns_reply(m->annotations);
+                dbus_method.dictionaries = df_dictionary_resolve_method(interface, m);
 
+                /* Make sure we go through all dictionary values for this method */
                 iterations = df_get_number_of_iterations(dbus_method.signature);
+                iterations = MAX(iterations, df_dictionary_get_max_length(dbus_method.dictionaries));
                 iterations = CLAMP(iterations, df_min_iterations, df_max_iterations);
+                if (df_incremental_is_enabled())
+                        fingerprint = df_incremental_fingerprint_method(m);
+                iterations = df_member_iterations("method", object, interface, m->name, fingerprint, iterations);
+
+                if (df_plan_is_enabled()) {
+                        df_plan_add("method", name, object, interface, m->name, dbus_method.signature,
+                                    iterations, suppressed ? 0 : iterations, suppressed);
+                        continue;
+                }
 
                 // tests for method
                 ret = df_fuzz_test_method(
@@ -351,12 +571,17 @@ static int df_fuzz(GDBusConnection *dcon, const char *name, const char *object,
                                 df_pid,
                                 df_execute_cmd,
                                 iterations);
+                df_member_tested(progress, ret);
+                if (ret >= 0)
+                        df_incremental_record("method", object, interface, m->name, fingerprint);
                 if (ret < 0) {
                         // error during testing method
                         df_debug("Error in df_fuzz_test_method()\n");
                         return DF_BUS_ERROR;
                 } else if (ret == 1 && !df_test_method) {
                         // launch process again after crash
+                        df_profile_enter(DF_PROFILE_RECOVERY);
+                        start = g_get_monotonic_time();
                         rv = DF_BUS_FAIL;
                         dproxy = safe_g_dbus_proxy_unref(dproxy);
 
@@ -376,6 +601,9 @@ static int df_fuzz(GDBusConnection *dcon, const char *name, const char *object,
                                 df_debug("Error in df_get_pid() on getting pid of process\n");
                                 return DF_BUS_ERROR;
                         }
+                        df_metrics_set_target_pid(df_pid);
+                        DF_PROBE2(target_restarted, name, df_pid);
+                        df_log_flush();
                         fprintf(stderr, "%s%s[RE-CONNECTED TO PID: %d]%s\n",
                                         ansi_cr(), ansi_cyan(), df_pid, ansi_blue());
 
@@ -383,6 +611,8 @@ static int df_fuzz(GDBusConnection *dcon, const char *name, const char *object,
                                 df_debug("Error in df_fuzz_add_proxy()\n");
                                 return DF_BUS_ERROR;
                         }
+                        df_profile_enter(DF_PROFILE_OTHER);
+                        df_trace_span("recovery", "reconnect", start, g_get_monotonic_time(), NULL);
                 } else if (ret == 1 && df_test_method) {
                         // for one method, testing ends with failure
                         rv = DF_BUS_FAIL;
@@ -436,6 +666,7 @@ static int df_traverse_node(GDBusConnection *dcon, const char *root_node)
         int rd = 0;          // return value from df_fuzz()
         int rt = 0;          // return value from recursive transition
         int ret = DF_BUS_OK; // return value of this function
+        gint64 start;
 
 
         if (!df_is_valid_dbus(target_proc.name, root_node, intro_iface))
@@ -446,6 +677,7 @@ static int df_traverse_node(GDBusConnection *dcon, const char *root_node)
         if (!dproxy)
                 return DF_BUS_ERROR;
 
+        start = g_get_monotonic_time();
         response = df_bus_call(dproxy, intro_method, NULL, G_DBUS_CALL_FLAGS_NONE);
         if (!response)
                 return DF_BUS_ERROR;
@@ -464,13 +696,21 @@ static int df_traverse_node(GDBusConnection *dcon, const char *root_node)
                 df_error("Error in g_dbus_node_info_new_for_xml()", error);
                 return DF_BUS_ERROR;
         }
+        df_trace_span("introspection", root_node, start, g_get_monotonic_time(), NULL);
+        DF_PROBE2(introspection_done, target_proc.name, root_node);
 
         // go through all interfaces
         STRV_FOREACH(interface, node_data->interfaces) {
+                df_log_flush();
                 fprintf(stderr, " Interface: %s%s%s\n",
                         ansi_bold(), interface->name, ansi_normal());
                 // start fuzzing on the target_proc.name
+                start = g_get_monotonic_time();
                 rd = df_fuzz(dcon, target_proc.name, root_node, interface->name);
+                df_trace_span("interface", interface->name, start, g_get_monotonic_time(), root_node);
+                /* Keep the fingerprints of the tested members even if the run gets killed later */
+                if (df_incremental_flush() < 0)
+                        return DF_BUS_ERROR;
                 if (rd == DF_BUS_ERROR)
                         return DF_BUS_ERROR;
                 else if (ret != DF_BUS_FAIL) {
@@ -493,6 +733,7 @@ static int df_traverse_node(GDBusConnection *dcon, const char *root_node)
                         df_fail("Error: Could not allocate memory for root_node string.\n");
                         return DF_BUS_ERROR;
                 }
+                df_log_flush();
                 fprintf(stderr, "Object: %s%s%s\n", ansi_bold(), object, ansi_normal());
                 rt = df_traverse_node(dcon, object);
                 if (rt == DF_BUS_ERROR)
@@ -576,6 +817,28 @@ static void df_print_help(const char *name)
          "  -d --debug                  Enable debug logging; implies -v.\n"
          "  -L --log-dir=DIRNAME        Write full, parseable log into DIRNAME/BUS_NAME.\n"
          "                              The directory must already exist.\n"
+         "     --log-format=FORMAT      Format of the log written by --log-dir=: 'text' (default)\n"
+         "                              or 'binary' (DIRNAME/BUS_NAME.dflog, see dfuzzer-log(1)).\n"
+         "     --log-compress           Compress the log written by --log-dir= with gzip.\n"
+         "     --flight-recorder=N      Keep only the last N successful inputs in memory and write\n"
+         "                              them into the log on failure or on SIGUSR1, instead of\n"
+         "                              logging every input. Requires --log-dir=.\n"
+         "     --crash-recorder=N       Keep the last N inputs in DIRNAME/BUS_NAME.dfcrash, which\n"
+         "                              survives even if dfuzzer gets killed, see dfuzzer-log(1)\n"
+         "                              --recover. Requires --log-dir=.\n"
+         "     --json=FILE|FD           Write a machine-readable stream of events (RFC 7464 JSON\n"
+         "                              text sequences) into FILE or the file descriptor FD.\n"
+         "     --metrics-file=PATH      Periodically rewrite PATH with Prometheus metrics (calls/s,\n"
+         "                              latencies, progress, crashes and the target's memory usage).\n"
+         "     --control-socket=PATH    Listen on a Unix socket at PATH for commands to show the live\n"
+         "                              status, pause, resume or skip the current test.\n"
+         "     --plan                   Only introspect the bus name and list the methods and\n"
+         "                              properties which would be tested, with their number of\n"
+         "                              iterations and an estimated duration, without calling them.\n"
+         "     --profile                Print how much time was spent in each phase of testing\n"
+         "                              (generating inputs, calls, logging, ...) at exit.\n"
+         "     --trace=FILE             Write a timeline of introspection, tests, calls and recoveries\n"
+         "                              into FILE in the Chrome trace event format.\n"
          "  -s --no-suppressions        Don't load suppression file(s).\n"
          "  -o --object=OBJECT_PATH     Optional object path to test. All children objects are traversed.\n"
          "  -i --interface=INTERFACE    Interface to test. Requires -o to be set as well.\n"
@@ -596,10 +859,31 @@ static void df_print_help(const char *name)
          "                              Default: 10 iterations; minimum: 1 iteration.\n"
          "  -I --iterations=ITER        Set both the minimum and maximum number of iterations to ITER\n"
          "                              See --max-iterations= and --min-iterations= above\n"
+         "     --seed=SEED              Seed the random generators with SEED instead of the current\n"
+         "                              time, to make runs reproducible.\n"
+         "     --checkpoint=FILE        Periodically write the completed tests, the current test and\n"
+         "                              the findings into FILE, to be able to resume the run later.\n"
+         "     --resume                 Skip the tests completed in the --checkpoint= file, if it\n"
+         "                              exists, and continue with its seed.\n"
+         "     --incremental=FILE       Keep fingerprints of the tested interfaces, methods and\n"
+         "                              properties in FILE and give only the regression budget to\n"
+         "                              methods and properties which didn't change since the last\n"
+         "                              run with the same FILE.\n"
+         "     --regression-iterations=ITER\n"
+         "                              Maximum number of iterations for unchanged methods and\n"
+         "                              properties with --incremental=. Default: 5 iterations.\n"
+         "     --shard=K/N              Test only the K-th of N disjoint parts of the methods and\n"
+         "                              properties, to split the testing between N processes. See\n"
+         "                              dfuzzer-log(1) --merge for combining their results.\n"
          "  -e --command=COMMAND        Command/script to execute after each method call.\n"
          "     --show-command-output    Don't suppress stdout/stderr of a COMMAND.\n"
          "  -f --dictionary=FILENAME    Name of a file with custom dictionary which is used as input\n"
          "                              for fuzzed methods before generating random data.\n"
+         "  -D --typed-dictionary=FILENAME\n"
+         "                              Name of a file with typed dictionaries scoped to interfaces,\n"
+         "                              members or arguments. Can be used multiple times.\n"
+         "     --nesting-stress         Generate maximally nested arrays, structs, dicts and variants\n"
+         "                              for variant arguments.\n"
          "\nExamples:\n\n"
          "Test all methods of GNOME Shell. Be verbose.\n"
          "# %1$s -v -n org.gnome.Shell\n\n"
@@ -623,12 +907,30 @@ static void df_parse_parameters(int argc, char **argv)
                  * short variant */
                 ARG_SKIP_METHODS = 0x100,
                 ARG_SKIP_PROPERTIES,
-                ARG_SHOW_COMMAND_OUTPUT
+                ARG_SHOW_COMMAND_OUTPUT,
+                ARG_NESTING_STRESS,
+                ARG_LOG_FORMAT,
+                ARG_LOG_COMPRESS,
+                ARG_FLIGHT_RECORDER,
+                ARG_CRASH_RECORDER,
+                ARG_JSON,
+                ARG_METRICS_FILE,
+                ARG_CONTROL_SOCKET,
+                ARG_PROFILE,
+                ARG_PLAN,
+                ARG_TRACE,
+                ARG_SEED,
+                ARG_SHARD,
+                ARG_CHECKPOINT,
+                ARG_RESUME,
+                ARG_INCREMENTAL,
+                ARG_REGRESSION_ITERATIONS
         };
 
         static const struct option options[] = {
                 { "buffer-limit",        required_argument,  NULL,   'b'                     },
                 { "debug",               no_argument,        NULL,   'd'                     },
+                { "typed-dictionary",    required_argument,  NULL,   'D'                     },
                 { "command",             required_argument,  NULL,   'e'                     },
                 { "string-file",         required_argument,  NULL,   'f'                     },
                 { "help",                no_argument,        NULL,   'h'                     },
@@ -649,10 +951,27 @@ static void df_parse_parameters(int argc, char **argv)
                 { "skip-methods",        no_argument,        NULL,   ARG_SKIP_METHODS        },
                 { "skip-properties",     no_argument,        NULL,   ARG_SKIP_PROPERTIES     },
                 { "show-command-output", no_argument,        NULL,   ARG_SHOW_COMMAND_OUTPUT },
+                { "nesting-stress",      no_argument,        NULL,   ARG_NESTING_STRESS      },
+                { "log-format",          required_argument,  NULL,   ARG_LOG_FORMAT          },
+                { "log-compress",        no_argument,        NULL,   ARG_LOG_COMPRESS        },
+                { "flight-recorder",     required_argument,  NULL,   ARG_FLIGHT_RECORDER     },
+                { "crash-recorder",      required_argument,  NULL,   ARG_CRASH_RECORDER      },
+                { "json",                required_argument,  NULL,   ARG_JSON                },
+                { "metrics-file",        required_argument,  NULL,   ARG_METRICS_FILE        },
+                { "control-socket",      required_argument,  NULL,   ARG_CONTROL_SOCKET      },
+                { "profile",             no_argument,        NULL,   ARG_PROFILE             },
+                { "plan",                no_argument,        NULL,   ARG_PLAN                },
+                { "trace",               required_argument,  NULL,   ARG_TRACE               },
+                { "seed",                required_argument,  NULL,   ARG_SEED                },
+                { "shard",               required_argument,  NULL,   ARG_SHARD               },
+                { "checkpoint",          required_argument,  NULL,   ARG_CHECKPOINT          },
+                { "resume",              no_argument,        NULL,   ARG_RESUME              },
+                { "incremental",         required_argument,  NULL,   ARG_INCREMENTAL         },
+                { "regression-iterations", required_argument, NULL,  ARG_REGRESSION_ITERATIONS },
                 {}
         };
 
-        while ((c = getopt_long(argc, argv, "n:o:i:m:b:t:e:L:x:y:f:I:p:sdvlhV", options, NULL)) >= 0) {
+        while ((c = getopt_long(argc, argv, "n:o:i:m:b:t:e:L:x:y:f:D:I:p:sdvlhV", options, NULL)) >= 0) {
                 switch (c) {
                         case 'n':
                                 if (strlen(optarg) >= MAX_OBJECT_PATH_LENGTH) {
@@ -791,6 +1110,14 @@ static void df_parse_parameters(int argc, char **argv)
                                         exit(1);
                                 }
 
+                                break;
+                        case 'D':
+                                r = df_dictionary_load(optarg);
+                                if (r < 0) {
+                                        df_fail("Error: failed to load typed dictionary from file '%s'\n", optarg);
+                                        exit(1);
+                                }
+
                                 break;
                         case ARG_SKIP_METHODS:
                                 df_skip_methods = TRUE;
@@ -800,6 +1127,104 @@ static void df_parse_parameters(int argc, char **argv)
                                 break;
                         case ARG_SHOW_COMMAND_OUTPUT:
                                 df_fuzz_set_show_command_output(TRUE);
+                                break;
+                        case ARG_NESTING_STRESS:
+                                df_rand_set_nesting_stress(TRUE);
+                                break;
+                        case ARG_LOG_FORMAT:
+                                if (g_str_equal(optarg, "text"))
+                                        df_log_binary = FALSE;
+                                else if (g_str_equal(optarg, "binary"))
+                                        df_log_binary = TRUE;
+                                else {
+                                        df_fail("Error: invalid log format '%s'\n", optarg);
+                                        exit(1);
+                                }
+
+                                break;
+                        case ARG_LOG_COMPRESS:
+                                df_log_compress = TRUE;
+                                break;
+                        case ARG_FLIGHT_RECORDER:
+                                r = safe_strtoull(optarg, &df_flight_recorder_size);
+                                if (r < 0 || df_flight_recorder_size == 0 || df_flight_recorder_size > DF_FLIGHTREC_MAX_SIZE) {
+                                        df_fail("Error: invalid value for --flight-recorder=: %s (expected 1-%d)\n",
+                                                optarg, DF_FLIGHTREC_MAX_SIZE);
+                                        exit(1);
+                                }
+
+                                break;
+                        case ARG_CRASH_RECORDER:
+                                r = safe_strtoull(optarg, &df_crash_recorder_size);
+                                if (r < 0 || df_crash_recorder_size == 0 || df_crash_recorder_size > DF_CRASHREC_MAX_SLOTS) {
+                                        df_fail("Error: invalid value for --crash-recorder=: %s (expected 1-%d)\n",
+                                                optarg, DF_CRASHREC_MAX_SLOTS);
+                                        exit(1);
+                                }
+
+                                break;
+                        case ARG_JSON:
+                                df_json_target = optarg;
+                                break;
+                        case ARG_METRICS_FILE:
+                                df_metrics_file_name = optarg;
+                                break;
+                        case ARG_CONTROL_SOCKET:
+                                df_control_socket_path = optarg;
+                                break;
+                        case ARG_PROFILE:
+                                df_print_profile = TRUE;
+                                break;
+                        case ARG_PLAN:
+                                df_plan_mode = TRUE;
+                                break;
+                        case ARG_TRACE:
+                                df_trace_file_name = optarg;
+                                break;
+                        case ARG_SEED:
+                                r = safe_strtoull(optarg, &df_seed);
+                                if (r < 0 || df_seed > G_MAXUINT) {
+                                        df_fail("Error: invalid value for option --seed: %s\n",
+                                                r < 0 ? strerror(-r) : "out of range");
+                                        exit(1);
+                                }
+
+                                df_seed_set = TRUE;
+                                break;
+                        case ARG_SHARD: {
+                                guint index, count;
+
+                                if (df_shard_parse(optarg, &index, &count) < 0) {
+                                        df_fail("Error: invalid value for option --shard: %s (expected K/N with 1 <= K <= N <= %d)\n",
+                                                optarg, DF_SHARD_MAX);
+                                        exit(1);
+                                }
+
+                                df_shard_set(index, count);
+                                break;
+                        }
+                        case ARG_CHECKPOINT:
+                                df_checkpoint_file_name = optarg;
+                                break;
+                        case ARG_RESUME:
+                                df_resume = TRUE;
+                                break;
+                        case ARG_INCREMENTAL:
+                                df_incremental_file_name = optarg;
+                                break;
+                        case ARG_REGRESSION_ITERATIONS:
+                                r = safe_strtoull(optarg, &df_regression_iterations);
+                                if (r < 0) {
+                                        df_fail("Error: invalid value for option --regression-iterations: %s\n",
+                                                strerror(-r));
+                                        exit(1);
+                                }
+
+                                if (df_regression_iterations <= 0) {
+                                        df_fail("Error: --regression-iterations: at least 1 iteration required\n");
+                                        exit(1);
+                                }
+
                                 break;
                         default:    // '?'
                                 exit(1);
@@ -826,6 +1251,31 @@ static void df_parse_parameters(int argc, char **argv)
                 df_fail("Error: -t/--method= and -p/--property= are mutually exclusive.\n");
                 exit(1);
         }
+
+        if (df_flight_recorder_size > 0 && !df_log_dir_name) {
+                df_fail("Error: --flight-recorder= requires --log-dir= to be set.\n");
+                exit(1);
+        }
+
+        if (df_crash_recorder_size > 0 && !df_log_dir_name) {
+                df_fail("Error: --crash-recorder= requires --log-dir= to be set.\n");
+                exit(1);
+        }
+
+        if (df_resume && !df_checkpoint_file_name) {
+                df_fail("Error: --resume requires --checkpoint= to be set.\n");
+                exit(1);
+        }
+
+        if (df_regression_iterations != DF_INCREMENTAL_REGRESSION_ITERATIONS && !df_incremental_file_name) {
+                df_fail("Error: --regression-iterations= requires --incremental= to be set.\n");
+                exit(1);
+        }
+}
+
+static void df_sigusr1_handler(G_GNUC_UNUSED int sig)
+{
+        df_flightrec_request_dump();
 }
 
 static int df_process_bus(GBusType bus_type)
@@ -833,6 +1283,8 @@ static int df_process_bus(GBusType bus_type)
         g_autoptr(GDBusConnection) dcon = NULL;
         g_autoptr(GError) error = NULL;
 
+        df_log_flush();
+
         switch (bus_type) {
         case G_BUS_TYPE_SESSION:
                 fprintf(stderr, "%s%s[SESSION BUS]%s\n", ansi_cr(), ansi_cyan(), ansi_normal());
@@ -852,6 +1304,9 @@ static int df_process_bus(GBusType bus_type)
                 return DF_BUS_SKIP;
         }
 
+        /* Keep the recorded inputs per connection */
+        df_flightrec_reset();
+
         if (df_list_names) {
                 // list names on the bus
                 if (df_list_bus_names(dcon) == -1) {
@@ -862,8 +1317,12 @@ static int df_process_bus(GBusType bus_type)
                 // gets pid of tested process
                 df_pid = df_get_pid(dcon, TRUE);
                 if (df_pid > 0) {
+                        df_metrics_set_target_pid(df_pid);
                         df_print_process_info(df_pid);
                         fprintf(stderr, "%s%s[CONNECTED TO PID: %d]%s\n", ansi_cr(), ansi_cyan(), df_pid, ansi_normal());
+                        /* Without the latency the plan is still listed, just without the estimates */
+                        if (df_plan_is_enabled())
+                                (void) df_plan_measure_latency(dcon, target_proc.name);
                         if (!isempty(target_proc.interface)) {
                                 fprintf(stderr, "Object: %s%s%s\n", ansi_bold(), target_proc.obj_path, ansi_normal());
                                 fprintf(stderr, " Interface: %s%s%s\n", ansi_bold(), target_proc.interface, ansi_normal());
@@ -889,15 +1348,106 @@ int main(int argc, char **argv)
         const char *log_file_name;
         int rses = 0;               // return value from session bus testing
         int rsys = 0;               // return value from system bus testing
-        int ret = 0;
+        int ret = 0, r;
         df_parse_parameters(argc, argv);
 
+        if (df_print_profile)
+                df_profile_enable();
+        if (df_plan_mode)
+                df_plan_enable();
+
+        if (df_flight_recorder_size > 0) {
+                struct sigaction sa = {
+                        .sa_handler = df_sigusr1_handler,
+                        .sa_flags = SA_RESTART,
+                };
+
+                r = df_flightrec_init(df_flight_recorder_size);
+                if (r < 0) {
+                        df_fail("Error: failed to initialize the flight recorder: %s\n", strerror(-r));
+                        return 1;
+                }
+
+                if (sigaction(SIGUSR1, &sa, NULL) < 0) {
+                        df_fail("Error: failed to install the SIGUSR1 handler: %m\n");
+                        return 1;
+                }
+        }
+
         if (df_log_dir_name) {
-                log_file_name = strjoina(df_log_dir_name, "/", target_proc.name);
-                if (df_log_open_log_file(log_file_name) < 0) {
+                if (df_log_binary) {
+                        log_file_name = strjoina(df_log_dir_name, "/", target_proc.name, ".dflog",
+                                                 df_log_compress ? DF_COMPRESS_SUFFIX : "");
+                        r = df_binlog_open(log_file_name, df_log_compress);
+                } else {
+                        log_file_name = strjoina(df_log_dir_name, "/", target_proc.name,
+                                                 df_log_compress ? DF_COMPRESS_SUFFIX : "");
+                        r = df_log_open_log_file(log_file_name, df_log_compress);
+                }
+                if (r < 0) {
+                        ret = 1;
+                        goto cleanup;
+                }
+
+                if (df_crash_recorder_size > 0) {
+                        log_file_name = strjoina(df_log_dir_name, "/", target_proc.name, ".dfcrash");
+                        if (df_crashrec_open(log_file_name, df_crash_recorder_size) < 0) {
+                                ret = 1;
+                                goto cleanup;
+                        }
+                }
+        }
+        if (df_json_target) {
+                g_autoptr(gchar) shard = NULL;
+                GString *e;
+
+                if (df_json_open(df_json_target) < 0) {
                         ret = 1;
                         goto cleanup;
                 }
+
+                e = df_json_event_new("run_start");
+                df_json_event_add_string(e, "version", G_STRINGIFY(DFUZZER_VERSION));
+                df_json_event_add_string(e, "bus", target_proc.name);
+                df_json_event_add_string(e, "object", target_proc.obj_path);
+                df_json_event_add_string(e, "interface", target_proc.interface);
+                df_json_event_add_int(e, "pid", getpid());
+                shard = df_shard_to_string();
+                df_json_event_add_string(e, "shard", shard);
+                df_json_event_emit(e);
+        }
+        if (df_metrics_file_name && df_metrics_open(df_metrics_file_name, target_proc.name) < 0) {
+                ret = 1;
+                goto cleanup;
+        }
+        if (df_control_socket_path && df_control_open(df_control_socket_path) < 0) {
+                ret = 1;
+                goto cleanup;
+        }
+        if (df_trace_file_name && df_trace_open(df_trace_file_name) < 0) {
+                ret = 1;
+                goto cleanup;
+        }
+        /* The plan doesn't test anything, so there's nothing to checkpoint */
+        if (df_checkpoint_file_name && !df_list_names && !df_plan_mode) {
+                g_autoptr(gchar) shard = NULL;
+                unsigned int seed;
+
+                shard = df_shard_to_string();
+                if (df_checkpoint_open(df_checkpoint_file_name, target_proc.name, shard, df_resume) < 0) {
+                        ret = 1;
+                        goto cleanup;
+                }
+
+                /* Continue with the seed of the interrupted run */
+                if (!df_seed_set && df_checkpoint_get_seed(&seed)) {
+                        df_seed = seed;
+                        df_seed_set = TRUE;
+                }
+        }
+        if (df_incremental_file_name && !df_list_names && df_incremental_open(df_incremental_file_name) < 0) {
+                ret = 1;
+                goto cleanup;
         }
         if (!df_supflg) {
                 if (df_suppression_load(&suppressions, target_proc.name) < 0) {
@@ -927,10 +1477,55 @@ int main(int argc, char **argv)
                 // all remaining combinations, like both results missing
                 ret = 4;
 
+        df_log_flush();
+        if (df_plan_is_enabled())
+                df_plan_print(stdout);
+
+        /* Summary of latencies and error counters */
+        df_stats_print(stdout);
+        if (df_profile_is_enabled()) {
+                fputc('\n', stdout);
+                df_profile_print(stdout);
+        }
+        if (df_log_dir_name) {
+                log_file_name = strjoina(df_log_dir_name, "/", target_proc.name, DF_STATS_SUFFIX);
+                if (df_stats_write_file(log_file_name) < 0)
+                        ret = 1;
+        }
+
+        if (df_json_is_open()) {
+                GString *e;
+
+                e = df_json_event_new("run_end");
+                df_json_event_add_int(e, "exit_status", ret);
+                df_json_event_emit(e);
+        }
+
+        /* Make sure all queued records made it into the binary log */
+        if (df_binlog_close() < 0 || df_log_close_log_file() < 0 || df_json_close() < 0 || df_metrics_close() < 0 ||
+            df_trace_close() < 0 || df_checkpoint_close() < 0 || df_incremental_close() < 0)
+                ret = 1;
+
+        df_log_flush();
         fprintf(stderr, "%sExit status: %d%s\n", ansi_bold(), ret, ansi_normal());
 
 cleanup:
+        (void) df_binlog_close();
+        (void) df_log_close_log_file();
+        df_crashrec_close();
+        (void) df_json_close();
+        (void) df_metrics_close();
+        df_control_close();
+        (void) df_trace_close();
+        (void) df_checkpoint_close();
+        (void) df_incremental_close();
+        df_stats_reset();
+        df_profile_reset();
+        df_plan_reset();
         df_suppression_free(&suppressions);
+        df_dictionary_unload();
+        df_fd_pool_done();
+        df_flightrec_done();
 
         return ret;
 }
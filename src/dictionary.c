@@ -0,0 +1,461 @@
+/** @file dictionary.c */
+/*
+ * dfuzzer - tool for fuzz testing processes communicating through D-Bus.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <gio/gio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dictionary.h"
+#include "log.h"
+#include "util.h"
+
+/* Typed dictionaries loaded via -D/--typed-dictionary=, keyed by their
+ * scope in format "interface:member:argument", where each part may be empty
+ * (i.e. it matches anything) */
+static GHashTable *df_dictionary_scopes;
+
+static const char *const df_dictionary_type_names[_DF_DICTIONARY_TYPE_MAX] = {
+        [DF_DICTIONARY_STRING]          = "string",
+        [DF_DICTIONARY_OBJECT_PATH]     = "objpath",
+        [DF_DICTIONARY_SIGNATURE]       = "signature",
+        [DF_DICTIONARY_INTEGER]         = "integer",
+        [DF_DICTIONARY_BYTES]           = "bytes",
+};
+
+static df_dictionary_t *df_dictionary_new(gboolean owns_values)
+{
+        static const GDestroyNotify free_funcs[_DF_DICTIONARY_TYPE_MAX] = {
+                [DF_DICTIONARY_STRING]          = g_free,
+                [DF_DICTIONARY_OBJECT_PATH]     = g_free,
+                [DF_DICTIONARY_SIGNATURE]       = g_free,
+                [DF_DICTIONARY_INTEGER]         = g_free,
+                [DF_DICTIONARY_BYTES]           = (GDestroyNotify) g_bytes_unref,
+        };
+        df_dictionary_t *dictionary;
+
+        dictionary = g_new0(df_dictionary_t, 1);
+
+        /* "Resolved" dictionaries only borrow the values from the loaded ones */
+        for (size_t i = 0; i < _DF_DICTIONARY_TYPE_MAX; i++)
+                dictionary->values[i] = g_ptr_array_new_with_free_func(owns_values ? free_funcs[i] : NULL);
+
+        return dictionary;
+}
+
+void df_dictionary_free(df_dictionary_t *dictionary)
+{
+        if (!dictionary)
+                return;
+
+        for (size_t i = 0; i < _DF_DICTIONARY_TYPE_MAX; i++)
+                g_ptr_array_unref(dictionary->values[i]);
+
+        g_free(dictionary);
+}
+
+static int df_dictionary_parse_type(const char *name)
+{
+        for (size_t i = 0; i < _DF_DICTIONARY_TYPE_MAX; i++)
+                if (g_str_equal(name, df_dictionary_type_names[i]))
+                        return i;
+
+        return -EINVAL;
+}
+
+static GBytes *df_dictionary_parse_bytes(const char *hex)
+{
+        g_autoptr(GByteArray) bytes = NULL;
+        size_t len;
+
+        len = strlen(hex);
+        if (len % 2 != 0)
+                return NULL;
+
+        bytes = g_byte_array_sized_new(len / 2);
+        for (size_t i = 0; i < len; i += 2) {
+                int hi, lo;
+                guint8 b;
+
+                hi = g_ascii_xdigit_value(hex[i]);
+                lo = g_ascii_xdigit_value(hex[i + 1]);
+                if (hi < 0 || lo < 0)
+                        return NULL;
+
+                b = (hi << 4) | lo;
+                g_byte_array_append(bytes, &b, 1);
+        }
+
+        return g_byte_array_free_to_bytes(g_steal_pointer(&bytes));
+}
+
+static gpointer df_dictionary_parse_value(df_dictionary_type_t type, const char *value)
+{
+        switch (type) {
+        case DF_DICTIONARY_STRING: {
+                g_autoptr(gchar) str = NULL;
+
+                /* Allow C-style escape sequences for non-printable characters */
+                str = g_strcompress(value);
+                if (!g_utf8_validate(str, -1, NULL))
+                        return NULL;
+
+                return g_steal_pointer(&str);
+        }
+        case DF_DICTIONARY_OBJECT_PATH:
+                return g_variant_is_object_path(value) ? g_strdup(value) : NULL;
+        case DF_DICTIONARY_SIGNATURE:
+                return g_variant_is_signature(value) ? g_strdup(value) : NULL;
+        case DF_DICTIONARY_INTEGER: {
+                gint64 *n;
+                char *e = NULL;
+
+                n = g_new(gint64, 1);
+
+                /* Values above G_MAXINT64 are stored as their two's complement
+                 * counterparts, so they can be converted back to guint64 when used */
+                errno = 0;
+                if (value[0] == '-')
+                        *n = g_ascii_strtoll(value, &e, 0);
+                else
+                        *n = (gint64) g_ascii_strtoull(value, &e, 0);
+                if (errno > 0 || !e || e == value || *e != 0) {
+                        g_free(n);
+                        return NULL;
+                }
+
+                return n;
+        }
+        case DF_DICTIONARY_BYTES:
+                return df_dictionary_parse_bytes(value);
+        default:
+                g_assert_not_reached();
+        }
+
+        return NULL;
+}
+
+static char *df_dictionary_parse_scope(const char *line)
+{
+        g_auto(GStrv) parts = NULL;
+        g_autoptr(char) scope = NULL;
+        const char *p, *e;
+        guint n;
+
+        p = line + 1;
+        e = strchr(p, ']');
+        if (!e || !isempty(e + 1 + strspn(e + 1, " \t")))
+                return NULL;
+
+        scope = strndup(p, e - p);
+        if (!scope)
+                return NULL;
+
+        /* The scope is in format [interface:member:argument], where trailing
+         * parts can be omitted */
+        parts = g_strsplit(scope, ":", 0);
+        n = g_strv_length(parts);
+        if (n > 3)
+                return NULL;
+
+        return strjoin(n > 0 ? parts[0] : "", ":",
+                       n > 1 ? parts[1] : "", ":",
+                       n > 2 ? parts[2] : "");
+}
+
+int df_dictionary_load(const char *filename)
+{
+        g_autoptr(FILE) f = NULL;
+        g_autoptr(char) line = NULL;
+        df_dictionary_t *current = NULL;
+        size_t len = 0, nvalues = 0;
+        ssize_t n;
+
+        g_assert(filename);
+
+        f = fopen(filename, "r");
+        if (!f)
+                return df_fail_ret(-errno, "Failed to open file '%s': %m\n", filename);
+
+        if (!df_dictionary_scopes)
+                df_dictionary_scopes = g_hash_table_new_full(g_str_hash, g_str_equal, free,
+                                                             (GDestroyNotify) df_dictionary_free);
+
+        while ((n = getline(&line, &len, f)) > 0) {
+                g_autoptr(char) type_name = NULL, value = NULL;
+                gpointer parsed;
+                int type;
+
+                /* Drop the newline, including the carriage return of CRLF
+                 * files */
+                if (n > 0 && line[n - 1] == '\n')
+                        line[--n] = 0;
+                if (n > 0 && line[n - 1] == '\r')
+                        line[--n] = 0;
+
+                /* Skip empty lines and comments */
+                if (strspn(line, " \t") == (size_t) n || line[0] == '#')
+                        continue;
+
+                if (line[0] == '[') {
+                        g_autoptr(char) scope = NULL;
+
+                        scope = df_dictionary_parse_scope(line);
+                        if (!scope)
+                                return df_fail_ret(-EINVAL, "Invalid dictionary scope '%s'\n", line);
+
+                        current = g_hash_table_lookup(df_dictionary_scopes, scope);
+                        if (!current) {
+                                current = df_dictionary_new(/* owns_values= */ TRUE);
+                                g_hash_table_insert(df_dictionary_scopes, g_steal_pointer(&scope), current);
+                        }
+
+                        continue;
+                }
+
+                /* Values before the first scope apply to everything; the global
+                 * dictionary may already exist from a previously loaded file */
+                if (!current) {
+                        current = g_hash_table_lookup(df_dictionary_scopes, "::");
+                        if (!current) {
+                                current = df_dictionary_new(/* owns_values= */ TRUE);
+                                g_hash_table_insert(df_dictionary_scopes, strdup("::"), current);
+                        }
+                }
+
+                /* Each value is in format "type value", the value may be empty
+                 * (i.e. an empty string) */
+                if (sscanf(line, "%ms %m[^\n]", &type_name, &value) < 1)
+                        return df_fail_ret(-EINVAL, "Failed to parse line '%s'\n", line);
+
+                type = df_dictionary_parse_type(type_name);
+                if (type < 0)
+                        return df_fail_ret(-EINVAL, "Unknown dictionary value type '%s'\n", type_name);
+
+                parsed = df_dictionary_parse_value(type, value ?: "");
+                if (!parsed)
+                        return df_fail_ret(-EINVAL, "Invalid %s value '%s'\n", type_name, value ?: "");
+
+                g_ptr_array_add(current->values[type], parsed);
+                nvalues++;
+        }
+
+        if (ferror(f))
+                return df_fail_ret(-EIO, "Error while reading from the dictionary file: %m\n");
+
+        df_verbose("Loaded %zu typed dictionary value(s) in %u scope(s)\n",
+                   nvalues, g_hash_table_size(df_dictionary_scopes));
+
+        return 0;
+}
+
+void df_dictionary_unload(void)
+{
+        g_clear_pointer(&df_dictionary_scopes, g_hash_table_unref);
+}
+
+gboolean df_dictionary_is_loaded(void)
+{
+        return !!df_dictionary_scopes;
+}
+
+/**
+ * @function Merges values from all loaded scopes matching the given argument
+ * into a single dictionary. Values from more specific scopes come first.
+ * @param interface Interface name
+ * @param member Method or property name
+ * @param argument Argument name (may be NULL)
+ * @return Dictionary borrowing the matching values, or NULL if nothing matched
+ */
+df_dictionary_t *df_dictionary_resolve(const char *interface, const char *member, const char *argument)
+{
+        g_autoptr(df_dictionary_t) resolved = NULL;
+        const char *parts[3] = { interface, member, argument };
+
+        if (!df_dictionary_scopes)
+                return NULL;
+
+        /* Go from the most specific scope ("interface:member:argument") to the
+         * least specific one ("::"); each bit in mask represents whether the
+         * respective part should be used or wildcarded */
+        for (int mask = 7; mask >= 0; mask--) {
+                g_autoptr(char) key = NULL;
+                df_dictionary_t *found;
+                gboolean skip = FALSE;
+
+                for (size_t i = 0; i < G_N_ELEMENTS(parts); i++)
+                        if ((mask & (1 << i)) && isempty(parts[i]))
+                                skip = TRUE;
+                if (skip)
+                        continue;
+
+                key = strjoin(mask & 1 ? parts[0] : "", ":",
+                              mask & 2 ? parts[1] : "", ":",
+                              mask & 4 ? parts[2] : "");
+                if (!key)
+                        return NULL;
+
+                found = g_hash_table_lookup(df_dictionary_scopes, key);
+                if (!found)
+                        continue;
+
+                if (!resolved)
+                        resolved = df_dictionary_new(/* owns_values= */ FALSE);
+
+                for (size_t t = 0; t < _DF_DICTIONARY_TYPE_MAX; t++)
+                        for (guint i = 0; i < found->values[t]->len; i++)
+                                g_ptr_array_add(resolved->values[t], found->values[t]->pdata[i]);
+        }
+
+        return g_steal_pointer(&resolved);
+}
+
+/**
+ * @function Resolves dictionaries for each input argument of a method.
+ * @return Array of dictionaries (or NULLs) in the order of method's input
+ * arguments, or NULL if there are no dictionaries for this method at all
+ */
+GPtrArray *df_dictionary_resolve_method(const char *interface, const GDBusMethodInfo *method)
+{
+        g_autoptr(GPtrArray) dictionaries = NULL;
+        gboolean found = FALSE;
+
+        g_assert(method);
+
+        if (!df_dictionary_scopes)
+                return NULL;
+
+        dictionaries = g_ptr_array_new_with_free_func((GDestroyNotify) df_dictionary_free);
+
+        for (GDBusArgInfo **arg = method->in_args; *arg; arg++) {
+                df_dictionary_t *dictionary;
+
+                dictionary = df_dictionary_resolve(interface, method->name, (*arg)->name);
+                if (dictionary)
+                        found = TRUE;
+
+                g_ptr_array_add(dictionaries, dictionary);
+        }
+
+        return found ? g_steal_pointer(&dictionaries) : NULL;
+}
+
+guint64 df_dictionary_get_max_length(const GPtrArray *dictionaries)
+{
+        guint64 max = 0;
+
+        if (!dictionaries)
+                return 0;
+
+        for (guint i = 0; i < dictionaries->len; i++) {
+                const df_dictionary_t *dictionary = dictionaries->pdata[i];
+
+                if (!dictionary)
+                        continue;
+
+                for (size_t t = 0; t < _DF_DICTIONARY_TYPE_MAX; t++)
+                        max = MAX(max, dictionary->values[t]->len);
+        }
+
+        return max;
+}
+
+/**
+ * @function Returns a value from the dictionary for given type and iteration.
+ * Integers are truncated to the width of the requested type.
+ * @return Floating GVariant, or NULL if there's no such value
+ */
+GVariant *df_dictionary_get_value(const df_dictionary_t *dictionary, const GVariantType *type, guint64 iteration)
+{
+        const char *sig;
+        df_dictionary_type_t t;
+        gpointer value;
+        gint64 n;
+
+        if (!dictionary)
+                return NULL;
+
+        sig = g_variant_type_peek_string(type);
+        switch (sig[0]) {
+        case 's':
+                t = DF_DICTIONARY_STRING;
+                break;
+        case 'o':
+                t = DF_DICTIONARY_OBJECT_PATH;
+                break;
+        case 'g':
+                t = DF_DICTIONARY_SIGNATURE;
+                break;
+        case 'y':
+        case 'n':
+        case 'q':
+        case 'i':
+        case 'u':
+        case 'x':
+        case 't':
+                t = DF_DICTIONARY_INTEGER;
+                break;
+        case 'a':
+                if (sig[1] != 'y')
+                        return NULL;
+
+                t = DF_DICTIONARY_BYTES;
+                break;
+        default:
+                return NULL;
+        }
+
+        if (iteration >= dictionary->values[t]->len)
+                return NULL;
+
+        value = dictionary->values[t]->pdata[iteration];
+
+        switch (sig[0]) {
+        case 's':
+                return g_variant_new_string(value);
+        case 'o':
+                return g_variant_new_object_path(value);
+        case 'g':
+                return g_variant_new_signature(value);
+        case 'a':
+                return g_variant_new_from_bytes(G_VARIANT_TYPE_BYTESTRING, value, TRUE);
+        }
+
+        n = *(gint64 *) value;
+
+        switch (sig[0]) {
+        case 'y':
+                return g_variant_new_byte((guint8) n);
+        case 'n':
+                return g_variant_new_int16((gint16) n);
+        case 'q':
+                return g_variant_new_uint16((guint16) n);
+        case 'i':
+                return g_variant_new_int32((gint32) n);
+        case 'u':
+                return g_variant_new_uint32((guint32) n);
+        case 'x':
+                return g_variant_new_int64(n);
+        case 't':
+                return g_variant_new_uint64((guint64) n);
+        default:
+                g_assert_not_reached();
+        }
+
+        return NULL;
+}
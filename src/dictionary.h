@@ -0,0 +1,36 @@
+/** @file dictionary.h */
+#pragma once
+
+#include <gio/gio.h>
+
+/* Types of values a typed dictionary can hold */
+typedef enum df_dictionary_type {
+        DF_DICTIONARY_STRING = 0,
+        DF_DICTIONARY_OBJECT_PATH,
+        DF_DICTIONARY_SIGNATURE,
+        DF_DICTIONARY_INTEGER,
+        DF_DICTIONARY_BYTES,
+        _DF_DICTIONARY_TYPE_MAX
+} df_dictionary_type_t;
+
+/* A set of typed values which applies to a single (method/property) argument.
+ *
+ * Strings, object paths and signatures are stored as char*, integers
+ * as gint64*, and byte blobs as GBytes*.
+ */
+typedef struct df_dictionary {
+        GPtrArray *values[_DF_DICTIONARY_TYPE_MAX];
+} df_dictionary_t;
+
+void df_dictionary_free(df_dictionary_t *dictionary);
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(df_dictionary_t, df_dictionary_free)
+
+int df_dictionary_load(const char *filename);
+void df_dictionary_unload(void);
+gboolean df_dictionary_is_loaded(void);
+
+df_dictionary_t *df_dictionary_resolve(const char *interface, const char *member, const char *argument);
+GPtrArray *df_dictionary_resolve_method(const char *interface, const GDBusMethodInfo *method);
+guint64 df_dictionary_get_max_length(const GPtrArray *dictionaries);
+
+GVariant *df_dictionary_get_value(const df_dictionary_t *dictionary, const GVariantType *type, guint64 iteration);
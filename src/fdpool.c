@@ -0,0 +1,260 @@
+/** @file fdpool.c */
+/*
+ * dfuzzer - tool for fuzz testing processes communicating through D-Bus.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <gio/gio.h>
+#include <gio/gunixfdlist.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "fdpool.h"
+#include "log.h"
+#include "util.h"
+
+/** Number of pooled FDs of each type, so a single call can get more distinct
+  * FDs of the same type */
+#define DF_FD_POOL_SLOTS_PER_TYPE 2
+
+typedef struct df_fd_pool_entry {
+        df_fd_type_t type;
+        fd_t fd;
+        /* The other end of pipes and sockets, which we keep open so the remote
+         * side doesn't get EOF/EPIPE straight away */
+        fd_t peer;
+        guint64 uses;
+} df_fd_pool_entry_t;
+
+static const char *const df_fd_type_names[_DF_FD_TYPE_MAX] = {
+        [DF_FD_MEMFD]           = "memfd",
+        [DF_FD_PIPE_READ]       = "pipe (read end)",
+        [DF_FD_PIPE_WRITE]      = "pipe (write end)",
+        [DF_FD_SOCKET]          = "socket",
+        [DF_FD_DEV_NULL]        = "/dev/null",
+        [DF_FD_DIRECTORY]       = "directory",
+};
+
+static df_fd_pool_entry_t df_fd_pool[_DF_FD_TYPE_MAX * DF_FD_POOL_SLOTS_PER_TYPE];
+/** 0 if the pool is not initialized yet, 1 if it's ready, -1 if the
+  * initialization failed */
+static int df_fd_pool_state;
+/** Indices into df_fd_pool of FDs attached to the current call */
+static guint8 df_fd_pool_call[DF_FD_POOL_MAX_FDS_PER_CALL];
+static guint df_fd_pool_call_len;
+
+static int df_fd_pool_entry_open(df_fd_pool_entry_t *e)
+{
+        static const char content[] = "dfuzzer\n";
+        int fds[2];
+
+        g_assert(e);
+        g_assert(e->fd < 0 && e->peer < 0);
+
+        switch (e->type) {
+        case DF_FD_MEMFD:
+                e->fd = memfd_create("dfuzzer", MFD_CLOEXEC);
+                if (e->fd < 0)
+                        return -errno;
+                if (write(e->fd, content, sizeof(content) - 1) < 0 || lseek(e->fd, 0, SEEK_SET) < 0)
+                        return -errno;
+                break;
+        case DF_FD_PIPE_READ:
+        case DF_FD_PIPE_WRITE:
+                if (pipe2(fds, O_CLOEXEC) < 0)
+                        return -errno;
+
+                e->fd = fds[e->type == DF_FD_PIPE_READ ? 0 : 1];
+                e->peer = fds[e->type == DF_FD_PIPE_READ ? 1 : 0];
+
+                /* Give the remote side something to read */
+                if (e->type == DF_FD_PIPE_READ && write(e->peer, content, sizeof(content) - 1) < 0)
+                        return -errno;
+                break;
+        case DF_FD_SOCKET:
+                if (socketpair(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, 0, fds) < 0)
+                        return -errno;
+
+                e->fd = fds[0];
+                e->peer = fds[1];
+                break;
+        case DF_FD_DEV_NULL:
+                e->fd = open("/dev/null", O_RDWR|O_CLOEXEC);
+                if (e->fd < 0)
+                        return -errno;
+                break;
+        case DF_FD_DIRECTORY:
+                e->fd = open("/", O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+                if (e->fd < 0)
+                        return -errno;
+                break;
+        default:
+                g_assert_not_reached();
+        }
+
+        e->uses = 0;
+
+        return 0;
+}
+
+static void df_fd_pool_entry_close(df_fd_pool_entry_t *e)
+{
+        e->fd = safe_close(e->fd);
+        e->peer = safe_close(e->peer);
+}
+
+/**
+ * @function Opens all pooled FDs. Called implicitly on the first
+ * df_fd_pool_pick() call if not called explicitly before.
+ * @return 0 on success, negative errno on error
+ */
+int df_fd_pool_init(void)
+{
+        int r;
+
+        if (df_fd_pool_state > 0)
+                return 0;
+
+        for (size_t i = 0; i < G_N_ELEMENTS(df_fd_pool); i++)
+                df_fd_pool[i] = (df_fd_pool_entry_t) {
+                        .type = i % _DF_FD_TYPE_MAX,
+                        .fd = -1,
+                        .peer = -1,
+                };
+
+        for (size_t i = 0; i < G_N_ELEMENTS(df_fd_pool); i++) {
+                r = df_fd_pool_entry_open(&df_fd_pool[i]);
+                if (r < 0) {
+                        for (size_t j = 0; j <= i; j++)
+                                df_fd_pool_entry_close(&df_fd_pool[j]);
+
+                        df_fd_pool_state = -1;
+                        return df_fail_ret(r, "Failed to open a pooled %s FD: %s\n",
+                                           df_fd_type_names[df_fd_pool[i].type], strerror(-r));
+                }
+        }
+
+        df_fd_pool_state = 1;
+
+        return 0;
+}
+
+void df_fd_pool_done(void)
+{
+        if (df_fd_pool_state <= 0)
+                return;
+
+        for (size_t i = 0; i < G_N_ELEMENTS(df_fd_pool); i++)
+                df_fd_pool_entry_close(&df_fd_pool[i]);
+
+        df_fd_pool_call_len = 0;
+        df_fd_pool_state = 0;
+}
+
+/**
+ * @function Starts collecting FDs for 'h' arguments of a new call. Also
+ * recycles worn-out pooled FDs, since the remote side might have changed
+ * their state (filled the pipe, moved the offset, truncated the memfd, ...).
+ */
+void df_fd_pool_begin_call(void)
+{
+        df_fd_pool_call_len = 0;
+
+        if (df_fd_pool_state <= 0)
+                return;
+
+        for (size_t i = 0; i < G_N_ELEMENTS(df_fd_pool); i++) {
+                df_fd_pool_entry_t *e = &df_fd_pool[i];
+                int r;
+
+                if (e->fd >= 0 && e->uses < DF_FD_POOL_MAX_USES)
+                        continue;
+
+                df_fd_pool_entry_close(e);
+                r = df_fd_pool_entry_open(e);
+                if (r < 0) {
+                        df_debug("Failed to re-open a pooled %s FD: %s\n", df_fd_type_names[e->type], strerror(-r));
+                        df_fd_pool_entry_close(e);
+                }
+        }
+}
+
+/**
+ * @function Attaches a pooled FD to the current call. All FD types are
+ * used in the first iterations, then they're picked pseudo-randomly.
+ * @return Index of the FD in the call's FD list (i.e. the 'h' value),
+ * or -1 if the pool is not available
+ */
+int df_fd_pool_pick(guint64 iteration)
+{
+        size_t idx;
+
+        if (df_fd_pool_state == 0)
+                (void) df_fd_pool_init();
+        if (df_fd_pool_state < 0)
+                return -1;
+
+        /* Reuse already attached FDs if we hit the limit */
+        if (df_fd_pool_call_len >= DF_FD_POOL_MAX_FDS_PER_CALL)
+                return rand() % df_fd_pool_call_len;
+
+        idx = iteration < _DF_FD_TYPE_MAX ? iteration : (size_t) rand() % G_N_ELEMENTS(df_fd_pool);
+        if (df_fd_pool[idx].fd < 0)
+                return -1;
+
+        /* Attach each pooled FD only once */
+        for (guint i = 0; i < df_fd_pool_call_len; i++)
+                if (df_fd_pool_call[i] == idx)
+                        return i;
+
+        df_fd_pool[idx].uses++;
+        df_fd_pool_call[df_fd_pool_call_len] = idx;
+
+        return df_fd_pool_call_len++;
+}
+
+/**
+ * @function Creates an FD list for the current call. The list takes the pooled
+ * FDs without duplicating them, df_fd_pool_release() must be called on the list
+ * after the call to take them back.
+ * @return GUnixFDList with all FDs picked since df_fd_pool_begin_call(), or NULL
+ * if there are none
+ */
+GUnixFDList *df_fd_pool_end_call(void)
+{
+        gint fds[DF_FD_POOL_MAX_FDS_PER_CALL];
+
+        if (df_fd_pool_call_len == 0)
+                return NULL;
+
+        for (guint i = 0; i < df_fd_pool_call_len; i++)
+                fds[i] = df_fd_pool[df_fd_pool_call[i]].fd;
+
+        return g_unix_fd_list_new_from_array(fds, df_fd_pool_call_len);
+}
+
+void df_fd_pool_release(GUnixFDList *fd_list)
+{
+        if (!fd_list)
+                return;
+
+        /* Steal the pooled FDs back from the list, so they don't get closed
+         * when the list is finalized */
+        g_free(g_unix_fd_list_steal_fds(fd_list, NULL));
+}
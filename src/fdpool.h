@@ -0,0 +1,30 @@
+/** @file fdpool.h */
+#pragma once
+
+#include <gio/gio.h>
+#include <gio/gunixfdlist.h>
+
+/** Maximum number of FDs attached to a single call; dbus-daemon's default
+  * limit on the system bus is 16 FDs per message */
+#define DF_FD_POOL_MAX_FDS_PER_CALL 16
+/** Number of uses after which a pooled FD is closed and re-opened */
+#define DF_FD_POOL_MAX_USES 256
+
+/* Kinds of FDs in the pool */
+typedef enum df_fd_type {
+        DF_FD_MEMFD = 0,
+        DF_FD_PIPE_READ,
+        DF_FD_PIPE_WRITE,
+        DF_FD_SOCKET,
+        DF_FD_DEV_NULL,
+        DF_FD_DIRECTORY,
+        _DF_FD_TYPE_MAX
+} df_fd_type_t;
+
+int df_fd_pool_init(void);
+void df_fd_pool_done(void);
+
+void df_fd_pool_begin_call(void);
+int df_fd_pool_pick(guint64 iteration);
+GUnixFDList *df_fd_pool_end_call(void);
+void df_fd_pool_release(GUnixFDList *fd_list);
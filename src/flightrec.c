@@ -0,0 +1,157 @@
+/** @file flightrec.c */
+/*
+ * dfuzzer - tool for fuzz testing processes communicating through D-Bus.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <gio/gio.h>
+#include <signal.h>
+#include <string.h>
+
+#include "flightrec.h"
+
+/** Ring of the most recent inputs, NULL if the recorder is disabled */
+static df_flightrec_entry_t *df_flightrec;
+static guint df_flightrec_size;
+/** Index of the slot the next input goes to */
+static guint df_flightrec_next;
+static guint df_flightrec_count;
+/** Set from the SIGUSR1 handler */
+static volatile sig_atomic_t df_flightrec_dump_pending;
+
+static void df_flightrec_entry_clear(df_flightrec_entry_t *e)
+{
+        g_clear_pointer(&e->value, g_variant_unref);
+        memset(e, 0, sizeof(*e));
+}
+
+/**
+ * @function Enables the flight recorder, which keeps the last size inputs
+ * in memory instead of logging each of them.
+ * @param size Number of inputs to keep
+ * @return 0 on success, negative errno on error
+ */
+int df_flightrec_init(guint size)
+{
+        if (size == 0 || size > DF_FLIGHTREC_MAX_SIZE)
+                return -EINVAL;
+
+        df_flightrec_done();
+
+        df_flightrec = g_new0(df_flightrec_entry_t, size);
+        df_flightrec_size = size;
+
+        return 0;
+}
+
+void df_flightrec_done(void)
+{
+        df_flightrec_reset();
+        g_clear_pointer(&df_flightrec, g_free);
+        df_flightrec_size = 0;
+}
+
+gboolean df_flightrec_is_enabled(void)
+{
+        return !!df_flightrec;
+}
+
+/**
+ * @function Drops all recorded inputs, e.g. when switching to another
+ * connection.
+ */
+void df_flightrec_reset(void)
+{
+        for (guint i = 0; i < df_flightrec_size; i++)
+                df_flightrec_entry_clear(&df_flightrec[i]);
+
+        df_flightrec_next = df_flightrec_count = 0;
+}
+
+/**
+ * @function Records an input, overwriting the oldest one if the ring is full.
+ * All strings must be interned, since only the pointers are stored.
+ * @param value Input, a reference is taken
+ */
+void df_flightrec_add(const char *interface, const char *object, const char *method, const char *signature,
+                      guint32 method_id, guint64 iteration, GVariant *value)
+{
+        df_flightrec_entry_t *e;
+
+        g_assert(df_flightrec);
+        g_assert(value);
+
+        e = &df_flightrec[df_flightrec_next];
+        g_clear_pointer(&e->value, g_variant_unref);
+
+        *e = (df_flightrec_entry_t) {
+                .interface = interface,
+                .object = object,
+                .method = method,
+                .signature = signature,
+                .method_id = method_id,
+                .iteration = iteration,
+                .value = g_variant_ref(value),
+        };
+
+        df_flightrec_next = (df_flightrec_next + 1) % df_flightrec_size;
+        df_flightrec_count = MIN(df_flightrec_count + 1, df_flightrec_size);
+}
+
+/**
+ * @function Passes all recorded inputs, oldest first, to func and empties
+ * the ring, so the same input is never dumped twice.
+ * @return Number of dumped inputs
+ */
+guint df_flightrec_dump(df_flightrec_dump_func_t func, gpointer user_data)
+{
+        guint start, count = df_flightrec_count;
+
+        g_assert(func);
+
+        if (!df_flightrec)
+                return 0;
+
+        start = (df_flightrec_next + df_flightrec_size - count) % df_flightrec_size;
+        for (guint i = 0; i < count; i++)
+                func(&df_flightrec[(start + i) % df_flightrec_size], user_data);
+
+        df_flightrec_reset();
+
+        return count;
+}
+
+/**
+ * @function Asks for a dump at the next opportunity. Async-signal-safe,
+ * i.e. can be called from a signal handler.
+ */
+void df_flightrec_request_dump(void)
+{
+        df_flightrec_dump_pending = 1;
+}
+
+/**
+ * @function Checks (and clears) a pending dump request.
+ * @return TRUE if a dump was requested since the last call
+ */
+gboolean df_flightrec_dump_requested(void)
+{
+        if (!df_flightrec_dump_pending)
+                return FALSE;
+
+        df_flightrec_dump_pending = 0;
+
+        return TRUE;
+}
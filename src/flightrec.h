@@ -0,0 +1,34 @@
+/** @file flightrec.h */
+#pragma once
+
+#include <gio/gio.h>
+
+/** Maximum number of inputs kept by the flight recorder */
+#define DF_FLIGHTREC_MAX_SIZE 65536
+
+/* A single recorded input; the strings are interned (see g_intern_string()),
+ * so recording an input doesn't allocate anything */
+typedef struct df_flightrec_entry {
+        const char *interface;
+        const char *object;
+        const char *method;
+        const char *signature;
+        /* ID of the method in the binary log, if any */
+        guint32 method_id;
+        guint64 iteration;
+        GVariant *value;
+} df_flightrec_entry_t;
+
+typedef void (*df_flightrec_dump_func_t)(const df_flightrec_entry_t *entry, gpointer user_data);
+
+int df_flightrec_init(guint size);
+void df_flightrec_done(void);
+gboolean df_flightrec_is_enabled(void);
+void df_flightrec_reset(void);
+
+void df_flightrec_add(const char *interface, const char *object, const char *method, const char *signature,
+                      guint32 method_id, guint64 iteration, GVariant *value);
+guint df_flightrec_dump(df_flightrec_dump_func_t func, gpointer user_data);
+
+void df_flightrec_request_dump(void);
+gboolean df_flightrec_dump_requested(void);
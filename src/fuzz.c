@@ -27,9 +27,22 @@
 #include <unistd.h>
 
 #include "fuzz.h"
+#include "binlog.h"
 #include "bus.h"
+#include "checkpoint.h"
+#include "control.h"
+#include "crashrec.h"
+#include "dictionary.h"
+#include "fdpool.h"
+#include "flightrec.h"
+#include "json.h"
 #include "log.h"
+#include "metrics.h"
+#include "probes.h"
+#include "profile.h"
 #include "rand.h"
+#include "stats.h"
+#include "trace.h"
 #include "util.h"
 
 static guint64 fuzz_buffer_length = MAX_BUFFER_LENGTH;
@@ -39,6 +52,22 @@ static GDBusProxy *df_dproxy;
 /** Exceptions counter; if MAX_EXCEPTIONS is reached testing continues
   * with a next method */
 static char df_except_counter = 0;
+/** Currently tested method or property, for the JSON event stream */
+static struct {
+        const char *kind;
+        const char *bus;
+        const char *object;
+        const char *interface;
+        const char *name;
+        const char *signature;
+        gint64 start;
+        guint64 calls;
+        /* Why the test failed or was skipped, may be NULL */
+        const char *reason;
+        gboolean skipped;
+        /* Latencies and counters of the tested method, NULL for properties */
+        df_stats_method_t *stats;
+} df_current;
 
 void df_fuzz_set_buffer_length(const guint64 length)
 {
@@ -142,6 +171,99 @@ int df_fuzz_init(GDBusProxy *dproxy)
         return 0;
 }
 
+static GString *df_fuzz_json_event_new(const char *event)
+{
+        GString *e;
+
+        e = df_json_event_new(event);
+        df_json_event_add_string(e, "kind", df_current.kind);
+        df_json_event_add_string(e, "bus", df_current.bus);
+        df_json_event_add_string(e, "object", df_current.object);
+        df_json_event_add_string(e, "interface", df_current.interface);
+        df_json_event_add_string(e, "name", df_current.name);
+        df_json_event_add_string(e, "signature", df_current.signature);
+
+        return e;
+}
+
+static void df_fuzz_test_start(const char *kind, const char *bus, const char *object, const char *interface,
+                               const char *name, const char *signature, guint64 iterations)
+{
+        GString *e;
+
+        df_current.kind = kind;
+        df_current.bus = bus;
+        df_current.object = object;
+        df_current.interface = interface;
+        df_current.name = name;
+        df_current.signature = signature;
+        df_current.start = g_get_monotonic_time();
+        df_current.calls = 0;
+        df_current.reason = NULL;
+        df_current.skipped = FALSE;
+        df_current.stats = NULL;
+
+        df_control_test_start(kind, bus, object, interface, name, iterations);
+        df_checkpoint_test_start(kind, object, interface, name);
+        df_profile_begin_test(interface, name);
+
+        if (!df_json_is_open())
+                return;
+
+        e = df_fuzz_json_event_new("test_start");
+        df_json_event_add_uint(e, "iterations", iterations);
+        df_json_event_emit(e);
+}
+
+static void df_fuzz_test_end(int r)
+{
+        const char *result = r < 0 ? "ERROR" : r > 0 ? "FAIL" : df_current.skipped ? "SKIP" : "PASS";
+        GString *e;
+
+        df_profile_end_test();
+        df_checkpoint_test_end(r);
+        df_trace_span("test", df_current.name, df_current.start, g_get_monotonic_time(), result);
+
+        if (!df_json_is_open())
+                return;
+
+        e = df_fuzz_json_event_new("test_end");
+        df_json_event_add_string(e, "result", result);
+        df_json_event_add_string(e, "reason", df_current.reason);
+        df_json_event_add_uint(e, "calls", df_current.calls);
+        df_json_event_add_uint(e, "exceptions", df_except_counter);
+        df_json_event_add_int(e, "duration_usec", g_get_monotonic_time() - df_current.start);
+        df_json_event_emit(e);
+}
+
+/**
+ * @function Reports a method or property which is not tested at all (e.g.
+ * because it's suppressed) to the JSON event stream.
+ */
+void df_fuzz_report_skipped(const char *kind, const char *bus, const char *object, const char *interface,
+                            const char *name, const char *reason)
+{
+        df_fuzz_test_start(kind, bus, object, interface, name, NULL, 0);
+        df_current.skipped = TRUE;
+        df_current.reason = reason;
+        df_fuzz_test_end(0);
+}
+
+static void df_fuzz_json_exception(const char *dbus_error, GError *error)
+{
+        GString *e;
+
+        if (!df_json_is_open())
+                return;
+
+        g_dbus_error_strip_remote_error(error);
+
+        e = df_fuzz_json_event_new("exception");
+        df_json_event_add_string(e, "error", dbus_error);
+        df_json_event_add_string(e, "message", error->message);
+        df_json_event_emit(e);
+}
+
 /**
  * @function Prints all method signatures and their values on the output.
  * @return 0 on success, -1 on error
@@ -170,6 +292,37 @@ static void df_fuzz_write_log(const struct df_dbus_method *method, GVariant *val
         }
 }
 
+static void df_fuzz_write_recorded_input(const df_flightrec_entry_t *e, G_GNUC_UNUSED gpointer user_data)
+{
+        g_autoptr(gchar) variant_value = NULL;
+
+        if (df_binlog_is_open()) {
+                df_binlog_add_call(e->method_id, e->iteration, df_rand_get_seed(),
+                                   DF_BINLOG_OUTCOME_SUCCESS, e->value);
+                return;
+        }
+
+        variant_value = g_variant_print(e->value, TRUE);
+        df_log_file("%s;%s;%s;%s;%s;Success\n",
+                    e->interface, e->object, e->method, e->signature, variant_value);
+}
+
+/**
+ * @function Writes inputs kept by the flight recorder (if enabled) into
+ * the log.
+ * @param reason Why the inputs are dumped, for the console message
+ */
+static void df_fuzz_dump_flight_recorder(const char *reason)
+{
+        guint n;
+
+        if (!df_flightrec_is_enabled())
+                return;
+
+        n = df_flightrec_dump(df_fuzz_write_recorded_input, NULL);
+        df_fail("   flight recorder: %u recent input(s) written to the log (%s)\n", n, reason);
+}
+
 static int df_check_if_exited(const int pid) {
         g_autoptr(FILE) f = NULL;
         g_autoptr(char) line = NULL;
@@ -211,26 +364,39 @@ static int df_check_if_exited(const int pid) {
  * @param value GVariant tuple containing all method arguments signatures and
  * their values
  * @param void_method If method has out args 1, 0 otherwise
+ * @param ret_start When the call was sent (monotonic time)
+ * @param ret_usec Round-trip time of the call, without the back-off after
+ * a timeout
  * @return 0 on success, -1 on error, 1 if void method returned non-void
  * value or 2 when tested method raised exception (so it should be skipped)
  */
-static int df_fuzz_call_method(const struct df_dbus_method *method, GVariant *value)
+static int df_fuzz_call_method(const struct df_dbus_method *method, GVariant *value,
+                               gint64 *ret_start, guint64 *ret_usec)
 {
         g_autoptr(GError) error = NULL;
         g_autoptr(GVariant) response = NULL;
         g_autoptr(gchar) dbus_error = NULL;
+        g_autoptr(GUnixFDList) fd_list = NULL;
         const gchar *fmt;
 
+        /* Attach pooled FDs referenced by 'h' arguments (if any) */
+        fd_list = df_fd_pool_end_call();
+
         // Synchronously invokes method with arguments stored in value (GVariant *)
         // on df_dproxy.
-        response = g_dbus_proxy_call_sync(
+        *ret_start = g_get_monotonic_time();
+        response = g_dbus_proxy_call_with_unix_fd_list_sync(
                         df_dproxy,
                         method->name,
                         value,
                         G_DBUS_CALL_FLAGS_NONE,
                         -1,
+                        fd_list,
+                        NULL,
                         NULL,
                         &error);
+        *ret_usec = g_get_monotonic_time() - *ret_start;
+        df_fd_pool_release(fd_list);
         if (!response) {
                 if (g_dbus_connection_is_closed(g_dbus_proxy_get_connection(df_dproxy)))
                         return df_fail_ret(2, "%s  %sFAIL%s [M] %s - the connection is closed (this is most likely a bug in dfuzzer, "
@@ -239,13 +405,22 @@ static int df_fuzz_call_method(const struct df_dbus_method *method, GVariant *va
 
                 // D-Bus exceptions are accepted
                 dbus_error = g_dbus_error_get_remote_error(error);
+                df_stats_record_error(df_current.stats, dbus_error,
+                                      g_error_matches(error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT) ||
+                                      g_strcmp0(dbus_error, "org.freedesktop.DBus.Error.Timeout") == 0);
+                df_fuzz_json_exception(dbus_error, error);
+                df_metrics_record_exception();
                 if (dbus_error) {
                         if (g_str_equal(dbus_error, "org.freedesktop.DBus.Error.NoReply"))
                                 /* If the method is annotated as "NoReply", don't consider
                                  * not replying as an error */
                                 return method->expect_reply ? -1 : 0;
                         else if (g_str_equal(dbus_error, "org.freedesktop.DBus.Error.Timeout")) {
+                                gint64 start = g_get_monotonic_time();
+
+                                df_profile_enter(DF_PROFILE_RECOVERY);
                                 sleep(10);
+                                df_trace_span("recovery", "timeout", start, g_get_monotonic_time(), df_current.name);
                                 return -1;
                         } else if (g_str_equal(dbus_error, "org.freedesktop.DBus.Error.AccessDenied") ||
                                    g_str_equal(dbus_error, "org.freedesktop.DBus.Error.AuthFailed"))
@@ -292,7 +467,7 @@ static int df_fuzz_call_method(const struct df_dbus_method *method, GVariant *va
  * function returning non-void value, 3 on warnings and 4 when executed
  * command finished unsuccessfuly
  */
-int df_fuzz_test_method(
+static int df_fuzz_run_method_test(
                 const struct df_dbus_method *method, const char *name,
                 const char *obj, const char *intf, const int pid, const char *execute_cmd,
                 guint64 iterations)
@@ -300,6 +475,10 @@ int df_fuzz_test_method(
         g_autoptr(GVariant) value = NULL;
         int ret = 0;            // return value from df_fuzz_call_method()
         int execr = 0;          // return value from execution of execute_cmd
+        guint32 method_id = 0;  // ID of the method in the binary log
+        gboolean crashed;
+        const char *rec_intf = NULL, *rec_obj = NULL, *rec_method = NULL, *rec_signature = NULL;
+        guint64 i;
 
         df_debug("  Method: %s%s %s => %"G_GUINT64_FORMAT" iterations%s\n", ansi_bold(),
                  method->name, method->signature, iterations, ansi_normal());
@@ -308,24 +487,71 @@ int df_fuzz_test_method(
 
         df_except_counter = 0;
 
-        for (guint64 i = 0; i < iterations; i++) {
+        if (df_binlog_is_open())
+                method_id = df_binlog_add_method(intf, obj, method->name, method->signature);
+
+        /* The flight recorder stores only pointers, so intern the strings once
+         * per method instead of copying them for each input */
+        if (df_flightrec_is_enabled()) {
+                rec_intf = g_intern_string(intf);
+                rec_obj = g_intern_string(obj);
+                rec_method = g_intern_string(method->name);
+                rec_signature = g_intern_string(method->signature);
+        }
+
+        for (i = 0; i < iterations; i++) {
+                gint64 call_start;
+                guint64 call_usec;
                 int r;
 
                 value = safe_g_variant_unref(value);
 
+                /* Blocks while paused from the control socket */
+                df_profile_enter(DF_PROFILE_OTHER);
+                df_checkpoint_iteration(i);
+                if (df_control_checkpoint(i)) {
+                        df_verbose("%s  %sSKIP%s [M] %s - skipped on request\n",
+                                   ansi_cr(), ansi_blue(), ansi_normal(), method->name);
+                        df_current.skipped = TRUE;
+                        df_current.reason = "skipped-on-request";
+                        return 0;
+                }
+
+                /* Start collecting FDs for 'h' arguments of this call */
+                df_profile_enter(DF_PROFILE_GENERATE);
+                df_fd_pool_begin_call();
                 /* Create a random GVariant based on method's signature */
-                value = df_generate_random_from_signature(method->signature, i);
+                value = df_generate_random_arguments(method->signature, i, method->dictionaries);
                 if (!value)
                         return df_debug_ret(-1, "Failed to generate a variant for signature '%s'\n", method->signature);
 
                 /* Convert the floating variant reference into a full one */
                 value = g_variant_ref_sink(value);
-                ret = df_fuzz_call_method(method, value);
+                DF_PROBE3(input_generated, method->name, i, method->signature);
+                df_profile_enter(DF_PROFILE_LOG);
+                df_log_progress(method->name);
+                /* Keep the input in the crash recorder file until the call returns,
+                 * so it survives even if dfuzzer gets killed in the meantime */
+                df_profile_enter(DF_PROFILE_SERIALIZE);
+                df_crashrec_begin_call(intf, obj, method->name, method->signature, i, value);
+                df_profile_enter(DF_PROFILE_CALL);
+                DF_PROBE2(call_start, method->name, i);
+                ret = df_fuzz_call_method(method, value, &call_start, &call_usec);
+                DF_PROBE4(call_end, method->name, i, call_usec, ret);
+                df_profile_enter(DF_PROFILE_LOG);
+                df_trace_span("call", method->name, call_start, call_start + call_usec, NULL);
+                df_stats_record_call(df_current.stats, call_usec);
+                df_metrics_record_call(call_usec);
+                df_crashrec_end_call();
+                df_current.calls++;
+                df_profile_enter(DF_PROFILE_HOOK);
                 execr = execute_cmd ? df_execute_external_command(execute_cmd, show_command_output) : 0;
+                df_profile_enter(DF_PROFILE_LOG);
 
                 if (ret < 0) {
                         df_fail("%s  %sFAIL%s [M] %s - unexpected response\n",
                                 ansi_cr(), ansi_red(), ansi_normal(), method->name);
+                        df_current.reason = "unexpected-response";
                         break;
                 }
 
@@ -335,30 +561,46 @@ int df_fuzz_test_method(
                         df_fail("%s  %sFAIL%s [M] %s - '%s' returned %s%d%s\n",
                                 ansi_cr(), ansi_red(), ansi_normal(), method->name,
                                 execute_cmd, ansi_red(), execr, ansi_normal());
+                        df_current.reason = "command-failed";
                         break;
                 }
 
+                df_profile_enter(DF_PROFILE_LIVENESS);
                 r = df_check_if_exited(pid);
+                df_profile_enter(DF_PROFILE_LOG);
                 if (r < 0)
                         return df_fail_ret(-1, "Error while reading process' stat file: %m\n");
                 else if (r == 0) {
                         ret = -1;
                         df_fail("%s  %sFAIL%s [M] %s - process %d exited\n",
                                 ansi_cr(), ansi_red(), ansi_normal(), method->name, pid);
+                        df_current.reason = "process-exited";
                         break;
                 }
 
                 /* Ignore exceptions returned by the test method */
-                if (ret == 2)
+                if (ret == 2) {
+                        df_current.skipped = TRUE;
+                        df_current.reason = "exception";
                         return 0;
-                else if (ret > 0)
+                } else if (ret > 0) {
+                        df_current.reason = "void-method-returned-value";
                         break;
+                }
 
-                df_log_file("%s;%s;", intf, obj);
-
-                if (df_log_file_is_open())
+                if (df_flightrec_is_enabled()) {
+                        /* No log I/O on the success path, the recent inputs are
+                         * written out only on failure or on request */
+                        df_flightrec_add(rec_intf, rec_obj, rec_method, rec_signature, method_id, i, value);
+                        if (df_flightrec_dump_requested())
+                                df_fuzz_dump_flight_recorder("SIGUSR1");
+                } else if (df_binlog_is_open())
+                        df_binlog_add_call(method_id, i, df_rand_get_seed(), DF_BINLOG_OUTCOME_SUCCESS, value);
+                else if (df_log_file_is_open()) {
+                        df_log_file("%s;%s;", intf, obj);
                         df_fuzz_write_log(method, value);
-                df_log_file("Success\n");
+                        df_log_file("Success\n");
+                }
 
                 if (df_except_counter == MAX_EXCEPTIONS)
                         break;
@@ -373,6 +615,19 @@ int df_fuzz_test_method(
 
 
 fail_label:
+        /* The process might've crashed even if we noticed only an unexpected response */
+        df_profile_enter(DF_PROFILE_LIVENESS);
+        crashed = df_check_if_exited(pid) == 0;
+        df_profile_enter(DF_PROFILE_LOG);
+        if (crashed) {
+                DF_PROBE2(crash_detected, method->name, pid);
+                df_stats_record_crash(df_current.stats);
+                df_metrics_record_crash();
+        }
+
+        /* Inputs which preceded the failing one go into the log first */
+        df_fuzz_dump_flight_recorder("failure");
+
         if (ret != 1) {
                 df_fail("   on input:\n");
                 df_log_file("%s;%s;", intf, obj);
@@ -381,14 +636,44 @@ fail_label:
 
         df_fail("   reproducer: %sdfuzzer -v -n %s -o %s -i %s -t %s",
                 ansi_yellow(), name, obj, intf, method->name);
-        df_fail(" -b %"G_GUINT64_FORMAT, fuzz_buffer_length);
+        df_fail(" -b %"G_GUINT64_FORMAT" --seed=%u", fuzz_buffer_length, df_rand_get_seed());
         if (execute_cmd != NULL)
                 df_fail(" -e '%s'", execute_cmd);
         df_fail("%s\n", ansi_normal());
 
+        if (df_json_is_open()) {
+                g_autoptr(GString) reproducer = NULL;
+                g_autoptr(gchar) input = NULL;
+                GString *e;
+
+                reproducer = g_string_new(NULL);
+                g_string_printf(reproducer, "dfuzzer -v -n %s -o %s -i %s -t %s -b %"G_GUINT64_FORMAT" --seed=%u",
+                                name, obj, intf, method->name, fuzz_buffer_length, df_rand_get_seed());
+                if (execute_cmd != NULL)
+                        g_string_append_printf(reproducer, " -e '%s'", execute_cmd);
+                input = g_variant_print(value, TRUE);
+
+                e = df_fuzz_json_event_new("failure");
+                df_json_event_add_string(e, "reason", df_current.reason);
+                df_json_event_add_bool(e, "crash", crashed);
+                df_json_event_add_uint(e, "iteration", i);
+                df_json_event_add_uint(e, "seed", df_rand_get_seed());
+                df_json_event_add_uint(e, "buffer_limit", fuzz_buffer_length);
+                df_json_event_add_string(e, "command", execute_cmd);
+                df_json_event_add_string(e, "input", input);
+                df_json_event_add_string(e, "reproducer", reproducer->str);
+                df_json_event_emit(e);
+        }
+
         /* Method with a void return type returned a non-void value */
         if (ret == 1)
                 return 2;
+
+        if (df_binlog_is_open())
+                df_binlog_add_call(method_id, i, df_rand_get_seed(),
+                                   execr > 0 ? DF_BINLOG_OUTCOME_COMMAND_ERROR : DF_BINLOG_OUTCOME_CRASH,
+                                   value);
+
         /* Command specified via -e/--command returned a non-zero exit code */
         if (execr > 0) {
                 df_log_file("Command execution error\n");
@@ -399,6 +684,22 @@ fail_label:
         return 1;
 }
 
+int df_fuzz_test_method(
+                const struct df_dbus_method *method, const char *name,
+                const char *obj, const char *intf, const int pid, const char *execute_cmd,
+                guint64 iterations)
+{
+        int r;
+
+        df_fuzz_test_start("method", name, obj, intf, method->name, method->signature, iterations);
+        df_rand_init_member(obj, intf, method->name);
+        df_current.stats = df_stats_get_method(intf, method->name);
+        r = df_fuzz_run_method_test(method, name, obj, intf, pid, execute_cmd, iterations);
+        df_fuzz_test_end(r);
+
+        return r;
+}
+
 static int df_fuzz_get_property(GDBusProxy *pproxy, const char *interface,
                                 const struct df_dbus_property *property)
 {
@@ -419,26 +720,35 @@ static int df_fuzz_get_property(GDBusProxy *pproxy, const char *interface,
         return 0;
 }
 
+/* ret_start and ret_usec are the same as for df_fuzz_call_method() */
 static int df_fuzz_set_property(GDBusProxy *pproxy, const char *interface,
-                                const struct df_dbus_property *property, GVariant *value)
+                                const struct df_dbus_property *property, GVariant *value,
+                                gint64 *ret_start, guint64 *ret_usec)
 {
         g_autoptr(GVariant) val = NULL, response = NULL;
         g_autoptr(GError) error = NULL;
         g_autoptr(gchar) dbus_error = NULL;
+        g_autoptr(GUnixFDList) fd_list = NULL;
 
         /* Unwrap the variant, since our generator automagically wraps it in a tuple
          * to make generating method signatures easier. Property signatures should
          * consist of a single complete type, hence getting the first child from
          * the tuple should achieve just that. */
         val = g_variant_get_child_value(value, 0);
-        response = g_dbus_proxy_call_sync(
+        fd_list = df_fd_pool_end_call();
+        *ret_start = g_get_monotonic_time();
+        response = g_dbus_proxy_call_with_unix_fd_list_sync(
                         pproxy,
                         "Set",
                         g_variant_new("(ssv)", interface, property->name, val),
                         G_DBUS_CALL_FLAGS_NONE,
                         -1,
+                        fd_list,
+                        NULL,
                         NULL,
                         &error);
+        *ret_usec = g_get_monotonic_time() - *ret_start;
+        df_fd_pool_release(fd_list);
         if (!response) {
                 if (g_dbus_connection_is_closed(g_dbus_proxy_get_connection(pproxy)))
                         return df_fail_ret(2, "%s  %sFAIL%s [P] %s - the connection is closed (this is most likely a bug in dfuzzer, "
@@ -446,13 +756,19 @@ static int df_fuzz_set_property(GDBusProxy *pproxy, const char *interface,
                                            ansi_cr(), ansi_red(), ansi_normal(), property->name);
 
                 dbus_error = g_dbus_error_get_remote_error(error);
+                df_fuzz_json_exception(dbus_error, error);
+                df_metrics_record_exception();
                 if (dbus_error) {
                         if (g_str_equal(dbus_error, "org.freedesktop.DBus.Error.NoReply"))
                                 /* If the property is annotated as "NoReply", don't consider
                                  * not replying as an error */
                                 return property->expect_reply ? -1 : 0;
                         else if (g_str_equal(dbus_error, "org.freedesktop.DBus.Error.Timeout")) {
+                                gint64 start = g_get_monotonic_time();
+
+                                df_profile_enter(DF_PROFILE_RECOVERY);
                                 sleep(10);
+                                df_trace_span("recovery", "timeout", start, g_get_monotonic_time(), df_current.name);
                                 return -1;
                         } else if (g_str_equal(dbus_error, "org.freedesktop.DBus.Error.AccessDenied") ||
                                    g_str_equal(dbus_error, "org.freedesktop.DBus.Error.AuthFailed"))
@@ -481,11 +797,42 @@ static int df_fuzz_set_property(GDBusProxy *pproxy, const char *interface,
         return 0;
 }
 
-int df_fuzz_test_property(GDBusConnection *dcon, const struct df_dbus_property *property,
-                          const char *bus, const char *object, const char *interface,
-                          const int pid, guint64 iterations)
+/**
+ * @function Computes how many times df_fuzz_test_property() reads and writes
+ * the property.
+ * @param property Tested property
+ * @param reads Number of reads, 0 if the property is not readable
+ * @param writes Number of writes, 0 if the property is not writable
+ */
+void df_fuzz_get_property_iterations(const struct df_dbus_property *property, guint64 *reads, guint64 *writes)
+{
+        guint64 iterations;
+
+        g_assert(property);
+        g_assert(reads);
+        g_assert(writes);
+
+        /* For performance reasons read readable property only twice, since that
+         * should be enough to trigger most of the issues.
+         */
+        iterations = 2;
+        *reads = property->is_readable ? iterations : 0;
+
+        /* Cap the iterations for writable properties to 16 for now, since without
+         * dictionaries doing the "full" loop is mostly a waste of time. If there
+         * are dictionaries for the property, go through all their values.
+         */
+        iterations = MAX(CLAMP(iterations, 1, 16), df_dictionary_get_max_length(property->dictionaries));
+        *writes = property->is_writable ? iterations : 0;
+}
+
+static int df_fuzz_run_property_test(GDBusConnection *dcon, const struct df_dbus_property *property,
+                                     const char *bus, const char *object, const char *interface,
+                                     const int pid, guint64 iterations)
 {
         g_autoptr(GDBusProxy) pproxy = NULL;
+        guint64 reads, writes, call_usec;
+        gint64 call_start;
         int r;
 
         /* Create a "property proxy"
@@ -496,12 +843,10 @@ int df_fuzz_test_property(GDBusConnection *dcon, const struct df_dbus_property *
         if (!pproxy)
                 return df_fail_ret(-1, "Failed to create a property proxy for object '%s'\n", object);
 
-        /* Try to read the property if it's readable.
-         *
-         * For performance reasons read readable property only twice, since that
-         * should be enough to trigger most of the issues.
-         */
-        iterations = 2;
+        df_fuzz_get_property_iterations(property, &reads, &writes);
+
+        /* Try to read the property if it's readable */
+        iterations = reads;
         if (property->is_readable) {
                 df_debug("  Property: %s%s %s (read) => %"G_GUINT64_FORMAT" iterations%s\n", ansi_bold(),
                          property->name, property->signature, iterations, ansi_normal());
@@ -509,19 +854,36 @@ int df_fuzz_test_property(GDBusConnection *dcon, const struct df_dbus_property *
                 df_verbose("  [P] %s (read)...", property->name);
 
                 for (guint8 i = 0; i < iterations; i++) {
+                        df_checkpoint_iteration(i);
+                        if (df_control_checkpoint(i))
+                                goto skip;
+
+                        df_profile_enter(DF_PROFILE_LOG);
+                        df_log_progress(property->name);
+                        df_current.calls++;
+                        df_profile_enter(DF_PROFILE_CALL);
+                        DF_PROBE2(call_start, property->name, i);
+                        call_start = g_get_monotonic_time();
                         r = df_fuzz_get_property(pproxy, interface, property);
+                        df_profile_enter(DF_PROFILE_OTHER);
+                        DF_PROBE4(call_end, property->name, i, g_get_monotonic_time() - call_start, r);
+                        df_trace_span("call", property->name, call_start, g_get_monotonic_time(), "read");
                         if (r < 0)
                                 return df_fail_ret(1, "%s  %sFAIL%s [P] %s - unexpected response while reading a property\n",
                                                    ansi_cr(), ansi_red(), ansi_normal(), property->name);
                 }
 
                 /* Check if the remote side is still alive */
+                df_profile_enter(DF_PROFILE_LIVENESS);
                 r = df_check_if_exited(pid);
+                df_profile_enter(DF_PROFILE_OTHER);
                 if (r < 0)
                         return df_fail_ret(-1, "Error while reading process' stat file: %m\n");
                 else if (r == 0) {
                         df_fail("%s  %sFAIL%s [P] %s (read) - process %d exited\n",
                                 ansi_cr(), ansi_red(), ansi_normal(), property->name, pid);
+                        DF_PROBE2(crash_detected, property->name, pid);
+                        df_metrics_record_crash();
                         return 1;
                 }
 
@@ -529,12 +891,8 @@ int df_fuzz_test_property(GDBusConnection *dcon, const struct df_dbus_property *
                            ansi_cr(), ansi_green(), ansi_normal(), property->name);
         }
 
-        /* Try to write a random value to the property if it's writable
-         *
-         * Cap the iterations for writable properties to 16 for now, since without
-         * dictionaries doing the "full" loop is mostly a waste of time.
-         */
-        iterations = CLAMP(iterations, 1, 16);
+        /* Try to write a random value to the property if it's writable */
+        iterations = writes;
         if (property->is_writable) {
                 df_debug("  Property: %s%s %s (write) => %"G_GUINT64_FORMAT" iterations%s\n", ansi_bold(),
                          property->name, property->signature, iterations, ansi_normal());
@@ -544,30 +902,73 @@ int df_fuzz_test_property(GDBusConnection *dcon, const struct df_dbus_property *
                 for (guint64 i = 0; i < iterations; i++) {
                         g_autoptr(GVariant) value = NULL;
 
+                        df_checkpoint_iteration(i);
+                        if (df_control_checkpoint(i))
+                                goto skip;
+
+                        /* Start collecting FDs for 'h' arguments of this call */
+                        df_profile_enter(DF_PROFILE_GENERATE);
+                        df_fd_pool_begin_call();
                         /* Create a random GVariant based on method's signature */
-                        value = df_generate_random_from_signature(property->signature, i);
+                        value = df_generate_random_arguments(property->signature, i, property->dictionaries);
                         if (!value)
                                 return df_debug_ret(-1, "Failed to generate a variant for signature '%s'\n", property->signature);
 
                         /* Convert the floating variant reference into a full one */
                         value = g_variant_ref_sink(value);
-                        r = df_fuzz_set_property(pproxy, interface, property, value);
+                        DF_PROBE3(input_generated, property->name, i, property->signature);
+                        df_profile_enter(DF_PROFILE_LOG);
+                        df_log_progress(property->name);
+                        df_current.calls++;
+                        df_profile_enter(DF_PROFILE_CALL);
+                        DF_PROBE2(call_start, property->name, i);
+                        r = df_fuzz_set_property(pproxy, interface, property, value, &call_start, &call_usec);
+                        df_profile_enter(DF_PROFILE_OTHER);
+                        DF_PROBE4(call_end, property->name, i, call_usec, r);
+                        df_trace_span("call", property->name, call_start, call_start + call_usec, "write");
                         if (r < 0)
                                 return df_fail_ret(1, "%s  %sFAIL%s [P] %s (write) - unexpected response while writing to a property\n",
                                                    ansi_cr(), ansi_red(), ansi_normal(), property->name);
                 }
 
                 /* Check if the remote side is still alive */
+                df_profile_enter(DF_PROFILE_LIVENESS);
                 r = df_check_if_exited(pid);
+                df_profile_enter(DF_PROFILE_OTHER);
                 if (r < 0)
                         return df_fail_ret(-1, "Error while reading process' stat file: %m\n");
-                else if (r == 0)
+                else if (r == 0) {
+                        DF_PROBE2(crash_detected, property->name, pid);
+                        df_metrics_record_crash();
                         return df_fail_ret(1, "%s  %sFAIL%s [P] %s (write) - process %d exited\n",
                                            ansi_cr(), ansi_red(), ansi_normal(), property->name, pid);
+                }
 
                 df_verbose("%s  %sPASS%s [P] %s (write)\n",
                            ansi_cr(), ansi_green(), ansi_normal(), property->name);
         }
 
         return 0;
+
+skip:
+        df_verbose("%s  %sSKIP%s [P] %s - skipped on request\n",
+                   ansi_cr(), ansi_blue(), ansi_normal(), property->name);
+        df_current.skipped = TRUE;
+        df_current.reason = "skipped-on-request";
+
+        return 0;
+}
+
+int df_fuzz_test_property(GDBusConnection *dcon, const struct df_dbus_property *property,
+                          const char *bus, const char *object, const char *interface,
+                          const int pid, guint64 iterations)
+{
+        int r;
+
+        df_fuzz_test_start("property", bus, object, interface, property->name, property->signature, iterations);
+        df_rand_init_member(object, interface, property->name);
+        r = df_fuzz_run_property_test(dcon, property, bus, object, interface, pid, iterations);
+        df_fuzz_test_end(r);
+
+        return r;
 }
@@ -46,12 +46,16 @@ typedef struct df_dbus_method {
         char *signature;
         gboolean returns_value;
         gboolean expect_reply;
+        /* Typed dictionaries for each input argument, may be NULL */
+        GPtrArray *dictionaries;
 } df_dbus_method_t;
 
 static inline void df_dbus_method_clear(df_dbus_method_t *p)
 {
         free(p->name);
         free(p->signature);
+        if (p->dictionaries)
+                g_ptr_array_unref(p->dictionaries);
         memset(p, 0, sizeof(*p));
 }
 
@@ -61,12 +65,16 @@ typedef struct df_dbus_property {
         gboolean is_readable;
         gboolean is_writable;
         gboolean expect_reply;
+        /* Typed dictionary for the property value (wrapped in an array), may be NULL */
+        GPtrArray *dictionaries;
 } df_dbus_property_t;
 
 static inline void df_dbus_property_clear(df_dbus_property_t *p)
 {
         free(p->name);
         free(p->signature);
+        if (p->dictionaries)
+                g_ptr_array_unref(p->dictionaries);
         memset(p, 0, sizeof(*p));
 }
 
@@ -78,6 +86,7 @@ guint64 df_fuzz_get_buffer_length(void);
 void df_fuzz_set_show_command_output(gboolean value);
 
 guint64 df_get_number_of_iterations(const char *signature);
+void df_fuzz_get_property_iterations(const struct df_dbus_property *property, guint64 *reads, guint64 *writes);
 /**
  * @function Saves pointer on D-Bus interface proxy for this module to be
  * able to call methods through this proxy during fuzz testing. Also saves
@@ -133,3 +142,6 @@ int df_fuzz_test_method(
 int df_fuzz_test_property(GDBusConnection *dcon, const struct df_dbus_property *property,
                           const char *bus, const char *object, const char *interface,
                           const int pid, guint64 iterations);
+
+void df_fuzz_report_skipped(const char *kind, const char *bus, const char *object, const char *interface,
+                            const char *name, const char *reason);
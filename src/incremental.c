@@ -0,0 +1,338 @@
+/** @file incremental.c */
+/*
+ * dfuzzer - tool for fuzz testing processes communicating through D-Bus.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <gio/gio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "incremental.h"
+#include "log.h"
+#include "util.h"
+
+static char *df_incremental_file_name;
+/* "KIND OBJECT INTERFACE[ NAME]" -> fingerprint, from the previous run
+ * updated with the members tested in this one */
+static GHashTable *df_incremental_fingerprints;
+/* Fingerprints of the previous run, for df_incremental_check() */
+static GHashTable *df_incremental_previous;
+static gboolean df_incremental_dirty;
+
+static const char * const df_incremental_state_names[] = {
+        [DF_INCREMENTAL_NEW]            = "new",
+        [DF_INCREMENTAL_CHANGED]        = "changed",
+        [DF_INCREMENTAL_UNCHANGED]      = "unchanged",
+};
+
+const char *df_incremental_state_to_string(df_incremental_state_t state)
+{
+        g_assert(state < G_N_ELEMENTS(df_incremental_state_names));
+
+        return df_incremental_state_names[state];
+}
+
+static char *df_incremental_key(const char *kind, const char *object, const char *interface, const char *name)
+{
+        return g_strjoin(" ", kind, object, interface, name, NULL);
+}
+
+/* Including the terminating NUL, so ("ab", "c") and ("a", "bc") differ */
+static void df_incremental_update(GChecksum *checksum, const char *s)
+{
+        g_checksum_update(checksum, (const guchar *) s, strlen(s) + 1);
+}
+
+static void df_incremental_update_annotations(GChecksum *checksum, GDBusAnnotationInfo **annotations)
+{
+        STRV_FOREACH(a, annotations) {
+                df_incremental_update(checksum, "annotation");
+                df_incremental_update(checksum, a->key);
+                df_incremental_update(checksum, a->value);
+        }
+}
+
+static char *df_incremental_checksum_free(GChecksum *checksum)
+{
+        char *fingerprint;
+
+        fingerprint = g_strdup(g_checksum_get_string(checksum));
+        g_checksum_free(checksum);
+
+        return fingerprint;
+}
+
+/**
+ * @function Computes the fingerprint of a method.
+ * @return Newly allocated fingerprint (hex digest)
+ */
+char *df_incremental_fingerprint_method(const GDBusMethodInfo *info)
+{
+        GChecksum *checksum;
+
+        g_assert(info);
+
+        checksum = g_checksum_new(G_CHECKSUM_SHA256);
+        df_incremental_update(checksum, "method");
+        df_incremental_update(checksum, info->name);
+        STRV_FOREACH(arg, info->in_args) {
+                df_incremental_update(checksum, "in");
+                df_incremental_update(checksum, arg->signature);
+        }
+        STRV_FOREACH(arg, info->out_args) {
+                df_incremental_update(checksum, "out");
+                df_incremental_update(checksum, arg->signature);
+        }
+        df_incremental_update_annotations(checksum, info->annotations);
+
+        return df_incremental_checksum_free(checksum);
+}
+
+/**
+ * @function Computes the fingerprint of a property.
+ * @return Newly allocated fingerprint (hex digest)
+ */
+char *df_incremental_fingerprint_property(const GDBusPropertyInfo *info)
+{
+        GChecksum *checksum;
+
+        g_assert(info);
+
+        checksum = g_checksum_new(G_CHECKSUM_SHA256);
+        df_incremental_update(checksum, "property");
+        df_incremental_update(checksum, info->name);
+        df_incremental_update(checksum, info->signature);
+        df_incremental_update(checksum, info->flags & G_DBUS_PROPERTY_INFO_FLAGS_READABLE ? "read" : "");
+        df_incremental_update(checksum, info->flags & G_DBUS_PROPERTY_INFO_FLAGS_WRITABLE ? "write" : "");
+        df_incremental_update_annotations(checksum, info->annotations);
+
+        return df_incremental_checksum_free(checksum);
+}
+
+/**
+ * @function Computes the fingerprint of an interface, i.e. of its name,
+ * annotations and all its methods and properties.
+ * @return Newly allocated fingerprint (hex digest)
+ */
+char *df_incremental_fingerprint_interface(const GDBusInterfaceInfo *info)
+{
+        GChecksum *checksum;
+
+        g_assert(info);
+
+        checksum = g_checksum_new(G_CHECKSUM_SHA256);
+        df_incremental_update(checksum, "interface");
+        df_incremental_update(checksum, info->name);
+        df_incremental_update_annotations(checksum, info->annotations);
+        STRV_FOREACH(m, info->methods) {
+                g_autoptr(gchar) fingerprint = df_incremental_fingerprint_method(m);
+
+                df_incremental_update(checksum, fingerprint);
+        }
+        STRV_FOREACH(p, info->properties) {
+                g_autoptr(gchar) fingerprint = df_incremental_fingerprint_property(p);
+
+                df_incremental_update(checksum, fingerprint);
+        }
+
+        return df_incremental_checksum_free(checksum);
+}
+
+static int df_incremental_load(void)
+{
+        g_autoptr(GError) error = NULL;
+        g_autoptr(gchar) contents = NULL;
+        g_auto(GStrv) lines = NULL;
+        guint64 version = 0;
+
+        if (!g_file_get_contents(df_incremental_file_name, &contents, NULL, &error)) {
+                if (g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+                        return df_verbose_ret(0, "Fingerprint file %s doesn't exist, testing everything\n",
+                                              df_incremental_file_name);
+
+                return df_fail_ret(-1, "Failed to read fingerprint file %s: %s\n",
+                                   df_incremental_file_name, error->message);
+        }
+
+        lines = g_strsplit(contents, "\n", -1);
+        STRV_FOREACH(line, lines) {
+                g_auto(GStrv) f = NULL;
+                guint n;
+
+                if (isempty(line) || line[0] == '#')
+                        continue;
+
+                f = g_strsplit(line, " ", -1);
+                n = g_strv_length(f);
+                if (g_str_equal(f[0], "version") && n == 2) {
+                        if (safe_strtoull(f[1], &version) < 0)
+                                goto invalid;
+                } else if (g_str_equal(f[0], "interface") && n == 4)
+                        g_hash_table_replace(df_incremental_previous, df_incremental_key(f[0], f[1], f[2], NULL),
+                                             g_strdup(f[3]));
+                else if ((g_str_equal(f[0], "method") || g_str_equal(f[0], "property")) && n == 5)
+                        g_hash_table_replace(df_incremental_previous, df_incremental_key(f[0], f[1], f[2], f[3]),
+                                             g_strdup(f[4]));
+                else
+                        goto invalid;
+        }
+
+        if (version != DF_INCREMENTAL_VERSION)
+                return df_fail_ret(-1, "Fingerprint file %s has unsupported version %"G_GUINT64_FORMAT"\n",
+                                   df_incremental_file_name, version);
+
+        return 0;
+
+invalid:
+        return df_fail_ret(-1, "Fingerprint file %s is invalid\n", df_incremental_file_name);
+}
+
+static void df_incremental_free(void)
+{
+        g_clear_pointer(&df_incremental_file_name, g_free);
+        g_clear_pointer(&df_incremental_fingerprints, g_hash_table_unref);
+        g_clear_pointer(&df_incremental_previous, g_hash_table_unref);
+}
+
+/**
+ * @function Loads the fingerprints of the previous run, if there was one.
+ * @param file_name Path to the fingerprint file
+ * @return 0 on success, -1 on error
+ */
+int df_incremental_open(const char *file_name)
+{
+        GHashTableIter iter;
+        gpointer key, value;
+
+        g_assert(file_name);
+        g_assert(!df_incremental_file_name);
+
+        df_incremental_file_name = g_strdup(file_name);
+        df_incremental_previous = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+        df_incremental_fingerprints = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+        df_incremental_dirty = FALSE;
+
+        if (df_incremental_load() < 0) {
+                df_incremental_free();
+                return -1;
+        }
+
+        g_hash_table_iter_init(&iter, df_incremental_previous);
+        while (g_hash_table_iter_next(&iter, &key, &value))
+                g_hash_table_insert(df_incremental_fingerprints, g_strdup(key), g_strdup(value));
+
+        return 0;
+}
+
+static int df_incremental_compare(const void *a, const void *b)
+{
+        return strcmp(*(const char * const *) a, *(const char * const *) b);
+}
+
+/**
+ * @function Writes the fingerprints into the file, if any were recorded
+ * since the last write.
+ * @return 0 on success, -1 on error
+ */
+int df_incremental_flush(void)
+{
+        g_autoptr(GString) out = NULL;
+        g_autoptr(GError) error = NULL;
+        g_autofree const gchar **keys = NULL;
+        guint n;
+
+        if (!df_incremental_file_name || !df_incremental_dirty)
+                return 0;
+
+        out = g_string_new("# dfuzzer fingerprints, use with --incremental=\n");
+        g_string_append_printf(out, "version %d\n", DF_INCREMENTAL_VERSION);
+
+        /* Sorted, so the file can be diffed */
+        keys = (const gchar **) g_hash_table_get_keys_as_array(df_incremental_fingerprints, &n);
+        qsort(keys, n, sizeof(*keys), df_incremental_compare);
+        for (guint i = 0; i < n; i++)
+                g_string_append_printf(out, "%s %s\n", keys[i],
+                                       (char *) g_hash_table_lookup(df_incremental_fingerprints, keys[i]));
+
+        /* Written into a temporary file which is renamed over the target */
+        if (!g_file_set_contents(df_incremental_file_name, out->str, out->len, &error))
+                return df_fail_ret(-1, "Failed to write fingerprint file %s: %s\n",
+                                   df_incremental_file_name, error->message);
+
+        df_incremental_dirty = FALSE;
+
+        return 0;
+}
+
+/**
+ * @function Writes the fingerprints and stops recording them. Does nothing
+ * if incremental fuzzing is disabled.
+ * @return 0 on success, -1 on error
+ */
+int df_incremental_close(void)
+{
+        int r;
+
+        r = df_incremental_flush();
+        df_incremental_free();
+
+        return r;
+}
+
+gboolean df_incremental_is_enabled(void)
+{
+        return !!df_incremental_file_name;
+}
+
+/**
+ * @function Compares a fingerprint with the one from the previous run.
+ * @param kind "interface", "method" or "property"
+ * @param name Name of the method or property, NULL for interfaces
+ * @return State of the interface or member since the previous run
+ */
+df_incremental_state_t df_incremental_check(const char *kind, const char *object, const char *interface,
+                                            const char *name, const char *fingerprint)
+{
+        g_autoptr(gchar) key = NULL;
+        const char *previous;
+
+        g_assert(fingerprint);
+
+        if (!df_incremental_file_name)
+                return DF_INCREMENTAL_NEW;
+
+        key = df_incremental_key(kind, object, interface, name);
+        previous = g_hash_table_lookup(df_incremental_previous, key);
+        if (!previous)
+                return DF_INCREMENTAL_NEW;
+
+        return g_str_equal(previous, fingerprint) ? DF_INCREMENTAL_UNCHANGED : DF_INCREMENTAL_CHANGED;
+}
+
+/**
+ * @function Records a fingerprint for the next run, e.g. of a member which
+ * was tested with the full budget.
+ */
+void df_incremental_record(const char *kind, const char *object, const char *interface, const char *name,
+                           const char *fingerprint)
+{
+        if (!df_incremental_file_name || !fingerprint)
+                return;
+
+        g_hash_table_replace(df_incremental_fingerprints, df_incremental_key(kind, object, interface, name),
+                             g_strdup(fingerprint));
+        df_incremental_dirty = TRUE;
+}
@@ -0,0 +1,45 @@
+/** @file incremental.h */
+#pragma once
+
+#include <gio/gio.h>
+
+/* Incremental fuzzing (--incremental=): fingerprints of the tested interfaces
+ * and of their methods and properties are kept in a file between runs, and
+ * members whose fingerprint didn't change since the last run get only a small
+ * regression budget. A fingerprint is a SHA-256 of the name, the signature(s),
+ * the access flags (of properties) and the annotations; argument names and
+ * signals don't affect fuzzing and are not included. The file is a text file
+ * with one record per line:
+ *
+ *   version 1
+ *   interface OBJECT INTERFACE FINGERPRINT
+ *   KIND OBJECT INTERFACE NAME FINGERPRINT
+ *
+ * where KIND is "method" or "property". Records of members which weren't
+ * tested in the current run are kept. */
+
+/** Version of the file format */
+#define DF_INCREMENTAL_VERSION 1
+/** Default number of iterations for unchanged members */
+#define DF_INCREMENTAL_REGRESSION_ITERATIONS 5
+
+typedef enum df_incremental_state {
+        DF_INCREMENTAL_NEW = 0,
+        DF_INCREMENTAL_CHANGED,
+        DF_INCREMENTAL_UNCHANGED,
+} df_incremental_state_t;
+
+int df_incremental_open(const char *file_name);
+int df_incremental_flush(void);
+int df_incremental_close(void);
+gboolean df_incremental_is_enabled(void);
+
+char *df_incremental_fingerprint_interface(const GDBusInterfaceInfo *info);
+char *df_incremental_fingerprint_method(const GDBusMethodInfo *info);
+char *df_incremental_fingerprint_property(const GDBusPropertyInfo *info);
+
+df_incremental_state_t df_incremental_check(const char *kind, const char *object, const char *interface,
+                                            const char *name, const char *fingerprint);
+void df_incremental_record(const char *kind, const char *object, const char *interface, const char *name,
+                           const char *fingerprint);
+const char *df_incremental_state_to_string(df_incremental_state_t state);
@@ -0,0 +1,481 @@
+/** @file json.c */
+/*
+ * dfuzzer - tool for fuzz testing processes communicating through D-Bus.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <gio/gio.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "json.h"
+#include "log.h"
+#include "util.h"
+
+/** Events are written in batches of (at most roughly) this size */
+#define DF_JSON_BATCH_SIZE (64 * 1024)
+
+static GAsyncQueue *df_json_queue;
+static GThread *df_json_writer_thread;
+static fd_t df_json_fd = -1;
+static gboolean df_json_close_fd;
+/* Written only by the writer thread, read after it's joined */
+static int df_json_error;
+/* Touched only by the fuzzing thread */
+static guint64 df_json_dropped;
+/* Pushed to the queue to stop the writer thread */
+static GString df_json_stop_marker;
+
+static int df_json_write_all(fd_t fd, const char *buf, gsize size)
+{
+        while (size > 0) {
+                ssize_t n;
+
+                n = write(fd, buf, size);
+                if (n < 0) {
+                        if (errno == EINTR)
+                                continue;
+
+                        return -errno;
+                }
+
+                buf += n;
+                size -= n;
+        }
+
+        return 0;
+}
+
+static gpointer df_json_writer(gpointer data)
+{
+        g_autoptr(GString) batch = NULL;
+        sigset_t mask;
+        gboolean stop = FALSE;
+
+        /* Get EPIPE instead of getting killed when the reading end goes away */
+        sigemptyset(&mask);
+        sigaddset(&mask, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+        batch = g_string_sized_new(DF_JSON_BATCH_SIZE);
+
+        while (!stop) {
+                GString *e;
+
+                /* Block for the first event, then take everything that's
+                 * already queued, so a burst of events ends up in a single write */
+                e = g_async_queue_pop(df_json_queue);
+                do {
+                        if (e == &df_json_stop_marker) {
+                                stop = TRUE;
+                                break;
+                        }
+
+                        g_string_append_len(batch, e->str, e->len);
+                        g_string_free(e, TRUE);
+                } while (batch->len < DF_JSON_BATCH_SIZE && (e = g_async_queue_try_pop(df_json_queue)));
+
+                /* Keep draining the queue after a write error, so the memory
+                 * is released */
+                if (df_json_error == 0 && batch->len > 0)
+                        df_json_error = df_json_write_all(df_json_fd, batch->str, batch->len);
+                g_string_truncate(batch, 0);
+        }
+
+        return NULL;
+}
+
+/**
+ * @function Opens the JSON event stream and starts the writer thread.
+ * @param target Path to a file (which is truncated), or a number of an
+ * already open file descriptor
+ * @return 0 on success, -1 on error
+ */
+int df_json_open(const char *target)
+{
+        g_autoptr(GError) error = NULL;
+        guint64 fd;
+
+        g_assert(target);
+        g_assert(!df_json_queue);
+
+        if (safe_strtoull(target, &fd) == 0) {
+                if (fd > G_MAXINT || fcntl((int) fd, F_GETFD) < 0)
+                        return df_fail_ret(-1, "Invalid file descriptor %s for the JSON stream\n", target);
+
+                df_json_fd = (int) fd;
+                df_json_close_fd = FALSE;
+        } else {
+                df_json_fd = open(target, O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, 0644);
+                if (df_json_fd < 0)
+                        return df_fail_ret(-1, "Failed to open file %s: %m\n", target);
+
+                df_json_close_fd = TRUE;
+        }
+
+        df_json_error = 0;
+        df_json_dropped = 0;
+        df_json_queue = g_async_queue_new();
+        df_json_writer_thread = g_thread_try_new("df-json", df_json_writer, NULL, &error);
+        if (!df_json_writer_thread) {
+                g_clear_pointer(&df_json_queue, g_async_queue_unref);
+                if (df_json_close_fd)
+                        df_json_fd = safe_close(df_json_fd);
+                return df_fail_ret(-1, "Failed to start the JSON writer thread: %s\n", error->message);
+        }
+
+        return 0;
+}
+
+/**
+ * @function Writes all queued events, stops the writer thread and closes the
+ * stream. Does nothing if the stream is not open.
+ * @return 0 on success, -1 if any of the writes failed
+ */
+int df_json_close(void)
+{
+        int r = 0;
+
+        if (!df_json_queue)
+                return 0;
+
+        g_async_queue_push(df_json_queue, &df_json_stop_marker);
+        g_thread_join(g_steal_pointer(&df_json_writer_thread));
+        g_clear_pointer(&df_json_queue, g_async_queue_unref);
+
+        if (df_json_error < 0)
+                r = df_fail_ret(-1, "Failed to write the JSON stream: %s\n", strerror(-df_json_error));
+
+        if (df_json_close_fd && close(df_json_fd) < 0 && r == 0)
+                r = df_fail_ret(-1, "Failed to close the JSON stream: %m\n");
+        df_json_fd = -1;
+
+        return r;
+}
+
+gboolean df_json_is_open(void)
+{
+        return !!df_json_queue;
+}
+
+/**
+ * @function Appends a string to out as a JSON string literal (including
+ * the quotes).
+ */
+void df_json_append_escaped(GString *out, const char *s)
+{
+        g_assert(out);
+        g_assert(s);
+
+        g_string_append_c(out, '"');
+        for (; *s; s++) {
+                switch (*s) {
+                case '"':
+                        g_string_append(out, "\\\"");
+                        break;
+                case '\\':
+                        g_string_append(out, "\\\\");
+                        break;
+                case '\n':
+                        g_string_append(out, "\\n");
+                        break;
+                case '\r':
+                        g_string_append(out, "\\r");
+                        break;
+                case '\t':
+                        g_string_append(out, "\\t");
+                        break;
+                default:
+                        if ((guchar) *s < 0x20)
+                                g_string_append_printf(out, "\\u%04x", (guchar) *s);
+                        else
+                                g_string_append_c(out, *s);
+                }
+        }
+        g_string_append_c(out, '"');
+}
+
+static void df_json_event_add_key(GString *event, const char *key)
+{
+        g_string_append_c(event, ',');
+        df_json_append_escaped(event, key);
+        g_string_append_c(event, ':');
+}
+
+/**
+ * @function Starts a new event. Add members to it using df_json_event_add_*()
+ * and pass it to df_json_event_emit().
+ * @param event Name of the event
+ * @return New event
+ */
+GString *df_json_event_new(const char *event)
+{
+        GString *e;
+
+        g_assert(event);
+
+        e = g_string_new(DF_JSON_RS "{\"event\":");
+        df_json_append_escaped(e, event);
+        g_string_append_printf(e, ",\"timestamp\":%"G_GINT64_FORMAT, g_get_real_time());
+
+        return e;
+}
+
+/** @function Adds a string member, or null if value is NULL */
+void df_json_event_add_string(GString *event, const char *key, const char *value)
+{
+        df_json_event_add_key(event, key);
+        if (value)
+                df_json_append_escaped(event, value);
+        else
+                g_string_append(event, "null");
+}
+
+void df_json_event_add_int(GString *event, const char *key, gint64 value)
+{
+        df_json_event_add_key(event, key);
+        g_string_append_printf(event, "%"G_GINT64_FORMAT, value);
+}
+
+void df_json_event_add_uint(GString *event, const char *key, guint64 value)
+{
+        df_json_event_add_key(event, key);
+        g_string_append_printf(event, "%"G_GUINT64_FORMAT, value);
+}
+
+void df_json_event_add_bool(GString *event, const char *key, gboolean value)
+{
+        df_json_event_add_key(event, key);
+        g_string_append(event, value ? "true" : "false");
+}
+
+/**
+ * @function Finishes an event and queues it for writing. Never blocks on I/O;
+ * if the writer thread can't keep up, the event is dropped.
+ * @param event Event created by df_json_event_new(), the ownership is taken
+ */
+void df_json_event_emit(GString *event)
+{
+        g_assert(event);
+
+        if (!df_json_queue) {
+                g_string_free(event, TRUE);
+                return;
+        }
+
+        if (g_async_queue_length(df_json_queue) >= DF_JSON_QUEUE_MAX) {
+                df_json_dropped++;
+                g_string_free(event, TRUE);
+                return;
+        }
+
+        /* Let the consumer know it's missing some events */
+        if (df_json_dropped > 0) {
+                GString *e;
+
+                e = df_json_event_new("dropped");
+                df_json_event_add_uint(e, "count", df_json_dropped);
+                g_string_append(e, "}\n");
+                g_async_queue_push(df_json_queue, e);
+                df_json_dropped = 0;
+        }
+
+        g_string_append(event, "}\n");
+        g_async_queue_push(df_json_queue, event);
+}
+
+static const char *df_json_skip_space(const char *p)
+{
+        while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')
+                p++;
+
+        return p;
+}
+
+static int df_json_parse_hex4(const char *p, gunichar *ret)
+{
+        gunichar c = 0;
+
+        for (int i = 0; i < 4; i++) {
+                int v = g_ascii_xdigit_value(p[i]);
+
+                if (v < 0)
+                        return -EINVAL;
+                c = c << 4 | v;
+        }
+
+        *ret = c;
+        return 0;
+}
+
+/* Returns the position after the closing quote, or NULL if the string is invalid */
+static const char *df_json_parse_string(const char *p, gchar **ret)
+{
+        g_autoptr(GString) s = NULL;
+
+        if (*p != '"')
+                return NULL;
+
+        s = g_string_new(NULL);
+        for (p++; *p != '"'; p++) {
+                gunichar c, low;
+
+                if ((guchar) *p < 0x20)
+                        return NULL;
+                if (*p != '\\') {
+                        g_string_append_c(s, *p);
+                        continue;
+                }
+
+                switch (*++p) {
+                case '"':
+                case '\\':
+                case '/':
+                        g_string_append_c(s, *p);
+                        break;
+                case 'b':
+                        g_string_append_c(s, '\b');
+                        break;
+                case 'f':
+                        g_string_append_c(s, '\f');
+                        break;
+                case 'n':
+                        g_string_append_c(s, '\n');
+                        break;
+                case 'r':
+                        g_string_append_c(s, '\r');
+                        break;
+                case 't':
+                        g_string_append_c(s, '\t');
+                        break;
+                case 'u':
+                        if (df_json_parse_hex4(p + 1, &c) < 0)
+                                return NULL;
+                        p += 4;
+
+                        if (c >= 0xd800 && c < 0xdc00) {
+                                /* High surrogate, must be followed by the low one */
+                                if (p[1] != '\\' || p[2] != 'u' || df_json_parse_hex4(p + 3, &low) < 0 ||
+                                    low < 0xdc00 || low >= 0xe000)
+                                        return NULL;
+                                c = 0x10000 + ((c - 0xd800) << 10) + (low - 0xdc00);
+                                p += 6;
+                        } else if (c >= 0xdc00 && c < 0xe000)
+                                return NULL;
+
+                        /* Can't be represented in a C string */
+                        if (c == 0)
+                                return NULL;
+
+                        g_string_append_unichar(s, c);
+                        break;
+                default:
+                        return NULL;
+                }
+        }
+
+        *ret = g_string_free(g_steal_pointer(&s), FALSE);
+        return p + 1;
+}
+
+/* Returns the position after the value, or NULL if it isn't a number, a boolean or null */
+static const char *df_json_parse_scalar(const char *p, gchar **ret)
+{
+        static const char * const literals[] = { "true", "false", "null" };
+        gchar *end = NULL;
+        size_t n;
+
+        for (size_t i = 0; i < G_N_ELEMENTS(literals); i++)
+                if (g_str_has_prefix(p, literals[i])) {
+                        n = strlen(literals[i]);
+                        *ret = i < 2 ? g_strndup(p, n) : NULL;
+                        return p + n;
+                }
+
+        n = strspn(p, "+-.0123456789eE");
+        if (n == 0 || *p == '+')
+                return NULL;
+        (void) g_ascii_strtod(p, &end);
+        if (end != p + n)
+                return NULL;
+
+        *ret = g_strndup(p, n);
+        return p + n;
+}
+
+/**
+ * @function Parses an event written by df_json_event_emit(), i.e. a JSON
+ * object whose members are strings, numbers, booleans or null (nested
+ * objects and arrays are not supported).
+ * @param text The event, with or without the leading RS
+ * @param ret Members of the event: strings are unescaped, numbers and
+ * booleans are kept as written and null is NULL
+ * @return 0 on success, -EINVAL if text is not such an object
+ */
+int df_json_parse_event(const char *text, GHashTable **ret)
+{
+        g_autoptr(GHashTable) members = NULL;
+        const char *p;
+
+        g_assert(text);
+        g_assert(ret);
+
+        if (g_str_has_prefix(text, DF_JSON_RS))
+                text += strlen(DF_JSON_RS);
+
+        p = df_json_skip_space(text);
+        if (*p != '{')
+                return -EINVAL;
+
+        members = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+        p = df_json_skip_space(p + 1);
+        if (*p != '}')
+                for (;;) {
+                        g_autoptr(gchar) key = NULL, value = NULL;
+
+                        p = df_json_parse_string(p, &key);
+                        if (!p)
+                                return -EINVAL;
+
+                        p = df_json_skip_space(p);
+                        if (*p != ':')
+                                return -EINVAL;
+                        p = df_json_skip_space(p + 1);
+
+                        if (*p == '"')
+                                p = df_json_parse_string(p, &value);
+                        else
+                                p = df_json_parse_scalar(p, &value);
+                        if (!p)
+                                return -EINVAL;
+
+                        g_hash_table_replace(members, g_steal_pointer(&key), g_steal_pointer(&value));
+
+                        p = df_json_skip_space(p);
+                        if (*p == '}')
+                                break;
+                        if (*p != ',')
+                                return -EINVAL;
+                        p = df_json_skip_space(p + 1);
+                }
+
+        if (*df_json_skip_space(p + 1) != '\0')
+                return -EINVAL;
+
+        *ret = g_steal_pointer(&members);
+        return 0;
+}
@@ -0,0 +1,30 @@
+/** @file json.h */
+#pragma once
+
+#include <gio/gio.h>
+
+/* Machine-readable event stream in the JSON text sequence format (RFC 7464),
+ * i.e. each event is a JSON object preceded by the RS character (0x1E) and
+ * followed by a newline. Each event has at least the "event" (name) and
+ * "timestamp" (wall-clock time in usec) members. */
+
+/** RFC 7464 record separator */
+#define DF_JSON_RS "\x1e"
+/** Maximum number of events waiting for the writer thread, events over the
+  * limit are dropped (and reported by a "dropped" event) */
+#define DF_JSON_QUEUE_MAX 65536
+
+int df_json_open(const char *target);
+int df_json_close(void);
+gboolean df_json_is_open(void);
+
+GString *df_json_event_new(const char *event);
+void df_json_event_add_string(GString *event, const char *key, const char *value);
+void df_json_event_add_int(GString *event, const char *key, gint64 value);
+void df_json_event_add_uint(GString *event, const char *key, guint64 value);
+void df_json_event_add_bool(GString *event, const char *key, gboolean value);
+void df_json_event_emit(GString *event);
+
+void df_json_append_escaped(GString *out, const char *s);
+
+int df_json_parse_event(const char *text, GHashTable **ret);
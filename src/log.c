@@ -1,10 +1,29 @@
+#include <gio/gio.h>
 #include <stdio.h>
 #include <sys/stat.h>
 
+#include "compress.h"
 #include "log.h"
+#include "util.h"
+
+/** Maximum length of the method name shown in the progress line */
+#define DF_LOG_PROGRESS_NAME_MAX 48
 
 static guint8 log_level_max = DF_LOG_LEVEL_INFO;
 static FILE *log_file;
+/* Compressed log stream behind log_file (if the log is compressed) */
+static GOutputStream *log_stream;
+static gint64 log_stream_last_flush;
+/* Console output to stdout is buffered and flushed at most once per
+ * DF_LOG_CONSOLE_INTERVAL, the progress line is redrawn at the same pace */
+static gint64 console_last_update;
+static guint64 progress_iterations;
+/* Iterations and time of the last progress redraw, which the rate is computed
+ * from; unlike console_last_update not touched by df_log_flush() */
+static guint64 progress_last_iterations;
+static gint64 progress_last_update;
+static guint progress_findings;
+static gboolean progress_shown;
 
 void df_set_log_level(guint8 log_level)
 {
@@ -18,16 +37,79 @@ guint8 df_get_log_level(void)
         return log_level_max;
 }
 
-int df_log_open_log_file(const char *file_name)
+static ssize_t df_log_stream_write(void *cookie, const char *buf, size_t size)
+{
+        if (!g_output_stream_write_all(G_OUTPUT_STREAM(cookie), buf, size, NULL, NULL, NULL)) {
+                errno = EIO;
+                return -1;
+        }
+
+        return size;
+}
+
+static int df_log_stream_close(void *cookie)
+{
+        g_autoptr(GOutputStream) stream = G_OUTPUT_STREAM(cookie);
+
+        if (!g_output_stream_close(stream, NULL, NULL)) {
+                errno = EIO;
+                return -1;
+        }
+
+        return 0;
+}
+
+int df_log_open_log_file(const char *file_name, gboolean compress)
 {
+        static const cookie_io_functions_t stream_functions = {
+                .write = df_log_stream_write,
+                .close = df_log_stream_close,
+        };
+        g_autoptr(GOutputStream) stream = NULL;
+        g_autoptr(GError) error = NULL;
+
         g_assert(!log_file);
 
         (void) umask(0022);
 
-        log_file = fopen(file_name, "a+");
+        if (!compress) {
+                log_file = fopen(file_name, "a+");
+                if (!log_file)
+                        return df_fail_ret(-1, "Failed to open file %s: %m\n", file_name);
+
+                return 0;
+        }
+
+        /* Keep the stdio buffering and formatting, and push the buffered data
+         * through the compressor */
+        stream = df_compress_open_append(file_name, TRUE, &error);
+        if (!stream)
+                return df_fail_ret(-1, "Failed to open file %s: %s\n", file_name, error->message);
+
+        log_file = fopencookie(stream, "a", stream_functions);
         if (!log_file)
                 return df_fail_ret(-1, "Failed to open file %s: %m\n", file_name);
 
+        /* The cookie now owns the stream */
+        log_stream = g_steal_pointer(&stream);
+        log_stream_last_flush = g_get_monotonic_time();
+
+        return 0;
+}
+
+int df_log_close_log_file(void)
+{
+        int r;
+
+        if (!log_file)
+                return 0;
+
+        r = fclose(log_file);
+        log_file = NULL;
+        log_stream = NULL;
+        if (r != 0)
+                return df_fail_ret(-1, "Failed to close the log file: %m\n");
+
         return 0;
 }
 
@@ -44,9 +126,37 @@ void df_log_file(const char *format, ...)
                 va_start(args, format);
                 vfprintf(log_file, format, args);
                 va_end(args);
+
+                /* Sync-flush the compressed log periodically, so we lose at most
+                 * one block if dfuzzer gets killed */
+                if (log_stream && g_get_monotonic_time() - log_stream_last_flush >= DF_COMPRESS_FLUSH_INTERVAL) {
+                        fflush(log_file);
+                        (void) g_output_stream_flush(log_stream, NULL, NULL);
+                        log_stream_last_flush = g_get_monotonic_time();
+                }
         }
 }
 
+static void df_log_progress_clear(void)
+{
+        if (!progress_shown)
+                return;
+
+        fputs(ANSI_CR, stderr);
+        progress_shown = FALSE;
+}
+
+/**
+ * @function Writes out buffered console output and clears the progress
+ * line, e.g. before writing to the console directly.
+ */
+void df_log_flush(void)
+{
+        df_log_progress_clear();
+        fflush(stdout);
+        console_last_update = g_get_monotonic_time();
+}
+
 void df_log_full(gint8 log_level, FILE *target, const char *format, ...)
 {
         if (log_level > log_level_max)
@@ -54,10 +164,65 @@ void df_log_full(gint8 log_level, FILE *target, const char *format, ...)
 
         va_list args;
 
+        df_log_progress_clear();
+
+        /* Failures are written out right away, after everything buffered
+         * before them */
+        if (target != stdout)
+                fflush(stdout);
+
         va_start(args, format);
         vfprintf(target, format, args);
         va_end(args);
-        fflush(target);
+
+        if (target != stdout)
+                fflush(target);
+        else if (g_get_monotonic_time() - console_last_update >= DF_LOG_CONSOLE_INTERVAL)
+                df_log_flush();
+}
+
+/**
+ * @function Accounts a single call of the given method and redraws the
+ * progress line (iterations per second, current method and number of
+ * findings) if it's due. The progress line is shown only on a terminal and
+ * only when not in the verbose mode, which has per-method lines instead.
+ * @param name Name of the method (or property) being tested
+ */
+void df_log_progress(const char *name)
+{
+        gint64 now;
+        guint64 rate;
+
+        g_assert(name);
+
+        progress_iterations++;
+
+        now = g_get_monotonic_time();
+        if (progress_last_update == 0)
+                progress_last_update = now;
+        if (now - progress_last_update < DF_LOG_CONSOLE_INTERVAL)
+                return;
+
+        rate = (progress_iterations - progress_last_iterations) * G_USEC_PER_SEC / (now - progress_last_update);
+        progress_last_iterations = progress_iterations;
+        progress_last_update = now;
+
+        df_log_flush();
+
+        if (log_level_max != DF_LOG_LEVEL_INFO || !df_isatty())
+                return;
+
+        fprintf(stderr, "%s%s%"G_GUINT64_FORMAT" it/s%s, %u finding(s), testing %.*s",
+                ANSI_CR, ANSI_BOLD, rate, ANSI_NORMAL, progress_findings, DF_LOG_PROGRESS_NAME_MAX, name);
+        progress_shown = TRUE;
+}
+
+/**
+ * @function Bumps the number of findings shown in the progress line.
+ */
+void df_log_progress_finding(void)
+{
+        progress_findings++;
 }
 
 void df_error(const char *message, GError *error)
@@ -5,6 +5,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+/** How often buffered console output is flushed and the progress line is
+  * redrawn (in usec); failures are always written out immediately */
+#define DF_LOG_CONSOLE_INTERVAL (G_USEC_PER_SEC / 4)
+
 enum {
         DF_LOG_LEVEL_INFO = 0,
         DF_LOG_LEVEL_VERBOSE,
@@ -14,12 +18,18 @@ enum {
 
 void df_set_log_level(guint8 log_level);
 guint8 df_get_log_level(void);
-int df_log_open_log_file(const char *file_name);
+int df_log_open_log_file(const char *file_name, gboolean compress);
+int df_log_close_log_file(void);
 gboolean df_log_file_is_open(void);
 
 /* Normal logging */
 void df_log_file(const char *format, ...) __attribute__((__format__(printf, 1, 2)));
 void df_log_full(gint8 log_level, FILE *target, const char *format, ...) __attribute__((__format__(printf, 3, 4)));
+void df_log_flush(void);
+
+/* Progress line */
+void df_log_progress(const char *name);
+void df_log_progress_finding(void);
 
 #define df_log(...)         df_log_full(DF_LOG_LEVEL_INFO, stdout, __VA_ARGS__)
 #define df_fail(...)        df_log_full(DF_LOG_LEVEL_INFO, stderr,  __VA_ARGS__)
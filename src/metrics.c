@@ -0,0 +1,399 @@
+/** @file metrics.c */
+/*
+ * dfuzzer - tool for fuzz testing processes communicating through D-Bus.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <gio/gio.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "metrics.h"
+#include "stats.h"
+#include "util.h"
+
+#define DF_METRICS_INC(p) __atomic_fetch_add((p), 1, __ATOMIC_RELAXED)
+#define DF_METRICS_GET(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+
+/* Counters updated by the fuzzing thread and read by the writer thread */
+static struct {
+        guint64 calls;
+        /* In usec */
+        guint64 latency_sum;
+        guint64 latency_histogram[DF_STATS_BUCKETS];
+        guint64 exceptions;
+        guint64 crashes;
+        guint64 findings;
+        int target_pid;
+} df_metrics;
+
+static gboolean df_metrics_enabled;
+static char *df_metrics_file_name;
+static char *df_metrics_bus_name;
+static GThread *df_metrics_writer_thread;
+/* Protects the list of interfaces and the stop flag */
+static GMutex df_metrics_mutex;
+static GCond df_metrics_cond;
+static gboolean df_metrics_stop;
+static GPtrArray *df_metrics_interfaces;
+/* Touched only by df_metrics_format() */
+static guint64 df_metrics_last_calls;
+static gint64 df_metrics_last_time;
+/* Written only by the writer thread, read after it's joined */
+static GError *df_metrics_error;
+
+static void df_metrics_interface_free(df_metrics_interface_t *i)
+{
+        if (!i)
+                return;
+
+        g_free(i->object);
+        g_free(i->interface);
+        g_free(i);
+}
+
+static void df_metrics_append_header(GString *out, const char *name, const char *type, const char *help)
+{
+        g_string_append_printf(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+/* Object paths and D-Bus names can't contain anything which would need
+ * escaping, but be safe anyway */
+static void df_metrics_append_label(GString *out, const char *key, const char *value)
+{
+        g_string_append_printf(out, "%s=\"", key);
+        for (; *value; value++) {
+                if (*value == '\\' || *value == '"')
+                        g_string_append_c(out, '\\');
+                if (*value == '\n')
+                        g_string_append(out, "\\n");
+                else
+                        g_string_append_c(out, *value);
+        }
+        g_string_append_c(out, '"');
+}
+
+static int df_metrics_get_target_rss(int pid, guint64 *ret)
+{
+        g_autoptr(gchar) path = NULL;
+        g_autoptr(gchar) contents = NULL;
+        unsigned long long size, resident;
+
+        path = g_strdup_printf("/proc/%d/statm", pid);
+        if (!g_file_get_contents(path, &contents, NULL, NULL))
+                return -1;
+        if (sscanf(contents, "%llu %llu", &size, &resident) != 2)
+                return -1;
+
+        *ret = resident * sysconf(_SC_PAGESIZE);
+
+        return 0;
+}
+
+/**
+ * @function Formats the current values of all metrics in the Prometheus text
+ * exposition format. The rate of calls is computed since the previous call
+ * of this function (or since df_metrics_open()).
+ * @return New GString with the metrics
+ */
+GString *df_metrics_format(void)
+{
+        static const double quantiles[] = { 0.5, 0.9, 0.99 };
+        g_autofree df_stats_method_t *latency = NULL;
+        GString *out;
+        guint64 calls, rss;
+        gint64 now;
+        int pid;
+
+        /* Reuse the percentile computation of per-method statistics */
+        latency = g_new0(df_stats_method_t, 1);
+        for (guint i = 0; i < DF_STATS_BUCKETS; i++) {
+                latency->histogram[i] = DF_METRICS_GET(&df_metrics.latency_histogram[i]);
+                if (latency->histogram[i] > 0) {
+                        latency->calls += latency->histogram[i];
+                        latency->max = df_stats_bucket_value(i);
+                }
+        }
+        calls = DF_METRICS_GET(&df_metrics.calls);
+        now = g_get_monotonic_time();
+
+        out = g_string_new(NULL);
+
+        df_metrics_append_header(out, "dfuzzer_info", "gauge", "Fuzzed bus name.");
+        g_string_append(out, "dfuzzer_info{");
+        df_metrics_append_label(out, "bus", df_metrics_bus_name ?: "");
+        g_string_append(out, "} 1\n");
+
+        df_metrics_append_header(out, "dfuzzer_calls_total", "counter", "Number of fuzzed method calls.");
+        g_string_append_printf(out, "dfuzzer_calls_total %"G_GUINT64_FORMAT"\n", calls);
+
+        df_metrics_append_header(out, "dfuzzer_calls_per_second", "gauge",
+                                 "Fuzzed method calls per second since the previous update.");
+        g_string_append_printf(out, "dfuzzer_calls_per_second %.3f\n",
+                               now > df_metrics_last_time ?
+                               (calls - df_metrics_last_calls) * (double) G_USEC_PER_SEC / (now - df_metrics_last_time) : 0.0);
+        df_metrics_last_calls = calls;
+        df_metrics_last_time = now;
+
+        df_metrics_append_header(out, "dfuzzer_call_duration_seconds", "summary",
+                                 "Round-trip time of fuzzed method calls.");
+        for (size_t i = 0; i < G_N_ELEMENTS(quantiles); i++) {
+                g_string_append_printf(out, "dfuzzer_call_duration_seconds{quantile=\"%g\"} ", quantiles[i]);
+                if (latency->calls > 0)
+                        g_string_append_printf(out, "%.6f\n",
+                                               df_stats_method_percentile(latency, quantiles[i] * 100) / (double) G_USEC_PER_SEC);
+                else
+                        g_string_append(out, "NaN\n");
+        }
+        g_string_append_printf(out, "dfuzzer_call_duration_seconds_sum %.6f\n",
+                               DF_METRICS_GET(&df_metrics.latency_sum) / (double) G_USEC_PER_SEC);
+        g_string_append_printf(out, "dfuzzer_call_duration_seconds_count %"G_GUINT64_FORMAT"\n", calls);
+
+        df_metrics_append_header(out, "dfuzzer_exceptions_total", "counter",
+                                 "Number of D-Bus errors returned by the fuzzed process.");
+        g_string_append_printf(out, "dfuzzer_exceptions_total %"G_GUINT64_FORMAT"\n",
+                               DF_METRICS_GET(&df_metrics.exceptions));
+        df_metrics_append_header(out, "dfuzzer_crashes_total", "counter", "Number of crashes of the fuzzed process.");
+        g_string_append_printf(out, "dfuzzer_crashes_total %"G_GUINT64_FORMAT"\n",
+                               DF_METRICS_GET(&df_metrics.crashes));
+        df_metrics_append_header(out, "dfuzzer_findings_total", "counter",
+                                 "Number of failed method and property tests.");
+        g_string_append_printf(out, "dfuzzer_findings_total %"G_GUINT64_FORMAT"\n",
+                               DF_METRICS_GET(&df_metrics.findings));
+
+        g_mutex_lock(&df_metrics_mutex);
+        if (df_metrics_interfaces && df_metrics_interfaces->len > 0) {
+                df_metrics_append_header(out, "dfuzzer_interface_members", "gauge",
+                                         "Number of methods and properties of an interface to test.");
+                for (guint i = 0; i < df_metrics_interfaces->len; i++) {
+                        const df_metrics_interface_t *intf = df_metrics_interfaces->pdata[i];
+
+                        g_string_append(out, "dfuzzer_interface_members{");
+                        df_metrics_append_label(out, "object", intf->object);
+                        g_string_append_c(out, ',');
+                        df_metrics_append_label(out, "interface", intf->interface);
+                        g_string_append_printf(out, "} %"G_GUINT64_FORMAT"\n", intf->total);
+                }
+
+                df_metrics_append_header(out, "dfuzzer_interface_members_tested", "gauge",
+                                         "Number of methods and properties of an interface tested so far.");
+                for (guint i = 0; i < df_metrics_interfaces->len; i++) {
+                        df_metrics_interface_t *intf = df_metrics_interfaces->pdata[i];
+
+                        g_string_append(out, "dfuzzer_interface_members_tested{");
+                        df_metrics_append_label(out, "object", intf->object);
+                        g_string_append_c(out, ',');
+                        df_metrics_append_label(out, "interface", intf->interface);
+                        g_string_append_printf(out, "} %"G_GUINT64_FORMAT"\n", DF_METRICS_GET(&intf->tested));
+                }
+        }
+        g_mutex_unlock(&df_metrics_mutex);
+
+        pid = DF_METRICS_GET(&df_metrics.target_pid);
+        if (pid > 0 && df_metrics_get_target_rss(pid, &rss) == 0) {
+                df_metrics_append_header(out, "dfuzzer_target_resident_memory_bytes", "gauge",
+                                         "Resident set size of the fuzzed process.");
+                g_string_append_printf(out, "dfuzzer_target_resident_memory_bytes %"G_GUINT64_FORMAT"\n", rss);
+        }
+
+        return out;
+}
+
+/* g_file_set_contents() writes into a temporary file and renames it over the
+ * target, so readers never see a partially written file */
+static gboolean df_metrics_write(GError **error)
+{
+        g_autoptr(GString) out = NULL;
+
+        out = df_metrics_format();
+
+        return g_file_set_contents(df_metrics_file_name, out->str, out->len, error);
+}
+
+static gpointer df_metrics_writer(gpointer data)
+{
+        gboolean stop = FALSE;
+
+        while (!stop) {
+                gint64 deadline = g_get_monotonic_time() + DF_METRICS_INTERVAL;
+
+                g_mutex_lock(&df_metrics_mutex);
+                while (!df_metrics_stop && g_cond_wait_until(&df_metrics_cond, &df_metrics_mutex, deadline))
+                        ;
+                stop = df_metrics_stop;
+                g_mutex_unlock(&df_metrics_mutex);
+
+                /* Keep the first error, but try again next time */
+                (void) df_metrics_write(df_metrics_error ? NULL : &df_metrics_error);
+        }
+
+        return NULL;
+}
+
+/**
+ * @function Starts the thread which periodically rewrites the metrics file.
+ * @param file_name Path to the metrics file
+ * @param bus_name Fuzzed bus name, exported as a label
+ * @return 0 on success, -1 on error
+ */
+int df_metrics_open(const char *file_name, const char *bus_name)
+{
+        g_autoptr(GError) error = NULL;
+
+        g_assert(file_name);
+        g_assert(!df_metrics_enabled);
+
+        memset(&df_metrics, 0, sizeof(df_metrics));
+        df_metrics_file_name = g_strdup(file_name);
+        df_metrics_bus_name = g_strdup(bus_name);
+        df_metrics_interfaces = g_ptr_array_new_with_free_func((GDestroyNotify) df_metrics_interface_free);
+        df_metrics_last_calls = 0;
+        df_metrics_last_time = g_get_monotonic_time();
+        df_metrics_stop = FALSE;
+
+        /* Fail early if the file can't be written at all */
+        if (!df_metrics_write(&error)) {
+                df_fail("Failed to write metrics file: %s\n", error->message);
+                goto fail;
+        }
+
+        df_metrics_writer_thread = g_thread_try_new("df-metrics", df_metrics_writer, NULL, &error);
+        if (!df_metrics_writer_thread) {
+                df_fail("Failed to start the metrics writer thread: %s\n", error->message);
+                goto fail;
+        }
+
+        df_metrics_enabled = TRUE;
+
+        return 0;
+
+fail:
+        g_clear_pointer(&df_metrics_file_name, g_free);
+        g_clear_pointer(&df_metrics_bus_name, g_free);
+        g_clear_pointer(&df_metrics_interfaces, g_ptr_array_unref);
+
+        return -1;
+}
+
+/**
+ * @function Writes the final values of all metrics and stops the writer
+ * thread. Does nothing if the metrics are not enabled.
+ * @return 0 on success, -1 if any of the writes failed
+ */
+int df_metrics_close(void)
+{
+        int r = 0;
+
+        if (!df_metrics_enabled)
+                return 0;
+
+        g_mutex_lock(&df_metrics_mutex);
+        df_metrics_stop = TRUE;
+        g_cond_signal(&df_metrics_cond);
+        g_mutex_unlock(&df_metrics_mutex);
+        g_thread_join(g_steal_pointer(&df_metrics_writer_thread));
+
+        if (df_metrics_error) {
+                r = df_fail_ret(-1, "Failed to write metrics file: %s\n", df_metrics_error->message);
+                g_clear_error(&df_metrics_error);
+        }
+
+        df_metrics_enabled = FALSE;
+        g_clear_pointer(&df_metrics_file_name, g_free);
+        g_clear_pointer(&df_metrics_bus_name, g_free);
+        g_clear_pointer(&df_metrics_interfaces, g_ptr_array_unref);
+
+        return r;
+}
+
+gboolean df_metrics_is_enabled(void)
+{
+        return df_metrics_enabled;
+}
+
+/**
+ * @function Sets the process whose memory usage is exported.
+ */
+void df_metrics_set_target_pid(int pid)
+{
+        if (df_metrics_enabled)
+                __atomic_store_n(&df_metrics.target_pid, pid, __ATOMIC_RELAXED);
+}
+
+/**
+ * @function Starts tracking the progress of an interface.
+ * @param total Number of methods and properties which are going to be tested
+ * @return Progress of the interface owned by the metrics module, NULL if
+ * the metrics are not enabled
+ */
+df_metrics_interface_t *df_metrics_add_interface(const char *object, const char *interface, guint64 total)
+{
+        df_metrics_interface_t *i;
+
+        g_assert(object);
+        g_assert(interface);
+
+        if (!df_metrics_enabled)
+                return NULL;
+
+        i = g_new0(df_metrics_interface_t, 1);
+        i->object = g_strdup(object);
+        i->interface = g_strdup(interface);
+        i->total = total;
+
+        g_mutex_lock(&df_metrics_mutex);
+        g_ptr_array_add(df_metrics_interfaces, i);
+        g_mutex_unlock(&df_metrics_mutex);
+
+        return i;
+}
+
+void df_metrics_interface_tested(df_metrics_interface_t *i)
+{
+        if (i)
+                DF_METRICS_INC(&i->tested);
+}
+
+/**
+ * @function Records a fuzzed method call and its round-trip time.
+ */
+void df_metrics_record_call(guint64 usec)
+{
+        if (!df_metrics_enabled)
+                return;
+
+        __atomic_fetch_add(&df_metrics.latency_sum, usec, __ATOMIC_RELAXED);
+        DF_METRICS_INC(&df_metrics.latency_histogram[df_stats_bucket_index(usec)]);
+        DF_METRICS_INC(&df_metrics.calls);
+}
+
+void df_metrics_record_exception(void)
+{
+        if (df_metrics_enabled)
+                DF_METRICS_INC(&df_metrics.exceptions);
+}
+
+void df_metrics_record_crash(void)
+{
+        if (df_metrics_enabled)
+                DF_METRICS_INC(&df_metrics.crashes);
+}
+
+void df_metrics_record_finding(void)
+{
+        if (df_metrics_enabled)
+                DF_METRICS_INC(&df_metrics.findings);
+}
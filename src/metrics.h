@@ -0,0 +1,36 @@
+/** @file metrics.h */
+#pragma once
+
+#include <gio/gio.h>
+
+/* Prometheus metrics in the text exposition format, periodically rewritten
+ * into a file by a background thread (for node_exporter's textfile collector).
+ * The fuzzing thread only bumps counters with relaxed atomic operations, the
+ * writer thread reads them without any locking. */
+
+/** How often (in usec) the metrics file is rewritten */
+#define DF_METRICS_INTERVAL (5 * G_USEC_PER_SEC)
+
+/** Progress of a single tested interface */
+typedef struct df_metrics_interface {
+        char *object;
+        char *interface;
+        /* Number of methods and properties to test, and tested so far */
+        guint64 total;
+        guint64 tested;
+} df_metrics_interface_t;
+
+int df_metrics_open(const char *file_name, const char *bus_name);
+int df_metrics_close(void);
+gboolean df_metrics_is_enabled(void);
+
+void df_metrics_set_target_pid(int pid);
+df_metrics_interface_t *df_metrics_add_interface(const char *object, const char *interface, guint64 total);
+void df_metrics_interface_tested(df_metrics_interface_t *i);
+
+void df_metrics_record_call(guint64 usec);
+void df_metrics_record_exception(void);
+void df_metrics_record_crash(void);
+void df_metrics_record_finding(void);
+
+GString *df_metrics_format(void);
@@ -0,0 +1,265 @@
+/** @file plan.c */
+/*
+ * dfuzzer - tool for fuzz testing processes communicating through D-Bus.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <gio/gio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json.h"
+#include "log.h"
+#include "plan.h"
+#include "util.h"
+
+typedef struct df_plan_member {
+        char *kind;
+        char *bus;
+        char *object;
+        char *interface;
+        char *name;
+        char *signature;
+        guint64 iterations;
+        guint64 calls;
+        gboolean suppressed;
+        /* calls x round-trip time of the bus name, if it's known */
+        gboolean estimate_known;
+        guint64 estimate;
+} df_plan_member_t;
+
+static gboolean df_plan_enabled;
+/** Members in the order they were discovered */
+static GPtrArray *df_plan_members;
+/** Round-trip time (in usec) to the currently tested bus name */
+static gboolean df_plan_latency_known;
+static guint64 df_plan_latency;
+
+static void df_plan_member_free(df_plan_member_t *m)
+{
+        g_free(m->kind);
+        g_free(m->bus);
+        g_free(m->object);
+        g_free(m->interface);
+        g_free(m->name);
+        g_free(m->signature);
+        g_free(m);
+}
+
+void df_plan_enable(void)
+{
+        df_plan_enabled = TRUE;
+}
+
+gboolean df_plan_is_enabled(void)
+{
+        return df_plan_enabled;
+}
+
+/**
+ * @function Drops all the listed members and disables the plan mode.
+ */
+void df_plan_reset(void)
+{
+        df_plan_enabled = FALSE;
+        df_plan_latency_known = FALSE;
+        df_plan_latency = 0;
+        g_clear_pointer(&df_plan_members, g_ptr_array_unref);
+}
+
+void df_plan_set_latency(gboolean known, guint64 usec)
+{
+        df_plan_latency_known = known;
+        df_plan_latency = known ? usec : 0;
+}
+
+static int df_plan_compare_samples(const void *a, const void *b)
+{
+        guint64 x = *(const guint64 *) a, y = *(const guint64 *) b;
+
+        return x < y ? -1 : x > y;
+}
+
+/**
+ * @function Measures the round-trip time to the bus name, used to estimate
+ * the duration of the members added afterwards. If the bus name doesn't
+ * answer org.freedesktop.DBus.Peer.Ping, the estimates are unknown.
+ * @param dcon D-Bus connection
+ * @param bus Tested bus name
+ * @return 0 on success, -1 on error
+ */
+int df_plan_measure_latency(GDBusConnection *dcon, const char *bus)
+{
+        guint64 samples[DF_PLAN_PINGS];
+
+        g_assert(dcon);
+        g_assert(bus);
+
+        df_plan_set_latency(FALSE, 0);
+
+        for (size_t i = 0; i < G_N_ELEMENTS(samples); i++) {
+                g_autoptr(GVariant) reply = NULL;
+                g_autoptr(GError) error = NULL;
+                gint64 start;
+
+                start = g_get_monotonic_time();
+                reply = g_dbus_connection_call_sync(dcon, bus, "/", "org.freedesktop.DBus.Peer", "Ping",
+                                                    NULL, NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL, &error);
+                if (!reply)
+                        return df_fail_ret(-1, "Failed to ping %s, the duration can't be estimated: %s\n",
+                                           bus, error->message);
+
+                samples[i] = g_get_monotonic_time() - start;
+        }
+
+        qsort(samples, G_N_ELEMENTS(samples), sizeof(*samples), df_plan_compare_samples);
+        df_plan_set_latency(TRUE, samples[G_N_ELEMENTS(samples) / 2]);
+        df_verbose("Ping latency of %s: %"G_GUINT64_FORMAT" usec (median of %d pings)\n",
+                   bus, df_plan_latency, DF_PLAN_PINGS);
+
+        return 0;
+}
+
+/**
+ * @function Lists a method or property which would be tested and emits it
+ * as a "plan" event into the JSON stream.
+ * @param kind "method" or "property"
+ * @param iterations Number of iterations the member would be tested with
+ * @param calls Number of calls the test would do, 0 if it's suppressed
+ * @param suppressed Whether a suppression matches the member
+ */
+void df_plan_add(const char *kind, const char *bus, const char *object, const char *interface, const char *name,
+                 const char *signature, guint64 iterations, guint64 calls, gboolean suppressed)
+{
+        df_plan_member_t *m;
+
+        if (!df_plan_members)
+                df_plan_members = g_ptr_array_new_with_free_func((GDestroyNotify) df_plan_member_free);
+
+        m = g_new0(df_plan_member_t, 1);
+        m->kind = g_strdup(kind);
+        m->bus = g_strdup(bus);
+        m->object = g_strdup(object);
+        m->interface = g_strdup(interface);
+        m->name = g_strdup(name);
+        m->signature = g_strdup(signature);
+        m->iterations = iterations;
+        m->calls = calls;
+        m->suppressed = suppressed;
+        m->estimate_known = df_plan_latency_known;
+        m->estimate = calls * df_plan_latency;
+        g_ptr_array_add(df_plan_members, m);
+
+        if (df_json_is_open()) {
+                GString *e;
+
+                e = df_json_event_new("plan");
+                df_json_event_add_string(e, "kind", kind);
+                df_json_event_add_string(e, "bus", bus);
+                df_json_event_add_string(e, "object", object);
+                df_json_event_add_string(e, "interface", interface);
+                df_json_event_add_string(e, "name", name);
+                df_json_event_add_string(e, "signature", signature);
+                df_json_event_add_uint(e, "iterations", iterations);
+                df_json_event_add_uint(e, "calls", calls);
+                df_json_event_add_bool(e, "suppressed", suppressed);
+                if (m->estimate_known) {
+                        df_json_event_add_uint(e, "latency_usec", df_plan_latency);
+                        df_json_event_add_uint(e, "estimate_usec", m->estimate);
+                }
+                df_json_event_emit(e);
+        }
+}
+
+static void df_plan_format_estimate(char *buf, size_t size, gboolean known, guint64 usec)
+{
+        if (known)
+                snprintf(buf, size, "%.3f", (double) usec / G_USEC_PER_SEC);
+        else
+                snprintf(buf, size, "-");
+}
+
+/**
+ * @function Prints the table of the listed members with a summary and emits
+ * the summary as a "plan_end" event into the JSON stream.
+ */
+void df_plan_print(FILE *output)
+{
+        int w_object = strlen("Object"), w_interface = strlen("Interface"), w_name = strlen("Member");
+        int w_signature = strlen("Signature");
+        guint methods = 0, properties = 0, suppressed = 0;
+        guint64 calls = 0, estimate = 0;
+        gboolean estimate_known = TRUE;
+        char buf[32];
+
+        g_assert(output);
+
+        if (!df_plan_members || df_plan_members->len == 0) {
+                fprintf(output, "Nothing to test\n");
+                estimate_known = df_plan_latency_known;
+        } else {
+                for (guint i = 0; i < df_plan_members->len; i++) {
+                        const df_plan_member_t *m = df_plan_members->pdata[i];
+
+                        w_object = MAX(w_object, (int) MIN(strlen(m->object), DF_PLAN_COLUMN_WIDTH_MAX));
+                        w_interface = MAX(w_interface, (int) MIN(strlen(m->interface), DF_PLAN_COLUMN_WIDTH_MAX));
+                        w_name = MAX(w_name, (int) MIN(strlen(m->name), DF_PLAN_COLUMN_WIDTH_MAX));
+                        w_signature = MAX(w_signature, (int) MIN(strlen(m->signature), DF_PLAN_COLUMN_WIDTH_MAX));
+                }
+
+                fprintf(output, "%-8s %-*s %-*s %-*s %-*s %10s %10s %12s %s\n", "Kind",
+                        w_object, "Object", w_interface, "Interface", w_name, "Member", w_signature, "Signature",
+                        "Iterations", "Calls", "Estimate [s]", "Suppressed");
+                for (guint i = 0; i < df_plan_members->len; i++) {
+                        const df_plan_member_t *m = df_plan_members->pdata[i];
+
+                        df_plan_format_estimate(buf, sizeof(buf), m->estimate_known, m->estimate);
+                        fprintf(output, "%-8s %-*.*s %-*.*s %-*.*s %-*.*s %10"G_GUINT64_FORMAT" %10"G_GUINT64_FORMAT
+                                " %12s %s\n", m->kind, w_object, w_object, m->object, w_interface, w_interface,
+                                m->interface, w_name, w_name, m->name, w_signature, w_signature, m->signature,
+                                m->iterations, m->calls, buf, m->suppressed ? "yes" : "no");
+
+                        if (g_str_equal(m->kind, "method"))
+                                methods++;
+                        else
+                                properties++;
+                        if (m->suppressed)
+                                suppressed++;
+                        calls += m->calls;
+                        estimate += m->estimate;
+                        estimate_known = estimate_known && m->estimate_known;
+                }
+        }
+
+        df_plan_format_estimate(buf, sizeof(buf), estimate_known, estimate);
+        fprintf(output, "Total: %u methods, %u properties (%u suppressed), %"G_GUINT64_FORMAT" calls, "
+                "estimated duration %s s\n", methods, properties, suppressed, calls, buf);
+        if (df_plan_latency_known)
+                fprintf(output, "Estimated from the ping latency of %"G_GUINT64_FORMAT" usec (median of %d pings), "
+                        "without the time the target spends handling the calls\n", df_plan_latency, DF_PLAN_PINGS);
+
+        if (df_json_is_open()) {
+                GString *e;
+
+                e = df_json_event_new("plan_end");
+                df_json_event_add_uint(e, "methods", methods);
+                df_json_event_add_uint(e, "properties", properties);
+                df_json_event_add_uint(e, "suppressed", suppressed);
+                df_json_event_add_uint(e, "calls", calls);
+                if (estimate_known)
+                        df_json_event_add_uint(e, "estimate_usec", estimate);
+                df_json_event_emit(e);
+        }
+}
@@ -0,0 +1,29 @@
+/** @file plan.h */
+#pragma once
+
+#include <gio/gio.h>
+#include <stdio.h>
+
+/* Plan mode (--plan): the bus name is only introspected, no fuzz input is
+ * sent. Each method and property which would be tested is listed with its
+ * number of iterations and calls, and the duration of the run is estimated
+ * from the number of calls and the round-trip time of
+ * org.freedesktop.DBus.Peer.Ping to the tested bus name. The estimate is a
+ * lower bound, as the pings carry no payload and the target does no work for
+ * them. */
+
+/** Number of pings the round-trip time is measured from (their median) */
+#define DF_PLAN_PINGS 20
+/** Maximum width of the columns of the plan table */
+#define DF_PLAN_COLUMN_WIDTH_MAX 64
+
+void df_plan_enable(void);
+gboolean df_plan_is_enabled(void);
+void df_plan_reset(void);
+
+int df_plan_measure_latency(GDBusConnection *dcon, const char *bus);
+void df_plan_set_latency(gboolean known, guint64 usec);
+
+void df_plan_add(const char *kind, const char *bus, const char *object, const char *interface, const char *name,
+                 const char *signature, guint64 iterations, guint64 calls, gboolean suppressed);
+void df_plan_print(FILE *output);
@@ -0,0 +1,35 @@
+/** @file probes.h */
+#pragma once
+
+/* USDT (SystemTap/DTrace-style) static probes, which can be attached to with
+ * bpftrace, perf or stap, e.g.:
+ *
+ *   bpftrace -e 'usdt:/usr/bin/dfuzzer:dfuzzer:call_end { @[str(arg0)] = hist(arg2); }'
+ *
+ * A disarmed probe is a single nop in the instruction stream (its arguments
+ * are described only in an ELF note), so they cost nothing unless something
+ * is attached. Without sys/sdt.h (or with -Dusdt=disabled) they're compiled
+ * out completely.
+ *
+ * Probes and their arguments:
+ *   input_generated(name, iteration, signature)
+ *   call_start(name, iteration)
+ *   call_end(name, iteration, duration in usec, result)
+ *   crash_detected(name, pid)
+ *   target_restarted(bus name, pid)
+ *   introspection_done(bus name, object path)
+ *
+ * where name is the name of the tested method or property and result is the
+ * return value of the call (negative on an unexpected response). */
+
+#if HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+
+#define DF_PROBE2(name, a, b) DTRACE_PROBE2(dfuzzer, name, a, b)
+#define DF_PROBE3(name, a, b, c) DTRACE_PROBE3(dfuzzer, name, a, b, c)
+#define DF_PROBE4(name, a, b, c, d) DTRACE_PROBE4(dfuzzer, name, a, b, c, d)
+#else
+#define DF_PROBE2(name, a, b) do { } while (0)
+#define DF_PROBE3(name, a, b, c) do { } while (0)
+#define DF_PROBE4(name, a, b, c, d) do { } while (0)
+#endif
@@ -0,0 +1,267 @@
+/** @file profile.c */
+/*
+ * dfuzzer - tool for fuzz testing processes communicating through D-Bus.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <gio/gio.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "profile.h"
+#include "util.h"
+
+/** Maximum width of the name column in the breakdown */
+#define DF_PROFILE_NAME_WIDTH_MAX 64
+/** Name of the entry for the time spent outside of tests */
+#define DF_PROFILE_OUTSIDE "(outside tests)"
+
+typedef struct df_profile_entry {
+        char *name;
+        /* In nsec */
+        guint64 phases[_DF_PROFILE_PHASE_MAX];
+} df_profile_entry_t;
+
+static const char * const df_profile_phase_names[_DF_PROFILE_PHASE_MAX] = {
+        [DF_PROFILE_GENERATE]   = "generate",
+        [DF_PROFILE_SERIALIZE]  = "serialize",
+        [DF_PROFILE_CALL]       = "call",
+        [DF_PROFILE_LIVENESS]   = "liveness",
+        [DF_PROFILE_LOG]        = "log",
+        [DF_PROFILE_HOOK]       = "hook",
+        [DF_PROFILE_RECOVERY]   = "recovery",
+        [DF_PROFILE_OTHER]      = "other",
+};
+
+/** Entries by "interface.name" */
+static GHashTable *df_profile_entries;
+static df_profile_entry_t *df_profile_outside;
+/* Where the time since df_profile_last goes */
+static df_profile_entry_t *df_profile_current;
+static df_profile_phase_t df_profile_phase;
+static guint64 df_profile_last;
+
+static guint64 df_profile_now(void)
+{
+        struct timespec ts;
+
+        /* Served from the vDSO, i.e. without a syscall */
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return (guint64) ts.tv_sec * G_GUINT64_CONSTANT(1000000000) + ts.tv_nsec;
+}
+
+static void df_profile_entry_free(df_profile_entry_t *e)
+{
+        if (!e)
+                return;
+
+        g_free(e->name);
+        g_free(e);
+}
+
+static df_profile_entry_t *df_profile_entry_get(const char *name)
+{
+        df_profile_entry_t *e;
+
+        e = g_hash_table_lookup(df_profile_entries, name);
+        if (e)
+                return e;
+
+        e = g_new0(df_profile_entry_t, 1);
+        e->name = g_strdup(name);
+        g_hash_table_insert(df_profile_entries, e->name, e);
+
+        return e;
+}
+
+/**
+ * @function Starts profiling, everything until df_profile_reset() is
+ * accounted to some phase.
+ */
+void df_profile_enable(void)
+{
+        g_assert(!df_profile_entries);
+
+        df_profile_entries = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+                                                   (GDestroyNotify) df_profile_entry_free);
+        df_profile_outside = df_profile_entry_get(DF_PROFILE_OUTSIDE);
+        df_profile_current = df_profile_outside;
+        df_profile_phase = DF_PROFILE_OTHER;
+        df_profile_last = df_profile_now();
+}
+
+gboolean df_profile_is_enabled(void)
+{
+        return !!df_profile_entries;
+}
+
+/**
+ * @function Accounts the time since the previous mark to the previous phase
+ * and switches to a new one.
+ * @param phase The phase which starts now
+ */
+void df_profile_enter(df_profile_phase_t phase)
+{
+        guint64 now;
+
+        g_assert(phase < _DF_PROFILE_PHASE_MAX);
+
+        if (!df_profile_entries)
+                return;
+
+        now = df_profile_now();
+        df_profile_current->phases[df_profile_phase] += now - df_profile_last;
+        df_profile_last = now;
+        df_profile_phase = phase;
+}
+
+/**
+ * @function Accounts everything until df_profile_end_test() to the given
+ * method or property, starting with DF_PROFILE_OTHER.
+ */
+void df_profile_begin_test(const char *interface, const char *name)
+{
+        g_autoptr(gchar) key = NULL;
+
+        g_assert(interface);
+        g_assert(name);
+
+        if (!df_profile_entries)
+                return;
+
+        df_profile_enter(DF_PROFILE_OTHER);
+        key = g_strjoin(".", interface, name, NULL);
+        df_profile_current = df_profile_entry_get(key);
+}
+
+void df_profile_end_test(void)
+{
+        if (!df_profile_entries)
+                return;
+
+        df_profile_enter(DF_PROFILE_OTHER);
+        df_profile_current = df_profile_outside;
+}
+
+/**
+ * @function Returns the time spent in a phase of a method or property.
+ * @return Time in nsec, 0 if the method or property is unknown
+ */
+guint64 df_profile_get(const char *interface, const char *name, df_profile_phase_t phase)
+{
+        g_autoptr(gchar) key = NULL;
+        df_profile_entry_t *e;
+
+        g_assert(phase < _DF_PROFILE_PHASE_MAX);
+
+        if (!df_profile_entries)
+                return 0;
+
+        key = interface ? g_strjoin(".", interface, name, NULL) : g_strdup(DF_PROFILE_OUTSIDE);
+        e = g_hash_table_lookup(df_profile_entries, key);
+
+        return e ? e->phases[phase] : 0;
+}
+
+static guint64 df_profile_entry_total(const df_profile_entry_t *e)
+{
+        guint64 total = 0;
+
+        for (guint i = 0; i < _DF_PROFILE_PHASE_MAX; i++)
+                total += e->phases[i];
+
+        return total;
+}
+
+static gint df_profile_compare_entries(gconstpointer a, gconstpointer b)
+{
+        const df_profile_entry_t *x = *(df_profile_entry_t * const *) a, *y = *(df_profile_entry_t * const *) b;
+        guint64 tx = df_profile_entry_total(x), ty = df_profile_entry_total(y);
+
+        if (tx != ty)
+                return tx < ty ? 1 : -1;
+
+        return strcmp(x->name, y->name);
+}
+
+/**
+ * @function Prints the time (in msec) spent in each phase for each method
+ * and property (the most expensive first), followed by the totals and their
+ * share of the wall time.
+ */
+void df_profile_print(FILE *output)
+{
+        g_autoptr(GPtrArray) entries = NULL;
+        guint64 totals[_DF_PROFILE_PHASE_MAX] = {}, wall = 0;
+        int width = strlen("Total");
+        GHashTableIter iter;
+        gpointer value;
+
+        g_assert(output);
+
+        if (!df_profile_entries)
+                return;
+
+        /* Account the current phase up to now */
+        df_profile_enter(df_profile_phase);
+
+        entries = g_ptr_array_new();
+        g_hash_table_iter_init(&iter, df_profile_entries);
+        while (g_hash_table_iter_next(&iter, NULL, &value)) {
+                df_profile_entry_t *e = value;
+
+                g_ptr_array_add(entries, e);
+                width = MAX(width, (int) MIN(strlen(e->name), DF_PROFILE_NAME_WIDTH_MAX));
+                for (guint i = 0; i < _DF_PROFILE_PHASE_MAX; i++)
+                        totals[i] += e->phases[i];
+        }
+        g_ptr_array_sort(entries, df_profile_compare_entries);
+        for (guint i = 0; i < _DF_PROFILE_PHASE_MAX; i++)
+                wall += totals[i];
+
+        fprintf(output, "%-*s", width, "Profile (ms)");
+        for (guint i = 0; i < _DF_PROFILE_PHASE_MAX; i++)
+                fprintf(output, " %10s", df_profile_phase_names[i]);
+        fprintf(output, " %10s\n", "total");
+
+        for (guint i = 0; i < entries->len; i++) {
+                const df_profile_entry_t *e = entries->pdata[i];
+
+                fprintf(output, "%-*.*s", width, width, e->name);
+                for (guint j = 0; j < _DF_PROFILE_PHASE_MAX; j++)
+                        fprintf(output, " %10.1f", e->phases[j] / 1e6);
+                fprintf(output, " %10.1f\n", df_profile_entry_total(e) / 1e6);
+        }
+
+        fprintf(output, "%-*s", width, "Total");
+        for (guint i = 0; i < _DF_PROFILE_PHASE_MAX; i++)
+                fprintf(output, " %10.1f", totals[i] / 1e6);
+        fprintf(output, " %10.1f\n", wall / 1e6);
+
+        fprintf(output, "%-*s", width, "Share");
+        for (guint i = 0; i < _DF_PROFILE_PHASE_MAX; i++)
+                fprintf(output, " %9.1f%%", wall > 0 ? totals[i] * 100.0 / wall : 0.0);
+        fprintf(output, " %9.1f%%\n", wall > 0 ? 100.0 : 0.0);
+}
+
+/**
+ * @function Stops profiling and drops all collected data.
+ */
+void df_profile_reset(void)
+{
+        g_clear_pointer(&df_profile_entries, g_hash_table_unref);
+        df_profile_outside = df_profile_current = NULL;
+}
@@ -0,0 +1,43 @@
+/** @file profile.h */
+#pragma once
+
+#include <gio/gio.h>
+#include <stdio.h>
+
+/* Phase-level self-profiling: the fuzzing thread marks where it enters each
+ * phase and the time since the previous mark is accounted to the previous
+ * phase of the currently tested method or property. Time outside of tests
+ * (introspection, reconnecting after crashes, ...) goes to a separate entry,
+ * so the sum of all entries is the wall time since df_profile_enable(). */
+
+typedef enum df_profile_phase {
+        /* Generating random arguments */
+        DF_PROFILE_GENERATE = 0,
+        /* Serializing inputs into the crash recorder. Marshalling the message
+         * is done by GDBus and is part of the call */
+        DF_PROFILE_SERIALIZE,
+        /* Sending the call and waiting for the reply */
+        DF_PROFILE_CALL,
+        /* Checking whether the tested process is still alive */
+        DF_PROFILE_LIVENESS,
+        /* Console output, logs and statistics */
+        DF_PROFILE_LOG,
+        /* The command specified by -e/--command */
+        DF_PROFILE_HOOK,
+        /* Waiting after timeouts and reconnecting after crashes */
+        DF_PROFILE_RECOVERY,
+        /* Everything else (setup, introspection, pauses, ...) */
+        DF_PROFILE_OTHER,
+        _DF_PROFILE_PHASE_MAX
+} df_profile_phase_t;
+
+void df_profile_enable(void);
+gboolean df_profile_is_enabled(void);
+
+void df_profile_enter(df_profile_phase_t phase);
+void df_profile_begin_test(const char *interface, const char *name);
+void df_profile_end_test(void);
+
+guint64 df_profile_get(const char *interface, const char *name, df_profile_phase_t phase);
+void df_profile_print(FILE *output);
+void df_profile_reset(void);
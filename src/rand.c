@@ -28,10 +28,25 @@
 #include <time.h>
 
 #include "rand.h"
+#include "dictionary.h"
+#include "fdpool.h"
 #include "log.h"
+#include "shard.h"
 #include "util.h"
 
 static struct external_dictionary df_external_dictionary;
+/** Seed of the pseudo-random generators, see df_rand_init() and
+  * df_rand_init_member() */
+static unsigned int df_rand_seed;
+/** Typed dictionary of the argument which is currently being generated */
+static const df_dictionary_t *df_active_dictionary;
+/** Generate maximally nested values for variants (see df_generate_nested()) */
+static gboolean df_nesting_stress;
+/** Remaining container depth for values nested in variants of the current
+  * arguments, so we don't go over the limits of the D-Bus specification */
+static guint df_nesting_budget = DF_DBUS_MAX_DEPTH;
+/** Number of variants currently being generated by df_rand_GVariant() */
+static guint df_variant_depth;
 
 /**
  * @function Initializes global flag variables and seeds pseudo-random
@@ -40,10 +55,37 @@ static struct external_dictionary df_external_dictionary;
  */
 void df_rand_init(unsigned int seed)
 {
+        df_rand_seed = seed;
         srand(seed);
         srandom(seed);
 }
 
+unsigned int df_rand_get_seed(void)
+{
+        return df_rand_seed;
+}
+
+/**
+ * @function Reseeds pseudo-random numbers generators before testing a method
+ * or property, so its inputs depend only on the seed and the member and not
+ * on what was tested before it (i.e. a failure can be reproduced by testing
+ * just the member with the same seed).
+ */
+void df_rand_init_member(const char *object, const char *interface, const char *member)
+{
+        guint64 hash;
+
+        hash = df_shard_hash(object, interface, member) ^ df_rand_seed;
+        hash ^= hash >> 32;
+        srand((unsigned int) hash);
+        srandom((unsigned int) hash);
+}
+
+void df_rand_set_nesting_stress(gboolean enable)
+{
+        df_nesting_stress = enable;
+}
+
 int df_rand_load_external_dictionary(const char *filename)
 {
         g_autoptr(FILE) f = NULL;
@@ -80,6 +122,132 @@ int df_rand_load_external_dictionary(const char *filename)
         return 0;
 }
 
+static GVariant *df_generate_random_boolean(guint64 iteration)
+{
+        return g_variant_new_boolean(df_rand_gboolean(iteration));
+}
+
+static GVariant *df_generate_random_byte(guint64 iteration)
+{
+        return g_variant_new_byte(df_rand_guint8(iteration));
+}
+
+static GVariant *df_generate_random_int16(guint64 iteration)
+{
+        return g_variant_new_int16(df_rand_gint16(iteration));
+}
+
+static GVariant *df_generate_random_uint16(guint64 iteration)
+{
+        return g_variant_new_uint16(df_rand_guint16(iteration));
+}
+
+static GVariant *df_generate_random_int32(guint64 iteration)
+{
+        return g_variant_new_int32(df_rand_gint32(iteration));
+}
+
+static GVariant *df_generate_random_uint32(guint64 iteration)
+{
+        return g_variant_new_uint32(df_rand_guint32(iteration));
+}
+
+static GVariant *df_generate_random_int64(guint64 iteration)
+{
+        return g_variant_new_int64(df_rand_gint64(iteration));
+}
+
+static GVariant *df_generate_random_uint64(guint64 iteration)
+{
+        return g_variant_new_uint64(df_rand_guint64(iteration));
+}
+
+static GVariant *df_generate_random_handle(guint64 iteration)
+{
+        return g_variant_new_handle(df_rand_unixFD(iteration));
+}
+
+static GVariant *df_generate_random_double(guint64 iteration)
+{
+        return g_variant_new_double(df_rand_gdouble(iteration));
+}
+
+static GVariant *df_generate_random_string(guint64 iteration)
+{
+        gchar *str = NULL;
+
+        if (df_rand_string(&str, iteration) < 0) {
+                df_fail("Failed to generate a random string\n");
+                return NULL;
+        }
+
+        /* Hand the generated string over to the variant to avoid a copy */
+        return g_variant_new_take_string(str);
+}
+
+static GVariant *df_generate_random_object_path(guint64 iteration)
+{
+        g_autoptr(char) obj_path = NULL;
+
+        if (df_rand_dbus_objpath_string(&obj_path, iteration) < 0) {
+                df_fail("Failed to generate a random object path\n");
+                return NULL;
+        }
+
+        return g_variant_new_object_path(obj_path);
+}
+
+static GVariant *df_generate_random_signature_variant(guint64 iteration)
+{
+        g_autoptr(char) sig_str = NULL;
+
+        if (df_rand_dbus_signature_string(&sig_str, iteration) < 0) {
+                df_fail("Failed to generate a random signature string\n");
+                return NULL;
+        }
+
+        return g_variant_new_signature(sig_str);
+}
+
+static GVariant *df_generate_random_variant(guint64 iteration)
+{
+        GVariant *variant = NULL;
+        int r;
+
+        /* Don't nest the stress values into each other, the budget is shared */
+        if (df_nesting_stress && df_variant_depth == 0 && df_nesting_budget > 1)
+                return g_variant_new_variant(df_generate_nested(iteration % _DF_NESTING_SHAPE_MAX,
+                                                                df_nesting_budget - 1, iteration));
+
+        df_variant_depth++;
+        r = df_rand_GVariant(&variant, iteration);
+        df_variant_depth--;
+        if (r < 0) {
+                df_fail("Failed to generate a random GVariant\n");
+                return NULL;
+        }
+
+        return g_variant_new_variant(variant);
+}
+
+/* Generators for basic types (and variant) indexed by their type character */
+static GVariant *(*const df_basic_generators[128])(guint64 iteration) = {
+        ['b'] = df_generate_random_boolean,
+        ['y'] = df_generate_random_byte,
+        ['n'] = df_generate_random_int16,
+        ['q'] = df_generate_random_uint16,
+        ['i'] = df_generate_random_int32,
+        ['u'] = df_generate_random_uint32,
+        ['x'] = df_generate_random_int64,
+        ['t'] = df_generate_random_uint64,
+        ['h'] = df_generate_random_handle,
+        ['d'] = df_generate_random_double,
+        ['s'] = df_generate_random_string,
+        ['o'] = df_generate_random_object_path,
+        ['g'] = df_generate_random_signature_variant,
+        ['v'] = df_generate_random_variant,
+};
+
 /* Generate a GVariant with random data for a basic (non-compound) type
  *
  * Note: variant itself is treated as a basic type, since it's a bit special and
@@ -87,77 +255,32 @@ int df_rand_load_external_dictionary(const char *filename)
  */
 GVariant *df_generate_random_basic(const GVariantType *type, guint64 iteration)
 {
-        g_autoptr(char) ssig = NULL;
+        unsigned char c;
 
         if (!type) {
                 g_assert_not_reached();
                 return NULL;
         }
 
-        ssig = g_variant_type_dup_string(type);
-
-        if (g_variant_type_equal(type, G_VARIANT_TYPE_BOOLEAN))
-                return g_variant_new(ssig, df_rand_gboolean(iteration));
-        else if (g_variant_type_equal(type, G_VARIANT_TYPE_BYTE))
-                return g_variant_new(ssig, df_rand_guint8(iteration));
-        else if (g_variant_type_equal(type, G_VARIANT_TYPE_INT16))
-                return g_variant_new(ssig, df_rand_gint16(iteration));
-        else if (g_variant_type_equal(type, G_VARIANT_TYPE_UINT16))
-                return g_variant_new(ssig, df_rand_guint16(iteration));
-        else if (g_variant_type_equal(type, G_VARIANT_TYPE_INT32))
-                return g_variant_new(ssig, df_rand_gint32(iteration));
-        else if (g_variant_type_equal(type, G_VARIANT_TYPE_UINT32))
-                return g_variant_new(ssig, df_rand_guint32(iteration));
-        else if (g_variant_type_equal(type, G_VARIANT_TYPE_INT64))
-                return g_variant_new(ssig, df_rand_gint64(iteration));
-        else if (g_variant_type_equal(type, G_VARIANT_TYPE_UINT64))
-                return g_variant_new(ssig, df_rand_guint64(iteration));
-        else if (g_variant_type_equal(type, G_VARIANT_TYPE_HANDLE))
-                return g_variant_new(ssig, df_rand_unixFD(iteration));
-        else if (g_variant_type_equal(type, G_VARIANT_TYPE_DOUBLE))
-                return g_variant_new(ssig, df_rand_gdouble(iteration));
-        else if (g_variant_type_equal(type, G_VARIANT_TYPE_STRING)) {
-                g_autoptr(char) str = NULL;
-
-                if (df_rand_string(&str, iteration) < 0) {
-                        df_fail("Failed to generate a random string\n");
-                        return NULL;
-                }
-
-                return g_variant_new(ssig, str);
-        } else if (g_variant_type_equal(type, G_VARIANT_TYPE_OBJECT_PATH)) {
-                g_autoptr(char) obj_path = NULL;
-
-                if (df_rand_dbus_objpath_string(&obj_path, iteration) < 0) {
-                        df_fail("Failed to generate a random object path\n");
-                        return NULL;
-                }
-
-                return g_variant_new(ssig, obj_path);
-        } else if (g_variant_type_equal(type, G_VARIANT_TYPE_SIGNATURE)) {
-                g_autoptr(char) sig_str = NULL;
-
-                if (df_rand_dbus_signature_string(&sig_str, iteration) < 0) {
-                        df_fail("Failed to generate a random signature string\n");
-                        return NULL;
-                }
+        /* Prefer values from the argument's typed dictionary, if there are any */
+        if (df_active_dictionary) {
+                GVariant *value;
 
-                return g_variant_new(ssig, sig_str);
-        } else if (g_variant_type_equal(type, G_VARIANT_TYPE_VARIANT)) {
-                GVariant *variant = NULL;
-
-                if (df_rand_GVariant(&variant, iteration) < 0) {
-                        df_fail("Failed to generate a random GVariant\n");
-                        return NULL;
-                }
+                value = df_dictionary_get_value(df_active_dictionary, type, iteration);
+                if (value)
+                        return value;
+        }
 
-                return g_variant_new(ssig, variant);
-        } else {
-                df_fail("Invalid basic type: %s\n", ssig);
+        /* Basic types are always a single character, so there's no need to copy
+         * the (not NUL-terminated) type string */
+        c = *g_variant_type_peek_string(type);
+        if (c >= G_N_ELEMENTS(df_basic_generators) || !df_basic_generators[c]) {
+                df_fail("Invalid basic type: %c\n", c);
                 g_assert_not_reached();
+                return NULL;
         }
 
-        return NULL;
+        return df_basic_generators[c](iteration);
 }
 
 GVariant *df_generate_random_from_signature(const char *signature, guint64 iteration)
@@ -185,8 +308,6 @@ GVariant *df_generate_random_from_signature(const char *signature, guint64 itera
 
                 g_autoptr(char) ssig = NULL;
 
-                ssig = g_variant_type_dup_string(iter);
-
                 if (g_variant_type_is_basic(iter) || g_variant_type_is_variant(iter)) {
                         /* Basic type, generate a random value
                          * Note: treat 'variant' as a basic type, since it can't
@@ -203,6 +324,7 @@ GVariant *df_generate_random_from_signature(const char *signature, guint64 itera
                         /* Tuple */
                         GVariant *tuple = NULL;
 
+                        ssig = g_variant_type_dup_string(iter);
                         tuple = df_generate_random_from_signature(ssig, iteration);
                         if (!tuple)
                                 return NULL;
@@ -214,6 +336,17 @@ GVariant *df_generate_random_from_signature(const char *signature, guint64 itera
                         const GVariantType *array_type = NULL;
                         int nest_level = 0;
 
+                        /* Byte arrays can come from the argument's typed dictionary as a whole */
+                        if (df_active_dictionary) {
+                                GVariant *blob;
+
+                                blob = df_dictionary_get_value(df_active_dictionary, iter, iteration);
+                                if (blob) {
+                                        g_variant_builder_add_value(builder, blob);
+                                        continue;
+                                }
+                        }
+
                         /* Open the "main" array container */
                         g_variant_builder_open(builder, iter);
 
@@ -227,13 +360,18 @@ GVariant *df_generate_random_from_signature(const char *signature, guint64 itera
                                 nest_level++;
                         }
 
-                        array_signature = g_variant_type_dup_string(array_type);
+                        /* Basic elements can be generated directly from their type */
+                        if (!g_variant_type_is_basic(array_type) && !g_variant_type_is_variant(array_type))
+                                array_signature = g_variant_type_dup_string(array_type);
 
                         /* Create a pseudo-randomly sized array */
                         for (size_t i = 0; i < df_rand_array_size(iteration); i++) {
                                 GVariant *array_item = NULL;
 
-                                array_item = df_generate_random_from_signature(array_signature, iteration);
+                                if (array_signature)
+                                        array_item = df_generate_random_from_signature(array_signature, iteration);
+                                else
+                                        array_item = df_generate_random_basic(array_type, iteration);
                                 if (!array_item)
                                         return NULL;
 
@@ -248,6 +386,7 @@ GVariant *df_generate_random_from_signature(const char *signature, guint64 itera
                         g_variant_builder_close(builder);
                 } else {
                         /* TODO: maybe */
+                        ssig = g_variant_type_dup_string(iter);
                         df_fail("Not implemented: %s\n", ssig);
                         return NULL;
                 }
@@ -256,6 +395,181 @@ GVariant *df_generate_random_from_signature(const char *signature, guint64 itera
         return g_variant_builder_end(builder);
 }
 
+/* Return the maximum container nesting depth of a signature, where each array,
+ * struct and dict entry counts as one level */
+static guint df_signature_depth(const char *signature)
+{
+        /* Open containers, 'a' for arrays (which are closed by the end of their
+         * element type) and '(' for structs and dict entries */
+        char stack[256];
+        guint n = 0, max = 0;
+
+        if (!signature)
+                return 0;
+
+        for (const char *p = signature; *p && n < sizeof(stack); p++) {
+                switch (*p) {
+                case 'a':
+                case '(':
+                case '{':
+                        stack[n++] = *p == 'a' ? 'a' : '(';
+                        max = MAX(max, n);
+                        continue;
+                case ')':
+                case '}':
+                        if (n > 0)
+                                n--;
+                        break;
+                default:
+                        break;
+                }
+
+                /* A complete type ended, close all arrays it was the element of */
+                while (n > 0 && stack[n - 1] == 'a')
+                        n--;
+        }
+
+        return max;
+}
+
+/**
+ * @function Generates a maximally nested value of the given shape. The value
+ * is built from the innermost level outwards in a loop, so even the deepest
+ * values are cheap to generate and don't need recursion. Arrays and structs
+ * (including dict entries) are limited to DF_DBUS_MAX_ARRAY_DEPTH and
+ * DF_DBUS_MAX_STRUCT_DEPTH levels per signature, variants reset these limits.
+ * @param shape Kind of containers to nest
+ * @param depth Total number of container levels (including variants)
+ * @param iteration Current iteration
+ * @return Floating GVariant with at most depth container levels
+ */
+GVariant *df_generate_nested(df_nesting_shape_t shape, guint depth, guint64 iteration)
+{
+        GVariant *value;
+        guint arrays = 0, structs = 0;
+
+        depth = MIN(depth, DF_DBUS_MAX_DEPTH);
+        value = g_variant_new_uint32(df_rand_guint32(iteration));
+
+        for (guint level = 0; level < depth; level++) {
+                gboolean array;
+
+                switch (shape) {
+                case DF_NESTING_ARRAY:
+                case DF_NESTING_STRUCT:
+                case DF_NESTING_MIXED:
+                        if (shape == DF_NESTING_MIXED)
+                                array = level % 2 == 0 ? arrays < DF_DBUS_MAX_ARRAY_DEPTH : structs >= DF_DBUS_MAX_STRUCT_DEPTH;
+                        else
+                                array = shape == DF_NESTING_ARRAY;
+
+                        if (array) {
+                                if (arrays >= DF_DBUS_MAX_ARRAY_DEPTH)
+                                        return value;
+
+                                value = g_variant_new_array(NULL, &value, 1);
+                                arrays++;
+                        } else {
+                                if (structs >= DF_DBUS_MAX_STRUCT_DEPTH)
+                                        return value;
+
+                                value = g_variant_new_tuple(&value, 1);
+                                structs++;
+                        }
+                        break;
+                case DF_NESTING_DICT: {
+                        GVariant *entry;
+
+                        /* a{sX} takes two levels (array + dict entry) */
+                        if (level + 1 >= depth || arrays >= DF_DBUS_MAX_ARRAY_DEPTH ||
+                            structs >= DF_DBUS_MAX_STRUCT_DEPTH)
+                                return value;
+
+                        entry = g_variant_new_dict_entry(g_variant_new_string("dfuzzer"), value);
+                        value = g_variant_new_array(NULL, &entry, 1);
+                        arrays++;
+                        structs++;
+                        level++;
+                        break;
+                }
+                case DF_NESTING_VARIANT:
+                        value = g_variant_new_variant(value);
+                        break;
+                case DF_NESTING_VARIANT_ARRAY:
+                        /* av chains, each variant starts a new signature */
+                        if (level % 2 == 0)
+                                value = g_variant_new_array(NULL, &value, 1);
+                        else
+                                value = g_variant_new_variant(value);
+                        break;
+                default:
+                        g_assert_not_reached();
+                }
+        }
+
+        return value;
+}
+
+/**
+ * @function Generates arguments for a method (or a property) with signature
+ * in format "(...)", where each top-level element is generated with its
+ * respective typed dictionary (if any).
+ * @param signature Signature of all arguments wrapped in a tuple
+ * @param iteration Current iteration
+ * @param dictionaries Array of dictionaries (or NULLs) for each top-level
+ * element of the signature, may be NULL
+ * @return Floating GVariant on success, NULL on error
+ */
+GVariant *df_generate_random_arguments(const char *signature, guint64 iteration, const GPtrArray *dictionaries)
+{
+        g_autoptr(GVariantType) type = NULL;
+        g_autoptr(GVariantBuilder) builder = NULL;
+        guint idx = 0, depth;
+
+        /* The top-level tuple is the message body, not a struct, but the value
+         * might get wrapped in a variant (properties), which evens it out */
+        depth = df_signature_depth(signature);
+        df_nesting_budget = depth < DF_DBUS_MAX_DEPTH ? DF_DBUS_MAX_DEPTH - depth : 0;
+
+        if (!dictionaries)
+                return df_generate_random_from_signature(signature, iteration);
+
+        if (!signature || !g_variant_type_string_is_valid(signature)) {
+                df_fail("Invalid signature: %s\n", signature);
+                return NULL;
+        }
+
+        type = g_variant_type_new(signature);
+        g_assert(g_variant_type_is_tuple(type));
+
+        builder = g_variant_builder_new(type);
+
+        for (const GVariantType *iter = g_variant_type_first(type);
+             iter;
+             iter = g_variant_type_next(iter), idx++) {
+
+                g_autoptr(char) ssig = NULL;
+                g_autoptr(GVariant) tuple = NULL, arg = NULL;
+
+                /* Generate each argument as a one-element tuple, so arrays (including
+                 * the byte blobs from the dictionary) go through the same path as
+                 * struct members */
+                ssig = g_strdup_printf("(%.*s)", (int) g_variant_type_get_string_length(iter),
+                                       g_variant_type_peek_string(iter));
+
+                df_active_dictionary = idx < dictionaries->len ? dictionaries->pdata[idx] : NULL;
+                tuple = df_generate_random_from_signature(ssig, iteration);
+                df_active_dictionary = NULL;
+                if (!tuple)
+                        return NULL;
+
+                tuple = g_variant_ref_sink(tuple);
+                arg = g_variant_get_child_value(tuple, 0);
+                g_variant_builder_add_value(builder, arg);
+        }
+
+        return g_variant_builder_end(builder);
+}
 
 size_t df_rand_array_size(guint64 iteration)
 {
@@ -266,21 +580,26 @@ size_t df_rand_array_size(guint64 iteration)
         return rand() % 10;
 }
 
+/* Boundary values used in the first iterations, before switching to
+ * pseudo-random values */
+static const guint8 df_guint8_boundaries[] = { 0, G_MAXUINT8, G_MAXUINT8 / 2 };
+static const gint16 df_gint16_boundaries[] = { G_MININT16, G_MAXINT16, 0, G_MAXINT16 / 2 };
+static const guint16 df_guint16_boundaries[] = { 0, G_MAXUINT16, G_MAXUINT16 / 2 };
+static const gint32 df_gint32_boundaries[] = { G_MININT32, G_MAXINT32, 0, G_MAXINT32 / 2 };
+static const guint32 df_guint32_boundaries[] = { 0, G_MAXUINT32, G_MAXUINT32 / 2 };
+static const gint64 df_gint64_boundaries[] = { G_MININT64, G_MAXINT64, 0, G_MAXINT64 / 2 };
+static const guint64 df_guint64_boundaries[] = { 0, G_MAXUINT64, G_MAXUINT64 / 2 };
+static const gdouble df_gdouble_boundaries[] = { G_MAXDOUBLE, G_MINDOUBLE, 0, G_MAXDOUBLE / 2.0 };
+
 /**
  * @return Generated pseudo-random 8-bit unsigned integer value
  */
 guint8 df_rand_guint8(guint64 iteration)
 {
-        switch (iteration) {
-        case 0:
-                return 0;
-        case 1:
-                return G_MAXUINT8;
-        case 2:
-                return G_MAXUINT8 / 2;
-        default:
-                return rand() % G_MAXUINT8;
-        }
+        if (iteration < G_N_ELEMENTS(df_guint8_boundaries))
+                return df_guint8_boundaries[iteration];
+
+        return rand() % G_MAXUINT8;
 }
 
 /**
@@ -298,22 +617,14 @@ gint16 df_rand_gint16(guint64 iteration)
 {
         gint16 gi16;
 
-        switch (iteration) {
-        case 0:
-                return G_MININT16;
-        case 1:
-                return G_MAXINT16;
-        case 2:
-                return 0;
-        case 3:
-                return G_MAXINT16 / 2;
-        default:
-                gi16 = rand() % G_MAXINT16;
-                if (rand() % 2 == 0)
-                        return (gi16 * -1) - 1;
+        if (iteration < G_N_ELEMENTS(df_gint16_boundaries))
+                return df_gint16_boundaries[iteration];
 
-                return gi16;
-        }
+        gi16 = rand() % G_MAXINT16;
+        if (rand() % 2 == 0)
+                return (gi16 * -1) - 1;
+
+        return gi16;
 }
 
 /**
@@ -321,16 +632,10 @@ gint16 df_rand_gint16(guint64 iteration)
  */
 guint16 df_rand_guint16(guint64 iteration)
 {
-        switch (iteration) {
-        case 0:
-                return 0;
-        case 1:
-                return G_MAXUINT16;
-        case 2:
-                return G_MAXUINT16 / 2;
-        default:
-                return rand() % G_MAXUINT16;
-        }
+        if (iteration < G_N_ELEMENTS(df_guint16_boundaries))
+                return df_guint16_boundaries[iteration];
+
+        return rand() % G_MAXUINT16;
 }
 
 /**
@@ -340,22 +645,14 @@ gint32 df_rand_gint32(guint64 iteration)
 {
         gint32 gi32;
 
-        switch (iteration) {
-        case 0:
-                return G_MININT32;
-        case 1:
-                return G_MAXINT32;
-        case 2:
-                return 0;
-        case 3:
-                return G_MAXINT32 / 2;
-        default:
-                gi32 = rand() % G_MAXINT32;
-                if (rand() % 2 == 0)
-                        return (gi32 * -1) - 1;
+        if (iteration < G_N_ELEMENTS(df_gint32_boundaries))
+                return df_gint32_boundaries[iteration];
 
-                return gi32;
-        }
+        gi32 = rand() % G_MAXINT32;
+        if (rand() % 2 == 0)
+                return (gi32 * -1) - 1;
+
+        return gi32;
 }
 
 /**
@@ -363,16 +660,10 @@ gint32 df_rand_gint32(guint64 iteration)
  */
 guint32 df_rand_guint32(guint64 iteration)
 {
-        switch (iteration) {
-        case 0:
-                return 0;
-        case 1:
-                return G_MAXUINT32;
-        case 2:
-                return G_MAXUINT32 / 2;
-        default:
-                return rand() % G_MAXUINT32;
-        }
+        if (iteration < G_N_ELEMENTS(df_guint32_boundaries))
+                return df_guint32_boundaries[iteration];
+
+        return rand() % G_MAXUINT32;
 }
 
 /**
@@ -382,22 +673,14 @@ gint64 df_rand_gint64(guint64 iteration)
 {
         gint64 gi64;
 
-        switch (iteration) {
-        case 0:
-                return G_MININT64;
-        case 1:
-                return G_MAXINT64;
-        case 2:
-                return 0;
-        case 3:
-                return G_MAXINT64 / 2;
-        default:
-                gi64 = rand() % G_MAXINT64;
-                if (rand() % 2 == 0)
-                        return (gi64 * -1) - 1;
+        if (iteration < G_N_ELEMENTS(df_gint64_boundaries))
+                return df_gint64_boundaries[iteration];
 
-                return gi64;
-        }
+        gi64 = rand() % G_MAXINT64;
+        if (rand() % 2 == 0)
+                return (gi64 * -1) - 1;
+
+        return gi64;
 }
 
 /**
@@ -405,16 +688,10 @@ gint64 df_rand_gint64(guint64 iteration)
  */
 guint64 df_rand_guint64(guint64 iteration)
 {
-        switch (iteration) {
-        case 0:
-                return 0;
-        case 1:
-                return G_MAXUINT64;
-        case 2:
-                return G_MAXUINT64 / 2;
-        default:
-                return rand() % G_MAXUINT64;
-        }
+        if (iteration < G_N_ELEMENTS(df_guint64_boundaries))
+                return df_guint64_boundaries[iteration];
+
+        return rand() % G_MAXUINT64;
 }
 
 /**
@@ -424,24 +701,16 @@ gdouble df_rand_gdouble(guint64 iteration)
 {
         gdouble gdbl;
 
-        switch (iteration) {
-        case 0:
-                return G_MAXDOUBLE;
-        case 1:
-                return G_MINDOUBLE;
-        case 2:
-                return 0;
-        case 3:
-                return G_MAXDOUBLE / 2.0;
-        default:
-                gdbl = (gdouble) random();
-                gdbl += ((gdouble) rand() / RAND_MAX);
+        if (iteration < G_N_ELEMENTS(df_gdouble_boundaries))
+                return df_gdouble_boundaries[iteration];
 
-                if (rand() % 2 == 0)
-                        return gdbl * -1.0;
+        gdbl = (gdouble) random();
+        gdbl += ((gdouble) rand() / RAND_MAX);
 
-                return gdbl;
-        }
+        if (rand() % 2 == 0)
+                return gdbl * -1.0;
+
+        return gdbl;
 }
 
 gunichar df_rand_unichar(guint16 *width)
@@ -802,12 +1071,18 @@ int df_rand_GVariant(GVariant **var, guint64 iteration)
 }
 
 /**
- * @return Generated pseudo-random FD number from interval <-1, INT_MAX)
+ * @return Index of a pooled FD attached to the current call (see fdpool.c),
+ * or a pseudo-random FD number from interval <-1, INT_MAX) if the FD pool
+ * is not available
  */
 int df_rand_unixFD(guint64 iteration)
 {
         int fd;
 
+        fd = df_fd_pool_pick(iteration);
+        if (fd >= 0)
+                return fd;
+
         switch (iteration) {
         case 0:
         case 1:
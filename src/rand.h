@@ -25,16 +25,38 @@
                                 "abcdefghijklmnopqrstuvwxyz" \
                                 "0123456789_"
 
+/** Limits of container nesting in D-Bus messages (see the "Valid Signatures"
+  * section of the D-Bus specification) */
+#define DF_DBUS_MAX_ARRAY_DEPTH 32
+#define DF_DBUS_MAX_STRUCT_DEPTH 32
+#define DF_DBUS_MAX_DEPTH 64
+
+/* Shapes of values generated by df_generate_nested() */
+typedef enum df_nesting_shape {
+        DF_NESTING_ARRAY = 0,
+        DF_NESTING_STRUCT,
+        DF_NESTING_DICT,
+        DF_NESTING_MIXED,
+        DF_NESTING_VARIANT,
+        DF_NESTING_VARIANT_ARRAY,
+        _DF_NESTING_SHAPE_MAX
+} df_nesting_shape_t;
+
 struct external_dictionary {
         size_t size;
         char **strings;
 };
 
 void df_rand_init(unsigned int seed);
+unsigned int df_rand_get_seed(void);
+void df_rand_init_member(const char *object, const char *interface, const char *member);
 int df_rand_load_external_dictionary(const char *filename);
+void df_rand_set_nesting_stress(gboolean enable);
 
 GVariant *df_generate_random_basic(const GVariantType *type, guint64 iteration);
 GVariant *df_generate_random_from_signature(const char *signature, guint64 iteration);
+GVariant *df_generate_random_arguments(const char *signature, guint64 iteration, const GPtrArray *dictionaries);
+GVariant *df_generate_nested(df_nesting_shape_t shape, guint depth, guint64 iteration);
 
 size_t df_rand_array_size(guint64 iteration);
 
@@ -91,6 +113,8 @@ int df_rand_dbus_signature_string(gchar **buf, guint64 iteration);
 int df_rand_GVariant(GVariant **var, guint64 iteration);
 
 /**
- * @return Generated pseudo-random FD number from interval <-1, INT_MAX)
+ * @return Index of a pooled FD attached to the current call (see fdpool.c),
+ * or a pseudo-random FD number from interval <-1, INT_MAX) if the FD pool
+ * is not available
  */
 int df_rand_unixFD(guint64 iteration);
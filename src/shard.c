@@ -0,0 +1,152 @@
+/** @file shard.c */
+/*
+ * dfuzzer - tool for fuzz testing processes communicating through D-Bus.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <gio/gio.h>
+#include <string.h>
+
+#include "shard.h"
+#include "util.h"
+
+#define DF_SHARD_FNV_OFFSET 0xcbf29ce484222325ULL
+#define DF_SHARD_FNV_PRIME 0x100000001b3ULL
+
+/* 1-based, 0 if sharding is disabled */
+static guint df_shard_index;
+static guint df_shard_count;
+
+/**
+ * @function Parses a shard specification in the K/N format.
+ * @param spec Shard specification, e.g. "2/4"
+ * @param ret_index Shard number K, 1 to N
+ * @param ret_count Number of shards N, 1 to DF_SHARD_MAX
+ * @return 0 on success, -EINVAL if spec is invalid
+ */
+int df_shard_parse(const char *spec, guint *ret_index, guint *ret_count)
+{
+        g_autoptr(gchar) index_str = NULL;
+        const char *slash;
+        guint64 index, count;
+
+        g_assert(spec);
+        g_assert(ret_index);
+        g_assert(ret_count);
+
+        slash = strchr(spec, '/');
+        if (!slash)
+                return -EINVAL;
+
+        index_str = g_strndup(spec, slash - spec);
+        if (safe_strtoull(index_str, &index) < 0 || safe_strtoull(slash + 1, &count) < 0)
+                return -EINVAL;
+        if (count < 1 || count > DF_SHARD_MAX || index < 1 || index > count)
+                return -EINVAL;
+
+        *ret_index = (guint) index;
+        *ret_count = (guint) count;
+
+        return 0;
+}
+
+void df_shard_set(guint index, guint count)
+{
+        g_assert(count >= 1 && count <= DF_SHARD_MAX);
+        g_assert(index >= 1 && index <= count);
+
+        df_shard_index = index;
+        df_shard_count = count;
+}
+
+gboolean df_shard_is_enabled(void)
+{
+        return df_shard_count > 0;
+}
+
+/**
+ * @function Formats the current shard as K/N.
+ * @return Newly allocated string, or NULL if sharding is disabled
+ */
+char *df_shard_to_string(void)
+{
+        if (!df_shard_is_enabled())
+                return NULL;
+
+        return g_strdup_printf("%u/%u", df_shard_index, df_shard_count);
+}
+
+static guint64 df_shard_hash_update(guint64 hash, const char *s)
+{
+        /* Including the terminating NUL, so ("ab", "c") and ("a", "bc") differ */
+        do
+                hash = (hash ^ (guchar) *s) * DF_SHARD_FNV_PRIME;
+        while (*s++);
+
+        return hash;
+}
+
+/**
+ * @function Stable (FNV-1a) hash of a member, the same on every host.
+ */
+guint64 df_shard_hash(const char *object, const char *interface, const char *member)
+{
+        guint64 hash = DF_SHARD_FNV_OFFSET;
+
+        g_assert(object);
+        g_assert(interface);
+        g_assert(member);
+
+        hash = df_shard_hash_update(hash, object);
+        hash = df_shard_hash_update(hash, interface);
+        hash = df_shard_hash_update(hash, member);
+
+        return hash;
+}
+
+/**
+ * @function Checks if a member belongs to the current shard.
+ * @return TRUE if the member should be tested by this process, which is
+ * always the case if sharding is disabled
+ */
+gboolean df_shard_owns(const char *object, const char *interface, const char *member)
+{
+        if (!df_shard_is_enabled())
+                return TRUE;
+
+        return df_shard_hash(object, interface, member) % df_shard_count == df_shard_index - 1;
+}
+
+/**
+ * @function Derives the seed of the current shard, so the shards don't
+ * generate the same sequences of inputs.
+ * @param seed Seed of the whole run
+ * @return Seed for this shard, seed itself if sharding is disabled
+ */
+unsigned int df_shard_seed(unsigned int seed)
+{
+        guint64 hash;
+
+        if (!df_shard_is_enabled())
+                return seed;
+
+        hash = DF_SHARD_FNV_OFFSET;
+        for (size_t i = 0; i < sizeof(seed); i++)
+                hash = (hash ^ ((seed >> (i * 8)) & 0xff)) * DF_SHARD_FNV_PRIME;
+        for (size_t i = 0; i < sizeof(df_shard_index); i++)
+                hash = (hash ^ ((df_shard_index >> (i * 8)) & 0xff)) * DF_SHARD_FNV_PRIME;
+
+        return (unsigned int) (hash ^ (hash >> 32));
+}
@@ -0,0 +1,22 @@
+/** @file shard.h */
+#pragma once
+
+#include <gio/gio.h>
+
+/* Sharding (--shard=K/N): each of the N shards tests only the members
+ * (methods and properties) whose (object, interface, member) triple hashes
+ * to K, so N independent dfuzzer processes cover the tested bus name without
+ * overlap. The hash doesn't depend on the host, the build or the order in
+ * which the members are introspected. K is 1-based. */
+
+/** Maximum number of shards */
+#define DF_SHARD_MAX 65536
+
+int df_shard_parse(const char *spec, guint *ret_index, guint *ret_count);
+void df_shard_set(guint index, guint count);
+gboolean df_shard_is_enabled(void);
+char *df_shard_to_string(void);
+
+guint64 df_shard_hash(const char *object, const char *interface, const char *member);
+gboolean df_shard_owns(const char *object, const char *interface, const char *member);
+unsigned int df_shard_seed(unsigned int seed);
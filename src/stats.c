@@ -0,0 +1,293 @@
+/** @file stats.c */
+/*
+ * dfuzzer - tool for fuzz testing processes communicating through D-Bus.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <gio/gio.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "log.h"
+#include "stats.h"
+#include "util.h"
+
+/** Maximum width of the method column in the summary */
+#define DF_STATS_NAME_WIDTH_MAX 64
+
+/** Methods by "interface.method" */
+static GHashTable *df_stats_methods;
+/** Number of D-Bus errors (guint64 *) by their name */
+static GHashTable *df_stats_errors;
+/** When the first method was looked up, for the overall throughput */
+static gint64 df_stats_start;
+
+G_STATIC_ASSERT(DF_STATS_MAX_BITS < 64);
+
+/**
+ * @function Maps a value to its histogram bucket.
+ */
+guint df_stats_bucket_index(guint64 value)
+{
+        guint bits;
+
+        if (value < DF_STATS_SUB_BUCKETS)
+                return value;
+        if (value >= G_GUINT64_CONSTANT(1) << DF_STATS_MAX_BITS)
+                value = (G_GUINT64_CONSTANT(1) << DF_STATS_MAX_BITS) - 1;
+
+        /* Position of the highest set bit (>= DF_STATS_SUB_BUCKET_BITS) */
+        bits = 63 - __builtin_clzll(value);
+
+        return (bits - DF_STATS_SUB_BUCKET_BITS + 1) * DF_STATS_SUB_BUCKETS +
+               ((value >> (bits - DF_STATS_SUB_BUCKET_BITS)) & (DF_STATS_SUB_BUCKETS - 1));
+}
+
+/**
+ * @function Returns the highest value which maps to the given bucket.
+ */
+guint64 df_stats_bucket_value(guint index)
+{
+        guint bits, sub;
+
+        g_assert(index < DF_STATS_BUCKETS);
+
+        if (index < DF_STATS_SUB_BUCKETS)
+                return index;
+
+        bits = index / DF_STATS_SUB_BUCKETS + DF_STATS_SUB_BUCKET_BITS - 1;
+        sub = index % DF_STATS_SUB_BUCKETS;
+
+        return ((guint64) (DF_STATS_SUB_BUCKETS + sub + 1) << (bits - DF_STATS_SUB_BUCKET_BITS)) - 1;
+}
+
+static void df_stats_method_free(df_stats_method_t *m)
+{
+        if (!m)
+                return;
+
+        g_free(m->name);
+        g_free(m);
+}
+
+/**
+ * @function Returns statistics of a method, creating them if needed. Look
+ * the method up once and record all its calls into the returned structure.
+ * @return Statistics of the method, owned by the stats module
+ */
+df_stats_method_t *df_stats_get_method(const char *interface, const char *method)
+{
+        g_autofree char *name = NULL;
+        df_stats_method_t *m;
+
+        g_assert(interface);
+        g_assert(method);
+
+        if (!df_stats_methods) {
+                df_stats_methods = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+                                                         (GDestroyNotify) df_stats_method_free);
+                df_stats_errors = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+                df_stats_start = g_get_monotonic_time();
+        }
+
+        name = g_strjoin(".", interface, method, NULL);
+        m = g_hash_table_lookup(df_stats_methods, name);
+        if (m)
+                return m;
+
+        m = g_new0(df_stats_method_t, 1);
+        m->name = g_steal_pointer(&name);
+        g_hash_table_insert(df_stats_methods, m->name, m);
+
+        return m;
+}
+
+/**
+ * @function Returns the value below which the given percentage of the
+ * recorded calls fall (with the histogram's precision).
+ * @param percentile Percentile (0-100)
+ * @return The value in usec, 0 if there are no calls
+ */
+guint64 df_stats_method_percentile(const df_stats_method_t *m, double percentile)
+{
+        guint64 count = 0, target;
+
+        g_assert(m);
+
+        if (m->calls == 0)
+                return 0;
+
+        target = (guint64) (CLAMP(percentile, 0.0, 100.0) / 100.0 * m->calls + 0.5);
+        target = CLAMP(target, 1, m->calls);
+
+        for (guint i = 0; i < DF_STATS_BUCKETS; i++) {
+                count += m->histogram[i];
+                if (count >= target)
+                        /* Never report more than the actual maximum */
+                        return MIN(df_stats_bucket_value(i), m->max);
+        }
+
+        return m->max;
+}
+
+/**
+ * @function Counts a D-Bus error returned by a method.
+ * @param m Method returned by df_stats_get_method(), may be NULL
+ * @param error_name Name of the D-Bus error, NULL for local errors
+ * @param timeout The call timed out
+ */
+void df_stats_record_error(df_stats_method_t *m, const char *error_name, gboolean timeout)
+{
+        guint64 *count;
+
+        /* Calls outside of a method test aren't tracked */
+        if (!m)
+                return;
+
+        g_assert(df_stats_errors);
+
+        m->errors++;
+        if (timeout)
+                m->timeouts++;
+
+        error_name = error_name ?: "(local error)";
+        /* Most calls fail with the same few errors, so allocate only for the
+         * first occurrence of each one */
+        count = g_hash_table_lookup(df_stats_errors, error_name);
+        if (!count) {
+                count = g_new0(guint64, 1);
+                g_hash_table_insert(df_stats_errors, g_strdup(error_name), count);
+        }
+        (*count)++;
+}
+
+void df_stats_record_crash(df_stats_method_t *m)
+{
+        if (m)
+                m->crashes++;
+}
+
+static gint df_stats_compare_methods(gconstpointer a, gconstpointer b)
+{
+        const df_stats_method_t *x = *(df_stats_method_t * const *) a, *y = *(df_stats_method_t * const *) b;
+
+        /* The slowest (in total) first */
+        if (x->total != y->total)
+                return x->total < y->total ? 1 : -1;
+
+        return strcmp(x->name, y->name);
+}
+
+static gint df_stats_compare_errors(gconstpointer a, gconstpointer b, gpointer user_data)
+{
+        GHashTable *errors = user_data;
+        guint64 x = *(const guint64 *) g_hash_table_lookup(errors, *(const char * const *) a),
+                y = *(const guint64 *) g_hash_table_lookup(errors, *(const char * const *) b);
+
+        if (x != y)
+                return x < y ? 1 : -1;
+
+        return strcmp(*(const char * const *) a, *(const char * const *) b);
+}
+
+/**
+ * @function Prints a table with per-method latencies (in usec), throughput
+ * and counters, followed by the number of D-Bus errors by name.
+ */
+void df_stats_print(FILE *output)
+{
+        g_autoptr(GPtrArray) methods = NULL;
+        g_autofree const char **errors = NULL;
+        guint64 calls = 0, elapsed;
+        guint n_errors = 0;
+        int width = strlen("Method");
+        GHashTableIter iter;
+        gpointer value;
+
+        g_assert(output);
+
+        if (!df_stats_methods || g_hash_table_size(df_stats_methods) == 0)
+                return;
+
+        methods = g_ptr_array_new();
+        g_hash_table_iter_init(&iter, df_stats_methods);
+        while (g_hash_table_iter_next(&iter, NULL, &value)) {
+                df_stats_method_t *m = value;
+
+                g_ptr_array_add(methods, m);
+                calls += m->calls;
+                width = MAX(width, (int) MIN(strlen(m->name), DF_STATS_NAME_WIDTH_MAX));
+        }
+        g_ptr_array_sort(methods, df_stats_compare_methods);
+
+        fprintf(output, "%-*s %10s %8s %8s %7s %10s %8s %8s %8s %8s %10s\n", width, "Method",
+                "Calls", "Errors", "Timeouts", "Crashes", "Calls/s", "Min", "p50", "p90", "p99", "Max");
+        for (guint i = 0; i < methods->len; i++) {
+                const df_stats_method_t *m = methods->pdata[i];
+
+                fprintf(output, "%-*.*s %10"G_GUINT64_FORMAT" %8"G_GUINT64_FORMAT" %8"G_GUINT64_FORMAT
+                        " %7"G_GUINT64_FORMAT" %10.1f %8"G_GUINT64_FORMAT" %8"G_GUINT64_FORMAT" %8"G_GUINT64_FORMAT
+                        " %8"G_GUINT64_FORMAT" %10"G_GUINT64_FORMAT"\n",
+                        width, width, m->name, m->calls, m->errors, m->timeouts, m->crashes,
+                        m->total > 0 ? m->calls * (double) G_USEC_PER_SEC / m->total : 0.0,
+                        m->min, df_stats_method_percentile(m, 50), df_stats_method_percentile(m, 90),
+                        df_stats_method_percentile(m, 99), m->max);
+        }
+
+        elapsed = MAX(g_get_monotonic_time() - df_stats_start, 1);
+        fprintf(output, "Latencies in usec. Total: %"G_GUINT64_FORMAT" calls in %.1f s (%.1f calls/s)\n",
+                calls, (double) elapsed / G_USEC_PER_SEC, calls * (double) G_USEC_PER_SEC / elapsed);
+
+        errors = (const char **) g_hash_table_get_keys_as_array(df_stats_errors, &n_errors);
+        if (n_errors == 0)
+                return;
+
+        g_qsort_with_data(errors, n_errors, sizeof(*errors), df_stats_compare_errors, df_stats_errors);
+        fprintf(output, "\n%10s  %s\n", "Count", "D-Bus error");
+        for (guint i = 0; i < n_errors; i++)
+                fprintf(output, "%10"G_GUINT64_FORMAT"  %s\n",
+                        *(const guint64 *) g_hash_table_lookup(df_stats_errors, errors[i]), errors[i]);
+}
+
+/**
+ * @function Writes the summary printed by df_stats_print() into a file.
+ * @return 0 on success, -1 on error
+ */
+int df_stats_write_file(const char *file_name)
+{
+        g_autoptr(FILE) f = NULL;
+
+        g_assert(file_name);
+
+        f = fopen(file_name, "we");
+        if (!f)
+                return df_fail_ret(-1, "Failed to open file %s: %m\n", file_name);
+
+        df_stats_print(f);
+
+        if (fflush(f) != 0 || ferror(f))
+                return df_fail_ret(-1, "Failed to write file %s: %m\n", file_name);
+
+        return 0;
+}
+
+/**
+ * @function Drops all recorded statistics.
+ */
+void df_stats_reset(void)
+{
+        g_clear_pointer(&df_stats_methods, g_hash_table_unref);
+        g_clear_pointer(&df_stats_errors, g_hash_table_unref);
+}
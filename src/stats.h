@@ -0,0 +1,59 @@
+/** @file stats.h */
+#pragma once
+
+#include <gio/gio.h>
+#include <stdio.h>
+
+/* Latencies are kept in log-bucketed histograms (like HdrHistogram): values
+ * below DF_STATS_SUB_BUCKETS are exact, larger values are bucketed by their
+ * highest set bit and the next DF_STATS_SUB_BUCKET_BITS bits, so the relative
+ * error is at most 1/DF_STATS_SUB_BUCKETS (~6 %) */
+#define DF_STATS_SUB_BUCKET_BITS 4
+#define DF_STATS_SUB_BUCKETS (1 << DF_STATS_SUB_BUCKET_BITS)
+/** Highest tracked value is 2^DF_STATS_MAX_BITS - 1 usec (~19 hours), larger
+  * values are clamped */
+#define DF_STATS_MAX_BITS 36
+#define DF_STATS_BUCKETS ((DF_STATS_MAX_BITS - DF_STATS_SUB_BUCKET_BITS + 1) * DF_STATS_SUB_BUCKETS)
+/** File name suffix of the statistics written into the log directory */
+#define DF_STATS_SUFFIX ".stats"
+
+typedef struct df_stats_method {
+        char *name;
+        guint64 calls;
+        /* D-Bus errors (including timeouts) returned by the method */
+        guint64 errors;
+        guint64 timeouts;
+        guint64 crashes;
+        /* All in usec */
+        guint64 total;
+        guint64 min;
+        guint64 max;
+        guint64 histogram[DF_STATS_BUCKETS];
+} df_stats_method_t;
+
+guint df_stats_bucket_index(guint64 value);
+guint64 df_stats_bucket_value(guint index);
+
+df_stats_method_t *df_stats_get_method(const char *interface, const char *method);
+guint64 df_stats_method_percentile(const df_stats_method_t *m, double percentile);
+
+/**
+ * @function Records the round-trip time of a single call.
+ * @param m Method returned by df_stats_get_method()
+ * @param usec Round-trip time in usec
+ */
+static inline void df_stats_record_call(df_stats_method_t *m, guint64 usec)
+{
+        m->calls++;
+        m->total += usec;
+        m->min = m->calls == 1 ? usec : MIN(m->min, usec);
+        m->max = MAX(m->max, usec);
+        m->histogram[df_stats_bucket_index(usec)]++;
+}
+
+void df_stats_record_error(df_stats_method_t *m, const char *error_name, gboolean timeout);
+void df_stats_record_crash(df_stats_method_t *m);
+
+void df_stats_print(FILE *output);
+int df_stats_write_file(const char *file_name);
+void df_stats_reset(void);
@@ -0,0 +1,186 @@
+/** @file trace.c */
+/*
+ * dfuzzer - tool for fuzz testing processes communicating through D-Bus.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <gio/gio.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "json.h"
+#include "log.h"
+#include "trace.h"
+#include "util.h"
+
+/* Protects everything below, spans may be emitted from any thread */
+static GMutex df_trace_mutex;
+static GString *df_trace_buffer;
+static fd_t df_trace_fd = -1;
+static gboolean df_trace_first;
+static int df_trace_error;
+
+static __thread pid_t df_trace_tid;
+
+static pid_t df_trace_gettid(void)
+{
+        if (df_trace_tid == 0)
+                df_trace_tid = (pid_t) syscall(SYS_gettid);
+
+        return df_trace_tid;
+}
+
+static int df_trace_write_all(fd_t fd, const char *buf, gsize size)
+{
+        while (size > 0) {
+                ssize_t n;
+
+                n = write(fd, buf, size);
+                if (n < 0) {
+                        if (errno == EINTR)
+                                continue;
+
+                        return -errno;
+                }
+
+                buf += n;
+                size -= n;
+        }
+
+        return 0;
+}
+
+/* Must be called with the mutex held */
+static void df_trace_flush(void)
+{
+        if (df_trace_error == 0 && df_trace_buffer->len > 0)
+                df_trace_error = df_trace_write_all(df_trace_fd, df_trace_buffer->str, df_trace_buffer->len);
+        g_string_truncate(df_trace_buffer, 0);
+}
+
+/* Must be called with the mutex held */
+static void df_trace_begin_event(const char *phase, const char *name)
+{
+        g_string_append(df_trace_buffer, df_trace_first ? "{" : ",\n{");
+        df_trace_first = FALSE;
+
+        g_string_append_printf(df_trace_buffer, "\"ph\":\"%s\",\"pid\":%d,\"tid\":%d,\"name\":",
+                               phase, getpid(), df_trace_gettid());
+        df_json_append_escaped(df_trace_buffer, name);
+}
+
+/**
+ * @function Opens the trace file (which is truncated) and starts the
+ * timeline.
+ * @return 0 on success, -1 on error
+ */
+int df_trace_open(const char *file_name)
+{
+        g_assert(file_name);
+        g_assert(!df_trace_buffer);
+
+        df_trace_fd = open(file_name, O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, 0644);
+        if (df_trace_fd < 0)
+                return df_fail_ret(-1, "Failed to open file %s: %m\n", file_name);
+
+        g_mutex_lock(&df_trace_mutex);
+        df_trace_buffer = g_string_sized_new(DF_TRACE_BUFFER_SIZE + 1024);
+        df_trace_error = 0;
+        df_trace_first = TRUE;
+
+        g_string_append(df_trace_buffer, "[\n");
+        /* Name the thread which opened the trace, i.e. the fuzzing one */
+        df_trace_begin_event("M", "thread_name");
+        g_string_append(df_trace_buffer, ",\"args\":{\"name\":\"dfuzzer\"}}");
+        g_mutex_unlock(&df_trace_mutex);
+
+        return 0;
+}
+
+/**
+ * @function Writes all buffered events, terminates the timeline and closes
+ * the trace file. Does nothing if the trace is not open.
+ * @return 0 on success, -1 if any of the writes failed
+ */
+int df_trace_close(void)
+{
+        int r = 0;
+
+        g_mutex_lock(&df_trace_mutex);
+        if (!df_trace_buffer) {
+                g_mutex_unlock(&df_trace_mutex);
+                return 0;
+        }
+
+        g_string_append(df_trace_buffer, "\n]\n");
+        df_trace_flush();
+        g_string_free(g_steal_pointer(&df_trace_buffer), TRUE);
+
+        if (df_trace_error < 0)
+                r = df_fail_ret(-1, "Failed to write the trace: %s\n", strerror(-df_trace_error));
+        if (close(df_trace_fd) < 0 && r == 0)
+                r = df_fail_ret(-1, "Failed to close the trace: %m\n");
+        df_trace_fd = -1;
+        g_mutex_unlock(&df_trace_mutex);
+
+        return r;
+}
+
+gboolean df_trace_is_enabled(void)
+{
+        return !!df_trace_buffer;
+}
+
+/**
+ * @function Adds a span to the timeline.
+ * @param category Category of the span (e.g. "call")
+ * @param name Name of the span (e.g. the method name)
+ * @param start Start of the span, from g_get_monotonic_time()
+ * @param end End of the span, from g_get_monotonic_time()
+ * @param detail Optional string shown in the span's arguments, may be NULL
+ */
+void df_trace_span(const char *category, const char *name, gint64 start, gint64 end, const char *detail)
+{
+        g_assert(category);
+        g_assert(name);
+
+        if (!df_trace_buffer)
+                return;
+
+        g_mutex_lock(&df_trace_mutex);
+        /* Closed in the meantime by another thread */
+        if (!df_trace_buffer) {
+                g_mutex_unlock(&df_trace_mutex);
+                return;
+        }
+
+        df_trace_begin_event("X", name);
+        g_string_append(df_trace_buffer, ",\"cat\":");
+        df_json_append_escaped(df_trace_buffer, category);
+        g_string_append_printf(df_trace_buffer, ",\"ts\":%"G_GINT64_FORMAT",\"dur\":%"G_GINT64_FORMAT,
+                               start, MAX(end - start, 0));
+        if (detail) {
+                g_string_append(df_trace_buffer, ",\"args\":{\"detail\":");
+                df_json_append_escaped(df_trace_buffer, detail);
+                g_string_append_c(df_trace_buffer, '}');
+        }
+        g_string_append_c(df_trace_buffer, '}');
+
+        if (df_trace_buffer->len >= DF_TRACE_BUFFER_SIZE)
+                df_trace_flush();
+        g_mutex_unlock(&df_trace_mutex);
+}
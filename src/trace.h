@@ -0,0 +1,19 @@
+/** @file trace.h */
+#pragma once
+
+#include <gio/gio.h>
+
+/* Timeline in the Chrome trace event format (JSON array format), which can
+ * be loaded into chrome://tracing or Perfetto. Each span is a complete ("X")
+ * event with the start and duration in usec (of the monotonic clock), and
+ * the pid and tid of the emitting thread. The array format doesn't need the
+ * closing bracket, so the timeline of a killed run is still readable. */
+
+/** Events are buffered and written out in chunks of (roughly) this size */
+#define DF_TRACE_BUFFER_SIZE (64 * 1024)
+
+int df_trace_open(const char *file_name);
+int df_trace_close(void);
+gboolean df_trace_is_enabled(void);
+
+void df_trace_span(const char *category, const char *name, gint64 start, gint64 end, const char *detail);
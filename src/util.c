@@ -73,6 +73,10 @@ int df_execute_external_command(const char *command, gboolean show_output)
 
         g_assert(command);
 
+        /* Don't let the child inherit (and possibly write out) buffered output,
+         * and keep the order of messages if it writes to the console itself */
+        df_log_flush();
+
         pid = fork();
 
         if (pid < 0)
@@ -108,10 +108,18 @@ char *strjoin_real(const char *x, ...) __attribute__((__sentinel__));
 #define ANSI_NORMAL     "\x1B[0m"
 #define ANSI_BOLD       "\x1B[1m"
 
-#define ANSI_CR         "\r"
+/* Carriage return and erase the line, so nothing is left over from
+ * a longer line (e.g. the progress line) */
+#define ANSI_CR         "\r\x1B[K"
 
 static inline int df_isatty(void) {
-        return isatty(STDOUT_FILENO) && isatty(STDERR_FILENO);
+        /* Called for each colored message, so check only once */
+        static int cached = -1;
+
+        if (cached < 0)
+                cached = isatty(STDOUT_FILENO) && isatty(STDERR_FILENO);
+
+        return cached;
 }
 
 #define DEFINE_ANSI_FUNC(name, NAME)                       \
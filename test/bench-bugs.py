@@ -0,0 +1,143 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-3.0-or-later
+"""Time-to-bug benchmark of dfuzzer against the planted bugs of dfuzzer-test-server.
+
+Starts a private dbus-daemon with dfuzzer-test-server --planted-bugs on it
+and fuzzes each planted bug (see DF_BUGS_OBJECT in dfuzzer-test-server.c)
+with --seeds different seeds, at most --max-iterations iterations per method.
+For each bug it reports how many seeds found it and the median number of
+calls and seconds (of the fuzzed methods, i.e. without the restart delays)
+until it was found. The results are printed as JSON (or written into
+--output).
+
+Track the numbers before and after a change of the generators: more bugs
+found in fewer calls means a better fuzzer. df_bug_magic_string is expected
+to be found only with --dictionary pointing to a file which contains the
+magic string.
+"""
+
+import argparse
+import json
+import statistics
+import subprocess
+import sys
+
+from benchlib import BUS_NAME, PrivateBus, which
+
+OBJECT = "/org/freedesktop/dfuzzerBugs"
+INTERFACE = "org.freedesktop.dfuzzerBugs"
+
+# name, interface, method (None for all methods of the interface)
+BUGS = [
+    ("boundary_int", INTERFACE, "df_bug_boundary_int"),
+    ("string_prefix", INTERFACE, "df_bug_string_prefix"),
+    ("array_length", INTERFACE, "df_bug_array_length"),
+    ("fd_type", INTERFACE, "df_bug_fd_type"),
+    ("magic_int", INTERFACE, "df_bug_magic_int"),
+    ("sequence", f"{INTERFACE}.Sequence", None),
+    ("deep_struct", INTERFACE, "df_bug_deep_struct"),
+    ("magic_string", INTERFACE, "df_bug_magic_string"),
+]
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--dfuzzer", default="dfuzzer", help="dfuzzer binary")
+    parser.add_argument("--test-server", default="dfuzzer-test-server", help="dfuzzer-test-server binary")
+    parser.add_argument("--dbus-daemon", default="dbus-daemon", help="dbus-daemon binary")
+    parser.add_argument("--seeds", type=int, default=5, help="number of seeds, starting at --first-seed (default: 5)")
+    parser.add_argument("--first-seed", type=int, default=1, help="first seed (default: 1)")
+    parser.add_argument("--max-iterations", type=int, default=20000,
+                        help="iterations of each method before giving up (default: 20000)")
+    parser.add_argument("--bug", action="append", default=[],
+                        help="run only this bug (can be used multiple times), one of: "
+                             + ", ".join(b[0] for b in BUGS))
+    parser.add_argument("--dictionary", help="pass this dictionary to dfuzzer (-f)")
+    parser.add_argument("--output", help="write the results into this file instead of stdout")
+    args = parser.parse_args()
+
+    unknown = set(args.bug) - {b[0] for b in BUGS}
+    if unknown:
+        parser.error(f"unknown bug: {', '.join(sorted(unknown))}")
+
+    return args
+
+
+def read_events(path):
+    # JSON text sequences (RFC 7464), each event starts with RS
+    with open(path) as f:
+        return [json.loads(e) for e in f.read().split("\x1e") if e.strip()]
+
+
+def run_bug(bus, args, interface, method, seed):
+    events = f"{bus.dir}/events.json"
+    cmd = [args.dfuzzer, "-n", BUS_NAME, "-o", OBJECT, "-i", interface,
+           f"-I{args.max_iterations}", f"--seed={seed}", f"--json={events}"]
+    if method:
+        cmd += ["-t", method]
+    if args.dictionary:
+        cmd += ["-f", args.dictionary]
+
+    result = subprocess.run(cmd, env=bus.env, cwd=bus.dir, capture_output=True, text=True)
+    # A found bug is a failure (2), errors (1) and nothing tested (4) are unexpected
+    if result.returncode not in (0, 2, 3):
+        sys.stderr.write(result.stdout + result.stderr)
+        sys.exit(f"dfuzzer failed with {result.returncode}")
+
+    # Count the calls and time of the tested methods up to the first crash
+    calls, usec = 0, 0
+    for e in read_events(events):
+        if e["event"] != "test_end":
+            continue
+        calls += e["calls"]
+        usec += e["duration_usec"]
+        if e["result"] == "FAIL":
+            return {"seed": seed, "found": True, "calls": calls, "seconds": usec / 1e6}
+
+    return {"seed": seed, "found": False, "calls": calls, "seconds": usec / 1e6}
+
+
+def summarize(name, runs):
+    found = [r for r in runs if r["found"]]
+    return {
+        "name": name,
+        "found": len(found),
+        "seeds": len(runs),
+        "median_calls": statistics.median(r["calls"] for r in found) if found else None,
+        "median_seconds": statistics.median(r["seconds"] for r in found) if found else None,
+        "runs": runs,
+    }
+
+
+def main():
+    args = parse_args()
+    args.dfuzzer = which(args.dfuzzer)
+    bus = PrivateBus(which(args.dbus_daemon), [which(args.test_server), "--planted-bugs"])
+
+    try:
+        bus.wait_for_server(args.dfuzzer)
+        results = {"first_seed": args.first_seed, "seeds": args.seeds,
+                   "max_iterations": args.max_iterations, "dictionary": args.dictionary, "bugs": []}
+        for name, interface, method in BUGS:
+            if args.bug and name not in args.bug:
+                continue
+
+            runs = [run_bug(bus, args, interface, method, seed)
+                    for seed in range(args.first_seed, args.first_seed + args.seeds)]
+            results["bugs"].append(summarize(name, runs))
+            summary = results["bugs"][-1]
+            print(f"{name}: found {summary['found']}/{summary['seeds']}, "
+                  f"median {summary['median_calls']} calls, {summary['median_seconds']} s", file=sys.stderr)
+    finally:
+        bus.close()
+
+    output = json.dumps(results, indent=2) + "\n"
+    if args.output:
+        with open(args.output, "w") as f:
+            f.write(output)
+    else:
+        sys.stdout.write(output)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,141 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-3.0-or-later
+"""End-to-end throughput benchmark of dfuzzer against dfuzzer-test-server.
+
+Starts a private dbus-daemon (no system services or root needed) with
+dfuzzer-test-server on it and runs dfuzzer with a fixed seed and number of
+iterations:
+
+  call       one method (df_complex_sig_1), i.e. the call path and the
+             liveness checks; reports calls/s and the p50/p99 latency
+  traversal  the whole bus name with all its objects and interfaces; reports
+             the time to complete it
+
+Methods which hang or crash the server are suppressed and properties are
+skipped in the traversal, since the fixed timeouts and restart delays would
+dominate the results. Each scenario is run --runs times and the median is
+reported. The results are printed as JSON (or written into --output).
+
+The server can be made slow, leaky or crashy with --server-arg, e.g.
+--server-arg=--latency=5 to measure how dfuzzer copes with a slow service,
+or --server-arg=--tree-objects=10000 to benchmark the traversal of a large
+object tree.
+"""
+
+import argparse
+import json
+import re
+import statistics
+import subprocess
+import sys
+import time
+
+from benchlib import BUS_NAME, PrivateBus, which
+
+OBJECT = "/org/freedesktop/dfuzzerObject"
+INTERFACE = "org.freedesktop.dfuzzerInterface"
+METHOD = "df_complex_sig_1"
+
+SUPPRESSIONS = """[{name}]
+df_crash benchmark: crashes
+df_variant_crash benchmark: crashes
+df_hang benchmark: times out
+df_noreply benchmark: times out
+df_noreply_expected benchmark: times out
+df_crash_intermittent benchmark: crashes
+"""
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--dfuzzer", default="dfuzzer", help="dfuzzer binary")
+    parser.add_argument("--test-server", default="dfuzzer-test-server", help="dfuzzer-test-server binary")
+    parser.add_argument("--dbus-daemon", default="dbus-daemon", help="dbus-daemon binary")
+    parser.add_argument("--server-arg", action="append", default=[],
+                        help="pass an option to dfuzzer-test-server (can be used multiple times)")
+    parser.add_argument("--runs", type=int, default=3, help="runs of each scenario (default: 3)")
+    parser.add_argument("--iterations", type=int, default=5000,
+                        help="iterations of the method in the call scenario (default: 5000)")
+    parser.add_argument("--traversal-iterations", type=int, default=100,
+                        help="iterations of each method in the traversal scenario (default: 100)")
+    parser.add_argument("--seed", type=int, default=1, help="seed passed to dfuzzer (default: 1)")
+    parser.add_argument("--output", help="write the results into this file instead of stdout")
+    return parser.parse_args()
+
+
+def run_dfuzzer(bus, dfuzzer, args):
+    metrics = f"{bus.dir}/metrics.prom"
+    start = time.monotonic()
+    result = subprocess.run([dfuzzer, f"--metrics-file={metrics}"] + args,
+                            env=bus.env, cwd=bus.dir, capture_output=True, text=True)
+    elapsed = time.monotonic() - start
+    # Failures (2) and warnings (3) are expected, errors (1) and nothing tested (4) aren't
+    if result.returncode not in (0, 2, 3):
+        sys.stderr.write(result.stdout + result.stderr)
+        sys.exit(f"dfuzzer failed with {result.returncode}")
+
+    with open(metrics) as f:
+        samples = dict(line.rsplit(" ", 1) for line in f.read().splitlines() if not line.startswith("#"))
+
+    return result.stdout, samples, elapsed
+
+
+def bench_call(bus, args):
+    stdout, samples, _ = run_dfuzzer(bus, args.dfuzzer,
+                                     ["-n", BUS_NAME, "-o", OBJECT, "-i", INTERFACE, "-t", METHOD,
+                                      f"-I{args.iterations}", f"--seed={args.seed}"])
+    # The per-method statistics, e.g.:
+    #   Latencies in usec. Total: 5000 calls in 1.2 s (4166.7 calls/s)
+    m = re.search(r"Total: (\d+) calls in [\d.]+ s \(([\d.]+) calls/s\)", stdout)
+    if not m:
+        sys.exit("Failed to find the call statistics in the output of dfuzzer")
+
+    return {
+        "calls": int(m.group(1)),
+        "calls_per_sec": float(m.group(2)),
+        "p50_usec": float(samples['dfuzzer_call_duration_seconds{quantile="0.5"}']) * 1e6,
+        "p99_usec": float(samples['dfuzzer_call_duration_seconds{quantile="0.99"}']) * 1e6,
+    }
+
+
+def bench_traversal(bus, args):
+    _, samples, elapsed = run_dfuzzer(bus, args.dfuzzer,
+                                      ["-n", BUS_NAME, "--skip-properties",
+                                       f"-I{args.traversal_iterations}", f"--seed={args.seed}"])
+
+    return {
+        "calls": int(samples["dfuzzer_calls_total"]),
+        "seconds": elapsed,
+    }
+
+
+def median_of(runs):
+    return {key: statistics.median(run[key] for run in runs) for key in runs[0]}
+
+
+def main():
+    args = parse_args()
+    dfuzzer = which(args.dfuzzer)
+    bus = PrivateBus(which(args.dbus_daemon), [which(args.test_server)] + args.server_arg,
+                     SUPPRESSIONS.format(name=BUS_NAME))
+
+    try:
+        bus.wait_for_server(dfuzzer)
+        results = {"seed": args.seed, "runs": args.runs, "server_args": args.server_arg, "benchmarks": []}
+        for name, bench in (("call", bench_call), ("traversal", bench_traversal)):
+            runs = [bench(bus, args) for _ in range(args.runs)]
+            results["benchmarks"].append(dict(name=name, **median_of(runs)))
+            print(f"{name}: {results['benchmarks'][-1]}", file=sys.stderr)
+    finally:
+        bus.close()
+
+    output = json.dumps(results, indent=2) + "\n"
+    if args.output:
+        with open(args.output, "w") as f:
+            f.write(output)
+    else:
+        sys.stdout.write(output)
+
+
+if __name__ == "__main__":
+    main()
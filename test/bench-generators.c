@@ -0,0 +1,244 @@
+#include <getopt.h>
+#include <gio/gio.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "fdpool.h"
+#include "json.h"
+#include "log.h"
+#include "rand.h"
+#include "suppression.h"
+#include "util.h"
+
+/* Throughput of the input generators (and other per-call work), reported as
+ * a JSON object, e.g.:
+ *
+ *   {"seed":1,"duration_ms":500,"benchmarks":[
+ *     {"name":"signature/df_complex_sig_1","iterations":123,"seconds":0.5,
+ *      "values_per_sec":246.0,"mb_per_sec":1.2},
+ *     ...]}
+ *
+ * Run with `meson test --benchmark` or directly with --duration=MSEC,
+ * --filter=STR (run only benchmarks whose name contains STR), --output=FILE
+ * and --seed=SEED. Progress goes to stderr. */
+
+/** Iterations passed to the generators cycle through [0, this) */
+#define BENCH_ITERATION_CYCLE 128
+/** Number of suppressions for the tested bus */
+#define BENCH_SUPPRESSIONS 256
+
+typedef struct bench {
+        const char *name;
+        /* Generates one value, returns its size in bytes (0 if it has none) */
+        gsize (*func)(guint64 iteration, gconstpointer data);
+        gconstpointer data;
+} bench_t;
+
+static GList *bench_suppressions;
+
+static gsize bench_signature(guint64 iteration, gconstpointer data)
+{
+        g_autoptr(GVariant) value = NULL;
+
+        /* Same as in the fuzz loop, for the 'h' arguments */
+        df_fd_pool_begin_call();
+        value = df_generate_random_from_signature(data, iteration);
+        g_assert_nonnull(value);
+        g_variant_ref_sink(value);
+
+        return g_variant_get_size(value);
+}
+
+static gsize bench_string(guint64 iteration, gconstpointer data)
+{
+        g_autoptr(gchar) str = NULL;
+
+        g_assert_cmpint(df_rand_string(&str, iteration), ==, 0);
+
+        return strlen(str);
+}
+
+static gsize bench_objpath(guint64 iteration, gconstpointer data)
+{
+        g_autoptr(gchar) str = NULL;
+
+        g_assert_cmpint(df_rand_dbus_objpath_string(&str, iteration), ==, 0);
+
+        return strlen(str);
+}
+
+static gsize bench_variant(guint64 iteration, gconstpointer data)
+{
+        g_autoptr(GVariant) value = NULL;
+
+        g_assert_cmpint(df_rand_GVariant(&value, iteration), ==, 0);
+        g_variant_ref_sink(value);
+
+        return g_variant_get_size(value);
+}
+
+static gsize bench_suppression(guint64 iteration, gconstpointer data)
+{
+        g_autoptr(gchar) method = NULL;
+        char *description;
+
+        /* Hits spread over the whole list and misses (the common case) */
+        method = g_strdup_printf("Method%"G_GUINT64_FORMAT, iteration * 3 % (BENCH_SUPPRESSIONS * 2));
+        (void) df_suppression_check(bench_suppressions, "/org/bench", "org.bench.Interface", method, &description);
+
+        return 0;
+}
+
+static int bench_load_suppressions(void)
+{
+        g_autoptr(GString) contents = NULL;
+        g_autoptr(GError) error = NULL;
+        g_autoptr(gchar) cwd = NULL, dir = NULL, path = NULL;
+        int r;
+
+        /* df_suppression_load() looks for ./dfuzzer.conf first */
+        dir = g_dir_make_tmp("dfuzzer-bench-XXXXXX", &error);
+        if (!dir)
+                return df_fail_ret(-1, "Failed to create a temporary directory: %s\n", error->message);
+
+        contents = g_string_new("[org.bench]\n");
+        for (guint i = 0; i < BENCH_SUPPRESSIONS; i++)
+                g_string_append_printf(contents, "/org/bench:org.bench.Interface:Method%u Suppression #%u\n", i, i);
+
+        path = g_build_filename(dir, "dfuzzer.conf", NULL);
+        if (!g_file_set_contents(path, contents->str, contents->len, &error))
+                return df_fail_ret(-1, "Failed to write %s: %s\n", path, error->message);
+
+        cwd = g_get_current_dir();
+        if (chdir(dir) < 0)
+                return df_fail_ret(-1, "Failed to change directory to %s: %m\n", dir);
+        r = df_suppression_load(&bench_suppressions, "org.bench");
+        if (chdir(cwd) < 0)
+                return df_fail_ret(-1, "Failed to change directory to %s: %m\n", cwd);
+
+        (void) g_unlink(path);
+        (void) g_rmdir(dir);
+
+        return r;
+}
+
+static void bench_run(const bench_t *b, gint64 duration, GString *out)
+{
+        guint64 iterations = 0, bytes = 0;
+        gint64 start, elapsed;
+        double seconds;
+
+        start = g_get_monotonic_time();
+        do {
+                /* Don't read the clock for every value */
+                for (guint i = 0; i < 16; i++, iterations++)
+                        bytes += b->func(iterations % BENCH_ITERATION_CYCLE, b->data);
+
+                elapsed = g_get_monotonic_time() - start;
+        } while (elapsed < duration);
+
+        seconds = elapsed / 1e6;
+        g_string_append(out, out->str[out->len - 1] == '[' ? "\n" : ",\n");
+        g_string_append(out, "{\"name\":");
+        df_json_append_escaped(out, b->name);
+        g_string_append_printf(out, ",\"iterations\":%"G_GUINT64_FORMAT",\"seconds\":%.3f,\"values_per_sec\":%.1f",
+                               iterations, seconds, iterations / seconds);
+        if (bytes > 0)
+                g_string_append_printf(out, ",\"mb_per_sec\":%.3f", bytes / seconds / (1024 * 1024));
+        g_string_append_c(out, '}');
+
+        fprintf(stderr, "%-40s %12.1f values/s\n", b->name, iterations / seconds);
+}
+
+int main(int argc, char *argv[])
+{
+        static const bench_t benchmarks[] = {
+                { "signature/y",                bench_signature,        "y"     },
+                { "signature/i",                bench_signature,        "i"     },
+                { "signature/d",                bench_signature,        "d"     },
+                { "signature/s",                bench_signature,        "s"     },
+                { "signature/o",                bench_signature,        "o"     },
+                { "signature/g",                bench_signature,        "g"     },
+                { "signature/v",                bench_signature,        "v"     },
+                /* Containers are generated as method arguments, i.e. wrapped in a tuple */
+                { "signature/(as)",             bench_signature,        "(as)"  },
+                { "signature/(a{sv})",          bench_signature,        "(a{sv})" },
+                /* Signatures of the methods exported by dfuzzer-test-server */
+                { "signature/df_complex_sig_1", bench_signature,        "(iuga{ss}a(uiyo))" },
+                { "signature/df_complex_sig_2", bench_signature,        "(isaaai(y(b(n(q(iua{ov})v)o))x(dh))a{t(bov)})" },
+                { "df_rand_string",             bench_string,           NULL    },
+                { "df_rand_dbus_objpath_string", bench_objpath,         NULL    },
+                { "df_rand_GVariant",           bench_variant,          NULL    },
+                { "df_suppression_check",       bench_suppression,      NULL    },
+        };
+        static const struct option options[] = {
+                { "duration",   required_argument,      NULL,   'd'     },
+                { "filter",     required_argument,      NULL,   'f'     },
+                { "output",     required_argument,      NULL,   'o'     },
+                { "seed",       required_argument,      NULL,   's'     },
+                { NULL,         0,                      NULL,   0       },
+        };
+        g_autoptr(GString) out = NULL;
+        g_autoptr(GError) error = NULL;
+        const char *output = NULL, *filter = NULL;
+        guint64 duration_ms = 500, seed = 1;
+        int c;
+
+        while ((c = getopt_long(argc, argv, "d:f:o:s:", options, NULL)) >= 0) {
+                switch (c) {
+                        case 'd':
+                                if (safe_strtoull(optarg, &duration_ms) < 0 || duration_ms == 0) {
+                                        fprintf(stderr, "Invalid duration: %s\n", optarg);
+                                        return EXIT_FAILURE;
+                                }
+                                break;
+                        case 'f':
+                                filter = optarg;
+                                break;
+                        case 'o':
+                                output = optarg;
+                                break;
+                        case 's':
+                                if (safe_strtoull(optarg, &seed) < 0) {
+                                        fprintf(stderr, "Invalid seed: %s\n", optarg);
+                                        return EXIT_FAILURE;
+                                }
+                                break;
+                        default:
+                                fprintf(stderr, "Usage: %s [--duration=MSEC] [--filter=STR] [--output=FILE] [--seed=SEED]\n",
+                                        argv[0]);
+                                return EXIT_FAILURE;
+                }
+        }
+
+        df_rand_init((unsigned int) seed);
+        if (bench_load_suppressions() < 0)
+                return EXIT_FAILURE;
+
+        out = g_string_new(NULL);
+        g_string_append_printf(out, "{\"seed\":%"G_GUINT64_FORMAT",\"duration_ms\":%"G_GUINT64_FORMAT",\"benchmarks\":[",
+                               seed, duration_ms);
+        for (size_t i = 0; i < G_N_ELEMENTS(benchmarks); i++) {
+                if (filter && !strstr(benchmarks[i].name, filter))
+                        continue;
+
+                bench_run(&benchmarks[i], duration_ms * 1000, out);
+        }
+        g_string_append(out, "\n]}\n");
+
+        df_suppression_free(&bench_suppressions);
+
+        if (output) {
+                if (!g_file_set_contents(output, out->str, out->len, &error)) {
+                        fprintf(stderr, "Failed to write %s: %s\n", output, error->message);
+                        return EXIT_FAILURE;
+                }
+        } else
+                fputs(out->str, stdout);
+
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,85 @@
+# SPDX-License-Identifier: GPL-3.0-or-later
+"""Helpers shared by the end-to-end benchmarks."""
+
+import os
+import re
+import shlex
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+BUS_NAME = "org.freedesktop.dfuzzerServer"
+
+BUS_CONFIG = """<!DOCTYPE busconfig PUBLIC "-//freedesktop//DTD D-Bus Bus Configuration 1.0//EN"
+ "http://www.freedesktop.org/standards/dbus/1.0/busconfig.dtd">
+<busconfig>
+  <type>session</type>
+  <listen>unix:path={dir}/bus</listen>
+  <servicedir>{dir}/services</servicedir>
+  <auth>EXTERNAL</auth>
+  <policy context="default">
+    <allow send_destination="*" eavesdrop="true"/>
+    <allow eavesdrop="true"/>
+    <allow own="*"/>
+  </policy>
+</busconfig>
+"""
+
+# dfuzzer-test-server owns its name on the system bus, so point it there
+SERVICE_FILE = """[D-BUS Service]
+Name={name}
+Exec=/usr/bin/env DBUS_SYSTEM_BUS_ADDRESS={address} {server}
+"""
+
+
+def which(program):
+    path = shutil.which(program)
+    if not path:
+        sys.exit(f"{program} not found")
+    return os.path.abspath(path)
+
+
+class PrivateBus:
+    def __init__(self, dbus_daemon, server, suppressions=""):
+        # server is the command line of dfuzzer-test-server
+        self.dir = tempfile.mkdtemp(prefix="dfuzzer-bench-")
+        self.address = f"unix:path={self.dir}/bus"
+
+        os.mkdir(f"{self.dir}/services")
+        with open(f"{self.dir}/bus.conf", "w") as f:
+            f.write(BUS_CONFIG.format(dir=self.dir))
+        with open(f"{self.dir}/services/{BUS_NAME}.service", "w") as f:
+            f.write(SERVICE_FILE.format(name=BUS_NAME, address=self.address, server=shlex.join(server)))
+        # dfuzzer looks for ./dfuzzer.conf first
+        with open(f"{self.dir}/dfuzzer.conf", "w") as f:
+            f.write(suppressions)
+
+        self.daemon = subprocess.Popen([dbus_daemon, f"--config-file={self.dir}/bus.conf",
+                                        "--nofork", "--print-address"],
+                                       stdout=subprocess.PIPE, text=True)
+        # The daemon prints the address once it listens
+        self.daemon.stdout.readline()
+
+        self.server = subprocess.Popen(server, stdout=subprocess.DEVNULL,
+                                       env=dict(os.environ, DBUS_SYSTEM_BUS_ADDRESS=self.address))
+        # dfuzzer tests both buses, make sure it finds the target only once
+        self.env = dict(os.environ, DBUS_SESSION_BUS_ADDRESS=self.address,
+                        DBUS_SYSTEM_BUS_ADDRESS=f"unix:path={self.dir}/no-such-bus")
+
+    def wait_for_server(self, dfuzzer, timeout=30):
+        deadline = time.monotonic() + timeout
+        while time.monotonic() < deadline:
+            names = subprocess.run([dfuzzer, "-l"], env=self.env, cwd=self.dir,
+                                   capture_output=True, text=True).stdout
+            if re.search(rf"^\s*{re.escape(BUS_NAME)}\s*$", names, re.MULTILINE):
+                return
+            time.sleep(0.1)
+        sys.exit(f"{BUS_NAME} didn't appear on the private bus")
+
+    def close(self):
+        for p in (self.server, self.daemon):
+            p.terminate()
+            p.wait()
+        shutil.rmtree(self.dir, ignore_errors=True)
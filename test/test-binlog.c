@@ -0,0 +1,128 @@
+#include <gio/gio.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+
+#include "binlog.h"
+#include "compress.h"
+#include "util.h"
+
+static char *render_file(const char *path, int *ret)
+{
+        g_autoptr(GFile) file = NULL;
+        g_autoptr(GInputStream) base = NULL;
+        g_autoptr(GInputStream) input = NULL;
+        g_autoptr(FILE) f = NULL;
+        char *buf = NULL;
+        size_t size = 0;
+
+        file = g_file_new_for_path(path);
+        base = G_INPUT_STREAM(g_file_read(file, NULL, NULL));
+        g_assert_nonnull(base);
+        input = df_decompress_input_stream_new(base, NULL);
+        g_assert_nonnull(input);
+
+        f = open_memstream(&buf, &size);
+        g_assert_nonnull(f);
+        *ret = df_binlog_render(input, f);
+        g_clear_pointer(&f, fclose);
+
+        return buf;
+}
+
+static void test_binlog_render(gboolean compress)
+{
+        g_autoptr(GError) error = NULL;
+        g_autoptr(gchar) path = NULL;
+        g_autoptr(gchar) text = NULL;
+        g_autoptr(gchar) contents = NULL;
+        g_autoptr(GString) expected = NULL;
+        gsize length;
+        guint32 id1, id2;
+        int fd, r;
+
+        fd = g_file_open_tmp("test-binlog-XXXXXX", &path, &error);
+        g_assert_no_error(error);
+        close(fd);
+
+        expected = g_string_new(NULL);
+
+        /* Two runs appended to the same file */
+        for (int run = 0; run < 2; run++) {
+                g_assert_true(df_binlog_open(path, compress) == 0);
+                g_assert_true(df_binlog_is_open());
+
+                id1 = df_binlog_add_method("org.foo.Bar", "/org/foo", "Method1", "(su)");
+                id2 = df_binlog_add_method("org.foo.Bar", "/org/foo", "Method2", "(a{sv}h)");
+
+                /* Go over the queue size to make sure the producer waits for the writer */
+                for (guint i = 0; i < DF_BINLOG_QUEUE_SIZE + 16; i++) {
+                        g_autoptr(GVariant) v1 = NULL;
+                        g_autoptr(GVariant) v2 = NULL;
+                        g_autoptr(gchar) s1 = NULL;
+                        g_autoptr(gchar) s2 = NULL;
+                        GVariantBuilder builder;
+
+                        v1 = g_variant_ref_sink(g_variant_new("(su)", "hello;world", i));
+                        g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
+                        g_variant_builder_add(&builder, "{sv}", "key", g_variant_new_uint64(i));
+                        v2 = g_variant_ref_sink(g_variant_new("(a{sv}h)", &builder, 0));
+
+                        df_binlog_add_call(id1, i, 42, DF_BINLOG_OUTCOME_SUCCESS, v1);
+                        df_binlog_add_call(id2, i, 42, i % 2 ? DF_BINLOG_OUTCOME_CRASH : DF_BINLOG_OUTCOME_COMMAND_ERROR, v2);
+
+                        s1 = g_variant_print(v1, TRUE);
+                        s2 = g_variant_print(v2, TRUE);
+                        g_string_append_printf(expected, "org.foo.Bar;/org/foo;Method1;(su);%s;Success\n", s1);
+                        g_string_append_printf(expected, "org.foo.Bar;/org/foo;Method2;(a{sv}h);%s;%s\n", s2,
+                                               i % 2 ? "Crash" : "Command execution error");
+                }
+
+                g_assert_true(df_binlog_close() == 0);
+                g_assert_false(df_binlog_is_open());
+        }
+
+        text = render_file(path, &r);
+        g_assert_cmpint(r, ==, 0);
+        g_assert_cmpstr(text, ==, expected->str);
+        g_clear_pointer(&text, g_free);
+
+        /* A truncated record (or compressed block) at the end is ignored */
+        g_assert_true(g_file_get_contents(path, &contents, &length, &error));
+        g_assert_no_error(error);
+        g_assert_true(g_file_set_contents(path, contents, length / 2, &error));
+        g_assert_no_error(error);
+        text = render_file(path, &r);
+        g_assert_cmpint(r, ==, 0);
+        g_assert_true(g_str_has_prefix(expected->str, text));
+        g_assert_cmpuint(strlen(text), <, expected->len);
+        g_clear_pointer(&text, g_free);
+
+        /* Not a binary log */
+        g_assert_true(g_file_set_contents(path, "org.foo.Bar;/;Method;(s);('a',);Success\n", -1, &error));
+        g_assert_no_error(error);
+        text = render_file(path, &r);
+        g_assert_cmpint(r, <, 0);
+
+        (void) g_unlink(path);
+}
+
+static void test_df_binlog_render(void)
+{
+        test_binlog_render(FALSE);
+}
+
+static void test_df_binlog_render_compressed(void)
+{
+        test_binlog_render(TRUE);
+}
+
+int main(int argc, char *argv[])
+{
+        g_test_init(&argc, &argv, NULL);
+
+        g_test_add_func("/df_binlog/df_binlog_render", test_df_binlog_render);
+        g_test_add_func("/df_binlog/df_binlog_render_compressed", test_df_binlog_render_compressed);
+
+        return g_test_run();
+}
@@ -0,0 +1,148 @@
+#include <gio/gio.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "checkpoint.h"
+#include "util.h"
+
+static gchar *checkpoint_read(const char *path)
+{
+        g_autoptr(GError) error = NULL;
+        gchar *contents = NULL;
+
+        g_assert_true(g_file_get_contents(path, &contents, NULL, &error));
+        g_assert_no_error(error);
+
+        return contents;
+}
+
+static void test_df_checkpoint_resume(void)
+{
+        g_autoptr(GError) error = NULL;
+        g_autoptr(gchar) path = NULL;
+        g_autoptr(gchar) contents = NULL;
+        unsigned int seed;
+        int ret;
+        fd_t fd;
+
+        fd = g_file_open_tmp("dfuzzer-test-checkpoint-XXXXXX", &path, &error);
+        g_assert_no_error(error);
+        close(fd);
+        (void) g_unlink(path);
+
+        /* Nothing to resume from yet */
+        g_assert_false(df_checkpoint_is_enabled());
+        g_assert_cmpint(df_checkpoint_open(path, "org.example", NULL, TRUE), ==, 0);
+        g_assert_true(df_checkpoint_is_enabled());
+        g_assert_false(df_checkpoint_get_seed(&seed));
+        df_checkpoint_set_seed(1234);
+
+        df_checkpoint_test_start("method", "/org/example", "org.example.Interface", "Passed");
+        df_checkpoint_iteration(5);
+        df_checkpoint_test_end(0);
+        /* Findings are written out right away */
+        df_checkpoint_test_start("method", "/org/example", "org.example.Interface", "Crashed");
+        df_checkpoint_test_end(1);
+        contents = checkpoint_read(path);
+        g_assert_nonnull(strstr(contents, "\nfindings 1\n"));
+        g_assert_nonnull(strstr(contents, "\ncompleted method /org/example org.example.Interface Crashed 1\n"));
+        g_clear_pointer(&contents, g_free);
+        /* Errors are not completed tests */
+        df_checkpoint_test_start("property", "/org/example", "org.example.Interface", "Failed");
+        df_checkpoint_test_end(-1);
+        df_checkpoint_test_start("property", "/org/example", "org.example.Interface", "Interrupted");
+        df_checkpoint_iteration(42);
+        g_assert_cmpint(df_checkpoint_close(), ==, 0);
+        g_assert_false(df_checkpoint_is_enabled());
+
+        contents = checkpoint_read(path);
+        g_assert_true(g_str_has_prefix(contents, "# dfuzzer checkpoint"));
+        g_assert_nonnull(strstr(contents, "\nversion 1\nbus org.example\nseed 1234\nfindings 1\n"
+                                          "current property /org/example org.example.Interface Interrupted 42\n"
+                                          "completed method /org/example org.example.Interface Passed 0\n"
+                                          "completed method /org/example org.example.Interface Crashed 1\n"));
+        g_assert_null(strstr(contents, "Failed"));
+        g_clear_pointer(&contents, g_free);
+
+        /* A checkpoint of another bus name or shard is left alone */
+        g_assert_cmpint(df_checkpoint_open(path, "org.example.Other", NULL, TRUE), <, 0);
+        g_assert_cmpint(df_checkpoint_open(path, "org.example", "1/2", TRUE), <, 0);
+        g_assert_false(df_checkpoint_is_enabled());
+
+        g_assert_cmpint(df_checkpoint_open(path, "org.example", NULL, TRUE), ==, 0);
+        g_assert_true(df_checkpoint_get_seed(&seed));
+        g_assert_cmpuint(seed, ==, 1234);
+        g_assert_true(df_checkpoint_is_completed("method", "/org/example", "org.example.Interface", "Passed", &ret));
+        g_assert_cmpint(ret, ==, 0);
+        g_assert_true(df_checkpoint_is_completed("method", "/org/example", "org.example.Interface", "Crashed", &ret));
+        g_assert_cmpint(ret, ==, 1);
+        g_assert_false(df_checkpoint_is_completed("property", "/org/example", "org.example.Interface", "Passed", &ret));
+        g_assert_false(df_checkpoint_is_completed("property", "/org/example", "org.example.Interface", "Failed", &ret));
+        g_assert_false(df_checkpoint_is_completed("property", "/org/example", "org.example.Interface", "Interrupted", &ret));
+        /* Tests completed before resuming keep their result */
+        df_checkpoint_test_start("method", "/org/example", "org.example.Interface", "Crashed");
+        df_checkpoint_test_end(0);
+        g_assert_true(df_checkpoint_is_completed("method", "/org/example", "org.example.Interface", "Crashed", &ret));
+        g_assert_cmpint(ret, ==, 1);
+        g_assert_cmpint(df_checkpoint_close(), ==, 0);
+
+        /* Without --resume the checkpoint starts from scratch */
+        g_assert_cmpint(df_checkpoint_open(path, "org.example", "1/2", FALSE), ==, 0);
+        g_assert_false(df_checkpoint_is_completed("method", "/org/example", "org.example.Interface", "Passed", &ret));
+        g_assert_cmpint(df_checkpoint_close(), ==, 0);
+        contents = checkpoint_read(path);
+        g_assert_cmpstr(strchr(contents, '\n'), ==, "\nversion 1\nbus org.example\nshard 1/2\nfindings 0\n");
+
+        (void) g_unlink(path);
+}
+
+static void test_df_checkpoint_invalid(void)
+{
+        static const char * const invalid[] = {
+                "",
+                "version 1\n",
+                "version 2\nbus org.example\n",
+                "version 1\nbus org.example\nfoo\n",
+                "version 1\nbus org.example\nseed x\n",
+                "version 1\nbus org.example\ncompleted method /a b\n",
+                "version 1\nbus org.example\ncompleted method /a b c -1\n",
+        };
+        g_autoptr(GError) error = NULL;
+        g_autoptr(gchar) path = NULL;
+        fd_t fd;
+
+        fd = g_file_open_tmp("dfuzzer-test-checkpoint-XXXXXX", &path, &error);
+        g_assert_no_error(error);
+        close(fd);
+
+        for (size_t i = 0; i < G_N_ELEMENTS(invalid); i++) {
+                g_autoptr(gchar) contents = NULL;
+
+                g_assert_true(g_file_set_contents(path, invalid[i], -1, &error));
+                g_assert_no_error(error);
+                g_assert_cmpint(df_checkpoint_open(path, "org.example", NULL, TRUE), <, 0);
+                g_assert_false(df_checkpoint_is_enabled());
+
+                /* ... and left untouched */
+                contents = checkpoint_read(path);
+                g_assert_cmpstr(contents, ==, invalid[i]);
+        }
+
+        /* Unwritable file */
+        g_assert_cmpint(df_checkpoint_open("/a/b/c/d/e", "org.example", NULL, FALSE), <, 0);
+        g_assert_false(df_checkpoint_is_enabled());
+
+        (void) g_unlink(path);
+}
+
+int main(int argc, char *argv[])
+{
+        g_test_init(&argc, &argv, NULL);
+
+        g_test_add_func("/df_checkpoint/df_checkpoint_resume", test_df_checkpoint_resume);
+        g_test_add_func("/df_checkpoint/df_checkpoint_invalid", test_df_checkpoint_invalid);
+
+        return g_test_run();
+}
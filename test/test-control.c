@@ -0,0 +1,136 @@
+#include <gio/gio.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "control.h"
+#include "util.h"
+
+static char *request(const char *path, const char *command, guint n_responses)
+{
+        struct sockaddr_un sa = { .sun_family = AF_UNIX };
+        g_auto(fd_t) fd = -1;
+        g_autoptr(GString) response = NULL;
+        char buf[512];
+
+        fd = socket(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, 0);
+        g_assert_cmpint(fd, >=, 0);
+        g_strlcpy(sa.sun_path, path, sizeof(sa.sun_path));
+        g_assert_cmpint(connect(fd, (struct sockaddr *) &sa, sizeof(sa)), ==, 0);
+        g_assert_cmpint(write(fd, command, strlen(command)), ==, (gssize) strlen(command));
+
+        /* Read until the terminating empty line of the last response */
+        response = g_string_new(NULL);
+        for (guint found = 0; found < n_responses;) {
+                ssize_t n;
+
+                n = read(fd, buf, sizeof(buf));
+                g_assert_cmpint(n, >, 0);
+                g_string_append_len(response, buf, n);
+
+                found = 0;
+                for (const char *p = response->str; (p = strstr(p, "\n\n")); p += 2)
+                        found++;
+        }
+
+        return g_string_free(g_steal_pointer(&response), FALSE);
+}
+
+static gpointer checkpoint_thread(gpointer data)
+{
+        return GINT_TO_POINTER(df_control_checkpoint(7));
+}
+
+static void test_df_control_commands(void)
+{
+        g_autoptr(GError) error = NULL;
+        g_autoptr(gchar) dir = NULL;
+        g_autoptr(gchar) path = NULL;
+        g_autoptr(gchar) response = NULL;
+        GThread *thread;
+
+        /* Everything is a no-op when the control socket is not enabled */
+        g_assert_false(df_control_is_enabled());
+        g_assert_false(df_control_checkpoint(0));
+        df_control_close();
+
+        dir = g_dir_make_tmp("test-control-XXXXXX", &error);
+        g_assert_no_error(error);
+        path = g_build_filename(dir, "control", NULL);
+
+        g_assert_true(df_control_open(path) == 0);
+        g_assert_true(df_control_is_enabled());
+
+        df_control_begin_interface(3);
+        df_control_test_start("method", "org.foo", "/org/foo", "org.foo.Bar", "Method", 10);
+        g_assert_false(df_control_checkpoint(0));
+        g_assert_false(df_control_checkpoint(1));
+        df_control_member_tested();
+        df_control_record_finding();
+
+        response = request(path, "status\n", 1);
+        g_assert_nonnull(strstr(response, "state=running\n"));
+        g_assert_nonnull(strstr(response, "name=Method\n"));
+        g_assert_nonnull(strstr(response, "iteration=1\n"));
+        g_assert_nonnull(strstr(response, "iterations=10\n"));
+        g_assert_nonnull(strstr(response, "calls=2\n"));
+        g_assert_nonnull(strstr(response, "findings=1\n"));
+        g_assert_nonnull(strstr(response, "tested=1\n"));
+        g_assert_nonnull(strstr(response, "pending=2\n"));
+        g_clear_pointer(&response, g_free);
+
+        /* Multiple requests over one connection */
+        response = request(path, "help\nfoo\n", 2);
+        g_assert_true(g_str_has_prefix(response, "status\n"));
+        g_assert_true(g_str_has_suffix(response, "\n\nERROR unknown command 'foo'\n\n"));
+        g_clear_pointer(&response, g_free);
+
+        /* Pausing blocks the fuzzing thread until it's resumed */
+        response = request(path, "pause\n", 1);
+        g_assert_cmpstr(response, ==, "OK\n\n");
+        g_clear_pointer(&response, g_free);
+        thread = g_thread_new("checkpoint", checkpoint_thread, NULL);
+        for (;;) {
+                g_autoptr(gchar) status = NULL;
+
+                status = request(path, "status\n", 1);
+                if (strstr(status, "state=paused\n"))
+                        break;
+                g_assert_nonnull(strstr(status, "state=pausing\n"));
+                g_usleep(1000);
+        }
+        response = request(path, "resume\n", 1);
+        g_clear_pointer(&response, g_free);
+        g_assert_false(GPOINTER_TO_INT(g_thread_join(thread)));
+
+        /* Skipping works even while paused, and only once */
+        g_string_free(df_control_handle_command("pause"), TRUE);
+        thread = g_thread_new("checkpoint", checkpoint_thread, NULL);
+        g_string_free(df_control_handle_command("skip"), TRUE);
+        g_assert_true(GPOINTER_TO_INT(g_thread_join(thread)));
+        g_string_free(df_control_handle_command("resume"), TRUE);
+        g_assert_false(df_control_checkpoint(8));
+
+        /* A skip requested between tests doesn't affect the next one */
+        g_string_free(df_control_handle_command("skip"), TRUE);
+        df_control_test_start("method", "org.foo", "/org/foo", "org.foo.Bar", "Method2", 10);
+        g_assert_false(df_control_checkpoint(0));
+
+        df_control_close();
+        g_assert_false(df_control_is_enabled());
+        g_assert_false(g_file_test(path, G_FILE_TEST_EXISTS));
+        g_assert_true(g_rmdir(dir) == 0);
+}
+
+int main(int argc, char *argv[])
+{
+        g_test_init(&argc, &argv, NULL);
+
+        g_test_add_func("/df_control/df_control_commands", test_df_control_commands);
+
+        return g_test_run();
+}
@@ -0,0 +1,107 @@
+#include <errno.h>
+#include <gio/gio.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+
+#include "crashrec.h"
+#include "util.h"
+
+static char *recover_file(const char *path, int *ret)
+{
+        g_autoptr(FILE) f = NULL;
+        char *buf = NULL;
+        size_t size = 0;
+
+        f = open_memstream(&buf, &size);
+        g_assert_nonnull(f);
+        *ret = df_crashrec_recover(path, f);
+        g_clear_pointer(&f, fclose);
+
+        return buf;
+}
+
+static void test_df_crashrec_recover(void)
+{
+        g_autoptr(GError) error = NULL;
+        g_autoptr(gchar) path = NULL;
+        g_autoptr(gchar) text = NULL;
+        g_autoptr(GString) expected = NULL;
+        g_autoptr(GVariant) big = NULL;
+        g_autofree gchar *big_str = NULL;
+        int fd, r;
+
+        fd = g_file_open_tmp("test-crashrec-XXXXXX", &path, &error);
+        g_assert_no_error(error);
+        close(fd);
+
+        g_assert_true(df_crashrec_open(path, 0) == -EINVAL);
+        g_assert_true(df_crashrec_open(path, DF_CRASHREC_MAX_SLOTS + 1) == -EINVAL);
+        g_assert_true(df_crashrec_open(path, 4) == 0);
+        g_assert_true(df_crashrec_is_open());
+
+        /* An empty recorder */
+        text = recover_file(path, &r);
+        g_assert_cmpint(r, ==, 0);
+        g_assert_cmpstr(text, ==, "");
+        g_clear_pointer(&text, g_free);
+
+        expected = g_string_new(NULL);
+        for (guint64 i = 0; i < 10; i++) {
+                g_autoptr(GVariant) value = NULL;
+                g_autoptr(gchar) value_str = NULL;
+
+                value = g_variant_ref_sink(g_variant_new("(st)", "hello;world", i));
+                df_crashrec_begin_call("org.foo.Bar", "/org/foo", "Method", "(st)", i, value);
+                /* The last call never returns */
+                if (i < 9)
+                        df_crashrec_end_call();
+
+                /* Only the last 4 inputs are kept */
+                if (i >= 6) {
+                        value_str = g_variant_print(value, TRUE);
+                        g_string_append_printf(expected, "org.foo.Bar;/org/foo;Method;(st);%s;%s\n", value_str,
+                                               i < 9 ? "Completed" : "In flight");
+                }
+        }
+
+        /* The file is readable while dfuzzer is still running (or was killed) */
+        text = recover_file(path, &r);
+        g_assert_cmpint(r, ==, 0);
+        g_assert_cmpstr(text, ==, expected->str);
+        g_clear_pointer(&text, g_free);
+
+        /* Inputs which don't fit into a slot are truncated */
+        big_str = g_strnfill(DF_CRASHREC_SLOT_SIZE, 'a');
+        big = g_variant_ref_sink(g_variant_new("(s)", big_str));
+        df_crashrec_begin_call("org.foo.Bar", "/org/foo", "Big", "(s)", 0, big);
+        df_crashrec_end_call();
+        df_crashrec_close();
+        g_assert_false(df_crashrec_is_open());
+
+        text = recover_file(path, &r);
+        g_assert_cmpint(r, ==, 0);
+        g_assert_true(g_str_has_suffix(text, ";Big;(s);<truncated, 65479 of 65537 bytes>;Completed\n"));
+        g_clear_pointer(&text, g_free);
+
+        /* Not a crash recorder file */
+        g_assert_true(g_file_set_contents(path, "org.foo.Bar;/;Method;(s);('a',);Success\n", -1, &error));
+        g_assert_no_error(error);
+        text = recover_file(path, &r);
+        g_assert_cmpint(r, <, 0);
+        g_clear_pointer(&text, g_free);
+
+        (void) g_unlink(path);
+
+        text = recover_file(path, &r);
+        g_assert_cmpint(r, <, 0);
+}
+
+int main(int argc, char *argv[])
+{
+        g_test_init(&argc, &argv, NULL);
+
+        g_test_add_func("/df_crashrec/df_crashrec_recover", test_df_crashrec_recover);
+
+        return g_test_run();
+}
@@ -0,0 +1,232 @@
+#include <gio/gio.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+
+#include "dictionary.h"
+#include "rand.h"
+#include "util.h"
+
+static const char dictionary_contents[] =
+        "# global values\n"
+        "string global\n"
+        "\n"
+        "[org.foo.Bar:Method:arg]\n"
+        "string specific\n"
+        "integer -1\n"
+        "bytes 00ff\n"
+        "[::arg]\n"
+        "string any-arg\n"
+        "objpath /org/foo\n"
+        "signature a{sv}\n"
+        "[org.foo.Bar]\n"
+        "integer 0xffffffffffffffff\n";
+
+static char *write_dictionary(const char *contents)
+{
+        g_autoptr(GError) error = NULL;
+        char *path = NULL;
+        int fd;
+
+        fd = g_file_open_tmp("test-dictionary-XXXXXX", &path, &error);
+        g_assert_no_error(error);
+        g_assert_true(write(fd, contents, strlen(contents)) == (ssize_t) strlen(contents));
+        close(fd);
+
+        return path;
+}
+
+static void test_df_dictionary_resolve(void)
+{
+        g_autoptr(gchar) path = NULL;
+        g_autoptr(df_dictionary_t) d = NULL;
+        g_autoptr(GVariant) v = NULL;
+
+        path = write_dictionary(dictionary_contents);
+        g_assert_true(df_dictionary_load(path) == 0);
+        g_assert_true(df_dictionary_is_loaded());
+
+        /* Most specific scope first, global scope last */
+        d = df_dictionary_resolve("org.foo.Bar", "Method", "arg");
+        g_assert_nonnull(d);
+        g_assert_cmpuint(d->values[DF_DICTIONARY_STRING]->len, ==, 3);
+        g_assert_cmpstr(d->values[DF_DICTIONARY_STRING]->pdata[0], ==, "specific");
+        g_assert_cmpstr(d->values[DF_DICTIONARY_STRING]->pdata[1], ==, "any-arg");
+        g_assert_cmpstr(d->values[DF_DICTIONARY_STRING]->pdata[2], ==, "global");
+        g_assert_cmpuint(d->values[DF_DICTIONARY_INTEGER]->len, ==, 2);
+
+        /* Integers are truncated to the requested type */
+        v = g_variant_ref_sink(df_dictionary_get_value(d, G_VARIANT_TYPE_BYTE, 0));
+        g_assert_cmpuint(g_variant_get_byte(v), ==, G_MAXUINT8);
+        g_clear_pointer(&v, g_variant_unref);
+        v = g_variant_ref_sink(df_dictionary_get_value(d, G_VARIANT_TYPE_UINT64, 1));
+        g_assert_cmpuint(g_variant_get_uint64(v), ==, G_MAXUINT64);
+        g_clear_pointer(&v, g_variant_unref);
+        v = g_variant_ref_sink(df_dictionary_get_value(d, G_VARIANT_TYPE_BYTESTRING, 0));
+        g_assert_cmpuint(g_variant_n_children(v), ==, 2);
+        g_clear_pointer(&v, g_variant_unref);
+
+        /* Out of range iterations and unsupported types yield nothing */
+        g_assert_null(df_dictionary_get_value(d, G_VARIANT_TYPE_STRING, 3));
+        g_assert_null(df_dictionary_get_value(d, G_VARIANT_TYPE_BOOLEAN, 0));
+        g_clear_pointer(&d, df_dictionary_free);
+
+        /* Only the global scope matches */
+        d = df_dictionary_resolve("org.foo.Baz", "Method", "other");
+        g_assert_nonnull(d);
+        g_assert_cmpuint(d->values[DF_DICTIONARY_STRING]->len, ==, 1);
+        g_assert_cmpuint(d->values[DF_DICTIONARY_OBJECT_PATH]->len, ==, 0);
+
+        df_dictionary_unload();
+        g_assert_false(df_dictionary_is_loaded());
+        g_assert_null(df_dictionary_resolve("org.foo.Bar", "Method", "arg"));
+        (void) g_unlink(path);
+}
+
+static void test_df_dictionary_generate(void)
+{
+        g_autoptr(gchar) path = NULL;
+        g_autoptr(GPtrArray) dictionaries = NULL;
+
+        path = write_dictionary(dictionary_contents);
+        g_assert_true(df_dictionary_load(path) == 0);
+
+        /* Simulate a method with two arguments, where only the second one
+         * has a dictionary */
+        dictionaries = g_ptr_array_new_with_free_func((GDestroyNotify) df_dictionary_free);
+        g_ptr_array_add(dictionaries, NULL);
+        g_ptr_array_add(dictionaries, df_dictionary_resolve("org.foo.Bar", "Method", "arg"));
+
+        for (guint64 i = 0; i < 3; i++) {
+                g_autoptr(GVariant) v = NULL;
+                const char *str;
+
+                v = g_variant_ref_sink(df_generate_random_arguments("(ss)", i, dictionaries));
+                g_assert_nonnull(v);
+
+                g_variant_get(v, "(&s&s)", NULL, &str);
+                g_assert_cmpstr(str, ==, ((df_dictionary_t *) dictionaries->pdata[1])->values[DF_DICTIONARY_STRING]->pdata[i]);
+        }
+
+        df_dictionary_unload();
+        (void) g_unlink(path);
+}
+
+static void test_df_dictionary_generate_arrays(void)
+{
+        g_autoptr(gchar) path = NULL;
+        g_autoptr(GPtrArray) dictionaries = NULL;
+        const df_dictionary_t *d;
+
+        path = write_dictionary(dictionary_contents);
+        g_assert_true(df_dictionary_load(path) == 0);
+
+        dictionaries = g_ptr_array_new_with_free_func((GDestroyNotify) df_dictionary_free);
+        g_ptr_array_add(dictionaries, df_dictionary_resolve("org.foo.Bar", "Method", "arg"));
+        d = dictionaries->pdata[0];
+
+        /* Byte arrays come from the dictionary as a whole */
+        for (guint64 i = 0; i < 3; i++) {
+                g_autoptr(GVariant) v = NULL, bytes = NULL;
+
+                v = g_variant_ref_sink(df_generate_random_arguments("(ay)", i, dictionaries));
+                g_assert_nonnull(v);
+                g_assert_cmpstr(g_variant_get_type_string(v), ==, "(ay)");
+
+                if (i == 0) {
+                        bytes = g_variant_get_child_value(v, 0);
+                        g_assert_cmpuint(g_variant_n_children(bytes), ==, 2);
+                }
+        }
+
+        /* Elements of other arrays are taken from the dictionary one by one */
+        for (guint64 i = 0; i < 3; i++) {
+                g_autoptr(GVariant) v = NULL;
+                g_autoptr(GVariantIter) iter = NULL;
+                const char *str;
+
+                v = g_variant_ref_sink(df_generate_random_arguments("(as)", i, dictionaries));
+                g_assert_nonnull(v);
+                g_assert_cmpstr(g_variant_get_type_string(v), ==, "(as)");
+
+                g_variant_get(v, "(as)", &iter);
+                while (g_variant_iter_next(iter, "&s", &str))
+                        g_assert_cmpstr(str, ==, d->values[DF_DICTIONARY_STRING]->pdata[i]);
+        }
+
+        df_dictionary_unload();
+        (void) g_unlink(path);
+}
+
+static void test_df_dictionary_multiple_files(void)
+{
+        g_autoptr(gchar) path1 = NULL, path2 = NULL;
+        g_autoptr(df_dictionary_t) d = NULL;
+
+        /* Global values from all files are kept, CRLF line endings are
+         * dropped */
+        path1 = write_dictionary("string first\r\n"
+                                 "[org.foo.Bar]\r\n"
+                                 "string scoped\r\n");
+        path2 = write_dictionary("string second\n"
+                                 "[org.foo.Bar]\n"
+                                 "string scoped-too\n");
+        g_assert_true(df_dictionary_load(path1) == 0);
+        g_assert_true(df_dictionary_load(path2) == 0);
+
+        d = df_dictionary_resolve("org.foo.Baz", "Method", "arg");
+        g_assert_nonnull(d);
+        g_assert_cmpuint(d->values[DF_DICTIONARY_STRING]->len, ==, 2);
+        g_assert_cmpstr(d->values[DF_DICTIONARY_STRING]->pdata[0], ==, "first");
+        g_assert_cmpstr(d->values[DF_DICTIONARY_STRING]->pdata[1], ==, "second");
+        g_clear_pointer(&d, df_dictionary_free);
+
+        d = df_dictionary_resolve("org.foo.Bar", "Method", "arg");
+        g_assert_nonnull(d);
+        g_assert_cmpuint(d->values[DF_DICTIONARY_STRING]->len, ==, 4);
+        g_assert_cmpstr(d->values[DF_DICTIONARY_STRING]->pdata[0], ==, "scoped");
+        g_assert_cmpstr(d->values[DF_DICTIONARY_STRING]->pdata[1], ==, "scoped-too");
+
+        df_dictionary_unload();
+        (void) g_unlink(path1);
+        (void) g_unlink(path2);
+}
+
+static void test_df_dictionary_invalid(void)
+{
+        static const char *invalid[] = {
+                "[a:b:c:d]\n",
+                "[a:b\n",
+                "nope value\n",
+                "objpath not-a-path\n",
+                "signature (\n",
+                "integer 12a\n",
+                "bytes 0\n",
+                "bytes zz\n",
+        };
+
+        for (size_t i = 0; i < G_N_ELEMENTS(invalid); i++) {
+                g_autoptr(gchar) path = NULL;
+
+                path = write_dictionary(invalid[i]);
+                g_assert_true(df_dictionary_load(path) < 0);
+                df_dictionary_unload();
+                (void) g_unlink(path);
+        }
+
+        g_assert_true(df_dictionary_load("/a/b/c/d/e") < 0);
+}
+
+int main(int argc, char *argv[])
+{
+        g_test_init(&argc, &argv, NULL);
+        df_rand_init(g_test_rand_int());
+
+        g_test_add_func("/df_dictionary/df_dictionary_resolve", test_df_dictionary_resolve);
+        g_test_add_func("/df_dictionary/df_dictionary_generate", test_df_dictionary_generate);
+        g_test_add_func("/df_dictionary/df_dictionary_generate_arrays", test_df_dictionary_generate_arrays);
+        g_test_add_func("/df_dictionary/df_dictionary_multiple_files", test_df_dictionary_multiple_files);
+        g_test_add_func("/df_dictionary/df_dictionary_invalid", test_df_dictionary_invalid);
+
+        return g_test_run();
+}
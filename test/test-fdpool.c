@@ -0,0 +1,62 @@
+#include <fcntl.h>
+#include <gio/gio.h>
+#include <gio/gunixfdlist.h>
+#include <glib.h>
+#include <stdio.h>
+
+#include "fdpool.h"
+#include "util.h"
+
+static void test_df_fd_pool_pick(void)
+{
+        g_assert_true(df_fd_pool_init() == 0);
+
+        /* No 'h' arguments, no FD list */
+        df_fd_pool_begin_call();
+        g_assert_null(df_fd_pool_end_call());
+
+        for (guint64 iteration = 0; iteration < 1000; iteration++) {
+                g_autoptr(GUnixFDList) fd_list = NULL;
+                gint fds[DF_FD_POOL_MAX_FDS_PER_CALL];
+                gint n_fds;
+
+                df_fd_pool_begin_call();
+
+                for (guint i = 0; i < DF_FD_POOL_MAX_FDS_PER_CALL * 2; i++) {
+                        int idx = df_fd_pool_pick(iteration);
+
+                        g_assert_cmpint(idx, >=, 0);
+                        g_assert_cmpint(idx, <, DF_FD_POOL_MAX_FDS_PER_CALL);
+                }
+
+                fd_list = df_fd_pool_end_call();
+                g_assert_nonnull(fd_list);
+
+                n_fds = g_unix_fd_list_get_length(fd_list);
+                g_assert_cmpint(n_fds, >, 0);
+                g_assert_cmpint(n_fds, <=, DF_FD_POOL_MAX_FDS_PER_CALL);
+                memcpy(fds, g_unix_fd_list_peek_fds(fd_list, NULL), sizeof(*fds) * n_fds);
+                /* The same FD is always picked in the first iterations */
+                if (iteration < _DF_FD_TYPE_MAX)
+                        g_assert_cmpint(n_fds, ==, 1);
+
+                df_fd_pool_release(fd_list);
+                g_assert_cmpint(g_unix_fd_list_get_length(fd_list), ==, 0);
+
+                /* The pooled FDs must survive the list */
+                g_clear_object(&fd_list);
+                for (gint i = 0; i < n_fds; i++)
+                        g_assert_cmpint(fcntl(fds[i], F_GETFD), >=, 0);
+        }
+
+        df_fd_pool_done();
+}
+
+int main(int argc, char *argv[])
+{
+        g_test_init(&argc, &argv, NULL);
+
+        g_test_add_func("/df_fdpool/df_fd_pool_pick", test_df_fd_pool_pick);
+
+        return g_test_run();
+}
@@ -0,0 +1,86 @@
+#include <errno.h>
+#include <gio/gio.h>
+#include <glib.h>
+#include <stdio.h>
+
+#include "flightrec.h"
+#include "util.h"
+
+static void collect_iteration(const df_flightrec_entry_t *entry, gpointer user_data)
+{
+        GArray *iterations = user_data;
+
+        g_assert_cmpstr(entry->interface, ==, "org.foo.Bar");
+        g_assert_cmpstr(entry->method, ==, "Method");
+        g_assert_cmpuint(entry->method_id, ==, 7);
+        g_assert_cmpuint(g_variant_get_uint64(entry->value), ==, entry->iteration);
+
+        g_array_append_val(iterations, entry->iteration);
+}
+
+static void test_df_flightrec_dump(void)
+{
+        const char *intf = g_intern_string("org.foo.Bar"), *obj = g_intern_string("/org/foo"),
+                   *method = g_intern_string("Method"), *sig = g_intern_string("(t)");
+
+        g_assert_false(df_flightrec_is_enabled());
+        g_assert_true(df_flightrec_init(0) == -EINVAL);
+        g_assert_true(df_flightrec_init(DF_FLIGHTREC_MAX_SIZE + 1) == -EINVAL);
+        g_assert_true(df_flightrec_init(8) == 0);
+        g_assert_true(df_flightrec_is_enabled());
+
+        /* Partially filled, wrapped around multiple times, and emptied again */
+        for (guint64 n = 0; n < 30; n += 5) {
+                g_autoptr(GArray) iterations = NULL;
+
+                iterations = g_array_new(FALSE, FALSE, sizeof(guint64));
+
+                for (guint64 i = 0; i < n; i++) {
+                        g_autoptr(GVariant) value = NULL;
+
+                        value = g_variant_ref_sink(g_variant_new_uint64(i));
+                        df_flightrec_add(intf, obj, method, sig, 7, i, value);
+                }
+
+                g_assert_cmpuint(df_flightrec_dump(collect_iteration, iterations), ==, MIN(n, 8));
+                g_assert_cmpuint(iterations->len, ==, MIN(n, 8));
+                /* Oldest first */
+                for (guint i = 0; i < iterations->len; i++)
+                        g_assert_cmpuint(g_array_index(iterations, guint64, i), ==, n - iterations->len + i);
+
+                /* Dumped inputs are gone */
+                g_assert_cmpuint(df_flightrec_dump(collect_iteration, iterations), ==, 0);
+        }
+
+        /* Reset drops everything */
+        for (guint64 i = 0; i < 3; i++) {
+                g_autoptr(GVariant) value = NULL;
+
+                value = g_variant_ref_sink(g_variant_new_uint64(i));
+                df_flightrec_add(intf, obj, method, sig, 7, i, value);
+        }
+        df_flightrec_reset();
+        g_assert_cmpuint(df_flightrec_dump(collect_iteration, NULL), ==, 0);
+
+        df_flightrec_done();
+        g_assert_false(df_flightrec_is_enabled());
+}
+
+static void test_df_flightrec_request_dump(void)
+{
+        g_assert_false(df_flightrec_dump_requested());
+        df_flightrec_request_dump();
+        df_flightrec_request_dump();
+        g_assert_true(df_flightrec_dump_requested());
+        g_assert_false(df_flightrec_dump_requested());
+}
+
+int main(int argc, char *argv[])
+{
+        g_test_init(&argc, &argv, NULL);
+
+        g_test_add_func("/df_flightrec/df_flightrec_dump", test_df_flightrec_dump);
+        g_test_add_func("/df_flightrec/df_flightrec_request_dump", test_df_flightrec_request_dump);
+
+        return g_test_run();
+}
@@ -0,0 +1,170 @@
+#include <gio/gio.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "incremental.h"
+#include "util.h"
+
+static const char introspection_xml[] =
+        "<node>"
+        "  <interface name='org.example.Interface'>"
+        "    <method name='Foo'>"
+        "      <arg type='s' name='a' direction='in'/>"
+        "      <arg type='i' name='b' direction='out'/>"
+        "    </method>"
+        "    <method name='Bar'/>"
+        "    <property type='s' name='Baz' access='read'/>"
+        "  </interface>"
+        "  <interface name='org.example.Changed'>"
+        "    <method name='Foo'>"
+        "      <arg type='s' name='renamed' direction='in'/>"
+        "      <arg type='i' name='b' direction='out'/>"
+        "    </method>"
+        "    <method name='Bar'>"
+        "      <annotation name='org.freedesktop.DBus.Method.NoReply' value='true'/>"
+        "    </method>"
+        "    <property type='s' name='Baz' access='readwrite'/>"
+        "  </interface>"
+        "</node>";
+
+static void test_df_incremental_fingerprint(void)
+{
+        g_autoptr(GDBusNodeInfo) node = NULL;
+        g_autoptr(GError) error = NULL;
+        GDBusInterfaceInfo *a, *b;
+        g_autoptr(gchar) fa = NULL, fb = NULL;
+
+        node = g_dbus_node_info_new_for_xml(introspection_xml, &error);
+        g_assert_no_error(error);
+        a = node->interfaces[0];
+        b = node->interfaces[1];
+
+        /* Argument names don't matter */
+        fa = df_incremental_fingerprint_method(a->methods[0]);
+        fb = df_incremental_fingerprint_method(b->methods[0]);
+        g_assert_cmpuint(strlen(fa), ==, 64);
+        g_assert_cmpstr(fa, ==, fb);
+        g_clear_pointer(&fa, g_free);
+        g_clear_pointer(&fb, g_free);
+
+        /* ... annotations do */
+        fa = df_incremental_fingerprint_method(a->methods[1]);
+        fb = df_incremental_fingerprint_method(b->methods[1]);
+        g_assert_cmpstr(fa, !=, fb);
+        g_clear_pointer(&fa, g_free);
+        g_clear_pointer(&fb, g_free);
+
+        /* ... and so do access flags */
+        fa = df_incremental_fingerprint_property(a->properties[0]);
+        fb = df_incremental_fingerprint_property(b->properties[0]);
+        g_assert_cmpstr(fa, !=, fb);
+        g_clear_pointer(&fa, g_free);
+        g_clear_pointer(&fb, g_free);
+
+        /* Interface fingerprints are stable */
+        fa = df_incremental_fingerprint_interface(a);
+        fb = df_incremental_fingerprint_interface(a);
+        g_assert_cmpstr(fa, ==, fb);
+        g_clear_pointer(&fb, g_free);
+        fb = df_incremental_fingerprint_interface(b);
+        g_assert_cmpstr(fa, !=, fb);
+}
+
+static void test_df_incremental_state(void)
+{
+        g_autoptr(GError) error = NULL;
+        g_autoptr(gchar) path = NULL;
+        g_autoptr(gchar) contents = NULL;
+        fd_t fd;
+
+        fd = g_file_open_tmp("dfuzzer-test-incremental-XXXXXX", &path, &error);
+        g_assert_no_error(error);
+        close(fd);
+        (void) g_unlink(path);
+
+        /* Everything is new in the first run */
+        g_assert_false(df_incremental_is_enabled());
+        g_assert_cmpint(df_incremental_open(path), ==, 0);
+        g_assert_true(df_incremental_is_enabled());
+        g_assert_cmpint(df_incremental_check("method", "/org/example", "org.example.Interface", "Foo", "aaaa"),
+                        ==, DF_INCREMENTAL_NEW);
+        df_incremental_record("interface", "/org/example", "org.example.Interface", NULL, "ffff");
+        df_incremental_record("method", "/org/example", "org.example.Interface", "Foo", "aaaa");
+        df_incremental_record("property", "/org/example", "org.example.Interface", "Baz", "bbbb");
+        /* Recorded fingerprints are for the next run */
+        g_assert_cmpint(df_incremental_check("method", "/org/example", "org.example.Interface", "Foo", "aaaa"),
+                        ==, DF_INCREMENTAL_NEW);
+        g_assert_cmpint(df_incremental_close(), ==, 0);
+        g_assert_false(df_incremental_is_enabled());
+
+        g_assert_true(g_file_get_contents(path, &contents, NULL, &error));
+        g_assert_no_error(error);
+        g_assert_nonnull(strstr(contents, "\nversion 1\n"
+                                          "interface /org/example org.example.Interface ffff\n"
+                                          "method /org/example org.example.Interface Foo aaaa\n"
+                                          "property /org/example org.example.Interface Baz bbbb\n"));
+        g_clear_pointer(&contents, g_free);
+
+        g_assert_cmpint(df_incremental_open(path), ==, 0);
+        g_assert_cmpint(df_incremental_check("interface", "/org/example", "org.example.Interface", NULL, "ffff"),
+                        ==, DF_INCREMENTAL_UNCHANGED);
+        g_assert_cmpint(df_incremental_check("method", "/org/example", "org.example.Interface", "Foo", "aaaa"),
+                        ==, DF_INCREMENTAL_UNCHANGED);
+        g_assert_cmpint(df_incremental_check("property", "/org/example", "org.example.Interface", "Baz", "cccc"),
+                        ==, DF_INCREMENTAL_CHANGED);
+        g_assert_cmpint(df_incremental_check("property", "/org/example", "org.example.Interface", "Foo", "aaaa"),
+                        ==, DF_INCREMENTAL_NEW);
+        g_assert_cmpint(df_incremental_check("method", "/org/example/other", "org.example.Interface", "Foo", "aaaa"),
+                        ==, DF_INCREMENTAL_NEW);
+        /* Records which weren't tested again are kept */
+        df_incremental_record("property", "/org/example", "org.example.Interface", "Baz", "cccc");
+        g_assert_cmpint(df_incremental_close(), ==, 0);
+
+        g_assert_true(g_file_get_contents(path, &contents, NULL, &error));
+        g_assert_no_error(error);
+        g_assert_nonnull(strstr(contents, "\nmethod /org/example org.example.Interface Foo aaaa\n"
+                                          "property /org/example org.example.Interface Baz cccc\n"));
+
+        (void) g_unlink(path);
+}
+
+static void test_df_incremental_invalid(void)
+{
+        static const char * const invalid[] = {
+                "",
+                "version 2\n",
+                "version 1\nfoo\n",
+                "version 1\ninterface /a b\n",
+                "version 1\nmethod /a b c\n",
+                "version 1\nsignal /a b c d\n",
+        };
+        g_autoptr(GError) error = NULL;
+        g_autoptr(gchar) path = NULL;
+        fd_t fd;
+
+        fd = g_file_open_tmp("dfuzzer-test-incremental-XXXXXX", &path, &error);
+        g_assert_no_error(error);
+        close(fd);
+
+        for (size_t i = 0; i < G_N_ELEMENTS(invalid); i++) {
+                g_assert_true(g_file_set_contents(path, invalid[i], -1, &error));
+                g_assert_no_error(error);
+                g_assert_cmpint(df_incremental_open(path), <, 0);
+                g_assert_false(df_incremental_is_enabled());
+        }
+
+        (void) g_unlink(path);
+}
+
+int main(int argc, char *argv[])
+{
+        g_test_init(&argc, &argv, NULL);
+
+        g_test_add_func("/df_incremental/df_incremental_fingerprint", test_df_incremental_fingerprint);
+        g_test_add_func("/df_incremental/df_incremental_state", test_df_incremental_state);
+        g_test_add_func("/df_incremental/df_incremental_invalid", test_df_incremental_invalid);
+
+        return g_test_run();
+}
@@ -0,0 +1,192 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <gio/gio.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+
+#include "json.h"
+#include "util.h"
+
+static void test_df_json_append_escaped(void)
+{
+        static const struct {
+                const char *input;
+                const char *expected;
+        } tests[] = {
+                { "",                       "\"\""                              },
+                { "hello",                  "\"hello\""                         },
+                { "a \"quoted\" \\ string", "\"a \\\"quoted\\\" \\\\ string\""  },
+                { "line\nbreak\ttab\r",     "\"line\\nbreak\\ttab\\r\""         },
+                { "\x01\x1e\x1f",           "\"\\u0001\\u001e\\u001f\""         },
+                { "ünïcödé",                "\"ünïcödé\""                       },
+        };
+
+        for (size_t i = 0; i < G_N_ELEMENTS(tests); i++) {
+                g_autoptr(GString) out = NULL;
+
+                out = g_string_new(NULL);
+                df_json_append_escaped(out, tests[i].input);
+                g_assert_cmpstr(out->str, ==, tests[i].expected);
+        }
+}
+
+static void check_stream(const char *path, guint n_events)
+{
+        g_autoptr(GError) error = NULL;
+        g_autofree gchar *contents = NULL;
+        g_auto(GStrv) records = NULL;
+
+        g_assert_true(g_file_get_contents(path, &contents, NULL, &error));
+        g_assert_no_error(error);
+
+        /* Each record is RS, a JSON object and a newline */
+        g_assert_true(g_str_has_prefix(contents, DF_JSON_RS));
+        records = g_strsplit(contents + 1, DF_JSON_RS, -1);
+        g_assert_cmpuint(g_strv_length(records), ==, n_events);
+
+        for (guint i = 0; i < n_events; i++) {
+                g_autofree gchar *expected = NULL;
+
+                expected = g_strdup_printf(",\"index\":%u,\"name\":\"method \\\"%u\\\"\",\"negative\":-1,"
+                                           "\"ok\":true,\"missing\":null}\n", i, i);
+                g_assert_true(g_str_has_prefix(records[i], "{\"event\":\"test\",\"timestamp\":"));
+                g_assert_true(g_str_has_suffix(records[i], expected));
+        }
+}
+
+static void emit_events(guint n_events)
+{
+        for (guint i = 0; i < n_events; i++) {
+                g_autofree gchar *name = NULL;
+                GString *e;
+
+                name = g_strdup_printf("method \"%u\"", i);
+                e = df_json_event_new("test");
+                df_json_event_add_uint(e, "index", i);
+                df_json_event_add_string(e, "name", name);
+                df_json_event_add_int(e, "negative", -1);
+                df_json_event_add_bool(e, "ok", TRUE);
+                df_json_event_add_string(e, "missing", NULL);
+                df_json_event_emit(e);
+        }
+}
+
+static void test_df_json_stream(void)
+{
+        g_autoptr(GError) error = NULL;
+        g_autoptr(gchar) path = NULL;
+        g_autofree gchar *fd_str = NULL;
+        int fd;
+
+        fd = g_file_open_tmp("test-json-XXXXXX", &path, &error);
+        g_assert_no_error(error);
+        close(fd);
+
+        /* Into a file */
+        g_assert_true(df_json_open(path) == 0);
+        g_assert_true(df_json_is_open());
+        emit_events(1000);
+        g_assert_true(df_json_close() == 0);
+        g_assert_false(df_json_is_open());
+        check_stream(path, 1000);
+
+        /* The file is truncated */
+        g_assert_true(df_json_open(path) == 0);
+        emit_events(3);
+        g_assert_true(df_json_close() == 0);
+        check_stream(path, 3);
+
+        /* Into a file descriptor, which is left open */
+        fd = open(path, O_WRONLY|O_TRUNC|O_CLOEXEC);
+        g_assert_cmpint(fd, >=, 0);
+        fd_str = g_strdup_printf("%d", fd);
+        g_assert_true(df_json_open(fd_str) == 0);
+        emit_events(5);
+        g_assert_true(df_json_close() == 0);
+        g_assert_cmpint(fcntl(fd, F_GETFD), >=, 0);
+        close(fd);
+        check_stream(path, 5);
+
+        /* Events emitted while the stream is closed are ignored */
+        emit_events(1);
+
+        /* Invalid targets */
+        g_assert_true(df_json_open("987654") < 0);
+        g_assert_true(df_json_open("/a/b/c/d/e") < 0);
+        g_assert_false(df_json_is_open());
+
+        (void) g_unlink(path);
+}
+
+static void test_df_json_parse_event(void)
+{
+        static const char * const invalid[] = {
+                "",
+                "[]",
+                "{",
+                "{\"a\"}",
+                "{\"a\":}",
+                "{\"a\":1,}",
+                "{\"a\":1 \"b\":2}",
+                "{\"a\":{}}",
+                "{\"a\":[1]}",
+                "{\"a\":tru}",
+                "{\"a\":truex}",
+                "{\"a\":+1}",
+                "{\"a\":1e}",
+                "{\"a\":\"\\x\"}",
+                "{\"a\":\"\\u00\"}",
+                "{\"a\":\"\\u0000\"}",
+                "{\"a\":\"\\udc00\"}",
+                "{\"a\":\"\\ud800\"}",
+                "{\"a\":\"line\nbreak\"}",
+                "{\"a\":1} {}",
+        };
+        g_autoptr(GHashTable) members = NULL;
+        g_autoptr(GString) event = NULL;
+
+        for (size_t i = 0; i < G_N_ELEMENTS(invalid); i++)
+                g_assert_cmpint(df_json_parse_event(invalid[i], &members), ==, -EINVAL);
+
+        g_assert_cmpint(df_json_parse_event(" { } \n", &members), ==, 0);
+        g_assert_cmpuint(g_hash_table_size(members), ==, 0);
+        g_clear_pointer(&members, g_hash_table_unref);
+
+        /* Round trip of an event as written into the stream */
+        event = df_json_event_new("test");
+        df_json_event_add_string(event, "name", "a \"quoted\" \\ string\n\x01ünïcödé");
+        df_json_event_add_int(event, "negative", -42);
+        df_json_event_add_uint(event, "big", G_MAXUINT64);
+        df_json_event_add_bool(event, "ok", TRUE);
+        df_json_event_add_string(event, "missing", NULL);
+        g_string_append(event, "}\n");
+
+        g_assert_cmpint(df_json_parse_event(event->str, &members), ==, 0);
+        g_assert_cmpuint(g_hash_table_size(members), ==, 7);
+        g_assert_cmpstr(g_hash_table_lookup(members, "event"), ==, "test");
+        g_assert_nonnull(g_hash_table_lookup(members, "timestamp"));
+        g_assert_cmpstr(g_hash_table_lookup(members, "name"), ==, "a \"quoted\" \\ string\n\x01ünïcödé");
+        g_assert_cmpstr(g_hash_table_lookup(members, "negative"), ==, "-42");
+        g_assert_cmpstr(g_hash_table_lookup(members, "big"), ==, "18446744073709551615");
+        g_assert_cmpstr(g_hash_table_lookup(members, "ok"), ==, "true");
+        g_assert_true(g_hash_table_contains(members, "missing"));
+        g_assert_null(g_hash_table_lookup(members, "missing"));
+        g_clear_pointer(&members, g_hash_table_unref);
+
+        /* Escapes which df_json_append_escaped() doesn't produce */
+        g_assert_cmpint(df_json_parse_event("{\"a\" : \"\\/\\b\\f\\u00e9\\ud83d\\ude00\", \"b\":1.5e3}", &members), ==, 0);
+        g_assert_cmpstr(g_hash_table_lookup(members, "a"), ==, "/\b\f\u00e9\U0001F600");
+        g_assert_cmpstr(g_hash_table_lookup(members, "b"), ==, "1.5e3");
+}
+
+int main(int argc, char *argv[])
+{
+        g_test_init(&argc, &argv, NULL);
+
+        g_test_add_func("/df_json/df_json_append_escaped", test_df_json_append_escaped);
+        g_test_add_func("/df_json/df_json_stream", test_df_json_stream);
+        g_test_add_func("/df_json/df_json_parse_event", test_df_json_parse_event);
+
+        return g_test_run();
+}
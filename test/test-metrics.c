@@ -0,0 +1,85 @@
+#include <gio/gio.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "metrics.h"
+#include "util.h"
+
+static void test_df_metrics_file(void)
+{
+        g_autoptr(GError) error = NULL;
+        g_autoptr(gchar) dir = NULL;
+        g_autoptr(gchar) path = NULL;
+        g_autoptr(gchar) contents = NULL;
+        df_metrics_interface_t *progress;
+
+        dir = g_dir_make_tmp("test-metrics-XXXXXX", &error);
+        g_assert_no_error(error);
+        path = g_build_filename(dir, "dfuzzer.prom", NULL);
+
+        /* Everything is a no-op when the metrics are disabled */
+        g_assert_false(df_metrics_is_enabled());
+        g_assert_null(df_metrics_add_interface("/org/foo", "org.foo.Bar", 1));
+        df_metrics_record_call(10);
+        df_metrics_record_crash();
+        g_assert_true(df_metrics_close() == 0);
+
+        g_assert_true(df_metrics_open("/a/b/c/d/e/f.prom", "org.foo") < 0);
+        g_assert_false(df_metrics_is_enabled());
+
+        g_assert_true(df_metrics_open(path, "org.foo") == 0);
+        g_assert_true(df_metrics_is_enabled());
+        /* The file is written right away */
+        g_assert_true(g_file_get_contents(path, &contents, NULL, &error));
+        g_assert_no_error(error);
+        g_assert_nonnull(strstr(contents, "dfuzzer_calls_total 0\n"));
+        g_assert_nonnull(strstr(contents, "dfuzzer_call_duration_seconds{quantile=\"0.5\"} NaN\n"));
+        g_clear_pointer(&contents, g_free);
+
+        progress = df_metrics_add_interface("/org/foo", "org.foo.Bar", 3);
+        g_assert_nonnull(progress);
+        df_metrics_interface_tested(progress);
+        df_metrics_interface_tested(progress);
+        for (guint64 i = 1; i <= 100; i++)
+                df_metrics_record_call(i * 1000);
+        df_metrics_record_exception();
+        df_metrics_record_exception();
+        df_metrics_record_crash();
+        df_metrics_record_finding();
+        df_metrics_set_target_pid(getpid());
+
+        /* The final values are written on close */
+        g_assert_true(df_metrics_close() == 0);
+        g_assert_false(df_metrics_is_enabled());
+        g_assert_true(g_file_get_contents(path, &contents, NULL, &error));
+        g_assert_no_error(error);
+
+        g_assert_nonnull(strstr(contents, "# TYPE dfuzzer_calls_total counter\n"));
+        g_assert_nonnull(strstr(contents, "dfuzzer_info{bus=\"org.foo\"} 1\n"));
+        g_assert_nonnull(strstr(contents, "dfuzzer_calls_total 100\n"));
+        g_assert_nonnull(strstr(contents, "dfuzzer_call_duration_seconds_sum 5.050000\n"));
+        g_assert_nonnull(strstr(contents, "dfuzzer_call_duration_seconds_count 100\n"));
+        g_assert_nonnull(strstr(contents, "dfuzzer_call_duration_seconds{quantile=\"0.5\"} 0.05"));
+        g_assert_nonnull(strstr(contents, "dfuzzer_call_duration_seconds{quantile=\"0.99\"} 0.1"));
+        g_assert_nonnull(strstr(contents, "dfuzzer_exceptions_total 2\n"));
+        g_assert_nonnull(strstr(contents, "dfuzzer_crashes_total 1\n"));
+        g_assert_nonnull(strstr(contents, "dfuzzer_findings_total 1\n"));
+        g_assert_nonnull(strstr(contents, "dfuzzer_interface_members{object=\"/org/foo\",interface=\"org.foo.Bar\"} 3\n"));
+        g_assert_nonnull(strstr(contents, "dfuzzer_interface_members_tested{object=\"/org/foo\",interface=\"org.foo.Bar\"} 2\n"));
+        g_assert_nonnull(strstr(contents, "\ndfuzzer_target_resident_memory_bytes "));
+
+        /* No temporary files are left behind */
+        g_assert_true(g_unlink(path) == 0);
+        g_assert_true(g_rmdir(dir) == 0);
+}
+
+int main(int argc, char *argv[])
+{
+        g_test_init(&argc, &argv, NULL);
+
+        g_test_add_func("/df_metrics/df_metrics_file", test_df_metrics_file);
+
+        return g_test_run();
+}
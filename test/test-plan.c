@@ -0,0 +1,86 @@
+#include <gio/gio.h>
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "plan.h"
+#include "util.h"
+
+static gchar *plan_print(void)
+{
+        g_autoptr(FILE) f = NULL;
+        char *buf = NULL;
+        size_t size = 0;
+
+        f = open_memstream(&buf, &size);
+        g_assert_nonnull(f);
+        df_plan_print(f);
+        g_assert_cmpint(fflush(f), ==, 0);
+        g_clear_pointer(&f, fclose);
+
+        return buf;
+}
+
+static void test_df_plan_print(void)
+{
+        g_autofree gchar *out = NULL;
+
+        df_plan_enable();
+        g_assert_true(df_plan_is_enabled());
+        df_plan_set_latency(TRUE, 250);
+        df_plan_add("method", "org.example", "/org/example", "org.example.Interface", "Foo", "(si)",
+                    24, 24, FALSE);
+        df_plan_add("method", "org.example", "/org/example", "org.example.Interface", "Crash", "()",
+                    10, 0, TRUE);
+        df_plan_add("property", "org.example", "/org/example", "org.example.Interface", "Bar", "(s)",
+                    24, 4, FALSE);
+
+        out = plan_print();
+        g_assert_true(g_str_has_prefix(out, "Kind     Object       Interface             Member Signature "));
+        g_assert_nonnull(strstr(out, "\nmethod   /org/example org.example.Interface Foo    (si)      "
+                                     "        24         24        0.006 no\n"));
+        g_assert_nonnull(strstr(out, "\nmethod   /org/example org.example.Interface Crash  ()        "
+                                     "        10          0        0.000 yes\n"));
+        g_assert_nonnull(strstr(out, "\nproperty /org/example org.example.Interface Bar    (s)       "
+                                     "        24          4        0.001 no\n"));
+        g_assert_nonnull(strstr(out, "\nTotal: 2 methods, 1 properties (1 suppressed), 28 calls, "
+                                     "estimated duration 0.007 s\n"));
+        g_clear_pointer(&out, g_free);
+
+        df_plan_reset();
+        g_assert_false(df_plan_is_enabled());
+}
+
+static void test_df_plan_unknown_latency(void)
+{
+        g_autofree gchar *out = NULL;
+
+        df_plan_enable();
+        out = plan_print();
+        g_assert_cmpstr(out, ==, "Nothing to test\n"
+                                 "Total: 0 methods, 0 properties (0 suppressed), 0 calls, estimated duration - s\n");
+        g_clear_pointer(&out, g_free);
+
+        /* Members added without a known latency have no estimate */
+        df_plan_add("method", "org.example", "/org/example", "org.example.Interface", "Foo", "(si)",
+                    24, 24, FALSE);
+        df_plan_set_latency(TRUE, 100);
+        df_plan_add("method", "org.example", "/org/example", "org.example.Interface", "Bar", "(i)",
+                    24, 24, FALSE);
+        out = plan_print();
+        g_assert_nonnull(strstr(out, " 24            - no\n"));
+        g_assert_nonnull(strstr(out, " 24        0.002 no\n"));
+        g_assert_nonnull(strstr(out, ", 48 calls, estimated duration - s\n"));
+
+        df_plan_reset();
+}
+
+int main(int argc, char *argv[])
+{
+        g_test_init(&argc, &argv, NULL);
+
+        g_test_add_func("/df_plan/df_plan_print", test_df_plan_print);
+        g_test_add_func("/df_plan/df_plan_unknown_latency", test_df_plan_unknown_latency);
+
+        return g_test_run();
+}
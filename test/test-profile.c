@@ -0,0 +1,78 @@
+#include <gio/gio.h>
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "profile.h"
+#include "util.h"
+
+static void test_df_profile_phases(void)
+{
+        g_autofree char *buf = NULL;
+        g_autoptr(FILE) f = NULL;
+        size_t size = 0;
+        guint64 t;
+
+        /* Everything is a no-op when the profiler is disabled */
+        g_assert_false(df_profile_is_enabled());
+        df_profile_begin_test("org.foo.Bar", "Method");
+        df_profile_enter(DF_PROFILE_CALL);
+        df_profile_end_test();
+        g_assert_cmpuint(df_profile_get("org.foo.Bar", "Method", DF_PROFILE_CALL), ==, 0);
+
+        df_profile_enable();
+        g_assert_true(df_profile_is_enabled());
+
+        df_profile_begin_test("org.foo.Bar", "Method");
+        df_profile_enter(DF_PROFILE_CALL);
+        g_usleep(20 * 1000);
+        df_profile_enter(DF_PROFILE_HOOK);
+        g_usleep(10 * 1000);
+        df_profile_end_test();
+        /* Time between tests doesn't belong to any of them */
+        g_usleep(10 * 1000);
+        df_profile_enter(DF_PROFILE_RECOVERY);
+        g_usleep(10 * 1000);
+        df_profile_enter(DF_PROFILE_OTHER);
+        /* Time is accumulated over multiple runs of the same test */
+        df_profile_begin_test("org.foo.Bar", "Method");
+        df_profile_enter(DF_PROFILE_CALL);
+        g_usleep(20 * 1000);
+        df_profile_end_test();
+
+        t = df_profile_get("org.foo.Bar", "Method", DF_PROFILE_CALL);
+        g_assert_cmpuint(t, >=, 40 * 1000 * 1000);
+        g_assert_cmpuint(t, <, 10 * G_GUINT64_CONSTANT(1000000000));
+        g_assert_cmpuint(df_profile_get("org.foo.Bar", "Method", DF_PROFILE_HOOK), >=, 10 * 1000 * 1000);
+        g_assert_cmpuint(df_profile_get("org.foo.Bar", "Method", DF_PROFILE_RECOVERY), ==, 0);
+        g_assert_cmpuint(df_profile_get(NULL, NULL, DF_PROFILE_RECOVERY), >=, 10 * 1000 * 1000);
+        g_assert_cmpuint(df_profile_get(NULL, NULL, DF_PROFILE_OTHER), >=, 10 * 1000 * 1000);
+        g_assert_cmpuint(df_profile_get("org.foo.Bar", "Unknown", DF_PROFILE_CALL), ==, 0);
+
+        f = open_memstream(&buf, &size);
+        g_assert_nonnull(f);
+        df_profile_print(f);
+        g_clear_pointer(&f, fclose);
+
+        g_assert_true(g_str_has_prefix(buf, "Profile (ms)"));
+        g_assert_nonnull(strstr(buf, " generate "));
+        g_assert_nonnull(strstr(buf, "\norg.foo.Bar.Method "));
+        g_assert_nonnull(strstr(buf, "\n(outside tests) "));
+        g_assert_nonnull(strstr(buf, "\nTotal "));
+        g_assert_nonnull(strstr(buf, "\nShare "));
+        g_assert_true(g_str_has_suffix(buf, "100.0%\n"));
+        /* The most expensive test goes first */
+        g_assert_true(strstr(buf, "org.foo.Bar.Method") < strstr(buf, "(outside tests)"));
+
+        df_profile_reset();
+        g_assert_false(df_profile_is_enabled());
+}
+
+int main(int argc, char *argv[])
+{
+        g_test_init(&argc, &argv, NULL);
+
+        g_test_add_func("/df_profile/df_profile_phases", test_df_profile_phases);
+
+        return g_test_run();
+}
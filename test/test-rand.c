@@ -1,6 +1,7 @@
 #include <gio/gio.h>
 #include <glib.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "rand.h"
 #include "util.h"
@@ -106,6 +107,81 @@ static void test_df_rand_GVariant(void)
         }
 }
 
+static void test_df_generate_random_basic(void)
+{
+        static const char *const basic_types[] = {
+                "b", "y", "n", "q", "i", "u", "x", "t", "h", "d", "s", "o", "g", "v",
+        };
+
+        /* Boundary values come first */
+        g_assert_cmpint(df_rand_gint16(0), ==, G_MININT16);
+        g_assert_cmpint(df_rand_gint32(1), ==, G_MAXINT32);
+        g_assert_cmpuint(df_rand_guint64(1), ==, G_MAXUINT64);
+        g_assert_cmpfloat(df_rand_gdouble(2), ==, 0);
+
+        for (size_t i = 0; i < G_N_ELEMENTS(basic_types); i++)
+                for (guint64 iteration = 0; iteration < 16; iteration++) {
+                        g_autoptr(GVariant) variant = NULL;
+
+                        variant = g_variant_ref_sink(df_generate_random_basic(G_VARIANT_TYPE(basic_types[i]), iteration));
+                        g_assert_nonnull(variant);
+                        g_assert_cmpstr(g_variant_get_type_string(variant), ==, basic_types[i]);
+                }
+}
+
+static void test_df_generate_nested(void)
+{
+        for (df_nesting_shape_t shape = 0; shape < _DF_NESTING_SHAPE_MAX; shape++)
+                for (guint depth = 0; depth <= DF_DBUS_MAX_DEPTH + 1; depth++) {
+                        g_autoptr(GVariant) v = NULL;
+                        guint levels = 0;
+
+                        v = g_variant_ref_sink(df_generate_nested(shape, depth, depth));
+                        g_assert_nonnull(v);
+
+                        /* Walk the value down to the innermost integer */
+                        while (!g_variant_is_of_type(v, G_VARIANT_TYPE_UINT32)) {
+                                guint arrays = 0, structs = 0;
+                                GVariant *child;
+
+                                g_assert_true(g_variant_is_container(v));
+                                /* Count the per-signature nesting */
+                                for (const char *p = g_variant_get_type_string(v); *p; p++)
+                                        if (*p == 'a')
+                                                arrays++;
+                                        else if (*p == '(' || *p == '{')
+                                                structs++;
+                                g_assert_cmpuint(arrays, <=, DF_DBUS_MAX_ARRAY_DEPTH);
+                                g_assert_cmpuint(structs, <=, DF_DBUS_MAX_STRUCT_DEPTH);
+
+                                /* Single-element containers only, dict entries are keyed by a string */
+                                g_assert_cmpuint(g_variant_n_children(v), >=, 1);
+                                child = g_variant_get_child_value(v, g_variant_n_children(v) - 1);
+                                g_variant_unref(v);
+                                v = child;
+                                levels++;
+                        }
+
+                        g_assert_cmpuint(levels, <=, MIN(depth, DF_DBUS_MAX_DEPTH));
+                        if (shape == DF_NESTING_VARIANT || shape == DF_NESTING_VARIANT_ARRAY)
+                                g_assert_cmpuint(levels, ==, MIN(depth, DF_DBUS_MAX_DEPTH));
+                }
+}
+
+static void test_df_rand_init_member(void)
+{
+        g_autoptr(GVariant) first = NULL, second = NULL;
+
+        /* The inputs of a member don't depend on what was generated before */
+        df_rand_init_member("/org/foo", "org.foo.Bar", "Method");
+        first = g_variant_ref_sink(df_generate_random_from_signature("(sax)", 7));
+        df_rand_init_member("/org/foo", "org.foo.Bar", "Other");
+        (void) random();
+        df_rand_init_member("/org/foo", "org.foo.Bar", "Method");
+        second = g_variant_ref_sink(df_generate_random_from_signature("(sax)", 7));
+        g_assert_true(g_variant_equal(first, second));
+}
+
 int main(int argc, char *argv[])
 {
         g_test_init(&argc, &argv, NULL);
@@ -125,6 +201,9 @@ int main(int argc, char *argv[])
         g_test_add_func("/df_rand/df_rand_dbus_objpath_string", test_df_rand_dbus_objpath_string);
         g_test_add_func("/df_rand/df_rand_dbus_signature_string", test_df_rand_dbus_signature_string);
         g_test_add_func("/df_rand/df_rand_GVariant", test_df_rand_GVariant);
+        g_test_add_func("/df_rand/df_generate_random_basic", test_df_generate_random_basic);
+        g_test_add_func("/df_rand/df_generate_nested", test_df_generate_nested);
+        g_test_add_func("/df_rand/df_rand_init_member", test_df_rand_init_member);
 
         return g_test_run();
 }
@@ -0,0 +1,89 @@
+#include <errno.h>
+#include <gio/gio.h>
+#include <glib.h>
+
+#include "shard.h"
+#include "util.h"
+
+static void test_df_shard_parse(void)
+{
+        static const char * const invalid[] = {
+                "", "1", "/", "1/", "/1", "0/1", "2/1", "1/0", "-1/2", "1/-2", "a/b", "1/2/3", " 1/2", "1/65537",
+        };
+        guint index, count;
+
+        for (size_t i = 0; i < G_N_ELEMENTS(invalid); i++)
+                g_assert_cmpint(df_shard_parse(invalid[i], &index, &count), ==, -EINVAL);
+
+        g_assert_cmpint(df_shard_parse("1/1", &index, &count), ==, 0);
+        g_assert_cmpuint(index, ==, 1);
+        g_assert_cmpuint(count, ==, 1);
+        g_assert_cmpint(df_shard_parse("3/4", &index, &count), ==, 0);
+        g_assert_cmpuint(index, ==, 3);
+        g_assert_cmpuint(count, ==, 4);
+        g_assert_cmpint(df_shard_parse("65536/65536", &index, &count), ==, 0);
+}
+
+static void test_df_shard_owns(void)
+{
+        static const guint shard_counts[] = { 1, 2, 3, 7, 16 };
+        g_autoptr(gchar) shard = NULL;
+        guint seen[16] = {};
+        unsigned int seed;
+
+        /* Everything is tested without --shard= */
+        g_assert_false(df_shard_is_enabled());
+        g_assert_null(df_shard_to_string());
+        g_assert_true(df_shard_owns("/", "org.example", "Method"));
+        g_assert_cmpuint(df_shard_seed(1234), ==, 1234);
+
+        /* The hash is stable and covers all the parts */
+        g_assert_cmpuint(df_shard_hash("/a", "b", "c"), ==, df_shard_hash("/a", "b", "c"));
+        g_assert_cmpuint(df_shard_hash("/a", "b", "c"), !=, df_shard_hash("/a", "bc", ""));
+        g_assert_cmpuint(df_shard_hash("/a", "b", "c"), !=, df_shard_hash("/a", "c", "b"));
+
+        /* Each member belongs to exactly one shard */
+        for (size_t i = 0; i < G_N_ELEMENTS(shard_counts); i++)
+                for (guint m = 0; m < 1000; m++) {
+                        g_autoptr(gchar) member = g_strdup_printf("Method%u", m);
+                        guint owners = 0;
+
+                        for (guint k = 1; k <= shard_counts[i]; k++) {
+                                df_shard_set(k, shard_counts[i]);
+                                if (df_shard_owns("/org/example", "org.example.Interface", member)) {
+                                        owners++;
+                                        if (shard_counts[i] == 16)
+                                                seen[k - 1]++;
+                                }
+                        }
+
+                        g_assert_cmpuint(owners, ==, 1);
+                }
+
+        /* ... and the members are spread over all shards */
+        for (guint k = 0; k < 16; k++)
+                g_assert_cmpuint(seen[k], >, 1000 / 16 / 2);
+
+        df_shard_set(2, 4);
+        g_assert_true(df_shard_is_enabled());
+        shard = df_shard_to_string();
+        g_assert_cmpstr(shard, ==, "2/4");
+
+        /* Each shard has its own seed */
+        g_assert_cmpuint(df_shard_seed(1234), ==, df_shard_seed(1234));
+        g_assert_cmpuint(df_shard_seed(1234), !=, 1234);
+        g_assert_cmpuint(df_shard_seed(1234), !=, df_shard_seed(1235));
+        seed = df_shard_seed(1234);
+        df_shard_set(3, 4);
+        g_assert_cmpuint(df_shard_seed(1234), !=, seed);
+}
+
+int main(int argc, char *argv[])
+{
+        g_test_init(&argc, &argv, NULL);
+
+        g_test_add_func("/df_shard/df_shard_parse", test_df_shard_parse);
+        g_test_add_func("/df_shard/df_shard_owns", test_df_shard_owns);
+
+        return g_test_run();
+}
@@ -0,0 +1,131 @@
+#include <gio/gio.h>
+#include <glib.h>
+#include <stdio.h>
+
+#include "stats.h"
+#include "util.h"
+
+static void test_df_stats_buckets(void)
+{
+        guint last = 0;
+
+        /* Small values are exact */
+        for (guint64 i = 0; i < DF_STATS_SUB_BUCKETS; i++) {
+                g_assert_cmpuint(df_stats_bucket_index(i), ==, i);
+                g_assert_cmpuint(df_stats_bucket_value(i), ==, i);
+        }
+
+        /* Buckets are monotonic and each value falls into its own bucket with
+         * a relative error of at most 1/DF_STATS_SUB_BUCKETS */
+        for (guint64 v = 1; v < G_GUINT64_CONSTANT(1) << DF_STATS_MAX_BITS; v += v / 7 + 1) {
+                guint index = df_stats_bucket_index(v);
+                guint64 upper = df_stats_bucket_value(index);
+
+                g_assert_cmpuint(index, <, DF_STATS_BUCKETS);
+                g_assert_cmpuint(index, >=, last);
+                g_assert_cmpuint(upper, >=, v);
+                g_assert_cmpuint(upper - v, <=, v / DF_STATS_SUB_BUCKETS);
+                if (index > 0)
+                        g_assert_cmpuint(df_stats_bucket_value(index - 1), <, v);
+                last = index;
+        }
+
+        /* Bucket boundaries map back to their own bucket */
+        for (guint i = 0; i < DF_STATS_BUCKETS; i++)
+                g_assert_cmpuint(df_stats_bucket_index(df_stats_bucket_value(i)), ==, i);
+
+        /* Huge values are clamped into the last bucket */
+        g_assert_cmpuint(df_stats_bucket_index(G_MAXUINT64), ==, DF_STATS_BUCKETS - 1);
+}
+
+static void test_df_stats_percentiles(void)
+{
+        df_stats_method_t *m;
+
+        m = df_stats_get_method("org.foo.Bar", "Method");
+        g_assert_true(df_stats_get_method("org.foo.Bar", "Method") == m);
+        g_assert_cmpstr(m->name, ==, "org.foo.Bar.Method");
+        g_assert_cmpuint(df_stats_method_percentile(m, 50), ==, 0);
+
+        for (guint64 i = 1; i <= 1000; i++)
+                df_stats_record_call(m, i * 100);
+
+        g_assert_cmpuint(m->calls, ==, 1000);
+        g_assert_cmpuint(m->min, ==, 100);
+        g_assert_cmpuint(m->max, ==, 100000);
+        g_assert_cmpuint(m->total, ==, 100 * 1000 * 1001 / 2);
+
+        for (guint p = 10; p < 100; p += 10) {
+                guint64 expected = p * 1000, v = df_stats_method_percentile(m, p);
+
+                g_assert_cmpuint(v, >=, expected);
+                g_assert_cmpuint(v - expected, <=, expected / DF_STATS_SUB_BUCKETS);
+        }
+        g_assert_cmpuint(df_stats_method_percentile(m, 0), >=, 100);
+        g_assert_cmpuint(df_stats_method_percentile(m, 0), <=, 100 + 100 / DF_STATS_SUB_BUCKETS);
+        g_assert_cmpuint(df_stats_method_percentile(m, 100), ==, 100000);
+
+        df_stats_reset();
+}
+
+static void test_df_stats_print(void)
+{
+        g_autofree char *buf = NULL;
+        g_autoptr(FILE) f = NULL;
+        df_stats_method_t *fast, *slow;
+        size_t size = 0;
+
+        /* Nothing to print */
+        f = open_memstream(&buf, &size);
+        g_assert_nonnull(f);
+        df_stats_print(f);
+        g_clear_pointer(&f, fclose);
+        g_assert_cmpuint(size, ==, 0);
+        g_clear_pointer(&buf, g_free);
+
+        fast = df_stats_get_method("org.foo.Bar", "Fast");
+        slow = df_stats_get_method("org.foo.Bar", "Slow");
+        df_stats_record_call(fast, 10);
+        df_stats_record_call(slow, 1000);
+        df_stats_record_call(slow, 2000);
+        df_stats_record_error(slow, "org.freedesktop.DBus.Error.InvalidArgs", FALSE);
+        df_stats_record_error(slow, "org.freedesktop.DBus.Error.Timeout", TRUE);
+        df_stats_record_error(fast, "org.freedesktop.DBus.Error.InvalidArgs", FALSE);
+        df_stats_record_crash(slow);
+        /* Calls outside of method tests are ignored */
+        df_stats_record_error(NULL, "org.freedesktop.DBus.Error.Failed", FALSE);
+        df_stats_record_crash(NULL);
+
+        g_assert_cmpuint(slow->errors, ==, 2);
+        g_assert_cmpuint(slow->timeouts, ==, 1);
+        g_assert_cmpuint(slow->crashes, ==, 1);
+        g_assert_cmpuint(fast->errors, ==, 1);
+
+        f = open_memstream(&buf, &size);
+        g_assert_nonnull(f);
+        df_stats_print(f);
+        g_clear_pointer(&f, fclose);
+
+        /* The slowest method goes first, the most frequent error too */
+        g_assert_true(g_str_has_prefix(buf, "Method"));
+        g_assert_nonnull(strstr(buf, "org.foo.Bar.Slow"));
+        g_assert_true(strstr(buf, "org.foo.Bar.Slow") < strstr(buf, "org.foo.Bar.Fast"));
+        g_assert_nonnull(strstr(buf, "Total: 3 calls"));
+        g_assert_nonnull(strstr(buf, "         2  org.freedesktop.DBus.Error.InvalidArgs\n"));
+        g_assert_nonnull(strstr(buf, "         1  org.freedesktop.DBus.Error.Timeout\n"));
+        g_assert_null(strstr(buf, "org.freedesktop.DBus.Error.Failed"));
+        g_assert_true(strstr(buf, "InvalidArgs") < strstr(buf, "Error.Timeout"));
+
+        df_stats_reset();
+}
+
+int main(int argc, char *argv[])
+{
+        g_test_init(&argc, &argv, NULL);
+
+        g_test_add_func("/df_stats/df_stats_buckets", test_df_stats_buckets);
+        g_test_add_func("/df_stats/df_stats_percentiles", test_df_stats_percentiles);
+        g_test_add_func("/df_stats/df_stats_print", test_df_stats_print);
+
+        return g_test_run();
+}
@@ -0,0 +1,73 @@
+#include <gio/gio.h>
+#include <glib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "trace.h"
+#include "util.h"
+
+static gpointer test_df_trace_thread(gpointer data)
+{
+        df_trace_span("call", "FromThread", 10, 20, NULL);
+
+        return NULL;
+}
+
+static void test_df_trace_spans(void)
+{
+        g_autoptr(GError) error = NULL;
+        g_autoptr(gchar) path = NULL;
+        g_autoptr(gchar) buf = NULL;
+        g_autoptr(gchar) expected = NULL;
+        fd_t fd;
+
+        /* Spans are dropped when the trace is not open */
+        g_assert_false(df_trace_is_enabled());
+        df_trace_span("call", "Dropped", 0, 1, NULL);
+        g_assert_cmpint(df_trace_close(), ==, 0);
+
+        fd = g_file_open_tmp("dfuzzer-test-trace-XXXXXX", &path, &error);
+        g_assert_no_error(error);
+        close(fd);
+
+        g_assert_cmpint(df_trace_open(path), ==, 0);
+        g_assert_true(df_trace_is_enabled());
+        df_trace_span("test", "Method", 100, 250, "PASS");
+        df_trace_span("call", "Quote\"d", 300, 200, NULL);
+        g_thread_join(g_thread_new("trace", test_df_trace_thread, NULL));
+        /* Enough spans to flush the buffer at least once */
+        for (int i = 0; i < 2000; i++)
+                df_trace_span("call", "Method", i, i + 1, NULL);
+        g_assert_cmpint(df_trace_close(), ==, 0);
+        g_assert_false(df_trace_is_enabled());
+
+        g_assert_true(g_file_get_contents(path, &buf, NULL, &error));
+        g_assert_no_error(error);
+        g_assert_true(g_str_has_prefix(buf, "[\n{\"ph\":\"M\""));
+        g_assert_true(g_str_has_suffix(buf, "}\n]\n"));
+        g_assert_null(strstr(buf, "Dropped"));
+
+        expected = g_strdup_printf("{\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"name\":\"Method\",\"cat\":\"test\","
+                                   "\"ts\":100,\"dur\":150,\"args\":{\"detail\":\"PASS\"}}",
+                                   getpid(), getpid());
+        g_assert_nonnull(strstr(buf, expected));
+        /* Names are escaped and negative durations are clamped */
+        g_assert_nonnull(strstr(buf, "\"name\":\"Quote\\\"d\",\"cat\":\"call\",\"ts\":300,\"dur\":0}"));
+        /* Spans from other threads have their own tid */
+        g_clear_pointer(&expected, g_free);
+        expected = g_strdup_printf("\"tid\":%d,\"name\":\"FromThread\"", getpid());
+        g_assert_nonnull(strstr(buf, "\"name\":\"FromThread\""));
+        g_assert_null(strstr(buf, expected));
+        g_assert_nonnull(strstr(buf, "\"ts\":1999,\"dur\":1}\n]\n"));
+
+        unlink(path);
+}
+
+int main(int argc, char *argv[])
+{
+        g_test_init(&argc, &argv, NULL);
+
+        g_test_add_func("/df_trace/df_trace_spans", test_df_trace_spans);
+
+        return g_test_run();
+}